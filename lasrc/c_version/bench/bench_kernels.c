@@ -0,0 +1,1125 @@
+/*****************************************************************************
+FILE: bench_kernels.c
+
+PURPOSE: Times the LaSRC LUT and auxiliary readers and the per-pixel
+atmospheric correction, aerosol inversion, and aerosol interpolation kernels
+on a synthetic scene, and reports their throughput.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The LUT and auxiliary fixtures are generated by gen_synthetic (or may be
+   the real auxiliary tree) and the scene is generated in memory, so no real
+   Level-1 scene is needed.
+2. Each kernel is run --reps times on the same inputs and the best time is
+   reported, along with the throughput in items (pixels, pixel-bands,
+   aerosol windows, or LUT/CMG values) per second and per second per core.
+   The checksum of the kernel outputs is reported so changes in the results
+   are noticed along with changes in the timing.
+3. The gaseous absorption coefficients are all zero, so the kernels see the
+   same atmosphere that was used to build the synthetic scene.
+*****************************************************************************/
+#include <getopt.h>
+#include <sys/time.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+#include "synth_scene.h"
+#include "synth_fixtures.h"
+#include "lasrc_lib.h"
+#include "aero_interp.h"
+#include "poly_coeff.h"
+#include "first_touch.h"
+
+/* Default number of repetitions of each kernel */
+#define DEFAULT_REPS 3
+
+/* Look-up tables and per-band coefficients used by the kernels */
+typedef struct {
+    float *tsmax;        /* maximum scattering angle table */
+    float *tsmin;        /* minimum scattering angle table */
+    float *ttv;          /* view angle table */
+    float *nbfic;        /* cumulative number of azimuth angles */
+    float *nbfi;         /* number of azimuth angles */
+    float *tts;          /* sun angle table */
+    int32 *indts;        /* index for the sun angle table */
+    float *rolutt;       /* intrinsic reflectance table */
+    float *transt;       /* transmission table */
+    float *sphalbt;      /* spherical albedo table */
+    float *normext;      /* aerosol extinction coefficient table */
+    float tgo_arr[NREFL_BANDS];        /* per-band gaseous transmittance */
+    float xrorayp_arr[NREFL_BANDS];    /* per-band Rayleigh reflectance */
+    int roatm_iaMax[NREFL_BANDS];      /* per-band roatm AOT limit */
+    float roatm_coef[NREFL_BANDS][NCOEF];  /* roatm coefficients */
+    float ttatmg_coef[NREFL_BANDS][NCOEF]; /* ttatmg coefficients */
+    float satm_coef[NREFL_BANDS][NCOEF];   /* satm coefficients */
+    float normext_p0a3_arr[NREFL_BANDS];   /* normext[iband][0][3] */
+} Bench_luts_t;
+
+/* AOT and pressure tables, as used by compute_l8_sr_refl */
+static float aot550nm[NAOT_VALS] = {0.01, 0.05, 0.10, 0.15, 0.20, 0.30, 0.40,
+    0.60, 0.80, 1.00, 1.20, 1.40, 1.60, 1.80, 2.00, 2.30, 2.60, 3.00, 3.50,
+    4.00, 4.50, 5.00};
+static float tpres[NPRES_VALS] = {1050.0, 1013.0, 900.0, 800.0, 700.0,
+    600.0, 500.0};
+
+/******************************************************************************
+MODULE:  usage
+
+PURPOSE:  Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("bench_kernels times the LaSRC LUT/auxiliary readers and the "
+            "atmospheric correction, aerosol inversion, and aerosol "
+            "interpolation kernels on an in-memory synthetic scene.\n\n");
+
+    printf ("usage: bench_kernels --fixture_dir=dir [--sat=l8|s2] "
+            "[--aux=filename] [--nlines=n] [--nsamps=n] [--fill=frac] "
+            "[--cloud=frac] [--water=frac] [--aot=aot] [--seed=n] "
+            "[--reps=n]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -fixture_dir: directory containing the LUT directory, the "
+            "CMG files, and the LADS auxiliary directory, as written by "
+            "gen_synthetic\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -sat: satellite, l8 (default) or s2\n");
+    printf ("    -aux: name of the auxiliary file (default %s)\n",
+            "L8ANC" SYNTH_AUX_DATE ".hdf_fused");
+    printf ("    -nlines, -nsamps: size of the scene (default 2048 x 2048 "
+            "for L8, 2046 x 2046 for S2)\n");
+    printf ("    -fill, -cloud, -water, -aot, -seed: synthetic scene "
+            "parameters, as for gen_synthetic\n");
+    printf ("    -reps: number of repetitions of each kernel; the best time "
+            "is reported (default %d)\n", DEFAULT_REPS);
+}
+
+
+/******************************************************************************
+MODULE:  wall_time
+
+PURPOSE:  Returns the wall clock time in seconds.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+time            Wall clock time (seconds)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double wall_time ()
+{
+#ifdef _OPENMP
+    return (omp_get_wtime ());
+#else
+    struct timeval tv;   /* current time */
+
+    gettimeofday (&tv, NULL);
+    return (tv.tv_sec + tv.tv_usec * 1.0e-6);
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  report
+
+PURPOSE:  Prints the timing and throughput of a kernel.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void report
+(
+    char *kernel,        /* I: name of the kernel */
+    char *unit,          /* I: name of the items processed */
+    double nitems,       /* I: number of items processed per run */
+    double best,         /* I: best run time (seconds) */
+    double checksum      /* I: checksum of the kernel results */
+)
+{
+    int nthreads = 1;    /* number of threads */
+    double rate;         /* items per second */
+
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads ();
+#endif
+    rate = (best > 0.0) ? nitems / best : 0.0;
+    printf ("%-24s %12.0f %-12s %10.4f s %14.4g /s %14.4g /s/core  "
+        "checksum %.6g\n", kernel, nitems, unit, best, rate,
+        rate / nthreads, checksum);
+}
+
+
+/******************************************************************************
+MODULE:  alloc_luts
+
+PURPOSE:  Allocates the look-up tables.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The sun angle tables are read from NVIEW_ZEN_VALS x NSOLAR_ZEN_VALS
+   SDSs, so they are allocated at that size.
+******************************************************************************/
+static int alloc_luts
+(
+    Bench_luts_t *luts   /* O: look-up tables */
+)
+{
+    char FUNC_NAME[] = "alloc_luts";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nangle = NVIEW_ZEN_VALS * NSOLAR_ZEN_VALS;  /* angle table size */
+
+    luts->tsmax = calloc (nangle, sizeof (float));
+    luts->tsmin = calloc (nangle, sizeof (float));
+    luts->ttv = calloc (nangle, sizeof (float));
+    luts->nbfic = calloc (nangle, sizeof (float));
+    luts->nbfi = calloc (nangle, sizeof (float));
+    luts->tts = calloc (nangle, sizeof (float));
+    luts->indts = calloc (nangle, sizeof (int32));
+    luts->rolutt = calloc ((size_t) NSR_BANDS * NPRES_VALS * NAOT_VALS *
+        NSOLAR_VALS, sizeof (float));
+    luts->transt = calloc ((size_t) NSR_BANDS * NPRES_VALS * NAOT_VALS *
+        NSUNANGLE_VALS, sizeof (float));
+    luts->sphalbt = calloc (NSR_BANDS * NPRES_VALS * NAOT_VALS,
+        sizeof (float));
+    luts->normext = calloc (NSR_BANDS * NPRES_VALS * NAOT_VALS,
+        sizeof (float));
+    if (luts->tsmax == NULL || luts->tsmin == NULL || luts->ttv == NULL ||
+        luts->nbfic == NULL || luts->nbfi == NULL || luts->tts == NULL ||
+        luts->indts == NULL || luts->rolutt == NULL || luts->transt == NULL ||
+        luts->sphalbt == NULL || luts->normext == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the look-up tables");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  bench_readluts
+
+PURPOSE:  Times readluts.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the look-up tables
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The look-up tables are left populated for the remaining kernels.
+******************************************************************************/
+static int bench_readluts
+(
+    Lasrc_ctx_t *ctx,    /* I: context with the LUT filenames */
+    int reps,            /* I: number of repetitions */
+    Bench_luts_t *luts   /* O: look-up tables */
+)
+{
+    char FUNC_NAME[] = "bench_readluts";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int rep;                 /* looping variable for repetitions */
+    int nbands;              /* number of LUT bands */
+    double start;            /* start time of the run */
+    double elapsed;          /* run time */
+    double best = -1.0;      /* best run time */
+    double nvals;            /* number of LUT values read */
+
+    for (rep = 0; rep < reps; rep++)
+    {
+        start = wall_time ();
+        if (readluts (ctx->sat, luts->tsmax, luts->tsmin, luts->ttv,
+            luts->tts, luts->nbfic, luts->nbfi, luts->indts, luts->rolutt,
+            luts->transt, luts->sphalbt, luts->normext, 4.0, 0.0,
+            ctx->anglehdf, ctx->intrefnm, ctx->transmnm, ctx->spheranm)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the look-up tables");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+
+    nbands = (ctx->sat == SAT_LANDSAT_8) ? NSR_L8_BANDS : NSR_S2_BANDS;
+    nvals = (double) nbands * NPRES_VALS * NAOT_VALS *
+        (NSOLAR_VALS + NSUNANGLE_VALS + 2);
+    report ("readluts", "LUT values", nvals, best,
+        luts->rolutt[0] + luts->transt[0] + luts->sphalbt[0]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  bench_read_aux
+
+PURPOSE:  Times read_auxiliary_files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the auxiliary files
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The CMG arrays are only needed for the timing and are freed on return.
+******************************************************************************/
+static int bench_read_aux
+(
+    Lasrc_ctx_t *ctx,    /* I: context with the auxiliary filenames */
+    int reps             /* I: number of repetitions */
+)
+{
+    char FUNC_NAME[] = "bench_read_aux";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for CMG arrays */
+    int rep;                 /* looping variable for repetitions */
+    int retval = SUCCESS;    /* return status */
+    size_t npix = (size_t) CMG_NBLAT * CMG_NBLON;  /* pixels in a CMG grid */
+    double start;            /* start time of the run */
+    double elapsed;          /* run time */
+    double best = -1.0;      /* best run time */
+    int16 *cmg[12];          /* DEM and ratio CMG arrays */
+    uint16 *wv = NULL;       /* water vapor CMG */
+    uint8 *oz = NULL;        /* ozone CMG */
+
+    for (i = 0; i < 12; i++)
+        cmg[i] = calloc (npix, sizeof (int16));
+    wv = calloc (npix, sizeof (uint16));
+    oz = calloc (npix, sizeof (uint8));
+    for (i = 0; i < 12; i++)
+        if (cmg[i] == NULL)
+            retval = ERROR;
+    if (retval != SUCCESS || wv == NULL || oz == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the CMG arrays");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (rep = 0; rep < reps; rep++)
+    {
+        start = wall_time ();
+        if (read_auxiliary_files (ctx->cmgdemnm, ctx->rationm, ctx->auxnm,
+            cmg[0], cmg[1], cmg[2], cmg[3], cmg[4], cmg[5], cmg[6], cmg[7],
+            cmg[8], cmg[9], cmg[10], cmg[11], wv, oz) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the auxiliary files");
+            error_handler (true, FUNC_NAME, errmsg);
+            retval = ERROR;
+            break;
+        }
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+
+    if (retval == SUCCESS)
+        report ("read_auxiliary_files", "CMG values", 14.0 * npix, best,
+            cmg[0][npix/2] + cmg[1][npix/2] + wv[npix/2] + oz[npix/2]);
+
+    for (i = 0; i < 12; i++)
+        free (cmg[i]);
+    free (wv);
+    free (oz);
+
+    return (retval);
+}
+
+
+/******************************************************************************
+MODULE:  compute_coefficients
+
+PURPOSE:  Computes the per-band polynomial coefficients of the atmospheric
+parameters for the synthetic scene geometry, as compute_l8_sr_refl and
+compute_s2_sr_refl do.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the atmospheric parameters
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int compute_coefficients
+(
+    Sat_t sat,           /* I: satellite */
+    Bench_luts_t *luts   /* I/O: look-up tables; coefficients are updated */
+)
+{
+    char FUNC_NAME[] = "compute_coefficients";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int ib, ia;              /* looping variables for bands and AOTs */
+    int nbands;              /* number of reflectance bands */
+    int iaMaxTemp;           /* roatm AOT limit */
+    float xts, xtv;          /* solar and view zenith angles (deg) */
+    float xmus, xmuv;        /* cosine of solar and view zenith angles */
+    float xfi, cosxfi;       /* azimuthal difference and its cosine */
+    float roslamb, tgo, roatm, ttatmg, satm, xrorayp, next;
+                             /* atmcorlamb2 outputs */
+    float tauray[NSR_BANDS]; /* molecular optical thickness */
+    double nogas[NSR_BANDS]; /* zero gaseous absorption coefficients */
+    float roatm_arr[NAOT_VALS];   /* roatm for each AOT */
+    float ttatmg_arr[NAOT_VALS];  /* ttatmg for each AOT */
+    float satm_arr[NAOT_VALS];    /* satm for each AOT */
+
+    nbands = (sat == SAT_LANDSAT_8) ? NREFL_L8_BANDS : NREFL_S2_BANDS;
+    for (ib = 0; ib < NSR_BANDS; ib++)
+    {
+        nogas[ib] = 0.0;
+        tauray[ib] = (ib < nbands) ?
+            synth_rayleigh_tau (synth_band_wavelength (sat, ib)) : 0.0;
+    }
+
+    xts = SYNTH_SUN_ZEN;
+    xmus = cos (xts * DEG2RAD);
+    xtv = SYNTH_VIEW_ZEN;
+    xmuv = cos (xtv * DEG2RAD);
+    xfi = acos (cos ((SYNTH_SUN_AZ - SYNTH_VIEW_AZ) * DEG2RAD));
+    cosxfi = cos (xfi);
+    xfi *= RAD2DEG;
+    if (sat == SAT_LANDSAT_8)
+    {
+        xfi = 0.0;
+        cosxfi = 1.0;
+    }
+
+    for (ib = 0; ib < nbands; ib++)
+    {
+        luts->normext_p0a3_arr[ib] = luts->normext[ib * NPRES_VALS *
+            NAOT_VALS + 3];
+        for (ia = 0; ia < NAOT_VALS; ia++)
+        {
+            if (atmcorlamb2 (sat, xts, xtv, xmus, xmuv, xfi, cosxfi,
+                aot550nm[ia], ib, SYNTH_PRES, tpres, aot550nm, luts->rolutt,
+                luts->transt, 4.0, 0.0, SYNTH_XTVSTEP, SYNTH_XTVMIN,
+                luts->sphalbt, luts->normext, luts->tsmax, luts->tsmin,
+                luts->nbfic, luts->nbfi, luts->tts, luts->indts, luts->ttv,
+                0.3, 1.5, tauray, nogas, nogas, nogas, nogas, nogas, nogas,
+                0.0, &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next,
+                2.5) != SUCCESS)
+            {
+                sprintf (errmsg, "Computing the atmospheric parameters for "
+                    "band %d", ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            roatm_arr[ia] = roatm;
+            ttatmg_arr[ia] = ttatmg;
+            satm_arr[ia] = satm;
+        }
+        luts->tgo_arr[ib] = tgo;
+        luts->xrorayp_arr[ib] = xrorayp;
+
+        /* Fit roatm only up to the AOT where it stops increasing */
+        iaMaxTemp = 1;
+        for (ia = 1; ia < NAOT_VALS; ia++)
+        {
+            if (ia == NAOT_VALS-1)
+                iaMaxTemp = NAOT_VALS-1;
+
+            if ((roatm_arr[ia] - roatm_arr[ia-1]) > ESPA_EPSILON)
+                continue;
+            else
+            {
+                iaMaxTemp = ia-1;
+                break;
+            }
+        }
+        luts->roatm_iaMax[ib] = iaMaxTemp;
+        get_3rd_order_poly_coeff (aot550nm, roatm_arr, iaMaxTemp,
+            luts->roatm_coef[ib]);
+        get_3rd_order_poly_coeff (aot550nm, ttatmg_arr, NAOT_VALS,
+            luts->ttatmg_coef[ib]);
+        get_3rd_order_poly_coeff (aot550nm, satm_arr, NAOT_VALS,
+            luts->satm_coef[ib]);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  bench_atmcorlamb2
+
+PURPOSE:  Times the reference or fast-math per-pixel atmospheric correction
+over the clear and water pixels of the scene.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The TOA reflectance is taken from synth_toa_refl for each pixel-band, as
+   a float, so the timing does not include the band unpacking.
+******************************************************************************/
+static void bench_atmcorlamb2
+(
+    Synth_scene_t *scene,    /* I: synthetic scene */
+    Bench_luts_t *luts,      /* I: look-up tables and coefficients */
+    float **toa,             /* I: unscaled TOA reflectance per band */
+    Atmcorlamb2_func_t func, /* I: atmospheric correction routine */
+    char *name,              /* I: name of the routine for the report */
+    int reps                 /* I: number of repetitions */
+)
+{
+    int ib;              /* looping variable for bands */
+    int rep;             /* looping variable for repetitions */
+    int nbands;          /* number of reflectance bands */
+    long pix;            /* looping variable for pixels */
+    long npix = (long) scene->nlines * scene->nsamps;  /* scene pixels */
+    long ncorr = 0;      /* number of corrected pixel-bands */
+    float roslamb;       /* surface reflectance */
+    double checksum = 0.0;   /* sum of the surface reflectances */
+    double start;        /* start time of the run */
+    double elapsed;      /* run time */
+    double best = -1.0;  /* best run time */
+
+    nbands = (scene->sat == SAT_LANDSAT_8) ? NREFL_L8_BANDS : NREFL_S2_BANDS;
+    for (rep = 0; rep < reps; rep++)
+    {
+        checksum = 0.0;
+        ncorr = 0;
+        start = wall_time ();
+#ifdef _OPENMP
+        #pragma omp parallel for private (ib, roslamb) \
+            reduction (+:checksum, ncorr) schedule (static, 4096)
+#endif
+        for (pix = 0; pix < npix; pix++)
+        {
+            if (scene->class_map[pix] == SYNTH_FILL ||
+                scene->class_map[pix] == SYNTH_CLOUD)
+                continue;
+
+            for (ib = 0; ib < nbands; ib++)
+            {
+                func (scene->sat, luts->tgo_arr[ib], luts->xrorayp_arr[ib],
+                    aot550nm[luts->roatm_iaMax[ib]], luts->roatm_coef[ib],
+                    luts->ttatmg_coef[ib], luts->satm_coef[ib], scene->aot,
+                    ib, luts->normext_p0a3_arr[ib], toa[ib][pix], &roslamb,
+                    DEFAULT_EPS);
+                checksum += roslamb;
+                ncorr++;
+            }
+        }
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+
+    report (name, "pixel-bands", ncorr, best, checksum);
+}
+
+
+/******************************************************************************
+MODULE:  bench_subaeroret
+
+PURPOSE:  Times the reference aerosol inversion at the aerosol windows of the
+scene, and fills the aerosol and ipflag arrays for the interpolation
+kernels.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. L8 inverts the center pixel of each 3x3 window and S2 the UL pixel of
+   each 6x6 window, which is where the interpolation kernels expect the
+   retrieved values.
+2. The band ratios are the constant values of the synthetic ratio CMG, and
+   only the low eps retrieval is timed.
+******************************************************************************/
+static void bench_subaeroret
+(
+    Synth_scene_t *scene,    /* I: synthetic scene */
+    Bench_luts_t *luts,      /* I: look-up tables and coefficients */
+    float **toa,             /* I: unscaled TOA reflectance per band */
+    int reps,                /* I: number of repetitions */
+    uint8 *ipflag,           /* O: aerosol QA at the aerosol windows */
+    float *taero             /* O: aerosol at the aerosol windows */
+)
+{
+    int ib;              /* looping variable for bands */
+    int rep;             /* looping variable for repetitions */
+    int line, samp;      /* looping variables for the windows */
+    int window;          /* size of the aerosol window */
+    int offset;          /* offset of the inverted pixel in the window */
+    int iband1, iband3;  /* red and coastal aerosol band indices */
+    int blue_band;       /* blue band index */
+    int swir_band;       /* SWIR band index */
+    int iaots;           /* AOT index carried between calls */
+    long nwin = 0;       /* number of inverted windows */
+    size_t pix;          /* pixel inverted for the current window */
+    float erelc[NSR_BANDS];   /* band ratios */
+    float troatm[NSR_BANDS];  /* TOA reflectance of the ratio bands */
+    float raot;          /* retrieved AOT */
+    float residual;      /* model residual */
+    double checksum = 0.0;    /* sum of the retrieved AOTs */
+    double start;        /* start time of the run */
+    double elapsed;      /* run time */
+    double best = -1.0;  /* best run time */
+
+    if (scene->sat == SAT_LANDSAT_8)
+    {
+        window = L8_AERO_WINDOW;
+        offset = L8_HALF_AERO_WINDOW;
+        iband1 = DN_L8_BAND4;
+        iband3 = DN_L8_BAND1;
+        blue_band = DN_L8_BAND2;
+        swir_band = DN_L8_BAND7;
+    }
+    else
+    {
+        window = S2_AERO_WINDOW;
+        offset = 0;
+        iband1 = DN_S2_BAND4;
+        iband3 = DN_S2_BAND1;
+        blue_band = DN_S2_BAND2;
+        swir_band = DN_S2_BAND12;
+    }
+
+    for (rep = 0; rep < reps; rep++)
+    {
+        checksum = 0.0;
+        nwin = 0;
+        start = wall_time ();
+#ifdef _OPENMP
+        #pragma omp parallel for private (samp, ib, pix, erelc, troatm, \
+            raot, residual, iaots) reduction (+:checksum, nwin) \
+            schedule (dynamic)
+#endif
+        for (line = offset; line < scene->nlines; line += window)
+        {
+            for (samp = offset; samp < scene->nsamps; samp += window)
+            {
+                pix = (size_t) line * scene->nsamps + samp;
+                if (scene->class_map[pix] == SYNTH_FILL)
+                {
+                    ipflag[pix] = (1 << IPFLAG_FILL);
+                    continue;
+                }
+                if (scene->class_map[pix] == SYNTH_CLOUD)
+                {
+                    ipflag[pix] = (1 << IPFLAG_CLOUD);
+                    taero[pix] = DEFAULT_AERO;
+                    continue;
+                }
+
+                for (ib = 0; ib < NSR_BANDS; ib++)
+                {
+                    erelc[ib] = -1.0;
+                    troatm[ib] = 0.0;
+                }
+                erelc[iband3] = 0.55;
+                erelc[blue_band] = 0.6;
+                erelc[iband1] = 1.0;
+                erelc[swir_band] = 2.0;
+                troatm[iband3] = toa[iband3][pix];
+                troatm[blue_band] = toa[blue_band][pix];
+                troatm[iband1] = toa[iband1][pix];
+                troatm[swir_band] = toa[swir_band][pix];
+
+                iaots = 0;
+                subaeroret_new (scene->sat, iband1, iband3, erelc, troatm,
+                    luts->tgo_arr, luts->xrorayp_arr, luts->roatm_iaMax,
+                    luts->roatm_coef, luts->ttatmg_coef, luts->satm_coef,
+                    luts->normext_p0a3_arr, &raot, &residual, &iaots,
+                    LOW_EPS);
+
+                taero[pix] = raot;
+                if (scene->class_map[pix] == SYNTH_WATER)
+                    ipflag[pix] = (1 << IPFLAG_WATER);
+                else
+                    ipflag[pix] = (1 << IPFLAG_CLEAR);
+                checksum += raot;
+                nwin++;
+            }
+        }
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+
+    report ("subaeroret_new", "windows", nwin, best, checksum);
+}
+
+
+/******************************************************************************
+MODULE:  bench_aerosol_interp
+
+PURPOSE:  Times the median and the interpolation of the window aerosols.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           No clear aerosol values for the median
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The interpolation overwrites its inputs, so the window aerosols are
+   restored from a copy (outside the timing) before each run.
+******************************************************************************/
+static int bench_aerosol_interp
+(
+    Synth_scene_t *scene,    /* I: synthetic scene */
+    int16 **sband,           /* I: L8 TOA reflectance bands; NULL for S2 */
+    uint16 *qaband,          /* I: L8 QA band; NULL for S2 */
+    int reps,                /* I: number of repetitions */
+    uint8 *ipflag,           /* I/O: aerosol QA at the aerosol windows */
+    float *taero             /* I/O: aerosol at the aerosol windows */
+)
+{
+    char FUNC_NAME[] = "bench_aerosol_interp";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int rep;                 /* looping variable for repetitions */
+    size_t npix = (size_t) scene->nlines * scene->nsamps;  /* scene pixels */
+    size_t pix;              /* looping variable for pixels */
+    float median_aero = 0.0; /* median of the clear aerosols */
+    double checksum;         /* sum of the interpolated aerosols */
+    double start;            /* start time of the run */
+    double elapsed;          /* run time */
+    double best = -1.0;      /* best run time */
+    uint8 *ipflag_orig = NULL;   /* copy of the window aerosol QA */
+    float *taero_orig = NULL;    /* copy of the window aerosols */
+    Valid_span_t *spans = NULL;  /* L8 valid span of each line */
+    Espa_internal_meta_t xml_metadata;  /* empty XML metadata */
+
+    /* Median of the clear window aerosols */
+    for (rep = 0; rep < reps; rep++)
+    {
+        start = wall_time ();
+        if (scene->sat == SAT_LANDSAT_8)
+            median_aero = find_median_aerosol_l8 (ipflag, taero,
+                L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, scene->nlines,
+                scene->nsamps);
+        else
+            median_aero = find_median_aerosol_s2 (ipflag, taero,
+                S2_AERO_WINDOW, scene->nlines, scene->nsamps);
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+    if (median_aero == 0.0)
+    {
+        sprintf (errmsg, "No clear aerosol retrievals in the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    report ((scene->sat == SAT_LANDSAT_8) ? "find_median_aerosol_l8" :
+        "find_median_aerosol_s2", "pixels", npix, best, median_aero);
+
+    /* Fill the non-clear windows with the median, as lasrc does before the
+       interpolation */
+    if (scene->sat == SAT_LANDSAT_8)
+        aerosol_fill_median_l8 (ipflag, taero, L8_AERO_WINDOW,
+            L8_HALF_AERO_WINDOW, median_aero, scene->nlines, scene->nsamps);
+    else
+        aerosol_fill_median_s2 (ipflag, taero, S2_AERO_WINDOW, median_aero,
+            scene->nlines, scene->nsamps);
+
+    ipflag_orig = malloc (npix * sizeof (uint8));
+    taero_orig = malloc (npix * sizeof (float));
+    if (ipflag_orig == NULL || taero_orig == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the window aerosol copies");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    memcpy (ipflag_orig, ipflag, npix * sizeof (uint8));
+    memcpy (taero_orig, taero, npix * sizeof (float));
+
+    if (scene->sat == SAT_LANDSAT_8)
+    {
+        spans = build_valid_spans (qaband, scene->nlines, scene->nsamps);
+        if (spans == NULL)
+        {
+            sprintf (errmsg, "Building the valid spans");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        xml_metadata.nbands = 0;
+        xml_metadata.band = NULL;
+    }
+
+    /* Interpolation of the window aerosols */
+    best = -1.0;
+    for (rep = 0; rep < reps; rep++)
+    {
+        memcpy (ipflag, ipflag_orig, npix * sizeof (uint8));
+        memcpy (taero, taero_orig, npix * sizeof (float));
+
+        start = wall_time ();
+        if (scene->sat == SAT_LANDSAT_8)
+            aerosol_interp_l8 (&xml_metadata, L8_AERO_WINDOW,
+                L8_HALF_AERO_WINDOW, sband, qaband, spans, ipflag, taero,
+                median_aero, scene->nlines, scene->nsamps);
+        else
+            aerosol_interp_s2 (S2_AERO_WINDOW, ipflag, taero, scene->nlines,
+                scene->nsamps);
+        elapsed = wall_time () - start;
+        if (best < 0.0 || elapsed < best)
+            best = elapsed;
+    }
+    printf ("\n");
+
+    checksum = 0.0;
+    for (pix = 0; pix < npix; pix++)
+        checksum += taero[pix];
+    report ((scene->sat == SAT_LANDSAT_8) ? "aerosol_interp_l8" :
+        "aerosol_interp_s2", "pixels", npix, best, checksum);
+
+    free (spans);
+    free (ipflag_orig);
+    free (taero_orig);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Runs the kernel benchmarks.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error running the benchmarks
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "bench_kernels";   /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char aux_infile[STR_SIZE]; /* auxiliary filename */
+    char *fixture_dir = NULL;  /* directory of the LUT and aux fixtures */
+    int c;                     /* current argument index */
+    int option_index;          /* index for the command-line option */
+    int ib;                    /* looping variable for bands */
+    int nbands;                /* number of reflectance bands */
+    int nlines = 0;            /* number of lines in the scene */
+    int nsamps = 0;            /* number of samples in the scene */
+    int reps = DEFAULT_REPS;   /* number of repetitions of each kernel */
+    int nthreads = 1;          /* number of threads */
+    long line, samp;           /* looping variables for the scene */
+    float fill_frac = 0.2;     /* fraction of the scene that is fill */
+    float cloud_frac = 0.1;    /* fraction of valid pixels that are cloud */
+    float water_frac = 0.1;    /* fraction of valid pixels that are water */
+    float aot = 0.15;          /* 550nm AOT of the scene */
+    unsigned long seed = 1;    /* seed for the scene */
+    float *toa[NREFL_BANDS];   /* unscaled TOA reflectance per band */
+    int16 **sband = NULL;      /* L8 scaled TOA reflectance bands */
+    uint16 *qaband = NULL;     /* L8 QA band */
+    uint8 *ipflag = NULL;      /* aerosol QA */
+    float *taero = NULL;       /* aerosol values */
+    Sat_t sat = SAT_LANDSAT_8; /* satellite */
+    Synth_scene_t scene;       /* synthetic scene */
+    Bench_luts_t luts;         /* look-up tables and coefficients */
+    Lasrc_ctx_t ctx;           /* context holding the LUT filenames */
+    static struct option long_options[] =
+    {
+        {"sat", required_argument, 0, 's'},
+        {"fixture_dir", required_argument, 0, 'f'},
+        {"aux", required_argument, 0, 'x'},
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 'n'},
+        {"fill", required_argument, 0, 'F'},
+        {"cloud", required_argument, 0, 'c'},
+        {"water", required_argument, 0, 'w'},
+        {"aot", required_argument, 0, 'a'},
+        {"seed", required_argument, 0, 'r'},
+        {"reps", required_argument, 0, 'R'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    synth_aux_filename (SYNTH_AUX_DATE, aux_infile);
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':  /* help */
+                usage ();
+                exit (ERROR);
+                break;
+
+            case 's':  /* satellite */
+                if (!strcmp (optarg, "l8"))
+                    sat = SAT_LANDSAT_8;
+                else if (!strcmp (optarg, "s2"))
+                    sat = SAT_SENTINEL_2;
+                else
+                {
+                    sprintf (errmsg, "Unknown satellite: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    exit (ERROR);
+                }
+                break;
+
+            case 'f':  /* fixture directory */
+                fixture_dir = optarg;
+                break;
+
+            case 'x':  /* auxiliary file */
+                snprintf (aux_infile, sizeof (aux_infile), "%s", optarg);
+                break;
+
+            case 'l':  /* number of lines */
+                nlines = atoi (optarg);
+                break;
+
+            case 'n':  /* number of samples */
+                nsamps = atoi (optarg);
+                break;
+
+            case 'F':  /* fill fraction */
+                fill_frac = atof (optarg);
+                break;
+
+            case 'c':  /* cloud fraction */
+                cloud_frac = atof (optarg);
+                break;
+
+            case 'w':  /* water fraction */
+                water_frac = atof (optarg);
+                break;
+
+            case 'a':  /* AOT */
+                aot = atof (optarg);
+                break;
+
+            case 'r':  /* seed */
+                seed = strtoul (optarg, NULL, 10);
+                break;
+
+            case 'R':  /* repetitions */
+                reps = atoi (optarg);
+                if (reps < 1)
+                {
+                    sprintf (errmsg, "Invalid number of repetitions: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                exit (ERROR);
+                break;
+        }
+    }
+
+    if (fixture_dir == NULL)
+    {
+        sprintf (errmsg, "Fixture directory is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        exit (ERROR);
+    }
+
+    if (nlines == 0)
+        nlines = (sat == SAT_LANDSAT_8) ? 2048 : 2046;
+    if (nsamps == 0)
+        nsamps = (sat == SAT_LANDSAT_8) ? 2048 : 2046;
+
+#ifdef _OPENMP
+    nthreads = omp_get_max_threads ();
+#endif
+    printf ("%s scene %d x %d, fill %.2f, cloud %.2f, water %.2f, aot %.2f, "
+        "seed %lu, %d thread(s), best of %d\n",
+        (sat == SAT_LANDSAT_8) ? "L8" : "S2", nlines, nsamps, fill_frac,
+        cloud_frac, water_frac, aot, seed, nthreads, reps);
+
+    /* Set up the LUT and auxiliary filenames */
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.sat = sat;
+    if (lasrc_set_lut_files (fixture_dir, aux_infile, &ctx) != SUCCESS)
+    {
+        sprintf (errmsg, "Setting up the LUT and auxiliary filenames");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* LUT and auxiliary readers */
+    if (alloc_luts (&luts) != SUCCESS ||
+        bench_readluts (&ctx, reps, &luts) != SUCCESS ||
+        bench_read_aux (&ctx, reps) != SUCCESS)
+    {
+        sprintf (errmsg, "Benchmarking the LUT and auxiliary readers");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    if (compute_coefficients (sat, &luts) != SUCCESS)
+    {
+        sprintf (errmsg, "Computing the atmospheric coefficients");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Generate the scene */
+    if (init_synth_scene (sat, nlines, nsamps, fill_frac, cloud_frac,
+        water_frac, aot, seed, &scene) != SUCCESS)
+    {
+        sprintf (errmsg, "Initializing the synthetic scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    nbands = (sat == SAT_LANDSAT_8) ? NREFL_L8_BANDS : NREFL_S2_BANDS;
+    for (ib = 0; ib < nbands; ib++)
+    {
+        toa[ib] = first_touch_alloc (nlines, nsamps, sizeof (float));
+        if (toa[ib] == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the TOA reflectance");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }
+    ipflag = first_touch_alloc (nlines, nsamps, sizeof (uint8));
+    taero = first_touch_alloc (nlines, nsamps, sizeof (float));
+    if (ipflag == NULL || taero == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the aerosol arrays");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (samp, ib)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+            for (ib = 0; ib < nbands; ib++)
+                toa[ib][line * nsamps + samp] = synth_toa_refl (&scene, ib,
+                    line, samp);
+    }
+
+    if (sat == SAT_LANDSAT_8)
+    {
+        sband = calloc (SR_L8_TTL, sizeof (int16 *));
+        qaband = first_touch_alloc (nlines, nsamps, sizeof (uint16));
+        if (sband == NULL || qaband == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the L8 bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+        for (ib = 0; ib <= SR_L8_BAND11; ib++)
+        {
+            sband[ib] = first_touch_alloc (nlines, nsamps, sizeof (int16));
+            if (sband[ib] == NULL)
+            {
+                sprintf (errmsg, "Allocating memory for the L8 bands");
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+        synth_l8_toa (&scene, sband, qaband, NULL);
+    }
+
+    /* Per-pixel kernels */
+    bench_atmcorlamb2 (&scene, &luts, toa, atmcorlamb2_new,
+        "atmcorlamb2_new", reps);
+    bench_atmcorlamb2 (&scene, &luts, toa, atmcorlamb2_fast,
+        "atmcorlamb2_fast", reps);
+    bench_subaeroret (&scene, &luts, toa, reps, ipflag, taero);
+    if (bench_aerosol_interp (&scene, sband, qaband, reps, ipflag, taero)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Benchmarking the aerosol interpolation");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    /* Free memory */
+    for (ib = 0; ib < nbands; ib++)
+        free (toa[ib]);
+    if (sband != NULL)
+    {
+        for (ib = 0; ib <= SR_L8_BAND11; ib++)
+            free (sband[ib]);
+        free (sband);
+    }
+    free (qaband);
+    free (ipflag);
+    free (taero);
+    free_synth_scene (&scene);
+
+    exit (SUCCESS);
+}
@@ -0,0 +1,268 @@
+/*****************************************************************************
+FILE: gen_synthetic.c
+
+PURPOSE: Generates a synthetic L8 or S2 Level-1 scene and/or the synthetic
+LUT and auxiliary fixtures needed to run lasrc on it without the real
+auxiliary data.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. To run lasrc on the synthetic scene, point LASRC_AUX_DIR to the fixture
+   directory and run lasrc from the scene directory, e.g.
+       gen_synthetic --sat=l8 --scene_dir=scene --fixture_dir=aux
+       cd scene; LASRC_AUX_DIR=../aux lasrc --xml=<product_id>.xml
+           --aux=L8ANC2017166.hdf_fused
+*****************************************************************************/
+#include <getopt.h>
+#include "synth_scene.h"
+#include "synth_fixtures.h"
+
+/******************************************************************************
+MODULE:  usage
+
+PURPOSE:  Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void usage ()
+{
+    printf ("gen_synthetic generates a synthetic Landsat 8 or Sentinel-2 "
+            "Level-1 scene in the ESPA raw binary format, and/or synthetic "
+            "LUT and auxiliary files which let lasrc and bench_kernels run "
+            "without the real auxiliary data.\n\n");
+
+    printf ("usage: gen_synthetic [--sat=l8|s2] [--scene_dir=dir] "
+            "[--fixture_dir=dir] [--nlines=n] [--nsamps=n] [--fill=frac] "
+            "[--cloud=frac] [--water=frac] [--aot=aot] [--seed=n] "
+            "[--aux_date=yyyyddd]\n");
+
+    printf ("\nwhere at least one of the following parameters is "
+            "required:\n");
+    printf ("    -scene_dir: directory for the scene XML and image files\n");
+    printf ("    -fixture_dir: directory for the LUT directory, the CMG "
+            "files, and the LADS auxiliary file; use it as LASRC_AUX_DIR\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -sat: satellite, l8 (default) or s2\n");
+    printf ("    -nlines, -nsamps: size of the scene at 30m (L8) or 10m "
+            "(S2); the default is 2048 x 2048 (L8) or 2046 x 2046 (S2)\n");
+    printf ("    -fill: fraction of the scene that is fill (default "
+            "0.2)\n");
+    printf ("    -cloud: fraction of the valid pixels that are cloud "
+            "(default 0.1)\n");
+    printf ("    -water: fraction of the valid pixels that are water "
+            "(default 0.1)\n");
+    printf ("    -aot: 550nm aerosol optical thickness of the scene "
+            "(default 0.15)\n");
+    printf ("    -seed: seed for the scene layout and pixel noise (default "
+            "1)\n");
+    printf ("    -aux_date: date of the auxiliary file (default %s)\n",
+            SYNTH_AUX_DATE);
+
+    printf ("\nExample: gen_synthetic --sat=l8 --scene_dir=scene "
+            "--fixture_dir=aux --cloud=0.3\n");
+}
+
+
+/******************************************************************************
+MODULE:  main
+
+PURPOSE:  Generates the synthetic scene and fixtures.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error generating the scene or fixtures
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "gen_synthetic";   /* function name */
+    char errmsg[STR_SIZE];     /* error message */
+    char aux_infile[STR_SIZE]; /* auxiliary filename, as passed to lasrc */
+    char *scene_dir = NULL;    /* output directory for the scene */
+    char *fixture_dir = NULL;  /* output directory for the fixtures */
+    char *aux_date = SYNTH_AUX_DATE;  /* date of the auxiliary file */
+    char *xml_file = NULL;     /* XML filename of the scene */
+    int c;                     /* current argument index */
+    int option_index;          /* index for the command-line option */
+    int nlines = 0;            /* number of lines in the scene */
+    int nsamps = 0;            /* number of samples in the scene */
+    float fill_frac = 0.2;     /* fraction of the scene that is fill */
+    float cloud_frac = 0.1;    /* fraction of valid pixels that are cloud */
+    float water_frac = 0.1;    /* fraction of valid pixels that are water */
+    float aot = 0.15;          /* 550nm AOT of the scene */
+    unsigned long seed = 1;    /* seed for the scene */
+    Sat_t sat = SAT_LANDSAT_8; /* satellite */
+    Synth_scene_t scene;       /* synthetic scene */
+    static struct option long_options[] =
+    {
+        {"sat", required_argument, 0, 's'},
+        {"scene_dir", required_argument, 0, 'o'},
+        {"fixture_dir", required_argument, 0, 'f'},
+        {"nlines", required_argument, 0, 'l'},
+        {"nsamps", required_argument, 0, 'n'},
+        {"fill", required_argument, 0, 'F'},
+        {"cloud", required_argument, 0, 'c'},
+        {"water", required_argument, 0, 'w'},
+        {"aot", required_argument, 0, 'a'},
+        {"seed", required_argument, 0, 'r'},
+        {"aux_date", required_argument, 0, 'd'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    /* Loop through all the cmd-line options */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':  /* help */
+                usage ();
+                exit (ERROR);
+                break;
+
+            case 's':  /* satellite */
+                if (!strcmp (optarg, "l8"))
+                    sat = SAT_LANDSAT_8;
+                else if (!strcmp (optarg, "s2"))
+                    sat = SAT_SENTINEL_2;
+                else
+                {
+                    sprintf (errmsg, "Unknown satellite: %s", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    exit (ERROR);
+                }
+                break;
+
+            case 'o':  /* scene directory */
+                scene_dir = optarg;
+                break;
+
+            case 'f':  /* fixture directory */
+                fixture_dir = optarg;
+                break;
+
+            case 'l':  /* number of lines */
+                nlines = atoi (optarg);
+                break;
+
+            case 'n':  /* number of samples */
+                nsamps = atoi (optarg);
+                break;
+
+            case 'F':  /* fill fraction */
+                fill_frac = atof (optarg);
+                break;
+
+            case 'c':  /* cloud fraction */
+                cloud_frac = atof (optarg);
+                break;
+
+            case 'w':  /* water fraction */
+                water_frac = atof (optarg);
+                break;
+
+            case 'a':  /* AOT */
+                aot = atof (optarg);
+                break;
+
+            case 'r':  /* seed */
+                seed = strtoul (optarg, NULL, 10);
+                break;
+
+            case 'd':  /* auxiliary date */
+                aux_date = optarg;
+                if (strlen (aux_date) != 7)
+                {
+                    sprintf (errmsg, "Invalid auxiliary date: %s.  Expected "
+                        "YYYYDDD.", aux_date);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                usage ();
+                exit (ERROR);
+                break;
+        }
+    }
+
+    if (scene_dir == NULL && fixture_dir == NULL)
+    {
+        sprintf (errmsg, "At least one of scene_dir and fixture_dir must be "
+            "specified");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        exit (ERROR);
+    }
+
+    /* The S2 default size is a multiple of 6 so the 60m bands line up */
+    if (nlines == 0)
+        nlines = (sat == SAT_LANDSAT_8) ? 2048 : 2046;
+    if (nsamps == 0)
+        nsamps = (sat == SAT_LANDSAT_8) ? 2048 : 2046;
+
+    if (fixture_dir != NULL)
+    {
+        if (write_lut_fixtures (sat, fixture_dir) != SUCCESS ||
+            write_aux_fixtures (fixture_dir, aux_date) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the fixtures to %s", fixture_dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        synth_aux_filename (aux_date, aux_infile);
+        printf ("Wrote the fixtures to %s; use --aux=%s with "
+            "LASRC_AUX_DIR=%s\n", fixture_dir, aux_infile, fixture_dir);
+    }
+
+    if (scene_dir != NULL)
+    {
+        if (init_synth_scene (sat, nlines, nsamps, fill_frac, cloud_frac,
+            water_frac, aot, seed, &scene) != SUCCESS)
+        {
+            sprintf (errmsg, "Initializing the synthetic scene");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        if (write_synth_scene (&scene, scene_dir, &xml_file) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the synthetic scene to %s", scene_dir);
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        printf ("Wrote the %d x %d synthetic scene to %s\n", nlines, nsamps,
+            xml_file);
+        free (xml_file);
+        free_synth_scene (&scene);
+    }
+
+    exit (SUCCESS);
+}
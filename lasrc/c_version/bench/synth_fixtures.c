@@ -0,0 +1,898 @@
+/*****************************************************************************
+FILE: synth_fixtures.c
+
+PURPOSE: Contains functions for writing synthetic look-up table and auxiliary
+fixtures in the formats read by readluts and read_auxiliary_files.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The fixtures are structurally faithful (same SDS names, types, dimensions,
+   and ASCII layouts as the production LUT and auxiliary files) but are
+   generated from a simple analytic atmosphere (synth_atmos) rather than 6S.
+   They are meant for benchmarking and for exercising the code paths, not for
+   science-quality retrievals.
+2. The CMG fixtures are written with the full CMG dimensions since the readers
+   expect them, but they are spatially constant and compressed, so they are
+   small on disk.
+*****************************************************************************/
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "synth_fixtures.h"
+#include "hdf.h"
+#include "mfhdf.h"
+
+/* Number of CMG rows per compressed HDF chunk; read_auxiliary_files reads a
+   row at a time, so the grids are chunked by rows rather than compressed as
+   a single block */
+#define CMG_CHUNK_ROWS 100
+
+/* Band center wavelengths (microns) of the L8 and S2 LUT bands */
+static float synth_l8_wavelength[NSR_L8_BANDS] =
+    {0.443, 0.482, 0.561, 0.655, 0.865, 1.609, 2.201, 1.373};
+static float synth_s2_wavelength[NSR_S2_BANDS] =
+    {0.443, 0.490, 0.560, 0.665, 0.705, 0.740, 0.783, 0.842, 0.865, 0.945,
+     1.375, 1.610, 2.190};
+
+/******************************************************************************
+MODULE:  synth_band_wavelength
+
+PURPOSE:  Returns the center wavelength of the specified LUT band.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+wavelength      Band center wavelength (microns)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+float synth_band_wavelength
+(
+    Sat_t sat,           /* I: satellite */
+    int iband            /* I: LUT band index (0-based; SR_L8_BAND1 to
+                               SR_L8_BAND9 or SR_S2_BAND1 to SR_S2_BAND12) */
+)
+{
+    if (sat == SAT_LANDSAT_8)
+        return (synth_l8_wavelength[iband]);
+    else
+        return (synth_s2_wavelength[iband]);
+}
+
+
+/******************************************************************************
+MODULE:  synth_rayleigh_tau
+
+PURPOSE:  Computes the molecular optical thickness at sea level for the
+specified wavelength.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+tau             Rayleigh optical thickness at 1013 mb
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Uses the Hansen and Travis approximation.
+******************************************************************************/
+float synth_rayleigh_tau
+(
+    float wavelength     /* I: band center wavelength (microns) */
+)
+{
+    double wl2 = wavelength * wavelength;   /* wavelength squared */
+
+    return (0.008569 / (wl2 * wl2) * (1.0 + 0.0113 / wl2 +
+        0.00013 / (wl2 * wl2)));
+}
+
+
+/******************************************************************************
+MODULE:  synth_transmission
+
+PURPOSE:  Computes the one-way (downward or upward) atmospheric transmission
+of the synthetic atmosphere.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+trans           Total (direct + diffuse) transmission
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Half of the Rayleigh and most of the aerosol scattering is forward, so
+   only part of the optical thickness is lost from the diffuse transmission.
+******************************************************************************/
+float synth_transmission
+(
+    float wavelength,    /* I: band center wavelength (microns) */
+    float pres,          /* I: surface pressure (mb) */
+    float aot,           /* I: aerosol optical thickness at 550nm */
+    float xz             /* I: zenith angle (deg) */
+)
+{
+    double taur;             /* Rayleigh optical thickness at pres */
+    double taua;             /* aerosol optical thickness at wavelength */
+
+    taur = synth_rayleigh_tau (wavelength) * pres / 1013.0;
+    taua = aot * pow (wavelength / 0.55, -1.3);
+
+    return (exp (-(0.5 * taur + 0.16 * taua) / cos (xz * DEG2RAD)));
+}
+
+
+/******************************************************************************
+MODULE:  synth_atmos
+
+PURPOSE:  Computes the atmospheric intrinsic reflectance, transmission, and
+spherical albedo of the synthetic atmosphere.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Single-scattering Rayleigh and Henyey-Greenstein aerosol phase functions,
+   saturated so the reflectance stays bounded at large airmasses.  The
+   quantities increase monotonically with the AOT, as the retrievals expect.
+2. The scattering angle follows the 6S convention used by comproatm; 180
+   degrees is backscattering.
+******************************************************************************/
+void synth_atmos
+(
+    float wavelength,    /* I: band center wavelength (microns) */
+    float pres,          /* I: surface pressure (mb) */
+    float aot,           /* I: aerosol optical thickness at 550nm */
+    float xts,           /* I: solar zenith angle (deg) */
+    float xtv,           /* I: view zenith angle (deg) */
+    float scaa,          /* I: scattering angle (deg) */
+    float *roatm,        /* O: atmospheric intrinsic reflectance */
+    float *ttatmg,       /* O: total (down x up) atmospheric transmission */
+    float *satm          /* O: spherical albedo */
+)
+{
+    const double g = 0.65;   /* aerosol asymmetry parameter */
+    double taur;             /* Rayleigh optical thickness at pres */
+    double taua;             /* aerosol optical thickness at wavelength */
+    double mus, muv;         /* cosine of solar and view zenith angles */
+    double cs;               /* cosine of scattering angle */
+    double pr, pa;           /* Rayleigh and aerosol phase functions */
+
+    taur = synth_rayleigh_tau (wavelength) * pres / 1013.0;
+    taua = aot * pow (wavelength / 0.55, -1.3);
+    mus = cos (xts * DEG2RAD);
+    muv = cos (xtv * DEG2RAD);
+    cs = cos (scaa * DEG2RAD);
+
+    pr = 0.75 * (1.0 + cs * cs);
+    pa = (1.0 - g * g) / pow (1.0 + g * g - 2.0 * g * cs, 1.5);
+
+    *roatm = 0.5 * (1.0 - exp (-(taur * pr + 0.8 * taua * pa) *
+        (1.0 / mus + 1.0 / muv) * 0.25));
+
+    *ttatmg = synth_transmission (wavelength, pres, aot, xts) *
+        synth_transmission (wavelength, pres, aot, xtv);
+
+    *satm = (0.5 * taur + 0.15 * taua) / (1.0 + 0.5 * taur + 0.15 * taua);
+}
+
+
+/******************************************************************************
+MODULE:  synth_aux_filename
+
+PURPOSE:  Builds the name of the synthetic auxiliary file for the specified
+date.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. lasrc takes the year from characters 5-8 of the auxiliary filename, so the
+   production naming convention is used.
+******************************************************************************/
+void synth_aux_filename
+(
+    char *aux_date,      /* I: date of the auxiliary file (YYYYDDD) */
+    char *aux_infile     /* O: auxiliary filename, as passed to lasrc */
+)
+{
+    sprintf (aux_infile, "L8ANC%s.hdf_fused", aux_date);
+}
+
+
+/******************************************************************************
+MODULE:  synth_make_dir
+
+PURPOSE:  Creates the specified directory if it doesn't already exist.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the directory
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int synth_make_dir
+(
+    char *dirname        /* I: directory to be created */
+)
+{
+    char FUNC_NAME[] = "synth_make_dir";  /* function name */
+    char errmsg[STR_SIZE];                /* error message */
+
+    if (mkdir (dirname, 0755) != 0 && errno != EEXIST)
+    {
+        sprintf (errmsg, "Creating directory: %s", dirname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_sds
+
+PURPOSE:  Writes a complete SDS to an open HDF file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the SDS
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int write_sds
+(
+    int32 sd_id,         /* I: HDF file ID */
+    char *sds_name,      /* I: name of the SDS */
+    int32 data_type,     /* I: HDF data type of the SDS */
+    int32 rank,          /* I: number of dimensions */
+    int32 *dims,         /* I: size of each dimension */
+    bool compress,       /* I: deflate the SDS */
+    void *data           /* I: data to be written */
+)
+{
+    char FUNC_NAME[] = "write_sds";  /* function name */
+    char errmsg[STR_SIZE];           /* error message */
+    int32 sds_id;                    /* SDS ID */
+    int32 start[3] = {0, 0, 0};      /* starting point to write SDS data */
+    comp_info c_info;                /* compression parameters */
+
+    sds_id = SDcreate (sd_id, sds_name, data_type, rank, dims);
+    if (sds_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (compress)
+    {
+        c_info.deflate.level = 6;
+        if (SDsetcompress (sds_id, COMP_CODE_DEFLATE, &c_info) == FAIL)
+        {
+            sprintf (errmsg, "Setting the compression for the %s SDS",
+                sds_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (SDwritedata (sds_id, start, NULL, dims, data) == FAIL)
+    {
+        sprintf (errmsg, "Writing the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (SDendaccess (sds_id) == FAIL)
+    {
+        sprintf (errmsg, "Ending access to the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_cmg_sds
+
+PURPOSE:  Writes a spatially-constant CMG grid SDS to an open HDF file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the SDS
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The grid is chunked by rows and deflated.  The same row of values is
+   written for every row of the grid.
+******************************************************************************/
+static int write_cmg_sds
+(
+    int32 sd_id,         /* I: HDF file ID */
+    char *sds_name,      /* I: name of the SDS */
+    int32 data_type,     /* I: HDF data type of the SDS */
+    int nrows,           /* I: number of rows in the grid */
+    int ncols,           /* I: number of columns in the grid */
+    void *row            /* I: values for one row of the grid */
+)
+{
+    char FUNC_NAME[] = "write_cmg_sds";  /* function name */
+    char errmsg[STR_SIZE];           /* error message */
+    int i;                           /* looping variable for rows */
+    int32 sds_id;                    /* SDS ID */
+    int32 dims[2];                   /* size of the grid */
+    int32 start[2];                  /* starting point to write SDS data */
+    int32 edges[2];                  /* number of values to write */
+    HDF_CHUNK_DEF c_def;             /* chunking and compression parameters */
+
+    dims[0] = nrows;
+    dims[1] = ncols;
+    sds_id = SDcreate (sd_id, sds_name, data_type, 2, dims);
+    if (sds_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    c_def.comp.chunk_lengths[0] = CMG_CHUNK_ROWS;
+    c_def.comp.chunk_lengths[1] = ncols;
+    c_def.comp.comp_type = COMP_CODE_DEFLATE;
+    c_def.comp.cinfo.deflate.level = 6;
+    if (SDsetchunk (sds_id, c_def, HDF_CHUNK | HDF_COMP) == FAIL)
+    {
+        sprintf (errmsg, "Setting the chunking for the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    start[1] = 0;
+    edges[0] = 1;
+    edges[1] = ncols;
+    for (i = 0; i < nrows; i++)
+    {
+        start[0] = i;
+        if (SDwritedata (sds_id, start, NULL, edges, row) == FAIL)
+        {
+            sprintf (errmsg, "Writing row %d of the %s SDS", i, sds_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    if (SDendaccess (sds_id) == FAIL)
+    {
+        sprintf (errmsg, "Ending access to the %s SDS", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_lut_fixtures
+
+PURPOSE:  Writes the synthetic angle, intrinsic reflectance, transmission,
+and spherical albedo LUTs for the specified satellite.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the LUTs
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The LUTs are written to the LDCMLUT (L8) or MSILUT (S2) directory of
+   aux_path, with the filenames expected by lasrc_set_lut_files.
+2. The angle tables follow the 6S layout: for each solar zenith (its) and
+   view zenith (itv), the intrinsic reflectance is tabulated every 4 degrees
+   of scattering angle from tsmax down to tsmin.  nbfi is the number of
+   scattering angles in each (itv, its) block, nbfic is the cumulative count
+   over itv, and indts is the offset of each solar zenith in the table.
+3. readluts reads INDTS and TTS as 20 x 22 SDSs, so they are written with
+   that size; only the first row is used.
+******************************************************************************/
+int write_lut_fixtures
+(
+    Sat_t sat,           /* I: satellite */
+    char *aux_path       /* I: directory to contain the LUT directories */
+)
+{
+    char FUNC_NAME[] = "write_lut_fixtures";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char lut_dir[STR_SIZE];     /* LUT directory */
+    char lut_ver[STR_SIZE];     /* LUT version string */
+    char fname[STR_SIZE];       /* current filename */
+    char sds_name[STR_SIZE];    /* current SDS name */
+    char *s2_bandname[NSR_S2_BANDS] = {"1", "2", "3", "4", "5", "6", "7", "8",
+                                       "8a", "9", "10", "11", "12"};
+    int i;                      /* looping variable */
+    int iband;                  /* looping variable for bands */
+    int ipres;                  /* looping variable for pressure levels */
+    int iaot;                   /* looping variable for AOTs */
+    int its;                    /* looping variable for solar zeniths */
+    int itv;                    /* looping variable for view zeniths */
+    int isca;                   /* looping variable for scattering angles */
+    int nsr_bands;              /* number of SR bands in the LUTs */
+    int nbfi_curr;              /* number of scattering angles in the current
+                                   angle block */
+    int nbfic_curr;             /* cumulative number of scattering angles for
+                                   the current solar zenith */
+    int offset;                 /* offset of the current solar zenith in the
+                                   intrinsic reflectance table */
+    int ival;                   /* index in the intrinsic reflectance table */
+    int32 sd_id;                /* HDF file ID */
+    int32 dims[3];              /* SDS dimensions */
+    int32 indts[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS]; /* solar zenith offsets */
+    float tts[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];   /* solar zenith table */
+    float ttv[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];   /* view zenith table */
+    float tsmax[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS]; /* max scattering angle */
+    float tsmin[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS]; /* min scattering angle */
+    float nbfi[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];  /* number of scattering
+                                                     angles */
+    float nbfic[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS]; /* cumulative number of
+                                                     scattering angles */
+    float xts, xtv;             /* solar and view zenith (deg) */
+    float scaa;                 /* current scattering angle (deg) */
+    float wavelength;           /* current band wavelength (microns) */
+    float roatm, ttatmg, satm;  /* synthetic atmosphere values */
+    float normext;              /* normalized aerosol extinction */
+    float *rolut = NULL;        /* intrinsic reflectance for one band,
+                                   NSOLAR_VALS x NAOT_VALS x NPRES_VALS */
+    FILE *fp = NULL;            /* ASCII LUT file pointer */
+    float aot550nm[NAOT_VALS] =  /* AOT look-up table */
+        {0.01, 0.05, 0.10, 0.15, 0.20, 0.30, 0.40, 0.60, 0.80, 1.00, 1.20,
+         1.40, 1.60, 1.80, 2.00, 2.30, 2.60, 3.00, 3.50, 4.00, 4.50, 5.00};
+    float tpres[NPRES_VALS] =    /* surface pressure table */
+        {1050.0, 1013.0, 900.0, 800.0, 700.0, 600.0, 500.0};
+
+    /* Setup the satellite-specific LUT directory and band count */
+    if (sat == SAT_LANDSAT_8)
+    {
+        sprintf (lut_dir, "%s/LDCMLUT", aux_path);
+        strcpy (lut_ver, "V3.0-URBANCLEAN-V2.0");
+        nsr_bands = NSR_L8_BANDS;
+    }
+    else
+    {
+        sprintf (lut_dir, "%s/MSILUT", aux_path);
+        strcpy (lut_ver, "V3.0-URBANCLEAN-V3.0");
+        nsr_bands = NSR_S2_BANDS;
+    }
+
+    if (synth_make_dir (aux_path) != SUCCESS ||
+        synth_make_dir (lut_dir) != SUCCESS)
+    {
+        sprintf (errmsg, "Creating the LUT directory: %s", lut_dir);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Build the angle tables */
+    offset = 0;
+    for (its = 0; its < NSOLAR_ZEN_VALS; its++)
+    {
+        xts = 4.0 * its;
+        nbfic_curr = 0;
+        for (itv = 0; itv < NVIEW_ZEN_VALS; itv++)
+        {
+            if (itv == 0)
+                xtv = 0.0;
+            else
+                xtv = SYNTH_XTVMIN + (itv - 1) * SYNTH_XTVSTEP;
+
+            tsmax[itv][its] = 180.0 - fabs (xts - xtv);
+            tsmin[itv][its] = 180.0 - (xts + xtv);
+            nbfi_curr = (int) ceil ((tsmax[itv][its] - tsmin[itv][its]) *
+                0.25 - ESPA_EPSILON) + 1;
+            nbfic_curr += nbfi_curr;
+
+            ttv[itv][its] = xtv;
+            nbfi[itv][its] = nbfi_curr;
+            nbfic[itv][its] = nbfic_curr;
+        }
+
+        for (itv = 0; itv < NVIEW_ZEN_VALS; itv++)
+        {
+            indts[itv][its] = offset;
+            tts[itv][its] = xts;
+        }
+        offset += nbfic_curr;
+    }
+
+    if (offset > NSOLAR_VALS)
+    {
+        sprintf (errmsg, "Angle tables need %d scattering angles, which is "
+            "more than the %d in the intrinsic reflectance LUT", offset,
+            NSOLAR_VALS);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the angle HDF file */
+    sprintf (fname, "%s/ANGLE_NEW.hdf", lut_dir);
+    sd_id = SDstart (fname, DFACC_CREATE);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the angle HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    dims[0] = NVIEW_ZEN_VALS;
+    dims[1] = NSOLAR_ZEN_VALS;
+    if (write_sds (sd_id, "TSMAX", DFNT_FLOAT32, 2, dims, false, tsmax)
+            != SUCCESS ||
+        write_sds (sd_id, "TSMIN", DFNT_FLOAT32, 2, dims, false, tsmin)
+            != SUCCESS ||
+        write_sds (sd_id, "TTV", DFNT_FLOAT32, 2, dims, false, ttv)
+            != SUCCESS ||
+        write_sds (sd_id, "NBFI", DFNT_FLOAT32, 2, dims, false, nbfi)
+            != SUCCESS ||
+        write_sds (sd_id, "NBFIC", DFNT_FLOAT32, 2, dims, false, nbfic)
+            != SUCCESS ||
+        write_sds (sd_id, "INDTS", DFNT_INT32, 2, dims, false, indts)
+            != SUCCESS ||
+        write_sds (sd_id, "TTS", DFNT_FLOAT32, 2, dims, false, tts)
+            != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the angle HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (SDend (sd_id) == FAIL)
+    {
+        sprintf (errmsg, "Ending access to HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the intrinsic reflectance HDF file, in the per-band
+       NSOLAR_VALS x NAOT_VALS x NPRES_VALS order of the production LUT */
+    rolut = calloc (NSOLAR_VALS * NAOT_VALS * NPRES_VALS, sizeof (float));
+    if (rolut == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for rolut");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    sprintf (fname, "%s/RES_LUT_%s.hdf", lut_dir, lut_ver);
+    sd_id = SDstart (fname, DFACC_CREATE);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the intrinsic reflectance HDF file: %s",
+            fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    dims[0] = NSOLAR_VALS;
+    dims[1] = NAOT_VALS;
+    dims[2] = NPRES_VALS;
+    for (iband = 0; iband < nsr_bands; iband++)
+    {
+        wavelength = synth_band_wavelength (sat, iband);
+        for (its = 0; its < NSOLAR_ZEN_VALS; its++)
+        {
+            xts = tts[0][its];
+            for (itv = 0; itv < NVIEW_ZEN_VALS; itv++)
+            {
+                xtv = ttv[itv][its];
+                ival = indts[0][its] + nbfic[itv][its] - nbfi[itv][its];
+                for (isca = 0; isca < nbfi[itv][its]; isca++, ival++)
+                {
+                    if (isca == nbfi[itv][its] - 1)
+                        scaa = tsmin[itv][its];
+                    else
+                        scaa = tsmax[itv][its] - 4.0 * isca;
+
+                    for (iaot = 0; iaot < NAOT_VALS; iaot++)
+                    {
+                        for (ipres = 0; ipres < NPRES_VALS; ipres++)
+                        {
+                            synth_atmos (wavelength, tpres[ipres],
+                                aot550nm[iaot], xts, xtv, scaa, &roatm,
+                                &ttatmg, &satm);
+                            rolut[ival*NAOT_VALS*NPRES_VALS + iaot*NPRES_VALS
+                                + ipres] = roatm;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (sat == SAT_LANDSAT_8)
+            sprintf (sds_name, "NRLUT_BAND_%d", iband+1);
+        else
+            sprintf (sds_name, "NRLUT_BAND_%s", s2_bandname[iband]);
+        if (write_sds (sd_id, sds_name, DFNT_FLOAT32, 3, dims, true, rolut)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the intrinsic reflectance HDF file: %s",
+                fname);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    free (rolut);
+
+    if (SDend (sd_id) == FAIL)
+    {
+        sprintf (errmsg, "Ending access to HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the transmission ASCII file.  Each pressure level has one line
+       per solar zenith (except the last), holding the zenith followed by the
+       transmission for each AOT. */
+    sprintf (fname, "%s/TRANS_LUT_%s.ASCII", lut_dir, lut_ver);
+    fp = fopen (fname, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the transmission file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (iband = 0; iband < nsr_bands; iband++)
+    {
+        wavelength = synth_band_wavelength (sat, iband);
+        fprintf (fp, "synthetic transmission, band %d, %.3f microns\n",
+            iband+1, wavelength);
+        for (ipres = 0; ipres < NPRES_VALS; ipres++)
+        {
+            fprintf (fp, "pressure %.1f mb\n", tpres[ipres]);
+            for (i = 0; i < NSUNANGLE_VALS-1; i++)
+            {
+                fprintf (fp, "%.1f", tts[0][i]);
+                for (iaot = 0; iaot < NAOT_VALS; iaot++)
+                    fprintf (fp, " %.6f", synth_transmission (wavelength,
+                        tpres[ipres], aot550nm[iaot], tts[0][i]));
+                fprintf (fp, "\n");
+            }
+        }
+    }
+    fclose (fp);
+
+    /* Write the spherical albedo ASCII file.  Each pressure level has one
+       line per AOT, holding the AOT, the spherical albedo, and the aerosol
+       extinction normalized at 550nm. */
+    sprintf (fname, "%s/AERO_LUT_%s.ASCII", lut_dir, lut_ver);
+    fp = fopen (fname, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the spherical albedo file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (iband = 0; iband < nsr_bands; iband++)
+    {
+        wavelength = synth_band_wavelength (sat, iband);
+        normext = pow (wavelength / 0.55, -1.3);
+        fprintf (fp, "synthetic spherical albedo, band %d, %.3f microns\n",
+            iband+1, wavelength);
+        for (ipres = 0; ipres < NPRES_VALS; ipres++)
+        {
+            fprintf (fp, "pressure %.1f mb\n", tpres[ipres]);
+            for (iaot = 0; iaot < NAOT_VALS; iaot++)
+            {
+                synth_atmos (wavelength, tpres[ipres], aot550nm[iaot], 0.0,
+                    0.0, 180.0, &roatm, &ttatmg, &satm);
+                fprintf (fp, "%.2f %.6f %.6f\n", aot550nm[iaot], satm,
+                    normext);
+            }
+        }
+    }
+    fclose (fp);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_aux_fixtures
+
+PURPOSE:  Writes the synthetic CMG DEM, ratio averages, and ozone/water vapor
+auxiliary files.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the auxiliary files
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The files are written to aux_path (CMGDEM.hdf, ratiomapndwiexp.hdf) and to
+   the LADS/<year> directory of aux_path (L8ANC<date>.hdf_fused), as expected
+   by lasrc_set_lut_files.
+2. The ratio averages have a small NDWI standard deviation, so the slopes are
+   not used and the band ratios are the averages, as for most land pixels.
+******************************************************************************/
+int write_aux_fixtures
+(
+    char *aux_path,      /* I: directory to contain the CMG files and the LADS
+                               auxiliary directory */
+    char *aux_date       /* I: date of the auxiliary file (YYYYDDD) */
+)
+{
+    char FUNC_NAME[] = "write_aux_fixtures";  /* function name */
+    char errmsg[STR_SIZE];      /* error message */
+    char fname[STR_SIZE];       /* current filename */
+    char aux_infile[STR_SIZE];  /* auxiliary filename */
+    char aux_year[5];           /* year of the auxiliary file */
+    int i, j;                   /* looping variables */
+    int32 sd_id;                /* HDF file ID */
+    int16 *row16 = NULL;        /* int16 row of the CMG grids */
+    uint16 *rowu16 = NULL;      /* uint16 row of the CMG grids */
+    uint8 *rowu8 = NULL;        /* uint8 row of the CMG grids */
+
+    /* Ratio SDS names and their constant values (scaled by 1000) */
+    char *ratio_names[] = {"average ndvi", "average ratio b10",
+        "average ratio b9", "average ratio b7", "standard ndvi",
+        "slope ratiob9", "inter ratiob9", "slope ratiob10", "inter ratiob10",
+        "slope ratiob7", "inter ratiob7"};
+    int16 ratio_values[] = {300, 600, 550, 2000, 100, 0, 550, 0, 600, 0,
+        2000};
+    int nratio = sizeof (ratio_values) / sizeof (int16);
+
+    if (strlen (aux_date) != 7)
+    {
+        sprintf (errmsg, "Auxiliary date should be YYYYDDD: %s", aux_date);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strncpy (aux_year, aux_date, 4);
+    aux_year[4] = '\0';
+
+    if (synth_make_dir (aux_path) != SUCCESS)
+        return (ERROR);
+    sprintf (fname, "%s/LADS", aux_path);
+    if (synth_make_dir (fname) != SUCCESS)
+        return (ERROR);
+    sprintf (fname, "%s/LADS/%s", aux_path, aux_year);
+    if (synth_make_dir (fname) != SUCCESS)
+        return (ERROR);
+
+    /* The CMG grids all have the same number of columns */
+    row16 = calloc (RATIO_NBLON, sizeof (int16));
+    rowu16 = calloc (CMG_NBLON, sizeof (uint16));
+    rowu8 = calloc (CMG_NBLON, sizeof (uint8));
+    if (row16 == NULL || rowu16 == NULL || rowu8 == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the CMG rows");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* DEM (meters) */
+    sprintf (fname, "%s/CMGDEM.hdf", aux_path);
+    sd_id = SDstart (fname, DFACC_CREATE);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the DEM HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < DEM_NBLON; i++)
+        row16[i] = 100;
+    if (write_cmg_sds (sd_id, "averaged elevation", DFNT_INT16, DEM_NBLAT,
+        DEM_NBLON, row16) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the DEM HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    SDend (sd_id);
+
+    /* Ratio averages */
+    sprintf (fname, "%s/ratiomapndwiexp.hdf", aux_path);
+    sd_id = SDstart (fname, DFACC_CREATE);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the ratio HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < nratio; i++)
+    {
+        for (j = 0; j < RATIO_NBLON; j++)
+            row16[j] = ratio_values[i];
+        if (write_cmg_sds (sd_id, ratio_names[i], DFNT_INT16, RATIO_NBLAT,
+            RATIO_NBLON, row16) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing the ratio HDF file: %s", fname);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    SDend (sd_id);
+
+    /* Ozone (cm-atm x 400) and water vapor (g/cm2 x 200) */
+    synth_aux_filename (aux_date, aux_infile);
+    sprintf (fname, "%s/LADS/%s/%s", aux_path, aux_year, aux_infile);
+    sd_id = SDstart (fname, DFACC_CREATE);
+    if (sd_id == FAIL)
+    {
+        sprintf (errmsg, "Creating the auxiliary HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < CMG_NBLON; i++)
+    {
+        rowu8[i] = 120;
+        rowu16[i] = 300;
+    }
+    if (write_cmg_sds (sd_id, "Coarse Resolution Ozone", DFNT_UINT8,
+        CMG_NBLAT, CMG_NBLON, rowu8) != SUCCESS ||
+        write_cmg_sds (sd_id, "Coarse Resolution Water Vapor", DFNT_UINT16,
+        CMG_NBLAT, CMG_NBLON, rowu16) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the auxiliary HDF file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    SDend (sd_id);
+
+    free (row16);
+    free (rowu16);
+    free (rowu8);
+
+    return (SUCCESS);
+}
@@ -0,0 +1,77 @@
+#ifndef _SYNTH_FIXTURES_H_
+#define _SYNTH_FIXTURES_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "lasrc.h"
+
+/* View zenith table of the synthetic angle LUT, matching the xtvmin/xtvstep
+   values used by init_sr_refl */
+#define SYNTH_XTVMIN 2.84090
+#define SYNTH_XTVSTEP (6.52107 - SYNTH_XTVMIN)
+
+/* Default date of the synthetic auxiliary file (YYYYDDD) */
+#define SYNTH_AUX_DATE "2017166"
+
+/* Prototypes */
+float synth_band_wavelength
+(
+    Sat_t sat,           /* I: satellite */
+    int iband            /* I: LUT band index (0-based; SR_L8_BAND1 to
+                               SR_L8_BAND9 or SR_S2_BAND1 to SR_S2_BAND12) */
+);
+
+float synth_rayleigh_tau
+(
+    float wavelength     /* I: band center wavelength (microns) */
+);
+
+float synth_transmission
+(
+    float wavelength,    /* I: band center wavelength (microns) */
+    float pres,          /* I: surface pressure (mb) */
+    float aot,           /* I: aerosol optical thickness at 550nm */
+    float xz             /* I: zenith angle (deg) */
+);
+
+void synth_atmos
+(
+    float wavelength,    /* I: band center wavelength (microns) */
+    float pres,          /* I: surface pressure (mb) */
+    float aot,           /* I: aerosol optical thickness at 550nm */
+    float xts,           /* I: solar zenith angle (deg) */
+    float xtv,           /* I: view zenith angle (deg) */
+    float scaa,          /* I: scattering angle (deg) */
+    float *roatm,        /* O: atmospheric intrinsic reflectance */
+    float *ttatmg,       /* O: total (down x up) atmospheric transmission */
+    float *satm          /* O: spherical albedo */
+);
+
+int synth_make_dir
+(
+    char *dirname        /* I: directory to be created */
+);
+
+void synth_aux_filename
+(
+    char *aux_date,      /* I: date of the auxiliary file (YYYYDDD) */
+    char *aux_infile     /* O: auxiliary filename, as passed to lasrc */
+);
+
+int write_lut_fixtures
+(
+    Sat_t sat,           /* I: satellite */
+    char *aux_path       /* I: directory to contain the LUT directories */
+);
+
+int write_aux_fixtures
+(
+    char *aux_path,      /* I: directory to contain the CMG files and the LADS
+                               auxiliary directory */
+    char *aux_date       /* I: date of the auxiliary file (YYYYDDD) */
+);
+
+#endif
@@ -0,0 +1,1235 @@
+/*****************************************************************************
+FILE: synth_scene.c
+
+PURPOSE: Contains functions for generating synthetic L8 and S2 scenes, either
+in memory (as the TOA arrays the LaSRC kernels consume) or as ESPA raw binary
+products that lasrc can process end-to-end.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The scene is a sheared band of valid pixels (to mimic the rotated Landsat
+   footprint, with the requested fraction of edge fill) covered by land with
+   a mix of vegetation and soil, circular water bodies, and circular clouds.
+   The TOA reflectance is computed from the surface reflectance with the same
+   analytic atmosphere used to write the synthetic LUT fixtures.
+2. All the pixel values are hashed from the seed and the pixel location, so
+   the scene does not depend on the order or the threading of the generation
+   and is the same on every run.
+3. The geolocation is a UTM zone 33 grid; the lat/long corners are only
+   approximate.
+*****************************************************************************/
+#include "synth_scene.h"
+#include "synth_fixtures.h"
+#include "raw_binary_io.h"
+
+/* Projection of the synthetic scene */
+#define SYNTH_UTM_ZONE 33
+#define SYNTH_UL_X 300000.0
+#define SYNTH_UL_Y 5000000.0
+
+/* Size of the grid used to estimate the cloud and water fractions while the
+   discs are placed, and the maximum number of discs */
+#define SYNTH_GRID 128
+#define SYNTH_MAX_DISCS 10000
+
+/* Size of the vegetation/soil mixing blocks, in reflectance pixels */
+#define SYNTH_MIX_BLOCK 16
+
+/* L8 Level-1 calibration used for the synthetic DNs */
+#define SYNTH_REFL_GAIN 2.0E-05
+#define SYNTH_REFL_BIAS -0.1
+#define SYNTH_RAD_GAIN 3.3420E-04
+#define SYNTH_RAD_BIAS 0.1
+
+/* Bands of the synthetic L8 product after the SR_L8_BAND1 to SR_L8_BAND11
+   bands */
+typedef enum {SYNTH_L8_BAND8 = SR_L8_BAND11 + 1, SYNTH_L8_QA, SYNTH_L8_SZA,
+    SYNTH_L8_NBANDS} Synth_l8_band_t;
+
+/* Kinds of bands written for the synthetic products */
+typedef enum {SYNTH_BAND_REFL, SYNTH_BAND_PAN, SYNTH_BAND_THERMAL,
+    SYNTH_BAND_QA, SYNTH_BAND_SZA} Synth_band_kind_t;
+
+/* Reference spectra (surface reflectance) at the L8 band 1-7 wavelengths */
+static float ref_wavelength[NREFL_L8_BANDS] =
+    {0.443, 0.482, 0.561, 0.655, 0.865, 1.609, 2.201};
+static float veg_refl[NREFL_L8_BANDS] =
+    {0.030, 0.045, 0.080, 0.050, 0.350, 0.200, 0.100};
+static float soil_refl[NREFL_L8_BANDS] =
+    {0.070, 0.090, 0.130, 0.170, 0.240, 0.330, 0.280};
+static float water_refl[NREFL_L8_BANDS] =
+    {0.050, 0.050, 0.040, 0.025, 0.010, 0.005, 0.003};
+static float cloud_refl[NREFL_L8_BANDS] =
+    {0.600, 0.600, 0.620, 0.620, 0.630, 0.500, 0.400};
+
+/* Thermal constants for L8 bands 10 and 11 */
+static float synth_k1[2] = {774.8853, 480.8883};
+static float synth_k2[2] = {1321.0789, 1201.1442};
+
+/******************************************************************************
+MODULE:  splitmix64
+
+PURPOSE:  Advances the state and returns the next value of the splitmix64
+generator.
+
+RETURN VALUE:
+Type = uint64_t
+Value           Description
+-----           -----------
+value           Next pseudo-random value
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Used instead of rand() so the scenes are identical across platforms.
+******************************************************************************/
+static uint64_t splitmix64
+(
+    uint64_t *state      /* I/O: generator state */
+)
+{
+    uint64_t z;          /* mixed value */
+
+    z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (z ^ (z >> 31));
+}
+
+
+/******************************************************************************
+MODULE:  uniform
+
+PURPOSE:  Returns the next uniform value in [0, 1) from the generator.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Uniform pseudo-random value in [0, 1)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double uniform
+(
+    uint64_t *state      /* I/O: generator state */
+)
+{
+    return ((splitmix64 (state) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/******************************************************************************
+MODULE:  synth_noise
+
+PURPOSE:  Returns a uniform value in [0, 1) hashed from the seed, the pixel
+location, and a key.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+value           Uniform pseudo-random value in [0, 1)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+double synth_noise
+(
+    unsigned long seed,  /* I: scene seed */
+    int line,            /* I: line of the pixel */
+    int samp,            /* I: sample of the pixel */
+    int key              /* I: additional key, such as the band */
+)
+{
+    uint64_t state;      /* generator state for this pixel */
+
+    state = (uint64_t) seed * 0xD6E8FEB86659FD93ULL;
+    state ^= ((uint64_t) (uint32_t) line << 32) | (uint32_t) samp;
+    splitmix64 (&state);
+    state ^= (uint64_t) (uint32_t) key;
+    return (uniform (&state));
+}
+
+
+/******************************************************************************
+MODULE:  is_fill_pixel
+
+PURPOSE:  Determines if the pixel is outside the sheared band of valid
+pixels.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            Pixel is fill
+false           Pixel is valid
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Each line has a single valid span of (1 - fill_frac) * nsamps samples,
+   shifted from the left edge at the top of the scene to the right edge at
+   the bottom, like the edge fill of a rotated Landsat scene.
+******************************************************************************/
+static bool is_fill_pixel
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    double line,         /* I: reflectance line of the pixel */
+    double samp          /* I: reflectance sample of the pixel */
+)
+{
+    double width;        /* width of the valid span */
+    double offset;       /* start of the valid span */
+
+    width = scene->nsamps * (1.0 - scene->fill_frac);
+    offset = (scene->nsamps - width) * line / scene->nlines;
+    return (samp < offset || samp >= offset + width);
+}
+
+
+/******************************************************************************
+MODULE:  classify_pixel
+
+PURPOSE:  Determines the surface class of the pixel from the fill band and
+the cloud and water discs.
+
+RETURN VALUE:
+Type = Synth_class_t
+Value           Description
+-----           -----------
+class           Surface class of the pixel
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Fill takes precedence over cloud, which takes precedence over water.
+******************************************************************************/
+static Synth_class_t classify_pixel
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    double line,         /* I: reflectance line of the pixel */
+    double samp          /* I: reflectance sample of the pixel */
+)
+{
+    int i;                         /* looping variable for discs */
+    double dl, ds;                 /* distance from the disc center */
+    Synth_class_t type = SYNTH_LAND;  /* class of the pixel */
+
+    if (is_fill_pixel (scene, line, samp))
+        return (SYNTH_FILL);
+
+    for (i = 0; i < scene->ndiscs; i++)
+    {
+        dl = line - scene->discs[i].line;
+        ds = samp - scene->discs[i].samp;
+        if (dl * dl + ds * ds <
+            scene->discs[i].radius * scene->discs[i].radius)
+        {
+            if (scene->discs[i].type == SYNTH_CLOUD)
+                return (SYNTH_CLOUD);
+            type = SYNTH_WATER;
+        }
+    }
+
+    return (type);
+}
+
+
+/******************************************************************************
+MODULE:  place_discs
+
+PURPOSE:  Adds discs of the specified class to the scene until they cover the
+requested fraction of the valid pixels.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the discs
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The coverage is estimated on a SYNTH_GRID x SYNTH_GRID grid of the scene,
+   so the final fraction is approximate.
+******************************************************************************/
+static int place_discs
+(
+    Synth_scene_t *scene,/* I/O: synthetic scene */
+    Synth_class_t type,  /* I: class of the discs (cloud or water) */
+    float frac,          /* I: fraction of the valid pixels to be covered */
+    uint8 *grid,         /* I/O: class of each grid point */
+    uint64_t *state      /* I/O: generator state */
+)
+{
+    char FUNC_NAME[] = "place_discs";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable for grid points */
+    int nvalid = 0;          /* number of valid grid points */
+    int ncovered = 0;        /* number of grid points of this class */
+    double gline, gsamp;     /* location of the grid point */
+    double dl, ds;           /* distance from the disc center */
+    double min_size;         /* smaller of the scene dimensions */
+    Synth_disc_t *disc = NULL;  /* new disc */
+
+    for (i = 0; i < SYNTH_GRID * SYNTH_GRID; i++)
+    {
+        if (grid[i] != SYNTH_FILL)
+            nvalid++;
+        if (grid[i] == type)
+            ncovered++;
+    }
+
+    min_size = (scene->nlines < scene->nsamps) ? scene->nlines : scene->nsamps;
+    while (nvalid > 0 && ncovered < frac * nvalid &&
+        scene->ndiscs < SYNTH_MAX_DISCS)
+    {
+        disc = &scene->discs[scene->ndiscs++];
+        disc->line = uniform (state) * scene->nlines;
+        disc->samp = uniform (state) * scene->nsamps;
+        disc->radius = (0.02 + 0.06 * uniform (state)) * min_size;
+        disc->type = type;
+
+        /* Update the grid; water does not replace cloud */
+        for (i = 0; i < SYNTH_GRID * SYNTH_GRID; i++)
+        {
+            if (grid[i] == SYNTH_FILL || grid[i] == type ||
+                grid[i] == SYNTH_CLOUD)
+                continue;
+
+            gline = ((i / SYNTH_GRID) + 0.5) * scene->nlines / SYNTH_GRID;
+            gsamp = ((i % SYNTH_GRID) + 0.5) * scene->nsamps / SYNTH_GRID;
+            dl = gline - disc->line;
+            ds = gsamp - disc->samp;
+            if (dl * dl + ds * ds < disc->radius * disc->radius)
+            {
+                grid[i] = type;
+                ncovered++;
+            }
+        }
+    }
+
+    if (scene->ndiscs == SYNTH_MAX_DISCS)
+    {
+        sprintf (errmsg, "Reached the maximum number of discs (%d); the "
+            "cloud and water fractions may not be met", SYNTH_MAX_DISCS);
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  init_synth_scene
+
+PURPOSE:  Lays out the synthetic scene and computes its surface class map
+and atmosphere.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid parameters or error allocating memory
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The scene should be freed with free_synth_scene.
+******************************************************************************/
+int init_synth_scene
+(
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the reflectance bands */
+    int nsamps,          /* I: number of samples in the reflectance bands */
+    float fill_frac,     /* I: fraction of the scene that is fill */
+    float cloud_frac,    /* I: fraction of the valid pixels that are cloud */
+    float water_frac,    /* I: fraction of the valid pixels that are water */
+    float aot,           /* I: 550nm AOT used to build the TOA reflectance */
+    unsigned long seed,  /* I: seed for the scene layout and pixel noise */
+    Synth_scene_t *scene /* O: initialized scene */
+)
+{
+    char FUNC_NAME[] = "init_synth_scene";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i;                   /* looping variable */
+    int line, samp;          /* looping variables for the scene */
+    int nbands;              /* number of LUT bands */
+    uint8 grid[SYNTH_GRID * SYNTH_GRID];  /* class of each grid point */
+    uint64_t state;          /* generator state for the scene layout */
+    float xmus, xmuv;        /* cosine of solar and view zenith angles */
+    float cscaa;             /* cosine of the scattering angle */
+
+    if (nlines <= 0 || nsamps <= 0)
+    {
+        sprintf (errmsg, "Invalid scene size: %d lines x %d samples", nlines,
+            nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (sat == SAT_SENTINEL_2 && (nlines % 6 != 0 || nsamps % 6 != 0))
+    {
+        sprintf (errmsg, "S2 scene size must be a multiple of 6 so the 20m "
+            "and 60m bands line up with the 10m bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (fill_frac < 0.0 || fill_frac > 0.9 || cloud_frac < 0.0 ||
+        water_frac < 0.0 || cloud_frac + water_frac > 1.0)
+    {
+        sprintf (errmsg, "Invalid fractions: fill %f (0.0 to 0.9), cloud %f "
+            "and water %f (0.0 to 1.0 combined)", fill_frac, cloud_frac,
+            water_frac);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    scene->sat = sat;
+    scene->nlines = nlines;
+    scene->nsamps = nsamps;
+    scene->fill_frac = fill_frac;
+    scene->cloud_frac = cloud_frac;
+    scene->water_frac = water_frac;
+    scene->aot = aot;
+    scene->seed = seed;
+    scene->ndiscs = 0;
+    scene->class_map = NULL;
+    scene->discs = calloc (SYNTH_MAX_DISCS, sizeof (Synth_disc_t));
+    if (scene->discs == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the discs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Place the clouds, then the water bodies */
+    for (i = 0; i < SYNTH_GRID * SYNTH_GRID; i++)
+    {
+        if (is_fill_pixel (scene,
+            ((i / SYNTH_GRID) + 0.5) * nlines / SYNTH_GRID,
+            ((i % SYNTH_GRID) + 0.5) * nsamps / SYNTH_GRID))
+            grid[i] = SYNTH_FILL;
+        else
+            grid[i] = SYNTH_LAND;
+    }
+
+    state = seed;
+    if (place_discs (scene, SYNTH_CLOUD, cloud_frac, grid, &state) != SUCCESS
+        || place_discs (scene, SYNTH_WATER, water_frac, grid, &state)
+        != SUCCESS)
+    {
+        sprintf (errmsg, "Placing the cloud and water discs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Classify each reflectance pixel */
+    scene->class_map = malloc ((size_t) nlines * nsamps * sizeof (uint8));
+    if (scene->class_map == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the class map");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (samp)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        for (samp = 0; samp < nsamps; samp++)
+            scene->class_map[(size_t) line * nsamps + samp] =
+                classify_pixel (scene, line + 0.5, samp + 0.5);
+    }
+
+    /* Compute the scene atmosphere for each LUT band, using the 6S
+       scattering angle convention */
+    xmus = cos (SYNTH_SUN_ZEN * DEG2RAD);
+    xmuv = cos (SYNTH_VIEW_ZEN * DEG2RAD);
+    cscaa = -xmus * xmuv - cos ((SYNTH_SUN_AZ - SYNTH_VIEW_AZ) * DEG2RAD) *
+        sqrt (1.0 - xmus * xmus) * sqrt (1.0 - xmuv * xmuv);
+    nbands = (sat == SAT_LANDSAT_8) ? NSR_L8_BANDS : NSR_S2_BANDS;
+    for (i = 0; i < nbands; i++)
+        synth_atmos (synth_band_wavelength (sat, i), SYNTH_PRES, aot,
+            SYNTH_SUN_ZEN, SYNTH_VIEW_ZEN, acos (cscaa) * RAD2DEG,
+            &scene->roatm[i], &scene->ttatmg[i], &scene->satm[i]);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_synth_scene
+
+PURPOSE:  Frees the memory allocated for the synthetic scene.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_synth_scene
+(
+    Synth_scene_t *scene /* I/O: scene to be freed */
+)
+{
+    free (scene->discs);
+    free (scene->class_map);
+    scene->discs = NULL;
+    scene->class_map = NULL;
+    scene->ndiscs = 0;
+}
+
+
+/******************************************************************************
+MODULE:  interp_spectrum
+
+PURPOSE:  Linearly interpolates a reference spectrum at the specified
+wavelength.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+refl            Reflectance at the wavelength
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Wavelengths outside the reference wavelengths use the nearest end value.
+******************************************************************************/
+static float interp_spectrum
+(
+    float *spectrum,     /* I: reflectance at the reference wavelengths */
+    float wavelength     /* I: wavelength (microns) */
+)
+{
+    int i;               /* looping variable for reference wavelengths */
+    float w;             /* interpolation weight */
+
+    if (wavelength <= ref_wavelength[0])
+        return (spectrum[0]);
+
+    for (i = 1; i < NREFL_L8_BANDS; i++)
+    {
+        if (wavelength <= ref_wavelength[i])
+        {
+            w = (wavelength - ref_wavelength[i-1]) /
+                (ref_wavelength[i] - ref_wavelength[i-1]);
+            return (spectrum[i-1] + w * (spectrum[i] - spectrum[i-1]));
+        }
+    }
+
+    return (spectrum[NREFL_L8_BANDS-1]);
+}
+
+
+/******************************************************************************
+MODULE:  synth_toa_refl
+
+PURPOSE:  Computes the TOA reflectance of a reflectance pixel of the synthetic
+scene.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+refl            Unscaled TOA reflectance; 0.0 for fill pixels
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The cirrus band sees only the clouds, and the water vapor band sees a
+   partially absorbed surface.
+******************************************************************************/
+float synth_toa_refl
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    int iband,           /* I: LUT band index (0-based; SR_L8_BAND1 to
+                               SR_L8_BAND9 or SR_S2_BAND1 to SR_S2_BAND12) */
+    int line,            /* I: reflectance line of the pixel */
+    int samp             /* I: reflectance sample of the pixel */
+)
+{
+    Synth_class_t type;  /* surface class of the pixel */
+    float wavelength;    /* band wavelength (microns) */
+    double mix;          /* soil fraction of a land pixel */
+    double noise;        /* pixel noise */
+    float rs;            /* surface reflectance */
+
+    type = scene->class_map[(size_t) line * scene->nsamps + samp];
+    if (type == SYNTH_FILL)
+        return (0.0);
+
+    wavelength = synth_band_wavelength (scene->sat, iband);
+    noise = synth_noise (scene->seed, line, samp, iband);
+
+    /* Cirrus band */
+    if (wavelength > 1.35 && wavelength < 1.40)
+    {
+        if (type == SYNTH_CLOUD)
+            return (0.10 + 0.04 * noise);
+        else
+            return (0.002 + 0.002 * noise);
+    }
+
+    if (type == SYNTH_LAND)
+    {
+        mix = synth_noise (scene->seed, line / SYNTH_MIX_BLOCK,
+            samp / SYNTH_MIX_BLOCK, -1);
+        rs = (1.0 - mix) * interp_spectrum (veg_refl, wavelength) +
+            mix * interp_spectrum (soil_refl, wavelength);
+    }
+    else if (type == SYNTH_WATER)
+        rs = interp_spectrum (water_refl, wavelength);
+    else
+        rs = interp_spectrum (cloud_refl, wavelength);
+    rs *= 0.95 + 0.1 * noise;
+
+    /* Water vapor band */
+    if (wavelength > 0.93 && wavelength < 0.96)
+        rs *= 0.6;
+
+    return (scene->roatm[iband] + scene->ttatmg[iband] * rs /
+        (1.0 - scene->satm[iband] * rs));
+}
+
+
+/******************************************************************************
+MODULE:  synth_bt
+
+PURPOSE:  Returns the brightness temperature of a reflectance pixel of the
+synthetic scene.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+bt              Brightness temperature (K)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static float synth_bt
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    int ith,             /* I: thermal band index (0 = band 10, 1 = band 11) */
+    int line,            /* I: reflectance line of the pixel */
+    int samp             /* I: reflectance sample of the pixel */
+)
+{
+    Synth_class_t type;  /* surface class of the pixel */
+    double noise;        /* pixel noise */
+
+    type = scene->class_map[(size_t) line * scene->nsamps + samp];
+    noise = synth_noise (scene->seed, line, samp, SR_L8_BAND10 + ith);
+    if (type == SYNTH_CLOUD)
+        return (255.0 + 5.0 * noise - ith);
+    else if (type == SYNTH_WATER)
+        return (288.0 + noise - ith);
+    else
+        return (298.0 + 6.0 * noise - ith);
+}
+
+
+/******************************************************************************
+MODULE:  synth_sza
+
+PURPOSE:  Returns the solar zenith of a reflectance pixel of the synthetic
+scene.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+sza             Solar zenith angle (deg)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The solar zenith varies by a degree across the scene, about the scene
+   center value in the metadata.
+******************************************************************************/
+static float synth_sza
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    int line,            /* I: reflectance line of the pixel */
+    int samp             /* I: reflectance sample of the pixel */
+)
+{
+    return (SYNTH_SUN_ZEN + 0.6 * ((double) samp / scene->nsamps - 0.5) +
+        0.4 * ((double) line / scene->nlines - 0.5));
+}
+
+
+/******************************************************************************
+MODULE:  synth_l8_toa
+
+PURPOSE:  Fills the L8 TOA reflectance, brightness temperature, QA, and solar
+zenith arrays for the synthetic scene.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. sband must hold SR_L8_TTL-1 bands (all but the aerosol band).
+******************************************************************************/
+void synth_l8_toa
+(
+    Synth_scene_t *scene,/* I: synthetic L8 scene */
+    int16 **sband,       /* O: TOA reflectance and brightness temperature
+                               bands (scaled), as lasrc_compute_toa writes
+                               them, nlines x nsamps */
+    uint16 *qaband,      /* O: Level-1 QA band, nlines x nsamps */
+    int16 *sza           /* O: scaled per-pixel solar zenith, nlines x nsamps;
+                               NULL if not needed */
+)
+{
+    int ib;              /* looping variable for bands */
+    int line, samp;      /* looping variables for the scene */
+    size_t pix;          /* current pixel */
+    Synth_class_t type;  /* surface class of the pixel */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (samp, ib, pix, type)
+#endif
+    for (line = 0; line < scene->nlines; line++)
+    {
+        for (samp = 0; samp < scene->nsamps; samp++)
+        {
+            pix = (size_t) line * scene->nsamps + samp;
+            type = scene->class_map[pix];
+            if (type == SYNTH_FILL)
+            {
+                for (ib = SR_L8_BAND1; ib <= SR_L8_BAND11; ib++)
+                    sband[ib][pix] = FILL_VALUE;
+                qaband[pix] = SYNTH_QA_FILL;
+                if (sza != NULL)
+                    sza[pix] = PPA_FILL;
+                continue;
+            }
+
+            for (ib = SR_L8_BAND1; ib <= SR_L8_BAND9; ib++)
+                sband[ib][pix] = (int16) (synth_toa_refl (scene, ib, line,
+                    samp) * MULT_FACTOR);
+            sband[SR_L8_BAND10][pix] = (int16) (synth_bt (scene, 0, line,
+                samp) * MULT_FACTOR_TH);
+            sband[SR_L8_BAND11][pix] = (int16) (synth_bt (scene, 1, line,
+                samp) * MULT_FACTOR_TH);
+
+            if (type == SYNTH_CLOUD)
+                qaband[pix] = SYNTH_QA_CLOUD;
+            else
+                qaband[pix] = SYNTH_QA_CLEAR;
+
+            if (sza != NULL)
+                sza[pix] = (int16) (synth_sza (scene, line, samp) * 100.0);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  synth_s2_toa
+
+PURPOSE:  Fills the S2 TOA reflectance arrays for the synthetic scene.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. All the bands are generated at 10m; the 20m and 60m bands are not
+   degraded to their native resolution.
+******************************************************************************/
+void synth_s2_toa
+(
+    Synth_scene_t *scene,/* I: synthetic S2 scene */
+    uint16 **toaband     /* O: TOA reflectance bands (scaled) at 10m, as
+                               read_s2_toa_refl returns them,
+                               nlines x nsamps */
+)
+{
+    int ib;              /* looping variable for bands */
+    int line, samp;      /* looping variables for the scene */
+    size_t pix;          /* current pixel */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (samp, ib, pix)
+#endif
+    for (line = 0; line < scene->nlines; line++)
+    {
+        for (samp = 0; samp < scene->nsamps; samp++)
+        {
+            pix = (size_t) line * scene->nsamps + samp;
+            for (ib = SR_S2_BAND1; ib <= SR_S2_BAND12; ib++)
+                toaband[ib][pix] = (uint16) (synth_toa_refl (scene, ib, line,
+                    samp) * MULT_FACTOR + 0.5);
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  set_band_meta
+
+PURPOSE:  Sets the metadata common to all the synthetic bands.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void set_band_meta
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    char *product_id,    /* I: product ID, used as the filename prefix */
+    char *name,          /* I: band name */
+    char *category,      /* I: band category */
+    int data_type,       /* I: ESPA data type */
+    double pixsize,      /* I: pixel size of the band (meters) */
+    double refl_pixsize, /* I: pixel size of the reflectance bands */
+    long fill_value,     /* I: fill value */
+    char *data_units,    /* I: data units */
+    char *long_name,     /* I: long name */
+    Espa_band_meta_t *bmeta  /* O: band metadata */
+)
+{
+    if (scene->sat == SAT_LANDSAT_8)
+    {
+        strcpy (bmeta->product, "L1TP");
+        strcpy (bmeta->short_name, "LC08DN");
+    }
+    else
+    {
+        strcpy (bmeta->product, "L1C");
+        strcpy (bmeta->short_name, "S2MSI1C");
+    }
+    strcpy (bmeta->source, "level1");
+    strcpy (bmeta->name, name);
+    strcpy (bmeta->category, category);
+    bmeta->data_type = data_type;
+    bmeta->nlines = (int) (scene->nlines * refl_pixsize / pixsize);
+    bmeta->nsamps = (int) (scene->nsamps * refl_pixsize / pixsize);
+    bmeta->pixel_size[0] = pixsize;
+    bmeta->pixel_size[1] = pixsize;
+    strcpy (bmeta->pixel_units, "meters");
+    bmeta->fill_value = fill_value;
+    strcpy (bmeta->data_units, data_units);
+    strcpy (bmeta->long_name, long_name);
+    sprintf (bmeta->file_name, "%s_%s.img", product_id, name);
+    strcpy (bmeta->production_date, "2017-06-29T00:00:00Z");
+    strcpy (bmeta->app_version, "gen_synthetic");
+    strcpy (bmeta->resample_method, "none");
+}
+
+
+/******************************************************************************
+MODULE:  write_synth_band
+
+PURPOSE:  Writes one band of the synthetic product as ESPA raw binary.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the band
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. All the synthetic bands are 16-bit.  Bands at a different resolution than
+   the reflectance bands sample the reflectance pixel containing their pixel
+   center.
+******************************************************************************/
+static int write_synth_band
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    char *outdir,        /* I: output directory */
+    Espa_band_meta_t *bmeta, /* I: band metadata */
+    double refl_pixsize, /* I: pixel size of the reflectance bands */
+    Synth_band_kind_t kind,  /* I: kind of band */
+    int iband            /* I: LUT band index for reflectance bands, thermal
+                               band index (0 or 1) for thermal bands */
+)
+{
+    char FUNC_NAME[] = "write_synth_band";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char fname[STR_SIZE];    /* output filename */
+    int line, samp;          /* looping variables for the band */
+    int rline, rsamp;        /* corresponding reflectance pixel */
+    double ratio;            /* band pixel size / reflectance pixel size */
+    double toa;              /* TOA reflectance */
+    double rad;              /* thermal radiance */
+    double dn;               /* digital number */
+    Synth_class_t type;      /* surface class of the pixel */
+    uint16 *buf = NULL;      /* output line */
+    int16 *buf16 = NULL;     /* output line, as signed values */
+    FILE *fp = NULL;         /* output file pointer */
+
+    buf = calloc (bmeta->nsamps, sizeof (uint16));
+    if (buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the output line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    buf16 = (int16 *) buf;
+
+    sprintf (fname, "%s/%s", outdir, bmeta->file_name);
+    fp = open_raw_binary (fname, "w");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening the output file: %s", fname);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    ratio = bmeta->pixel_size[0] / refl_pixsize;
+    for (line = 0; line < bmeta->nlines; line++)
+    {
+        rline = (int) ((line + 0.5) * ratio);
+        for (samp = 0; samp < bmeta->nsamps; samp++)
+        {
+            rsamp = (int) ((samp + 0.5) * ratio);
+            type = scene->class_map[(size_t) rline * scene->nsamps + rsamp];
+
+            if (kind == SYNTH_BAND_QA)
+            {
+                if (type == SYNTH_FILL)
+                    buf[samp] = SYNTH_QA_FILL;
+                else if (type == SYNTH_CLOUD)
+                    buf[samp] = SYNTH_QA_CLOUD;
+                else
+                    buf[samp] = SYNTH_QA_CLEAR;
+                continue;
+            }
+
+            if (kind == SYNTH_BAND_SZA)
+            {
+                if (type == SYNTH_FILL)
+                    buf16[samp] = PPA_FILL;
+                else
+                    buf16[samp] = (int16) (synth_sza (scene, rline, rsamp) *
+                        100.0);
+                continue;
+            }
+
+            if (type == SYNTH_FILL)
+            {
+                buf[samp] = 0;
+                continue;
+            }
+
+            if (kind == SYNTH_BAND_THERMAL)
+            {
+                rad = synth_k1[iband] / (exp (synth_k2[iband] /
+                    synth_bt (scene, iband, rline, rsamp)) - 1.0);
+                dn = (rad - SYNTH_RAD_BIAS) / SYNTH_RAD_GAIN;
+            }
+            else
+            {
+                /* The pan band is the average of green and red */
+                if (kind == SYNTH_BAND_PAN)
+                    toa = 0.5 * (synth_toa_refl (scene, SR_L8_BAND3, rline,
+                        rsamp) + synth_toa_refl (scene, SR_L8_BAND4, rline,
+                        rsamp));
+                else
+                    toa = synth_toa_refl (scene, iband, rline, rsamp);
+
+                /* L8 DNs are calibrated to TOA reflectance without the solar
+                   zenith correction; S2 L1C values are scaled reflectance */
+                if (scene->sat == SAT_LANDSAT_8)
+                    dn = (toa * cos (synth_sza (scene, rline, rsamp) *
+                        DEG2RAD) - SYNTH_REFL_BIAS) / SYNTH_REFL_GAIN;
+                else
+                    dn = toa * MULT_FACTOR;
+            }
+
+            if (dn < 1.0)
+                dn = 1.0;
+            else if (dn > 65535.0)
+                dn = 65535.0;
+            buf[samp] = (uint16) (dn + 0.5);
+        }
+
+        if (write_raw_binary (fp, 1, bmeta->nsamps, sizeof (uint16), buf)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Writing line %d to the output file: %s", line,
+                fname);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    close_raw_binary (fp);
+    free (buf);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_synth_scene
+
+PURPOSE:  Writes the synthetic scene as an ESPA raw binary Level-1 product.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the product
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. L8 products contain bands 1-11, the Level-1 QA band, and the band 4 solar
+   zenith band.  S2 products contain B01-B12 and B8A at their native
+   resolutions (the scene size is the 10m size).
+2. The image filenames in the XML have no directory, like the ESPA products,
+   so lasrc should be run from the output directory.
+******************************************************************************/
+int write_synth_scene
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    char *outdir,        /* I: directory for the XML and image files */
+    char **xml_file      /* O: address of the XML filename; memory is
+                               allocated by this routine */
+)
+{
+    char FUNC_NAME[] = "write_synth_scene";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char product_id[STR_SIZE];   /* product ID */
+    char name[STR_SIZE];     /* band name */
+    char long_name[STR_SIZE];    /* band long name */
+    int ib;                  /* looping variable for bands */
+    int nbands;              /* number of bands in the product */
+    int retval;              /* return status */
+    double pixsize;          /* pixel size of the reflectance bands */
+    double lat, lon;         /* approximate geographic coordinates */
+    Espa_internal_meta_t xml;    /* XML metadata */
+    Espa_global_meta_t *gmeta = &xml.global;  /* global metadata */
+    Espa_band_meta_t *bmeta = NULL;           /* current band metadata */
+    char *s2_names[NSR_S2_BANDS] = {"B01", "B02", "B03", "B04", "B05", "B06",
+        "B07", "B08", "B8A", "B09", "B10", "B11", "B12"};
+    double s2_pixsize[NSR_S2_BANDS] = {60.0, 10.0, 10.0, 10.0, 20.0, 20.0,
+        20.0, 10.0, 20.0, 60.0, 60.0, 20.0, 20.0};
+
+    if (synth_make_dir (outdir) != SUCCESS)
+        return (ERROR);
+
+    init_metadata_struct (&xml);
+    if (scene->sat == SAT_LANDSAT_8)
+    {
+        pixsize = 30.0;
+        nbands = SYNTH_L8_NBANDS;
+        strcpy (product_id, "LC08_L1TP_190028_20170615_20170629_01_T1");
+        strcpy (gmeta->data_provider, "USGS/EROS");
+        strcpy (gmeta->satellite, "LANDSAT_8");
+        strcpy (gmeta->instrument, "OLI_TIRS");
+        gmeta->wrs_system = 2;
+        gmeta->wrs_path = 190;
+        gmeta->wrs_row = 28;
+    }
+    else
+    {
+        pixsize = 10.0;
+        nbands = NSR_S2_BANDS;
+        strcpy (product_id, "S2A_MSIL1C_20170615T100031_T33TWM");
+        strcpy (gmeta->data_provider, "ESA");
+        strcpy (gmeta->satellite, "Sentinel-2A");
+        strcpy (gmeta->instrument, "MSI");
+    }
+
+    /* Global metadata */
+    strcpy (gmeta->product_id, product_id);
+    strcpy (gmeta->acquisition_date, "2017-06-15");
+    strcpy (gmeta->scene_center_time, "10:00:31.0000000Z");
+    strcpy (gmeta->level1_production_date, "2017-06-29T00:00:00Z");
+    gmeta->solar_zenith = SYNTH_SUN_ZEN;
+    gmeta->solar_azimuth = SYNTH_SUN_AZ;
+    gmeta->view_zenith = SYNTH_VIEW_ZEN;
+    gmeta->view_azimuth = SYNTH_VIEW_AZ;
+    gmeta->earth_sun_dist = 1.0157;
+
+    gmeta->proj_info.proj_type = GCTP_UTM_PROJ;
+    gmeta->proj_info.datum_type = ESPA_WGS84;
+    gmeta->proj_info.utm_zone = SYNTH_UTM_ZONE;
+    strcpy (gmeta->proj_info.units, "meters");
+    strcpy (gmeta->proj_info.grid_origin, "UL");
+    gmeta->proj_info.ul_corner[0] = SYNTH_UL_X;
+    gmeta->proj_info.ul_corner[1] = SYNTH_UL_Y;
+    gmeta->proj_info.lr_corner[0] = SYNTH_UL_X + (scene->nsamps - 1) * pixsize;
+    gmeta->proj_info.lr_corner[1] = SYNTH_UL_Y - (scene->nlines - 1) * pixsize;
+
+    /* Approximate lat/long corners about the 15E central meridian */
+    lat = SYNTH_UL_Y / 111132.0;
+    lon = 15.0 + (SYNTH_UL_X - 500000.0) / (111320.0 * cos (lat * DEG2RAD));
+    gmeta->ul_corner[0] = lat;
+    gmeta->ul_corner[1] = lon;
+    gmeta->bounding_coords[ESPA_NORTH] = lat;
+    gmeta->bounding_coords[ESPA_WEST] = lon;
+    lat = gmeta->proj_info.lr_corner[1] / 111132.0;
+    lon = 15.0 + (gmeta->proj_info.lr_corner[0] - 500000.0) /
+        (111320.0 * cos (lat * DEG2RAD));
+    gmeta->lr_corner[0] = lat;
+    gmeta->lr_corner[1] = lon;
+    gmeta->bounding_coords[ESPA_SOUTH] = lat;
+    gmeta->bounding_coords[ESPA_EAST] = lon;
+
+    /* Band metadata */
+    if (allocate_band_metadata (&xml, nbands) != SUCCESS)
+    {
+        sprintf (errmsg, "Allocating the band metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (ib = 0; ib < nbands; ib++)
+    {
+        bmeta = &xml.band[ib];
+        if (scene->sat == SAT_SENTINEL_2)
+        {
+            sprintf (long_name, "band %s top-of-atmosphere reflectance",
+                s2_names[ib]);
+            set_band_meta (scene, product_id, s2_names[ib], "image",
+                ESPA_UINT16, s2_pixsize[ib], pixsize, 0, "reflectance",
+                long_name, bmeta);
+            bmeta->scale_factor = SCALE_FACTOR;
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_REFL, ib);
+        }
+        else if (ib <= SR_L8_BAND7)
+        {
+            /* Bands 1-7 */
+            sprintf (name, "b%d", ib + 1);
+            sprintf (long_name, "band %d digital numbers", ib + 1);
+            set_band_meta (scene, product_id, name, "image", ESPA_UINT16,
+                pixsize, pixsize, 0, "digital numbers", long_name, bmeta);
+            bmeta->refl_gain = SYNTH_REFL_GAIN;
+            bmeta->refl_bias = SYNTH_REFL_BIAS;
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_REFL, ib);
+        }
+        else if (ib == SR_L8_BAND9)
+        {
+            set_band_meta (scene, product_id, "b9", "image", ESPA_UINT16,
+                pixsize, pixsize, 0, "digital numbers",
+                "band 9 digital numbers", bmeta);
+            bmeta->refl_gain = SYNTH_REFL_GAIN;
+            bmeta->refl_bias = SYNTH_REFL_BIAS;
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_REFL, SR_L8_BAND9);
+        }
+        else if (ib == SR_L8_BAND10 || ib == SR_L8_BAND11)
+        {
+            sprintf (name, "b%d", ib + 2);
+            sprintf (long_name, "band %d digital numbers", ib + 2);
+            set_band_meta (scene, product_id, name, "image", ESPA_UINT16,
+                pixsize, pixsize, 0, "digital numbers", long_name, bmeta);
+            bmeta->rad_gain = SYNTH_RAD_GAIN;
+            bmeta->rad_bias = SYNTH_RAD_BIAS;
+            bmeta->k1_const = synth_k1[ib - SR_L8_BAND10];
+            bmeta->k2_const = synth_k2[ib - SR_L8_BAND10];
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_THERMAL, ib - SR_L8_BAND10);
+        }
+        else if (ib == SYNTH_L8_BAND8)
+        {
+            /* Band 8 (pan) at 15m */
+            set_band_meta (scene, product_id, "b8", "image", ESPA_UINT16,
+                pixsize / 2.0, pixsize, 0, "digital numbers",
+                "band 8 digital numbers", bmeta);
+            bmeta->refl_gain = SYNTH_REFL_GAIN;
+            bmeta->refl_bias = SYNTH_REFL_BIAS;
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_PAN, 0);
+        }
+        else if (ib == SYNTH_L8_QA)
+        {
+            set_band_meta (scene, product_id, "bqa", "qa", ESPA_UINT16,
+                pixsize, pixsize, SYNTH_QA_FILL,
+                "quality/feature classification", "level-1 quality band",
+                bmeta);
+            strcpy (bmeta->short_name, "LC08PQA");
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_QA, 0);
+        }
+        else
+        {
+            set_band_meta (scene, product_id, "solar_zenith_band4", "image",
+                ESPA_INT16, pixsize, pixsize, PPA_FILL, "degrees",
+                "band 4 solar zenith angles", bmeta);
+            strcpy (bmeta->short_name, "LC08SOZ");
+            bmeta->scale_factor = 0.01;
+            retval = write_synth_band (scene, outdir, bmeta, pixsize,
+                SYNTH_BAND_SZA, 0);
+        }
+
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Writing band %s", bmeta->name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Write the XML file */
+    *xml_file = malloc (STR_SIZE);
+    if (*xml_file == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the XML filename");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    sprintf (*xml_file, "%s/%s.xml", outdir, product_id);
+    if (write_metadata (&xml, *xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the XML file: %s", *xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    free_metadata (&xml);
+
+    return (SUCCESS);
+}
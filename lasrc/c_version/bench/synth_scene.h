@@ -0,0 +1,123 @@
+#ifndef _SYNTH_SCENE_H_
+#define _SYNTH_SCENE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "lasrc.h"
+
+/* Surface classes of the synthetic scene */
+typedef enum {SYNTH_FILL=0, SYNTH_LAND, SYNTH_WATER, SYNTH_CLOUD}
+    Synth_class_t;
+
+/* Level-1 QA values written for the synthetic L8 scene */
+#define SYNTH_QA_FILL 1       /* designated fill */
+#define SYNTH_QA_CLEAR 2720   /* low confidence cloud, shadow, snow, cirrus */
+#define SYNTH_QA_CLOUD 2800   /* high confidence cloud */
+
+/* Geometry of the synthetic scene */
+#define SYNTH_SUN_ZEN 35.0
+#define SYNTH_SUN_AZ 150.0
+#define SYNTH_VIEW_ZEN 0.0
+#define SYNTH_VIEW_AZ 0.0
+
+/* Surface pressure of the synthetic scene (mb), matching the 100m elevation
+   of the synthetic CMG DEM */
+#define SYNTH_PRES 1001.3
+
+/* Circular cloud or water body of the synthetic scene */
+typedef struct {
+    double line;         /* center line, in reflectance pixels */
+    double samp;         /* center sample, in reflectance pixels */
+    double radius;       /* radius, in reflectance pixels */
+    Synth_class_t type;  /* class inside the disc (cloud or water) */
+} Synth_disc_t;
+
+/* Synthetic scene description.  The scene is fully determined by the
+   parameters and the seed, so the same scene is generated on every run. */
+typedef struct {
+    Sat_t sat;           /* satellite */
+    int nlines;          /* number of lines in the reflectance bands (30m for
+                            L8, 10m for S2) */
+    int nsamps;          /* number of samples in the reflectance bands */
+    float fill_frac;     /* fraction of the scene that is fill */
+    float cloud_frac;    /* fraction of the valid pixels that are cloud */
+    float water_frac;    /* fraction of the valid pixels that are water */
+    float aot;           /* 550nm AOT used to build the TOA reflectance */
+    unsigned long seed;  /* seed for the scene layout and the pixel noise */
+    int ndiscs;          /* number of cloud and water discs */
+    Synth_disc_t *discs; /* cloud and water discs */
+    uint8 *class_map;    /* surface class of each reflectance pixel,
+                            nlines x nsamps */
+    float roatm[NSR_BANDS];  /* scene intrinsic reflectance per LUT band */
+    float ttatmg[NSR_BANDS]; /* scene total transmission per LUT band */
+    float satm[NSR_BANDS];   /* scene spherical albedo per LUT band */
+} Synth_scene_t;
+
+/* Prototypes */
+int init_synth_scene
+(
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the reflectance bands */
+    int nsamps,          /* I: number of samples in the reflectance bands */
+    float fill_frac,     /* I: fraction of the scene that is fill */
+    float cloud_frac,    /* I: fraction of the valid pixels that are cloud */
+    float water_frac,    /* I: fraction of the valid pixels that are water */
+    float aot,           /* I: 550nm AOT used to build the TOA reflectance */
+    unsigned long seed,  /* I: seed for the scene layout and pixel noise */
+    Synth_scene_t *scene /* O: initialized scene */
+);
+
+void free_synth_scene
+(
+    Synth_scene_t *scene /* I/O: scene to be freed */
+);
+
+double synth_noise
+(
+    unsigned long seed,  /* I: scene seed */
+    int line,            /* I: line of the pixel */
+    int samp,            /* I: sample of the pixel */
+    int key              /* I: additional key, such as the band */
+);
+
+float synth_toa_refl
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    int iband,           /* I: LUT band index (0-based; SR_L8_BAND1 to
+                               SR_L8_BAND9 or SR_S2_BAND1 to SR_S2_BAND12) */
+    int line,            /* I: reflectance line of the pixel */
+    int samp             /* I: reflectance sample of the pixel */
+);
+
+void synth_l8_toa
+(
+    Synth_scene_t *scene,/* I: synthetic L8 scene */
+    int16 **sband,       /* O: TOA reflectance and brightness temperature
+                               bands (scaled), as lasrc_compute_toa writes
+                               them, nlines x nsamps */
+    uint16 *qaband,      /* O: Level-1 QA band, nlines x nsamps */
+    int16 *sza           /* O: scaled per-pixel solar zenith, nlines x nsamps;
+                               NULL if not needed */
+);
+
+void synth_s2_toa
+(
+    Synth_scene_t *scene,/* I: synthetic S2 scene */
+    uint16 **toaband     /* O: TOA reflectance bands (scaled) at 10m, as
+                               read_s2_toa_refl returns them,
+                               nlines x nsamps */
+);
+
+int write_synth_scene
+(
+    Synth_scene_t *scene,/* I: synthetic scene */
+    char *outdir,        /* I: directory for the XML and image files */
+    char **xml_file      /* O: address of the XML filename; memory is
+                               allocated by this routine */
+);
+
+#endif
@@ -0,0 +1,228 @@
+#! /usr/bin/env python
+import sys
+import os
+import csv
+from optparse import OptionParser
+import logging
+
+ERROR = 1
+SUCCESS = 0
+
+
+#############################################################################
+# Created Python script to fit the coefficients of the lasrc cost model
+# (lasrc --estimate) to the measured wall time and peak memory of past lasrc
+# runs on the processing hardware.
+#
+# Usage: calibrate_lasrc_cost.py --help prints the help message
+############################################################################
+class CostCalibration():
+
+    def __init__(self):
+        pass
+
+
+    ########################################################################
+    # Description: readFeatures pulls the scene features from the
+    # COST_ESTIMATE line written by lasrc --estimate.
+    #
+    # Inputs:
+    #   estimate_log - name of the file containing the lasrc --estimate output
+    #
+    # Returns:
+    #     dictionary of the COST_ESTIMATE fields, or None if the line is not
+    #     in the file
+    #######################################################################
+    def readFeatures (self, estimate_log):
+        with open (estimate_log, 'r') as fd:
+            for line in fd:
+                if not line.startswith('COST_ESTIMATE '):
+                    continue
+                features = {}
+                for field in line.split()[1:]:
+                    (name, value) = field.split('=')
+                    features[name] = float(value)
+                return features
+        return None
+
+
+    ########################################################################
+    # Description: leastSquares solves the normal equations of a linear
+    # least squares fit with Gaussian elimination.
+    #
+    # Inputs:
+    #   rows - list of the rows of the design matrix
+    #   obs - list of the observations
+    #
+    # Returns:
+    #     list of the fit coefficients, or None if the system is singular
+    #######################################################################
+    def leastSquares (self, rows, obs):
+        ncoef = len(rows[0])
+        ata = [[0.0] * (ncoef + 1) for i in range(ncoef)]
+        for (row, y) in zip(rows, obs):
+            for i in range(ncoef):
+                for j in range(ncoef):
+                    ata[i][j] += row[i] * row[j]
+                ata[i][ncoef] += row[i] * y
+
+        # forward elimination with partial pivoting
+        for col in range(ncoef):
+            pivot = max(range(col, ncoef), key=lambda r: abs(ata[r][col]))
+            if abs(ata[pivot][col]) < 1e-12:
+                return None
+            (ata[col], ata[pivot]) = (ata[pivot], ata[col])
+            for r in range(col + 1, ncoef):
+                scale = ata[r][col] / ata[col][col]
+                for c in range(col, ncoef + 1):
+                    ata[r][c] -= scale * ata[col][c]
+
+        # back substitution
+        coef = [0.0] * ncoef
+        for r in range(ncoef - 1, -1, -1):
+            total = ata[r][ncoef]
+            for c in range(r + 1, ncoef):
+                total -= ata[r][c] * coef[c]
+            coef[r] = total / ata[r][r]
+        return coef
+
+
+    ########################################################################
+    # Description: runCalibration reads the table of past runs, fits the
+    # cost model coefficients, and writes them to the cost model file.
+    #
+    # Inputs:
+    #   runs_file - name of the CSV file of past runs with the columns
+    #       estimate_log, threads, wall_sec, max_rss_mb
+    #   model_file - name of the cost model file to be written
+    #
+    # Returns:
+    #     ERROR - error reading the runs or fitting the cost model
+    #     SUCCESS - successful calibration
+    #
+    # Notes:
+    #   1. estimate_log is the output of lasrc --estimate for the scene with
+    #      the same options as the run, threads is the OMP_NUM_THREADS of the
+    #      run, and wall_sec and max_rss_mb are the measured wall time and
+    #      peak RSS of the run, e.g. from /usr/bin/time -v.
+    #   2. The wall time for T threads is modeled as
+    #          serial_sec + serial_sec_per_mpix * Mpix
+    #              + (band_sec_per_mpix * Mvalid_band_pix
+    #                 + window_sec_per_mwin * Mclear_windows) / T
+    #      and the peak RSS as rss_scale * alloc_mb + rss_offset_mb.  The runs
+    #      need to cover a range of scene sizes, cloud cover, and thread
+    #      counts for the fit to separate the terms.
+    #######################################################################
+    def runCalibration (self, runs_file=None, model_file=None):
+        # if no parameters were passed then get the info from the
+        # command line
+        if runs_file == None:
+            # get the command line argument for the runs and model files
+            parser = OptionParser()
+            parser.add_option ('--runs', type='string', dest='runs_file',
+                help='CSV file of past lasrc runs with the columns '
+                     'estimate_log, threads, wall_sec, max_rss_mb',
+                metavar='FILE')
+            parser.add_option ('--model', type='string', dest='model_file',
+                default='lasrc_cost_model.txt',
+                help='name of the cost model file to be written '
+                     '(default: lasrc_cost_model.txt)',
+                metavar='FILE')
+            (options, args) = parser.parse_args()
+
+            runs_file = options.runs_file
+            model_file = options.model_file
+            if runs_file == None:
+                parser.error ('missing runs file command-line argument')
+                return ERROR
+
+        logger = logging.getLogger(__name__)
+
+        # read the runs and the features of their scenes
+        if not os.path.isfile(runs_file):
+            msg = ('Runs file does not exist or is not accessible: {}'
+                   .format(runs_file))
+            logger.error (msg)
+            return ERROR
+
+        time_rows = []
+        time_obs = []
+        rss_rows = []
+        rss_obs = []
+        with open (runs_file, 'r') as fd:
+            for run in csv.DictReader(fd):
+                try:
+                    features = self.readFeatures (run['estimate_log'])
+                    threads = float(run['threads'])
+                    wall_sec = float(run['wall_sec'])
+                    max_rss_mb = float(run['max_rss_mb'])
+                except (KeyError, IOError, ValueError) as e:
+                    msg = 'Invalid run in {}: {}'.format(runs_file, e)
+                    logger.error (msg)
+                    return ERROR
+                if features == None:
+                    msg = ('No COST_ESTIMATE line in {}'
+                           .format(run['estimate_log']))
+                    logger.error (msg)
+                    return ERROR
+
+                mpix = features['npix'] / 1.0e6
+                mvalid_band_pix = (features['nvalid'] * features['nbands']
+                                   / 1.0e6)
+                mwin = features['nclear_windows'] / 1.0e6
+                time_rows.append([1.0, mpix, mvalid_band_pix / threads,
+                                  mwin / threads])
+                time_obs.append(wall_sec)
+                rss_rows.append([features['alloc_mb'], 1.0])
+                rss_obs.append(max_rss_mb)
+
+        msg = 'Fitting the cost model to {} runs'.format(len(time_obs))
+        logger.info (msg)
+
+        # fit the wall time and the peak RSS
+        time_coef = None
+        rss_coef = None
+        if len(time_obs) >= 4:
+            time_coef = self.leastSquares (time_rows, time_obs)
+            rss_coef = self.leastSquares (rss_rows, rss_obs)
+        if time_coef == None or rss_coef == None:
+            msg = ('The runs do not determine the cost model.  Include '
+                   'scenes with different sizes and cloud cover, run with '
+                   'different thread counts.')
+            logger.error (msg)
+            return ERROR
+
+        for (name, value) in zip(['serial_sec', 'serial_sec_per_mpix',
+                                  'band_sec_per_mpix', 'window_sec_per_mwin'],
+                                 time_coef):
+            if value < 0.0:
+                msg = ('Fit {} is negative ({:g}).  The runs may not cover '
+                       'enough variation for this term.'.format(name, value))
+                logger.warning (msg)
+
+        # write the cost model file
+        with open (model_file, 'w') as fd:
+            fd.write ('# lasrc cost model fit to {} runs from {}\n'
+                      .format(len(time_obs), runs_file))
+            fd.write ('rss_scale {:.6g}\n'.format(rss_coef[0]))
+            fd.write ('rss_offset_mb {:.6g}\n'.format(rss_coef[1]))
+            fd.write ('serial_sec {:.6g}\n'.format(time_coef[0]))
+            fd.write ('serial_sec_per_mpix {:.6g}\n'.format(time_coef[1]))
+            fd.write ('band_sec_per_mpix {:.6g}\n'.format(time_coef[2]))
+            fd.write ('window_sec_per_mwin {:.6g}\n'.format(time_coef[3]))
+
+        msg = 'Cost model written to {}'.format(model_file)
+        logger.info (msg)
+        return SUCCESS
+
+######end of CostCalibration class######
+
+if __name__ == "__main__":
+    # setup the default logger format and level. log to STDOUT.
+    logging.basicConfig(format=('%(asctime)s.%(msecs)03d %(process)d'
+                                ' %(levelname)-8s'
+                                ' %(filename)s:%(lineno)d:'
+                                '%(funcName)s -- %(message)s'),
+                        datefmt='%Y-%m-%d %H:%M:%S',
+                        level=logging.INFO)
+    sys.exit (CostCalibration().runCalibration())
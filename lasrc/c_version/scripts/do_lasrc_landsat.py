@@ -159,16 +159,14 @@ class SurfaceReflectance():
             os.chdir(mydir)
             return ERROR
 
-        # Mask the angle bands to match the band quality band
-        cmdstr = ('mask_per_pixel_angles.py --xml {}'
-                  .format(base_xmlfile))
-        (status, output) = commands.getstatusoutput(cmdstr)
-        logger.info(output)
-        exit_code = status >> 8
-        if exit_code != 0:
-            logger.error('Error masking angle bands with the band '
-                         'quality band. Processing will terminate.')
-            return ERROR
+        # The angle bands are masked with the band quality band as lasrc
+        # reads them, so there is no separate masking step
+
+        # Bind the OpenMP threads to cores, unless already specified, so the
+        # memory first touched by each thread stays local to that thread
+        # through all the processing stages
+        os.environ.setdefault('OMP_PROC_BIND', 'close')
+        os.environ.setdefault('OMP_PLACES', 'cores')
 
         # run surface reflectance algorithm, checking the return status.  exit
         # if any errors occur.
@@ -134,6 +134,12 @@ class SurfaceReflectance():
             os.chdir (mydir)
             return ERROR
 
+        # Bind the OpenMP threads to cores, unless already specified, so the
+        # memory first touched by each thread stays local to that thread
+        # through all the processing stages
+        os.environ.setdefault('OMP_PROC_BIND', 'close')
+        os.environ.setdefault('OMP_PLACES', 'cores')
+
         # run surface reflectance algorithm, checking the return status.  exit
         # if any errors occur.
         cmdstr = ('lasrc --xml={} --aux={} --verbose'
@@ -15,6 +15,8 @@ PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
+  1. Only the valid span of each line is interpolated.  The samples outside
+     the spans are fill and are only flagged as such in the ipflag.
 ******************************************************************************/
 void aerosol_interp_l8
 (
@@ -23,6 +25,7 @@ void aerosol_interp_l8
     int half_aero_window, /* I: size of half the aerosol window */
     int16 **sband,     /* I/O: input TOA reflectance */
     uint16 *qaband,    /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans, /* I: valid span of each line, from the QA band */
     uint8 *ipflag,     /* I/O: QA flag to assist with aerosol interpolation,
                                nlines x nsamps.  It is expected that the ipflag
                                values are computed for the center of the
@@ -139,8 +142,9 @@ void aerosol_interp_l8
                 center_line1 = center_line;
         }
 
-        curr_pix = line * nsamps;
-        for (samp = 0; samp < nsamps; samp++, curr_pix++)
+        curr_pix = line * nsamps + spans[line].start;
+        for (samp = spans[line].start; samp < spans[line].end;
+             samp++, curr_pix++)
         {
             /* If this pixel is fill, then don't process */
             if (level1_qa_is_fill (qaband[curr_pix]))
@@ -263,10 +267,16 @@ void aerosol_interp_l8
        pixels. If an NxN window is a mixture of fill and non-fill, the center
        of the window can be flagged as fill and some other QA based on the
        other pixels in that window. At the end, we want fill to be fill. */
-    for (curr_pix = 0; curr_pix < nlines * nsamps; curr_pix++)
+    fill_span_gaps_uint8 (ipflag, (1 << IPFLAG_FILL), spans, nlines, nsamps);
+    for (line = 0; line < nlines; line++)
     {
-        if (level1_qa_is_fill (qaband[curr_pix]))
-            ipflag[curr_pix] = (1 << IPFLAG_FILL);
+        curr_pix = line * nsamps + spans[line].start;
+        for (samp = spans[line].start; samp < spans[line].end;
+             samp++, curr_pix++)
+        {
+            if (level1_qa_is_fill (qaband[curr_pix]))
+                ipflag[curr_pix] = (1 << IPFLAG_FILL);
+        }
     }
 
     /* Update final status */
@@ -677,3 +687,142 @@ float find_median_aerosol_s2
     return (median);
 }
 
+
+
+/******************************************************************************
+MODULE:  is_coarse_aero_window
+
+PURPOSE:  Determines if the aerosol window at the specified line/sample is on
+the coarse lattice of the adaptive aerosol inversion.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            Window is on the coarse lattice
+false           Window is not on the coarse lattice
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The coarse lattice is every AERO_COARSE_STEP windows in each direction,
+     starting with the first window.
+******************************************************************************/
+bool is_coarse_aero_window
+(
+    int line,          /* I: line of the inverted pixel of the window */
+    int samp,          /* I: sample of the inverted pixel of the window */
+    int aero_window,   /* I: size of the aerosol window (S2 or L8) */
+    int win_offset     /* I: offset of the inverted pixel in the window;
+                             half the window for L8, 0 for S2 */
+)
+{
+    return (((line - win_offset) / aero_window) % AERO_COARSE_STEP == 0 &&
+            ((samp - win_offset) / aero_window) % AERO_COARSE_STEP == 0);
+}
+
+
+/******************************************************************************
+MODULE:  interp_coarse_aero
+
+PURPOSE:  Interpolates the aerosol and angstrom coefficient for a window
+which is not on the coarse lattice from the four coarse lattice windows
+surrounding it, if they agree.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+true            The surrounding lattice windows are all clear and agree
+                within the tolerances; aero and eps are interpolated
+false           The window needs to be inverted
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The coarse lattice windows must already have been inverted.  They are
+     only read, so this can be called from multiple threads while the
+     remaining windows are processed.
+  2. If any of the surrounding lattice windows is not a clear land retrieval
+     (fill, cloud, shadow, water, or failed) then the class changes within
+     the cell and the window is inverted.  Windows beyond the last lattice
+     row or column are always inverted.
+******************************************************************************/
+bool interp_coarse_aero
+(
+    uint8 *ipflag,     /* I: QA flag for the inverted windows */
+    float *taero,      /* I: aerosol values for the inverted windows */
+    float *teps,       /* I: angstrom coeff for the inverted windows */
+    int nlines,        /* I: number of lines in ipflag, taero, and teps */
+    int nsamps,        /* I: number of samps in ipflag, taero, and teps */
+    int aero_window,   /* I: size of the aerosol window (S2 or L8) */
+    int win_offset,    /* I: offset of the inverted pixel in the window;
+                             half the window for L8, 0 for S2 */
+    float aot_tol,     /* I: largest difference in the lattice aerosols for
+                             the window to be interpolated */
+    int line,          /* I: line of the inverted pixel of the window */
+    int samp,          /* I: sample of the inverted pixel of the window */
+    float *aero,       /* O: interpolated aerosol value */
+    float *eps         /* O: interpolated angstrom coefficient */
+)
+{
+    int wline, wsamp;      /* window line/sample of the current window */
+    int cline[2];          /* window lines of the lattice rows above and below
+                              the current window */
+    int csamp[2];          /* window samples of the lattice columns left and
+                              right of the current window */
+    int il, is;            /* looping variables for the lattice corners */
+    int pix;               /* pixel of the current lattice corner */
+    float u, v;            /* fractional location of the window in the cell */
+    float w;               /* weight of the current lattice corner */
+    float aero_min, aero_max;  /* range of the lattice aerosols */
+    float eps_min, eps_max;    /* range of the lattice angstrom coeffs */
+
+    wline = (line - win_offset) / aero_window;
+    wsamp = (samp - win_offset) / aero_window;
+    cline[0] = (wline / AERO_COARSE_STEP) * AERO_COARSE_STEP;
+    csamp[0] = (wsamp / AERO_COARSE_STEP) * AERO_COARSE_STEP;
+    cline[1] = cline[0] + AERO_COARSE_STEP;
+    csamp[1] = csamp[0] + AERO_COARSE_STEP;
+    if (cline[1] * aero_window + win_offset >= nlines ||
+        csamp[1] * aero_window + win_offset >= nsamps)
+        return (false);
+
+    u = (float) (wline - cline[0]) / AERO_COARSE_STEP;
+    v = (float) (wsamp - csamp[0]) / AERO_COARSE_STEP;
+    aero_min = eps_min = FLT_MAX;
+    aero_max = eps_max = -FLT_MAX;
+    *aero = 0.0;
+    *eps = 0.0;
+    for (il = 0; il < 2; il++)
+    {
+        for (is = 0; is < 2; is++)
+        {
+            pix = (cline[il] * aero_window + win_offset) * nsamps +
+                csamp[is] * aero_window + win_offset;
+            if (!btest (ipflag[pix], IPFLAG_CLEAR))
+                return (false);
+
+            if (taero[pix] < aero_min)
+                aero_min = taero[pix];
+            if (taero[pix] > aero_max)
+                aero_max = taero[pix];
+            if (teps[pix] < eps_min)
+                eps_min = teps[pix];
+            if (teps[pix] > eps_max)
+                eps_max = teps[pix];
+
+            w = (il ? u : 1.0 - u) * (is ? v : 1.0 - v);
+            *aero += w * taero[pix];
+            *eps += w * teps[pix];
+        }
+    }
+
+    if (aero_max - aero_min > aot_tol ||
+        eps_max - eps_min > AERO_ADAPT_EPS_TOL)
+        return (false);
+
+    return (true);
+}
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <float.h>
 #include "lasrc.h"
 
 void aerosol_interp_l8
@@ -16,6 +17,7 @@ void aerosol_interp_l8
     int half_aero_window, /* I: size of half the aerosol window */
     int16 **sband,     /* I/O: input TOA reflectance */
     uint16 *qaband,    /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans, /* I: valid span of each line, from the QA band */
     uint8 *ipflag,     /* I/O: QA flag to assist with aerosol interpolation,
                                nlines x nsamps.  It is expected that the ipflag
                                values are computed for the center of the
@@ -108,4 +110,31 @@ void aerosol_fill_median_s2
     int nsamps         /* I: number of samps in ipflag & taero bands */
 );
 
+bool is_coarse_aero_window
+(
+    int line,          /* I: line of the inverted pixel of the window */
+    int samp,          /* I: sample of the inverted pixel of the window */
+    int aero_window,   /* I: size of the aerosol window (S2 or L8) */
+    int win_offset     /* I: offset of the inverted pixel in the window;
+                             half the window for L8, 0 for S2 */
+);
+
+bool interp_coarse_aero
+(
+    uint8 *ipflag,     /* I: QA flag for the inverted windows */
+    float *taero,      /* I: aerosol values for the inverted windows */
+    float *teps,       /* I: angstrom coeff for the inverted windows */
+    int nlines,        /* I: number of lines in ipflag, taero, and teps */
+    int nsamps,        /* I: number of samps in ipflag, taero, and teps */
+    int aero_window,   /* I: size of the aerosol window (S2 or L8) */
+    int win_offset,    /* I: offset of the inverted pixel in the window;
+                             half the window for L8, 0 for S2 */
+    float aot_tol,     /* I: largest difference in the lattice aerosols for
+                             the window to be interpolated */
+    int line,          /* I: line of the inverted pixel of the window */
+    int samp,          /* I: sample of the inverted pixel of the window */
+    float *aero,       /* O: interpolated aerosol value */
+    float *eps         /* O: interpolated angstrom coefficient */
+);
+
 #endif
@@ -0,0 +1,402 @@
+/*****************************************************************************
+FILE: angle_grid.c
+
+PURPOSE: Contains functions for precomputing the atmospheric correction
+coefficients on a grid of view geometries and interpolating them for the
+geometry of each pixel.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The coefficients at each node are computed exactly as the scene center
+   coefficients are computed in compute_l8_sr_refl: atmcorlamb2 is run for
+   each AOT in the LUT and 3rd order polynomials in AOT are fit to roatm,
+   ttatmg, and satm.  Since the polynomials are linear in their coefficients,
+   interpolating the coefficients is the same as interpolating the
+   polynomials.
+2. The grid only spans the range of angles in the scene, so the cost is a
+   few hundred atmcorlamb2 calls per band rather than one per pixel.
+*****************************************************************************/
+#include "angle_grid.h"
+
+/******************************************************************************
+MODULE:  grid_axis_weight
+
+PURPOSE:  Finds the node below the specified angle on a grid axis and the
+weight of the node above it.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+w               Weight of node inode+1 (0.0 to 1.0); the weight of node inode
+                is 1.0 - w
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. Angles outside the axis are clamped to the first or last node.
+******************************************************************************/
+static inline float grid_axis_weight
+(
+    Angle_grid_t *grid,   /* I: angle grid */
+    Grid_axis_t axis,     /* I: grid axis */
+    float angle,          /* I: angle on the axis (deg) */
+    int *inode            /* O: node below the angle */
+)
+{
+    float pos;            /* position of the angle in nodes */
+
+    if (grid->nnodes[axis] == 1)
+    {
+        *inode = 0;
+        return (0.0);
+    }
+
+    pos = (angle - grid->first[axis]) / grid->step[axis];
+    if (pos <= 0.0)
+    {
+        *inode = 0;
+        return (0.0);
+    }
+    if (pos >= grid->nnodes[axis] - 1)
+    {
+        *inode = grid->nnodes[axis] - 2;
+        return (1.0);
+    }
+
+    *inode = (int) pos;
+    return (pos - *inode);
+}
+
+
+/******************************************************************************
+MODULE:  init_angle_grid
+
+PURPOSE:  Sets up the angle grid for the specified range of angles and
+computes the atmospheric correction coefficients at each node.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the grid or computing the coefficients
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. An axis whose range is smaller than ANGLE_GRID_STEP has a single node at
+   the minimum angle.  Otherwise the nodes are ANGLE_GRID_STEP apart (or
+   wider, to stay within ANGLE_GRID_MAX_NODES) and cover the full range.
+2. The solar zenith axis is limited to ANGLE_GRID_MAX_SZA, as atmcorlamb2
+   can't be evaluated beyond the sun angle table.
+******************************************************************************/
+int init_angle_grid
+(
+    Sat_t sat,                    /* I: satellite */
+    int nbands,                   /* I: number of bands (0-based band indices
+                                        0 to nbands-1 are computed) */
+    float angle_min[GRID_NAXES],  /* I: smallest angle on each axis (deg) */
+    float angle_max[GRID_NAXES],  /* I: largest angle on each axis (deg) */
+    float pres,                   /* I: surface pressure */
+    float tpres[NPRES_VALS],      /* I: surface pressure table */
+    float aot550nm[NAOT_VALS],    /* I: AOT look-up table */
+    float *rolutt,                /* I: intrinsic reflectance table */
+    float *transt,                /* I: transmission table */
+    float xtsstep,                /* I: solar zenith step value */
+    float xtsmin,                 /* I: minimum solar zenith value */
+    float xtvstep,                /* I: observation step value */
+    float xtvmin,                 /* I: minimum observation value */
+    float *sphalbt,               /* I: spherical albedo table */
+    float *normext,               /* I: aerosol extinction coefficient */
+    float *tsmax,                 /* I: maximum scattering angle table */
+    float *tsmin,                 /* I: minimum scattering angle table */
+    float *nbfic,                 /* I: communitive number of azimuth angles */
+    float *nbfi,                  /* I: number of azimuth angles */
+    float tts[NSOLAR_ZEN_VALS],   /* I: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* I: index for the sun angle table */
+    float *ttv,                   /* I: view angle table */
+    float uoz,                    /* I: total column ozone */
+    float uwv,                    /* I: total column water vapor */
+    float tauray[NSR_BANDS],      /* I: molecular optical thickness coeff */
+    double ogtransa1[NSR_BANDS],  /* I: other gases transmission coeff */
+    double ogtransb0[NSR_BANDS],  /* I: other gases transmission coeff */
+    double ogtransb1[NSR_BANDS],  /* I: other gases transmission coeff */
+    double wvtransa[NSR_BANDS],   /* I: water vapor transmission coeff */
+    double wvtransb[NSR_BANDS],   /* I: water vapor transmission coeff */
+    double oztransa[NSR_BANDS],   /* I: ozone transmission coeff */
+    Angle_grid_t *grid            /* O: initialized angle grid */
+)
+{
+    char FUNC_NAME[] = "init_angle_grid";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int axis;                /* looping variable for the axes */
+    int nnodes;              /* total number of nodes */
+    int node;                /* current node */
+    int isza, ivza, iraa;    /* node index along each axis */
+    int ib;                  /* looping variable for bands */
+    int ia;                  /* looping variable for AOTs */
+    int iaMaxTemp;           /* last AOT index for the roatm fit */
+    int offset;              /* offset of the current node and band */
+    float range;             /* range of the angles on an axis */
+    float xts, xtv, xfi;     /* solar zenith, view zenith, and relative
+                                azimuth of the current node (deg) */
+    float xmus, xmuv;        /* cosines of the solar and view zenith */
+    float cosxfi;            /* cosine of the relative azimuth */
+    float rotoa;             /* top of atmosphere reflectance */
+    float roslamb;           /* lambertian surface reflectance */
+    float tgo;               /* other gaseous transmittance */
+    float roatm;             /* intrinsic atmospheric reflectance */
+    float ttatmg;            /* total atmospheric transmission */
+    float satm;              /* atmosphere spherical albedo */
+    float xrorayp;           /* Rayleigh reflectance */
+    float next;
+    float eps;               /* angstrom coefficient */
+    float roatm_arr[NAOT_VALS];   /* roatm for each AOT */
+    float ttatmg_arr[NAOT_VALS];  /* ttatmg for each AOT */
+    float satm_arr[NAOT_VALS];    /* satm for each AOT */
+
+    memset (grid, 0, sizeof (Angle_grid_t));
+    grid->nbands = nbands;
+
+    /* Set up the axes */
+    if (angle_max[GRID_SZA] > ANGLE_GRID_MAX_SZA)
+        angle_max[GRID_SZA] = ANGLE_GRID_MAX_SZA;
+    for (axis = 0; axis < GRID_NAXES; axis++)
+    {
+        range = angle_max[axis] - angle_min[axis];
+        grid->first[axis] = angle_min[axis];
+        grid->step[axis] = ANGLE_GRID_STEP;
+        if (range < ANGLE_GRID_STEP)
+            grid->nnodes[axis] = 1;
+        else
+        {
+            grid->nnodes[axis] = (int) ceil (range / ANGLE_GRID_STEP) + 1;
+            if (grid->nnodes[axis] > ANGLE_GRID_MAX_NODES)
+            {
+                grid->nnodes[axis] = ANGLE_GRID_MAX_NODES;
+                grid->step[axis] = range / (ANGLE_GRID_MAX_NODES - 1);
+            }
+        }
+    }
+    nnodes = grid->nnodes[GRID_SZA] * grid->nnodes[GRID_VZA] *
+        grid->nnodes[GRID_RAA];
+
+    /* Allocate the coefficients */
+    grid->tgo = calloc (nnodes * nbands, sizeof (float));
+    grid->xrorayp = calloc (nnodes * nbands, sizeof (float));
+    grid->roatm_upper = calloc (nnodes * nbands, sizeof (float));
+    grid->roatm_coef = calloc (nnodes * nbands * NCOEF, sizeof (float));
+    grid->ttatmg_coef = calloc (nnodes * nbands * NCOEF, sizeof (float));
+    grid->satm_coef = calloc (nnodes * nbands * NCOEF, sizeof (float));
+    if (grid->tgo == NULL || grid->xrorayp == NULL ||
+        grid->roatm_upper == NULL || grid->roatm_coef == NULL ||
+        grid->ttatmg_coef == NULL || grid->satm_coef == NULL)
+    {
+        free_angle_grid (grid);
+        sprintf (errmsg, "Allocating the angle grid coefficients");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* rotoa is not defined for these calls, which is ok, but the roslamb
+       value is not valid upon output */
+    rotoa = 0.0;
+    eps = 2.5;
+    for (node = 0; node < nnodes; node++)
+    {
+        iraa = node % grid->nnodes[GRID_RAA];
+        ivza = (node / grid->nnodes[GRID_RAA]) % grid->nnodes[GRID_VZA];
+        isza = node / (grid->nnodes[GRID_RAA] * grid->nnodes[GRID_VZA]);
+        xts = grid->first[GRID_SZA] + isza * grid->step[GRID_SZA];
+        xtv = grid->first[GRID_VZA] + ivza * grid->step[GRID_VZA];
+        xfi = grid->first[GRID_RAA] + iraa * grid->step[GRID_RAA];
+        xmus = cos (xts * DEG2RAD);
+        xmuv = cos (xtv * DEG2RAD);
+        cosxfi = cos (xfi * DEG2RAD);
+
+        for (ib = 0; ib < nbands; ib++)
+        {
+            offset = node * nbands + ib;
+            for (ia = 0; ia < NAOT_VALS; ia++)
+            {
+                if (atmcorlamb2 (sat, xts, xtv, xmus, xmuv, xfi, cosxfi,
+                    aot550nm[ia], ib, pres, tpres, aot550nm, rolutt, transt,
+                    xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
+                    tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
+                    ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
+                    oztransa, rotoa, &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                    &xrorayp, &next, eps) != SUCCESS)
+                {
+                    free_angle_grid (grid);
+                    sprintf (errmsg, "Performing lambertian atmospheric "
+                        "correction type 2 for band %d at solar zenith %f, "
+                        "view zenith %f, relative azimuth %f", ib, xts, xtv,
+                        xfi);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+                roatm_arr[ia] = roatm;
+                ttatmg_arr[ia] = ttatmg;
+                satm_arr[ia] = satm;
+            }
+
+            /* tgo and xrorayp are the same for each AOT */
+            grid->tgo[offset] = tgo;
+            grid->xrorayp[offset] = xrorayp;
+
+            /* Fit roatm up to the last AOT for which it is increasing */
+            iaMaxTemp = 1;
+            for (ia = 1; ia < NAOT_VALS; ia++)
+            {
+                if (ia == NAOT_VALS-1)
+                    iaMaxTemp = NAOT_VALS-1;
+
+                if ((roatm_arr[ia] - roatm_arr[ia-1]) <= ESPA_EPSILON)
+                {
+                    iaMaxTemp = ia-1;
+                    break;
+                }
+            }
+            grid->roatm_upper[offset] = aot550nm[iaMaxTemp];
+            get_3rd_order_poly_coeff (aot550nm, roatm_arr, iaMaxTemp,
+                &grid->roatm_coef[offset * NCOEF]);
+            get_3rd_order_poly_coeff (aot550nm, ttatmg_arr, NAOT_VALS,
+                &grid->ttatmg_coef[offset * NCOEF]);
+            get_3rd_order_poly_coeff (aot550nm, satm_arr, NAOT_VALS,
+                &grid->satm_coef[offset * NCOEF]);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  interp_angle_grid
+
+PURPOSE:  Trilinearly interpolates the atmospheric correction coefficients
+of the specified band for the specified geometry.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The roatm fit is only valid up to roatm_upper, so the smallest
+   roatm_upper of the contributing nodes is returned.
+******************************************************************************/
+void interp_angle_grid
+(
+    Angle_grid_t *grid,           /* I: angle grid */
+    int iband,                    /* I: band index (0-based) */
+    float sza,                    /* I: solar zenith angle (deg) */
+    float vza,                    /* I: view zenith angle (deg) */
+    float raa,                    /* I: relative azimuth angle (deg) */
+    float *tgo,                   /* O: other gaseous transmittance */
+    float *xrorayp,               /* O: Rayleigh reflectance */
+    float *roatm_upper,           /* O: largest AOT for the roatm fit */
+    float roatm_coef[NCOEF],      /* O: roatm poly coeffs */
+    float ttatmg_coef[NCOEF],     /* O: ttatmg poly coeffs */
+    float satm_coef[NCOEF]        /* O: satm poly coeffs */
+)
+{
+    int inode[GRID_NAXES];   /* node below the geometry on each axis */
+    float w[GRID_NAXES];     /* weight of the node above on each axis */
+    int corner;              /* looping variable for the cell corners */
+    int axis;                /* looping variable for the axes */
+    int ic;                  /* looping variable for the coefficients */
+    int idx[GRID_NAXES];     /* node of the current corner on each axis */
+    int offset;              /* offset of the current node and band */
+    float wc;                /* weight of the current corner */
+
+    w[GRID_SZA] = grid_axis_weight (grid, GRID_SZA, sza, &inode[GRID_SZA]);
+    w[GRID_VZA] = grid_axis_weight (grid, GRID_VZA, vza, &inode[GRID_VZA]);
+    w[GRID_RAA] = grid_axis_weight (grid, GRID_RAA, raa, &inode[GRID_RAA]);
+
+    *tgo = 0.0;
+    *xrorayp = 0.0;
+    *roatm_upper = 0.0;
+    for (ic = 0; ic < NCOEF; ic++)
+    {
+        roatm_coef[ic] = 0.0;
+        ttatmg_coef[ic] = 0.0;
+        satm_coef[ic] = 0.0;
+    }
+
+    /* Accumulate the eight corners of the cell, skipping those with no
+       weight (which includes the missing corners of single-node axes) */
+    for (corner = 0; corner < 8; corner++)
+    {
+        wc = 1.0;
+        for (axis = 0; axis < GRID_NAXES; axis++)
+        {
+            if (corner & (1 << axis))
+            {
+                idx[axis] = inode[axis] + 1;
+                wc *= w[axis];
+            }
+            else
+            {
+                idx[axis] = inode[axis];
+                wc *= 1.0 - w[axis];
+            }
+        }
+        if (wc == 0.0)
+            continue;
+
+        offset = ((idx[GRID_SZA] * grid->nnodes[GRID_VZA] + idx[GRID_VZA]) *
+            grid->nnodes[GRID_RAA] + idx[GRID_RAA]) * grid->nbands + iband;
+        *tgo += wc * grid->tgo[offset];
+        *xrorayp += wc * grid->xrorayp[offset];
+        if (*roatm_upper == 0.0 || grid->roatm_upper[offset] < *roatm_upper)
+            *roatm_upper = grid->roatm_upper[offset];
+        for (ic = 0; ic < NCOEF; ic++)
+        {
+            roatm_coef[ic] += wc * grid->roatm_coef[offset * NCOEF + ic];
+            ttatmg_coef[ic] += wc * grid->ttatmg_coef[offset * NCOEF + ic];
+            satm_coef[ic] += wc * grid->satm_coef[offset * NCOEF + ic];
+        }
+    }
+}
+
+
+/******************************************************************************
+MODULE:  free_angle_grid
+
+PURPOSE:  Frees the coefficients of the angle grid.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_angle_grid
+(
+    Angle_grid_t *grid            /* I/O: angle grid to be freed */
+)
+{
+    free (grid->tgo);
+    free (grid->xrorayp);
+    free (grid->roatm_upper);
+    free (grid->roatm_coef);
+    free (grid->ttatmg_coef);
+    free (grid->satm_coef);
+    grid->tgo = NULL;
+    grid->xrorayp = NULL;
+    grid->roatm_upper = NULL;
+    grid->roatm_coef = NULL;
+    grid->ttatmg_coef = NULL;
+    grid->satm_coef = NULL;
+}
@@ -0,0 +1,103 @@
+#ifndef _ANGLE_GRID_H_
+#define _ANGLE_GRID_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "lasrc.h"
+#include "poly_coeff.h"
+
+/* Spacing of the angle grid nodes (deg).  The atmospheric coefficients vary
+   smoothly with the geometry, so a one degree grid keeps the interpolation
+   error well below the LUT interpolation error. */
+#define ANGLE_GRID_STEP 1.0
+
+/* Maximum number of nodes along each axis; the step is widened if an axis
+   spans more than this */
+#define ANGLE_GRID_MAX_NODES 64
+
+/* Largest solar zenith for which the SR coefficients can be computed (deg) */
+#define ANGLE_GRID_MAX_SZA 76.0
+
+/* Axes of the angle grid */
+typedef enum {GRID_SZA=0, GRID_VZA, GRID_RAA, GRID_NAXES} Grid_axis_t;
+
+/* Atmospheric correction coefficients at each node of a solar zenith x view
+   zenith x relative azimuth grid.  The per-node arrays are stored node-major,
+   i.e. [node][band] and [node][band][NCOEF], with the node index being
+   (isza * nnodes[GRID_VZA] + ivza) * nnodes[GRID_RAA] + iraa. */
+typedef struct {
+    int nbands;                 /* number of bands in the grid */
+    int nnodes[GRID_NAXES];     /* number of nodes along each axis */
+    float first[GRID_NAXES];    /* first node on each axis (deg) */
+    float step[GRID_NAXES];     /* node spacing on each axis (deg) */
+    float *tgo;                 /* other gaseous transmittance [node][band] */
+    float *xrorayp;             /* Rayleigh reflectance [node][band] */
+    float *roatm_upper;         /* top AOT of the roatm fit [node][band] */
+    float *roatm_coef;          /* roatm poly coeffs [node][band][NCOEF] */
+    float *ttatmg_coef;         /* ttatmg poly coeffs [node][band][NCOEF] */
+    float *satm_coef;           /* satm poly coeffs [node][band][NCOEF] */
+} Angle_grid_t;
+
+/* Prototypes */
+int init_angle_grid
+(
+    Sat_t sat,                    /* I: satellite */
+    int nbands,                   /* I: number of bands (0-based band indices
+                                        0 to nbands-1 are computed) */
+    float angle_min[GRID_NAXES],  /* I: smallest angle on each axis (deg) */
+    float angle_max[GRID_NAXES],  /* I: largest angle on each axis (deg) */
+    float pres,                   /* I: surface pressure */
+    float tpres[NPRES_VALS],      /* I: surface pressure table */
+    float aot550nm[NAOT_VALS],    /* I: AOT look-up table */
+    float *rolutt,                /* I: intrinsic reflectance table */
+    float *transt,                /* I: transmission table */
+    float xtsstep,                /* I: solar zenith step value */
+    float xtsmin,                 /* I: minimum solar zenith value */
+    float xtvstep,                /* I: observation step value */
+    float xtvmin,                 /* I: minimum observation value */
+    float *sphalbt,               /* I: spherical albedo table */
+    float *normext,               /* I: aerosol extinction coefficient */
+    float *tsmax,                 /* I: maximum scattering angle table */
+    float *tsmin,                 /* I: minimum scattering angle table */
+    float *nbfic,                 /* I: communitive number of azimuth angles */
+    float *nbfi,                  /* I: number of azimuth angles */
+    float tts[NSOLAR_ZEN_VALS],   /* I: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* I: index for the sun angle table */
+    float *ttv,                   /* I: view angle table */
+    float uoz,                    /* I: total column ozone */
+    float uwv,                    /* I: total column water vapor */
+    float tauray[NSR_BANDS],      /* I: molecular optical thickness coeff */
+    double ogtransa1[NSR_BANDS],  /* I: other gases transmission coeff */
+    double ogtransb0[NSR_BANDS],  /* I: other gases transmission coeff */
+    double ogtransb1[NSR_BANDS],  /* I: other gases transmission coeff */
+    double wvtransa[NSR_BANDS],   /* I: water vapor transmission coeff */
+    double wvtransb[NSR_BANDS],   /* I: water vapor transmission coeff */
+    double oztransa[NSR_BANDS],   /* I: ozone transmission coeff */
+    Angle_grid_t *grid            /* O: initialized angle grid */
+);
+
+void interp_angle_grid
+(
+    Angle_grid_t *grid,           /* I: angle grid */
+    int iband,                    /* I: band index (0-based) */
+    float sza,                    /* I: solar zenith angle (deg) */
+    float vza,                    /* I: view zenith angle (deg) */
+    float raa,                    /* I: relative azimuth angle (deg) */
+    float *tgo,                   /* O: other gaseous transmittance */
+    float *xrorayp,               /* O: Rayleigh reflectance */
+    float *roatm_upper,           /* O: largest AOT for the roatm fit */
+    float roatm_coef[NCOEF],      /* O: roatm poly coeffs */
+    float ttatmg_coef[NCOEF],     /* O: ttatmg poly coeffs */
+    float satm_coef[NCOEF]        /* O: satm poly coeffs */
+);
+
+void free_angle_grid
+(
+    Angle_grid_t *grid            /* I/O: angle grid to be freed */
+);
+
+#endif
@@ -0,0 +1,468 @@
+/*****************************************************************************
+FILE: checkpoint.c
+
+PURPOSE: Contains functions for saving and restoring the results of the
+aerosol inversion, so that a run which fails after the inversion (during the
+interpolation, correction, or output) can be restarted without redoing the
+inversion.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. Only the pixels at which the aerosols were inverted (one per aerosol
+   window) are stored, along with the per-band climatology and atmospheric
+   correction coefficients.  The remaining pixels are regenerated by the
+   interpolation steps which follow the inversion.
+2. The checkpoint is written to a temporary file and then renamed, so an
+   interrupted write never leaves a partial checkpoint behind.
+3. The file is written in the native byte order and is meant to be restored
+   on the same system that wrote it.  A hash of the TOA reflectance, QA band,
+   solar angle and auxiliary, LUT, DEM and ratio filenames is stored with the checkpoint and
+   must match for the checkpoint to be used.
+*****************************************************************************/
+#include <unistd.h>
+#include "checkpoint.h"
+
+/******************************************************************************
+MODULE:  fnv1a_hash
+
+PURPOSE:  Adds the specified buffer to the running FNV-1a hash.
+
+RETURN VALUE:
+Type = uint64_t
+Value           Description
+-----           -----------
+hash            Updated hash value
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Start the hash with FNV1A_OFFSET_BASIS.
+******************************************************************************/
+uint64_t fnv1a_hash
+(
+    uint64_t hash,       /* I: current hash value */
+    const void *buf,     /* I: buffer to be added to the hash */
+    size_t nbytes        /* I: number of bytes in the buffer */
+)
+{
+    size_t i;                               /* looping variable */
+    const unsigned char *ptr = buf;         /* byte pointer to the buffer */
+
+    for (i = 0; i < nbytes; i++)
+    {
+        hash ^= ptr[i];
+        hash *= FNV1A_PRIME;
+    }
+
+    return (hash);
+}
+
+
+/******************************************************************************
+MODULE:  hash_aero_inputs
+
+PURPOSE:  Computes a hash of the inputs which determine the results of the
+aerosol inversion.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory for the line hashes
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Each line is hashed independently (in parallel if threading is enabled)
+     and the line hashes are then combined in order, so the result does not
+     depend on the number of threads.
+  2. Bands which aren't processed (NULL in band_data) keep a zero line hash,
+     so a run on a subset of the bands doesn't match a full-scene run.
+******************************************************************************/
+int hash_aero_inputs
+(
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int nbands,          /* I: number of bands in band_data */
+    void **band_data,    /* I: TOA reflectance bands, nlines x nsamps; NULL
+                               for bands which aren't processed */
+    size_t elem_size,    /* I: size of each band_data element in bytes */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    float xts,           /* I: scene center solar zenith angle (deg) */
+    char *auxnm,         /* I: auxiliary filename for ozone and water vapor */
+    char *intrefnm,      /* I: intrinsic reflectance filename */
+    char *transmnm,      /* I: transmission filename */
+    char *spheranm,      /* I: spherical albedo filename */
+    char *cmgdemnm,      /* I: climate modeling grid DEM filename */
+    char *rationm,       /* I: ratio averages filename */
+    bool fast_math,      /* I: is the fast-math inversion being used? */
+    float aero_adapt_tol,/* I: AOT tolerance of the adaptive inversion; 0.0
+                               if every window is inverted */
+    uint64_t *input_hash /* O: hash of the inputs */
+)
+{
+    char FUNC_NAME[] = "hash_aero_inputs";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int ib;                  /* looping variable for bands */
+    int line;                /* looping variable for lines */
+    size_t line_size;        /* number of bytes in each line */
+    uint64_t hash;           /* hash of all the inputs */
+    uint64_t *line_hash = NULL;  /* hash of each line, nlines (nbands+1) */
+
+    line_hash = calloc ((size_t) nlines * (nbands + 1), sizeof (uint64_t));
+    if (line_hash == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the line hashes");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Hash each line of each band, and the QA band */
+#ifdef _OPENMP
+    #pragma omp parallel for private (ib, line, line_size)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        line_size = (size_t) nsamps * elem_size;
+        for (ib = 0; ib < nbands; ib++)
+        {
+            if (band_data[ib] == NULL)
+                continue;
+            line_hash[ib * nlines + line] = fnv1a_hash (FNV1A_OFFSET_BASIS,
+                (char *) band_data[ib] + line * line_size, line_size);
+        }
+
+        line_size = (size_t) nsamps * sizeof (uint16);
+        line_hash[nbands * nlines + line] = fnv1a_hash (FNV1A_OFFSET_BASIS,
+            (char *) qaband + line * line_size, line_size);
+    }
+
+    /* Combine the line hashes with the scene information */
+    hash = FNV1A_OFFSET_BASIS;
+    hash = fnv1a_hash (hash, &nlines, sizeof (nlines));
+    hash = fnv1a_hash (hash, &nsamps, sizeof (nsamps));
+    hash = fnv1a_hash (hash, &xts, sizeof (xts));
+    hash = fnv1a_hash (hash, auxnm, strlen (auxnm));
+    hash = fnv1a_hash (hash, intrefnm, strlen (intrefnm));
+    hash = fnv1a_hash (hash, transmnm, strlen (transmnm));
+    hash = fnv1a_hash (hash, spheranm, strlen (spheranm));
+    hash = fnv1a_hash (hash, cmgdemnm, strlen (cmgdemnm));
+    hash = fnv1a_hash (hash, rationm, strlen (rationm));
+    hash = fnv1a_hash (hash, &fast_math, sizeof (fast_math));
+    hash = fnv1a_hash (hash, &aero_adapt_tol, sizeof (aero_adapt_tol));
+    hash = fnv1a_hash (hash, line_hash,
+        (size_t) nlines * (nbands + 1) * sizeof (uint64_t));
+
+    free (line_hash);
+    *input_hash = hash;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_aero_checkpoint
+
+PURPOSE:  Writes the results of the aerosol inversion and the atmospheric
+correction coefficients to the checkpoint file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the checkpoint
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The data is written to <ckpt_file>.tmp which is then renamed to
+     ckpt_file.
+******************************************************************************/
+int write_aero_checkpoint
+(
+    char *ckpt_file,     /* I: checkpoint filename */
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int win_offset,      /* I: offset of the inverted pixel in the window */
+    uint64_t input_hash, /* I: hash of the inputs to the aerosol inversion */
+    float *btgo,         /* I: climatology tgo for each band [NREFL_BANDS] */
+    float *broatm,       /* I: climatology roatm for each band */
+    float *bttatmg,      /* I: climatology ttatmg for each band */
+    float *bsatm,        /* I: climatology satm for each band */
+    float *tgo_arr,      /* I: per-band other gaseous transmittance */
+    float *xrorayp_arr,  /* I: per-band molecular reflectance */
+    float *normext_p0a3_arr, /* I: per-band normext[iband][0][3] */
+    int *roatm_iaMax,    /* I: per-band max AOT index for roatm */
+    float roatm_coef[][NCOEF],  /* I: per-band poly coeffs for roatm */
+    float ttatmg_coef[][NCOEF], /* I: per-band poly coeffs for ttatmg */
+    float satm_coef[][NCOEF],   /* I: per-band poly coeffs for satm */
+    uint8 *ipflag,       /* I: QA flag for aerosol interp, nlines x nsamps */
+    float *taero,        /* I: aerosol values, nlines x nsamps */
+    float *teps          /* I: angstrom coefficient, nlines x nsamps */
+)
+{
+    char FUNC_NAME[] = "write_aero_checkpoint";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmp_file[STR_SIZE]; /* temporary checkpoint filename */
+    int i, j;                /* looping variables for lines/samples */
+    int curr_pix;            /* current pixel in the nlines x nsamps arrays */
+    int ok;                  /* were all the writes successful */
+    Ckpt_header_t hdr;       /* checkpoint header */
+    FILE *fp = NULL;         /* checkpoint file pointer */
+
+    /* Set up the header */
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, CKPT_MAGIC, sizeof (hdr.magic));
+    hdr.version = CKPT_VERSION;
+    hdr.sat = sat;
+    hdr.nlines = nlines;
+    hdr.nsamps = nsamps;
+    hdr.aero_window = aero_window;
+    hdr.win_offset = win_offset;
+    hdr.input_hash = input_hash;
+
+    snprintf (tmp_file, sizeof (tmp_file), "%s.tmp", ckpt_file);
+    fp = fopen (tmp_file, "wb");
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Opening checkpoint file for writing: %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Write the header and the per-band coefficients */
+    ok = (fwrite (&hdr, sizeof (hdr), 1, fp) == 1) &&
+         (fwrite (btgo, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fwrite (broatm, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fwrite (bttatmg, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fwrite (bsatm, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fwrite (tgo_arr, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fwrite (xrorayp_arr, sizeof (float), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fwrite (normext_p0a3_arr, sizeof (float), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fwrite (roatm_iaMax, sizeof (int), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fwrite (roatm_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF) &&
+         (fwrite (ttatmg_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF) &&
+         (fwrite (satm_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF);
+
+    /* Write the inverted pixel of each aerosol window */
+    for (i = win_offset; ok && i < nlines; i += aero_window)
+    {
+        curr_pix = i * nsamps + win_offset;
+        for (j = win_offset; ok && j < nsamps;
+             j += aero_window, curr_pix += aero_window)
+        {
+            ok = (fwrite (&taero[curr_pix], sizeof (float), 1, fp) == 1) &&
+                 (fwrite (&teps[curr_pix], sizeof (float), 1, fp) == 1) &&
+                 (fwrite (&ipflag[curr_pix], sizeof (uint8), 1, fp) == 1);
+        }
+    }
+
+    if (fclose (fp) != 0)
+        ok = false;
+    if (!ok)
+    {
+        sprintf (errmsg, "Writing checkpoint file: %s", tmp_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    /* Move the completed checkpoint into place */
+    if (rename (tmp_file, ckpt_file) != 0)
+    {
+        sprintf (errmsg, "Renaming checkpoint file %s to %s", tmp_file,
+            ckpt_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        unlink (tmp_file);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_aero_checkpoint
+
+PURPOSE:  Restores the results of the aerosol inversion and the atmospheric
+correction coefficients from the checkpoint file, if the checkpoint exists and
+was generated from the same inputs.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           No valid checkpoint is available; the aerosol inversion needs
+                to be run
+SUCCESS         Checkpoint was restored
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. ipflag, taero, and teps are only modified if the checkpoint is valid and
+     was read completely.  They are expected to be zeroed on input, as they
+     are following the memory allocation.
+******************************************************************************/
+int read_aero_checkpoint
+(
+    char *ckpt_file,     /* I: checkpoint filename */
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int win_offset,      /* I: offset of the inverted pixel in the window */
+    bool fill_window,    /* I: copy taero/teps to the whole window (S2) */
+    uint64_t input_hash, /* I: hash of the inputs to the aerosol inversion */
+    float *btgo,         /* O: climatology tgo for each band [NREFL_BANDS] */
+    float *broatm,       /* O: climatology roatm for each band */
+    float *bttatmg,      /* O: climatology ttatmg for each band */
+    float *bsatm,        /* O: climatology satm for each band */
+    float *tgo_arr,      /* O: per-band other gaseous transmittance */
+    float *xrorayp_arr,  /* O: per-band molecular reflectance */
+    float *normext_p0a3_arr, /* O: per-band normext[iband][0][3] */
+    int *roatm_iaMax,    /* O: per-band max AOT index for roatm */
+    float roatm_coef[][NCOEF],  /* O: per-band poly coeffs for roatm */
+    float ttatmg_coef[][NCOEF], /* O: per-band poly coeffs for ttatmg */
+    float satm_coef[][NCOEF],   /* O: per-band poly coeffs for satm */
+    uint8 *ipflag,       /* O: QA flag for aerosol interp, nlines x nsamps */
+    float *taero,        /* O: aerosol values, nlines x nsamps */
+    float *teps          /* O: angstrom coefficient, nlines x nsamps */
+)
+{
+    char FUNC_NAME[] = "read_aero_checkpoint";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int i, j;                /* looping variables for lines/samples */
+    int iline, isamp;        /* looping variables for the aerosol window */
+    int curr_pix;            /* current pixel in the nlines x nsamps arrays */
+    int curr_win_pix;        /* current pixel in the aerosol window */
+    int nwin;                /* number of aerosol windows */
+    int iwin;                /* current aerosol window */
+    int ok;                  /* were all the reads successful */
+    Ckpt_header_t hdr;       /* checkpoint header */
+    FILE *fp = NULL;         /* checkpoint file pointer */
+    float *win_taero = NULL; /* taero for each aerosol window */
+    float *win_teps = NULL;  /* teps for each aerosol window */
+    uint8 *win_ipflag = NULL;  /* ipflag for each aerosol window */
+
+    /* A missing checkpoint isn't an error; the inversion will just be run */
+    fp = fopen (ckpt_file, "rb");
+    if (fp == NULL)
+        return (ERROR);
+
+    /* Make sure the checkpoint is for this scene and these inputs */
+    if (fread (&hdr, sizeof (hdr), 1, fp) != 1 ||
+        memcmp (hdr.magic, CKPT_MAGIC, sizeof (hdr.magic)) ||
+        hdr.version != CKPT_VERSION || hdr.sat != sat ||
+        hdr.nlines != nlines || hdr.nsamps != nsamps ||
+        hdr.aero_window != aero_window || hdr.win_offset != win_offset ||
+        hdr.input_hash != input_hash)
+    {
+        sprintf (errmsg, "Checkpoint file %s does not match the current "
+            "inputs and will be ignored.", ckpt_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        fclose (fp);
+        return (ERROR);
+    }
+
+    /* Read the per-band coefficients */
+    ok = (fread (btgo, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fread (broatm, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fread (bttatmg, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fread (bsatm, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fread (tgo_arr, sizeof (float), NREFL_BANDS, fp) == NREFL_BANDS) &&
+         (fread (xrorayp_arr, sizeof (float), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fread (normext_p0a3_arr, sizeof (float), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fread (roatm_iaMax, sizeof (int), NREFL_BANDS, fp) ==
+             NREFL_BANDS) &&
+         (fread (roatm_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF) &&
+         (fread (ttatmg_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF) &&
+         (fread (satm_coef, sizeof (float), NREFL_BANDS*NCOEF, fp) ==
+             NREFL_BANDS*NCOEF);
+
+    /* Read the window-level aerosol values into temporary arrays, so the
+       outputs are only touched once the whole checkpoint has been read */
+    nwin = ((nlines - win_offset + aero_window - 1) / aero_window) *
+           ((nsamps - win_offset + aero_window - 1) / aero_window);
+    win_taero = calloc (nwin, sizeof (float));
+    win_teps = calloc (nwin, sizeof (float));
+    win_ipflag = calloc (nwin, sizeof (uint8));
+    if (win_taero == NULL || win_teps == NULL || win_ipflag == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the checkpoint windows");
+        error_handler (true, FUNC_NAME, errmsg);
+        ok = false;
+    }
+
+    for (iwin = 0; ok && iwin < nwin; iwin++)
+    {
+        ok = (fread (&win_taero[iwin], sizeof (float), 1, fp) == 1) &&
+             (fread (&win_teps[iwin], sizeof (float), 1, fp) == 1) &&
+             (fread (&win_ipflag[iwin], sizeof (uint8), 1, fp) == 1);
+    }
+    fclose (fp);
+
+    if (!ok)
+    {
+        sprintf (errmsg, "Reading checkpoint file %s.  The checkpoint will be "
+            "ignored.", ckpt_file);
+        error_handler (false, FUNC_NAME, errmsg);
+        free (win_taero);
+        free (win_teps);
+        free (win_ipflag);
+        return (ERROR);
+    }
+
+    /* Restore the inverted pixel of each aerosol window, and the rest of the
+       window if the inversion fills the whole window */
+    iwin = 0;
+    for (i = win_offset; i < nlines; i += aero_window)
+    {
+        curr_pix = i * nsamps + win_offset;
+        for (j = win_offset; j < nsamps;
+             j += aero_window, curr_pix += aero_window, iwin++)
+        {
+            ipflag[curr_pix] = win_ipflag[iwin];
+            taero[curr_pix] = win_taero[iwin];
+            teps[curr_pix] = win_teps[iwin];
+            if (!fill_window)
+                continue;
+
+            for (iline = i; iline < i+aero_window && iline < nlines; iline++)
+            {
+                curr_win_pix = iline * nsamps + j;
+                for (isamp = j; isamp < j+aero_window && isamp < nsamps;
+                     isamp++, curr_win_pix++)
+                {
+                    taero[curr_win_pix] = win_taero[iwin];
+                    teps[curr_win_pix] = win_teps[iwin];
+                }
+            }
+        }
+    }
+
+    free (win_taero);
+    free (win_teps);
+    free (win_ipflag);
+    return (SUCCESS);
+}
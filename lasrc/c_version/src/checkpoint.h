@@ -0,0 +1,115 @@
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "lasrc.h"
+
+/* Defines */
+#define CKPT_MAGIC "LASRCCKP"   /* identifier at the start of each checkpoint */
+#define CKPT_VERSION 1          /* version of the checkpoint file layout */
+
+/* FNV-1a 64-bit hash constants */
+#define FNV1A_OFFSET_BASIS 14695981039346656037ULL
+#define FNV1A_PRIME 1099511628211ULL
+
+/* Header of the aerosol checkpoint file.  The header is followed by the
+   per-band atmospheric coefficients and then the window-level aerosol
+   values. */
+typedef struct {
+    char magic[8];          /* CKPT_MAGIC, not NULL-terminated */
+    int version;            /* CKPT_VERSION */
+    int sat;                /* satellite (Sat_t) */
+    int nlines;             /* number of lines in the scene */
+    int nsamps;             /* number of samples in the scene */
+    int aero_window;        /* size of the aerosol window */
+    int win_offset;         /* line/sample offset of the inverted pixel within
+                               the aerosol window (center for L8, UL for S2) */
+    uint64_t input_hash;    /* hash of the inputs to the aerosol inversion */
+} Ckpt_header_t;
+
+/* Prototypes */
+uint64_t fnv1a_hash
+(
+    uint64_t hash,       /* I: current hash value */
+    const void *buf,     /* I: buffer to be added to the hash */
+    size_t nbytes        /* I: number of bytes in the buffer */
+);
+
+int hash_aero_inputs
+(
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int nbands,          /* I: number of bands in band_data */
+    void **band_data,    /* I: TOA reflectance bands, nlines x nsamps; NULL
+                               for bands which aren't processed */
+    size_t elem_size,    /* I: size of each band_data element in bytes */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    float xts,           /* I: scene center solar zenith angle (deg) */
+    char *auxnm,         /* I: auxiliary filename for ozone and water vapor */
+    char *intrefnm,      /* I: intrinsic reflectance filename */
+    char *transmnm,      /* I: transmission filename */
+    char *spheranm,      /* I: spherical albedo filename */
+    char *cmgdemnm,      /* I: climate modeling grid DEM filename */
+    char *rationm,       /* I: ratio averages filename */
+    bool fast_math,      /* I: is the fast-math inversion being used? */
+    float aero_adapt_tol,/* I: AOT tolerance of the adaptive inversion; 0.0
+                               if every window is inverted */
+    uint64_t *input_hash /* O: hash of the inputs */
+);
+
+int write_aero_checkpoint
+(
+    char *ckpt_file,     /* I: checkpoint filename */
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int win_offset,      /* I: offset of the inverted pixel in the window */
+    uint64_t input_hash, /* I: hash of the inputs to the aerosol inversion */
+    float *btgo,         /* I: climatology tgo for each band [NREFL_BANDS] */
+    float *broatm,       /* I: climatology roatm for each band */
+    float *bttatmg,      /* I: climatology ttatmg for each band */
+    float *bsatm,        /* I: climatology satm for each band */
+    float *tgo_arr,      /* I: per-band other gaseous transmittance */
+    float *xrorayp_arr,  /* I: per-band molecular reflectance */
+    float *normext_p0a3_arr, /* I: per-band normext[iband][0][3] */
+    int *roatm_iaMax,    /* I: per-band max AOT index for roatm */
+    float roatm_coef[][NCOEF],  /* I: per-band poly coeffs for roatm */
+    float ttatmg_coef[][NCOEF], /* I: per-band poly coeffs for ttatmg */
+    float satm_coef[][NCOEF],   /* I: per-band poly coeffs for satm */
+    uint8 *ipflag,       /* I: QA flag for aerosol interp, nlines x nsamps */
+    float *taero,        /* I: aerosol values, nlines x nsamps */
+    float *teps          /* I: angstrom coefficient, nlines x nsamps */
+);
+
+int read_aero_checkpoint
+(
+    char *ckpt_file,     /* I: checkpoint filename */
+    Sat_t sat,           /* I: satellite */
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int win_offset,      /* I: offset of the inverted pixel in the window */
+    bool fill_window,    /* I: copy taero/teps to the whole window (S2) */
+    uint64_t input_hash, /* I: hash of the inputs to the aerosol inversion */
+    float *btgo,         /* O: climatology tgo for each band [NREFL_BANDS] */
+    float *broatm,       /* O: climatology roatm for each band */
+    float *bttatmg,      /* O: climatology ttatmg for each band */
+    float *bsatm,        /* O: climatology satm for each band */
+    float *tgo_arr,      /* O: per-band other gaseous transmittance */
+    float *xrorayp_arr,  /* O: per-band molecular reflectance */
+    float *normext_p0a3_arr, /* O: per-band normext[iband][0][3] */
+    int *roatm_iaMax,    /* O: per-band max AOT index for roatm */
+    float roatm_coef[][NCOEF],  /* O: per-band poly coeffs for roatm */
+    float ttatmg_coef[][NCOEF], /* O: per-band poly coeffs for ttatmg */
+    float satm_coef[][NCOEF],   /* O: per-band poly coeffs for satm */
+    uint8 *ipflag,       /* O: QA flag for aerosol interp, nlines x nsamps */
+    float *taero,        /* O: aerosol values, nlines x nsamps */
+    float *teps          /* O: angstrom coefficient, nlines x nsamps */
+);
+
+#endif
@@ -35,6 +35,19 @@ typedef char byte;
 #define L8_HALF_AERO_WINDOW 1
 #define S2_AERO_WINDOW 6
 
+/* Number of aerosol windows added around a region of interest (ROI) so the
+   aerosol interpolation at the edges of the ROI uses the same neighboring
+   windows as a full-scene run */
+#define ROI_HALO_WINDOWS 2
+
+/* Adaptive (coarse-to-fine) aerosol inversion.  The windows on a lattice of
+   every AERO_COARSE_STEP windows are inverted first, then the remaining
+   windows are interpolated from the surrounding lattice windows if those are
+   all clear and their aerosols agree within the requested AOT tolerance and
+   AERO_ADAPT_EPS_TOL.  Otherwise the window is inverted as usual. */
+#define AERO_COARSE_STEP 4
+#define AERO_ADAPT_EPS_TOL 0.25
+
 /* How many lines of data should be processed at one time */
 #define PROC_NLINES 10
 
@@ -193,6 +206,13 @@ typedef enum {
   WRS_MAX
 } Wrs_t;
 
+/* Region of interest (ROI) type definition */
+typedef enum {
+  ROI_NONE = 0,       /* process the full scene */
+  ROI_PIXEL,          /* ROI specified as UL/LR line/sample */
+  ROI_PROJ            /* ROI specified as UL/LR projection x/y */
+} Roi_type_t;
+
 typedef struct {
   int nlines;
   int nsamps;
@@ -12,10 +12,15 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 ******************************************************************************/
 
+#include <limits.h>
 #include "lasrc.h"
 #include "time.h"
 #include "aero_interp.h"
 #include "poly_coeff.h"
+#include "checkpoint.h"
+#include "fast_math.h"
+#include "angle_grid.h"
+#include "shard.h"
 
 /******************************************************************************
 MODULE:  compute_l8_toa_refl
@@ -38,6 +43,13 @@ at the USGS EROS
 NOTES:
   1. These TOA and BT algorithms match those as published by the USGS Landsat
      team in http://landsat.usgs.gov/Landsat8_Using_Product.php
+  2. The per-pixel solar zenith angles are PPA_FILL for the Level-1 fill
+     pixels (see get_input_ppa_lines).  Those pixels are skipped via the QA
+     band, so the fill angles are never used.
+  3. Only the valid span of each line is processed.  The samples outside the
+     spans are set to fill once each band has been computed.
+  4. If only a subset of the bands is processed (see set_input_bands), then
+     the other bands are not read and their sband arrays are NULL.
 ******************************************************************************/
 int compute_l8_toa_refl
 (
@@ -45,6 +57,7 @@ int compute_l8_toa_refl
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans,/* I: valid span of each line, from the QA band */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     char *instrument,   /* I: instrument to be processed (OLI, TIRS) */
@@ -84,7 +97,7 @@ int compute_l8_toa_refl
     printf ("Start TOA reflectance corrections: %s", ctime(&mytime));
 
     /* Allocate memory for band data */
-    uband = calloc (nlines*nsamps, sizeof (uint16));
+    uband = first_touch_alloc (nlines, nsamps, sizeof (uint16));
     if (uband == NULL)
     {
         sprintf (errmsg, "Error allocating memory for uband");
@@ -96,9 +109,12 @@ int compute_l8_toa_refl
        reflectance and TOA brightness temp */
     for (ib = DN_L8_BAND1; ib <= DN_L8_BAND11; ib++)
     {
-        /* Don't process the pan band */
+        /* Don't process the pan band, or the bands which aren't in the
+           processed subset */
         if (ib == DN_L8_BAND8)
             continue;
+        if (!input->proc_band[(ib <= DN_L8_BAND7) ? ib : ib-1])
+            continue;
         printf ("%d ... ", ib+1);
 
         /* Read the current band and calibrate bands 1-9 (except pan) to
@@ -135,8 +151,9 @@ int compute_l8_toa_refl
 #endif
             for (line = 0; line < nlines; line++)
             {
-                i = line * nsamps;
-                for (samp = 0; samp < nsamps; samp++, i++)
+                i = line * nsamps + spans[line].start;
+                for (samp = spans[line].start; samp < spans[line].end;
+                     samp++, i++)
                 {
                     /* If this pixel is not fill */
                     if (!level1_qa_is_fill (qaband[i]))
@@ -169,6 +186,8 @@ int compute_l8_toa_refl
                     }
                 }  /* for samp */
             }  /* for line */
+            fill_span_gaps_int16 (sband[sband_ib], FILL_VALUE, spans, nlines,
+                nsamps);
         }  /* end if band <= band 9 */
 
         /* Read the current band and calibrate thermal bands.  Not available
@@ -191,39 +210,47 @@ int compute_l8_toa_refl
             /* Compute brightness temp for band 10.  Make sure it falls
                within the min/max range for the thermal bands. */
 #ifdef _OPENMP
-            #pragma omp parallel for private (i, tmpf)
+            #pragma omp parallel for private (line, samp, i, tmpf)
 #endif
-            for (i = 0; i < nlines*nsamps; i++)
+            for (line = 0; line < nlines; line++)
             {
-                /* If this pixel is not fill */
-                if (!level1_qa_is_fill (qaband[i]))
+                i = line * nsamps + spans[line].start;
+                for (samp = spans[line].start; samp < spans[line].end;
+                     samp++, i++)
                 {
-                    /* Compute the TOA spectral radiance */
-                    tmpf = xcals * uband[i] + xcalo;
-
-                    /* Compute TOA brightness temp (K) and scale for output */
-                    tmpf = k2b10 / log (k1b10 / tmpf + 1.0);
-                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
-
-                    /* Make sure the brightness temp falls within the specified
-                       range */
-                    if (tmpf < MIN_VALID_TH)
-                        sband[SR_L8_BAND10][i] = MIN_VALID_TH;
-                    else if (tmpf > MAX_VALID_TH)
-                        sband[SR_L8_BAND10][i] = MAX_VALID_TH;
-                    else
-                        sband[SR_L8_BAND10][i] = (int) (roundf (tmpf));
+                    /* If this pixel is not fill */
+                    if (!level1_qa_is_fill (qaband[i]))
+                    {
+                        /* Compute the TOA spectral radiance */
+                        tmpf = xcals * uband[i] + xcalo;
+
+                        /* Compute TOA brightness temp (K) and scale for
+                           output */
+                        tmpf = k2b10 / log (k1b10 / tmpf + 1.0);
+                        tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+
+                        /* Make sure the brightness temp falls within the
+                           specified range */
+                        if (tmpf < MIN_VALID_TH)
+                            sband[SR_L8_BAND10][i] = MIN_VALID_TH;
+                        else if (tmpf > MAX_VALID_TH)
+                            sband[SR_L8_BAND10][i] = MAX_VALID_TH;
+                        else
+                            sband[SR_L8_BAND10][i] = (int) (roundf (tmpf));
 
-                    /* Check for saturation */
-                    if (uband[i] == L1_SATURATED)
-                        radsat[i] |= 1 << (ib+1);
-                }
-                else
-                {
-                    sband[SR_L8_BAND10][i] = FILL_VALUE;
-                    radsat[i] = RADSAT_FILL_VALUE;
-                }
-            }
+                        /* Check for saturation */
+                        if (uband[i] == L1_SATURATED)
+                            radsat[i] |= 1 << (ib+1);
+                    }
+                    else
+                    {
+                        sband[SR_L8_BAND10][i] = FILL_VALUE;
+                        radsat[i] = RADSAT_FILL_VALUE;
+                    }
+                }  /* for samp */
+            }  /* for line */
+            fill_span_gaps_int16 (sband[SR_L8_BAND10], FILL_VALUE, spans,
+                nlines, nsamps);
         }  /* end if band 10 */
 
         else if (ib == DN_L8_BAND11 && strcmp (instrument, "OLI"))
@@ -244,43 +271,54 @@ int compute_l8_toa_refl
             /* Compute brightness temp for band 11.  Make sure it falls
                within the min/max range for the thermal bands. */
 #ifdef _OPENMP
-            #pragma omp parallel for private (i, tmpf)
+            #pragma omp parallel for private (line, samp, i, tmpf)
 #endif
-            for (i = 0; i < nlines*nsamps; i++)
+            for (line = 0; line < nlines; line++)
             {
-                /* If this pixel is not fill */
-                if (!level1_qa_is_fill (qaband[i]))
+                i = line * nsamps + spans[line].start;
+                for (samp = spans[line].start; samp < spans[line].end;
+                     samp++, i++)
                 {
-                    /* Compute the TOA spectral radiance */
-                    tmpf = xcals * uband[i] + xcalo;
-
-                    /* Compute TOA brightness temp (K) and scale for output */
-                    tmpf = k2b11 / log (k1b11 / tmpf + 1.0);
-                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
-
-                    /* Make sure the brightness temp falls within the specified
-                       range */
-                    if (tmpf < MIN_VALID_TH)
-                        sband[SR_L8_BAND11][i] = MIN_VALID_TH;
-                    else if (tmpf > MAX_VALID_TH)
-                        sband[SR_L8_BAND11][i] = MAX_VALID_TH;
-                    else
-                        sband[SR_L8_BAND11][i] = (int) (roundf (tmpf));
+                    /* If this pixel is not fill */
+                    if (!level1_qa_is_fill (qaband[i]))
+                    {
+                        /* Compute the TOA spectral radiance */
+                        tmpf = xcals * uband[i] + xcalo;
+
+                        /* Compute TOA brightness temp (K) and scale for
+                           output */
+                        tmpf = k2b11 / log (k1b11 / tmpf + 1.0);
+                        tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+
+                        /* Make sure the brightness temp falls within the
+                           specified range */
+                        if (tmpf < MIN_VALID_TH)
+                            sband[SR_L8_BAND11][i] = MIN_VALID_TH;
+                        else if (tmpf > MAX_VALID_TH)
+                            sband[SR_L8_BAND11][i] = MAX_VALID_TH;
+                        else
+                            sband[SR_L8_BAND11][i] = (int) (roundf (tmpf));
 
-                    /* Check for saturation only */
-                    if (uband[i] == L1_SATURATED)
-                        radsat[i] |= 1 << (ib+1);
-                }
-                else
-                {
-                    sband[SR_L8_BAND11][i] = FILL_VALUE;
-                    radsat[i] = RADSAT_FILL_VALUE;
-                }
-            }
+                        /* Check for saturation only */
+                        if (uband[i] == L1_SATURATED)
+                            radsat[i] |= 1 << (ib+1);
+                    }
+                    else
+                    {
+                        sband[SR_L8_BAND11][i] = FILL_VALUE;
+                        radsat[i] = RADSAT_FILL_VALUE;
+                    }
+                }  /* for samp */
+            }  /* for line */
+            fill_span_gaps_int16 (sband[SR_L8_BAND11], FILL_VALUE, spans,
+                nlines, nsamps);
         }  /* end if band 11 */
     }  /* end for ib */
     printf ("\n");
 
+    /* Mark the samples outside the valid spans as fill in the saturation QA */
+    fill_span_gaps_uint16 (radsat, RADSAT_FILL_VALUE, spans, nlines, nsamps);
+
     /* The input data has been read and calibrated. The memory can be freed. */
     free (uband);
 
@@ -322,27 +360,84 @@ NOTES:
    clear (valid land pixel aerosols) and water (valid water pixel aerosols).
    Those final aerosol values are used for the surface reflectance corrections.
 5. Cloud-based QA information is not processed in this algorithm.
+6. If a checkpoint file is specified and it contains the aerosol inversion
+   results for the same inputs, then the LUT initialization, the atmospheric
+   coefficient retrieval, and the aerosol inversion are skipped and the saved
+   results are used.  Otherwise the aerosol inversion results are saved to the
+   checkpoint file once the inversion completes.  The checkpoint is removed
+   by the caller after the SR products are successfully written.
+7. The computations are done in memory; the SR bands are returned in sband
+   and the aerosol QA in ipflag.  write_l8_sr_refl writes them to the output
+   product.  Errors are returned to the caller rather than exiting, so this
+   routine can be called from liblasrc.
+8. If fast_math is specified, the aerosol inversion and the atmospheric
+   correction use the single-precision, approximate transcendental versions
+   of subaeroret and atmcorlamb2.  Every FAST_MATH_SAMPLE_STRIDE pixel is also
+   run through the reference routines with the same inputs, and the
+   distribution of the differences in the retrieved AOT (low eps retrieval)
+   and the surface reflectance is reported at the end.  The differences are
+   per-routine; the compounded effect of a fast-math AOT on the reflectance
+   is not included, as that would require a full reference inversion.
+9. If only a subset of the bands is processed (see set_input_bands), then
+   the climatology and aerosol corrections are skipped for the other bands
+   and their sband arrays are NULL.  The atmospheric coefficients are still
+   retrieved for all the bands, so the checkpoint is complete.
+10. If the per-pixel solar zenith angles are specified, then the final
+   atmospheric correction uses coefficients interpolated from an angle grid
+   (see init_angle_grid) at the geometry of each pixel, rather than the scene
+   center coefficients.  The aerosol inversion still uses the scene center
+   geometry.  Only the solar zenith varies per pixel, as the view zenith and
+   relative azimuth bands aren't read; the grid is set up so those axes can
+   be added.
+11. If aero_adapt_tol is positive, the aerosol inversion is adaptive.  The
+   windows on the coarse lattice (see is_coarse_aero_window) are inverted
+   first.  The remaining land windows are interpolated from the surrounding
+   lattice windows if they are all clear and agree within aero_adapt_tol,
+   and are otherwise inverted.  The number of interpolated windows is
+   reported, along with the AOT differences from the full inversion for a
+   sample of the interpolated windows (which keep the full inversion).
+12. If the scene is a row of a strip (see strip.c), then the LUTs and the
+   auxiliary data are only read for the first row, and the land windows
+   which are covered by a clear window of the previous row reuse its
+   aerosols rather than being inverted.  The atmospheric coefficients are
+   still computed for the scene center of each row.  The inversion modifies
+   the shared ratio arrays in place, but only to values which depend on the
+   unmodified ratio and NDWI arrays, so every row sees the same values.
 ******************************************************************************/
 int compute_l8_sr_refl
 (
     Input_t *input,     /* I: input structure for the Landsat product */
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
-    char *xml_infile,   /* I: input XML filename */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans,/* I: valid span of each line, from the QA band */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
     int16 **sband,      /* I/O: input TOA and output surface reflectance */
+    uint8 *ipflag,      /* O: aerosol QA band, nlines x nsamps; array should
+                              be all zeros on input to this routine */
     float xts,          /* I: scene center solar zenith angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
+    int16 *sza,         /* I: scaled per-pixel solar zenith angles (degrees),
+                              nlines x nsamps; NULL to correct with the scene
+                              center geometry */
     char *anglehdf,     /* I: angle HDF filename */
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *ckpt_file,    /* I: aerosol checkpoint filename (NULL if not
+                              checkpointing) */
+    bool fast_math,     /* I: use the fast-math inversion and correction and
+                              report the differences from the reference */
+    float aero_adapt_tol,/* I: AOT tolerance for interpolating the aerosol
+                              windows from the coarse lattice; 0.0 inverts
+                              every window */
+    Lasrc_strip_t *strip/* I/O: strip of WRS rows this scene belongs to;
+                              NULL if the scene is processed on its own */
 )
 {
     char errmsg[STR_SIZE];                     /* error message */
@@ -408,10 +503,29 @@ int compute_l8_sr_refl
     float xcmg, ycmg;     /* x/y location for CMG */
     float xndwi;          /* calculated NDWI value */
     float median_aerosol; /* median aerosol value for clear pixels */
-    uint8 *ipflag = NULL; /* QA flag to assist with aerosol interpolation,
-                             nlines x nsamps */
     float *taero = NULL;  /* aerosol values for each pixel, nlines x nsamps */
     float *teps = NULL;   /* angstrom coeff for each pixel, nlines x nsamps */
+    bool aero_restored = false; /* were the aerosol inversion results restored
+                                   from the checkpoint file? */
+    uint64_t aero_hash = 0;     /* hash of the aerosol inversion inputs */
+    int mapping_error = false;  /* did the geolocation mapping fail for any
+                                   aerosol window? */
+    int pass;             /* current pass of the aerosol inversion */
+    int npasses;          /* number of passes of the aerosol inversion; the
+                             adaptive inversion does the coarse lattice in
+                             the first pass */
+    float adapt_aero;     /* aerosol interpolated from the coarse lattice */
+    float adapt_eps;      /* angstrom coeff interpolated from the lattice */
+    bool adapt_sample;    /* is this interpolated window also inverted for
+                             the adaptive accuracy report? */
+    long adapt_interp = 0;   /* number of windows interpolated from the
+                                coarse lattice */
+    long adapt_invert = 0;   /* number of land windows off the lattice which
+                                were inverted */
+    Fast_math_stats_t adapt_stats;  /* adaptive AOT differences */
+    bool strip_aux = false;  /* are the LUTs and aux arrays the strip's? */
+    long strip_reused = 0;   /* number of windows reused from the previous
+                                row of the strip */
     int16 *aerob1 = NULL; /* L8 atmospherically corrected band 1 data
                              (TOA refl), nlines x nsamps */
     int16 *aerob2 = NULL; /* L8 atmospherically corrected band 2 data
@@ -463,6 +577,18 @@ int compute_l8_sr_refl
     float tts[22];         /* sun angle table */
     int32 indts[22];       /* index for sun angle table */
     int iaots;             /* index for AOTs */
+    int iaots_ref;         /* index for AOTs for the fast-math samples */
+    float raot_ref;        /* reference AOT for the fast-math samples */
+    float residual_ref;    /* reference residual for the fast-math samples */
+    float roslamb_ref;     /* reference surface reflectance for the fast-math
+                              samples */
+    Atmcorlamb2_func_t atmcorlamb2_func;  /* reference or fast-math
+                                             atmospheric correction */
+    Subaeroret_func_t subaeroret_func;    /* reference or fast-math aerosol
+                                             retrieval */
+    Fast_math_stats_t aot_stats;          /* fast-math AOT differences */
+    Fast_math_stats_t sr_stats[NSR_BANDS];/* fast-math SR differences */
+    char stats_name[STR_SIZE];            /* name for the SR differences */
 
     /* Atmospheric correction coefficient variables */
     float tgo_arr[NREFL_BANDS];     /* per-band other gaseous transmittance */
@@ -480,6 +606,20 @@ int compute_l8_sr_refl
     int iaMaxTemp;                         /* max temp for current AOT level */
     float arr1[NAOT_VALS], coef1[NCOEF];   /* temporary arrays */
 
+    /* Per-pixel geometry variables */
+    Angle_grid_t grid;             /* coefficients on the angle grid */
+    float angle_min[GRID_NAXES];   /* smallest angle on each grid axis */
+    float angle_max[GRID_NAXES];   /* largest angle on each grid axis */
+    int sza_min, sza_max;          /* range of the scaled per-pixel solar
+                                      zenith angles */
+    float px_tgo;                  /* tgo for the current pixel */
+    float px_xrorayp;              /* xrorayp for the current pixel */
+    float px_roatm_upper;          /* largest AOT for the roatm fit for the
+                                      current pixel */
+    float px_roatm_coef[NCOEF];    /* roatm poly coeffs for the pixel */
+    float px_ttatmg_coef[NCOEF];   /* ttatmg poly coeffs for the pixel */
+    float px_satm_coef[NCOEF];     /* satm poly coeffs for the pixel */
+
     /* Auxiliary file variables */
     int16 *dem = NULL;        /* CMG DEM data array [DEM_NBLAT x DEM_NBLON] */
     int16 *andwi = NULL;      /* avg NDWI [RATIO_NBLAT x RATIO_NBLON] */
@@ -527,11 +667,6 @@ int compute_l8_sr_refl
 
     /* Output file info */
     time_t mytime;               /* timing variable */
-    Output_t *sr_output = NULL;  /* output structure and metadata for the SR
-                                    product */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
-    char envi_file[STR_SIZE];    /* ENVI filename */
-    char *cptr = NULL;           /* pointer to the file extension */
 
     /* Table constants */
     float aot550nm[NAOT_VALS] =  /* AOT look-up table */
@@ -578,7 +713,7 @@ int compute_l8_sr_refl
     /* Allocate memory for the many arrays needed to do the surface reflectance
        computations */
     retval = l8_memory_allocation_sr (nlines, nsamps, &aerob1, &aerob2, &aerob4,
-        &aerob5, &aerob7, &ipflag, &taero, &teps, &dem, &andwi, &sndwi,
+        &aerob5, &aerob7, &taero, &teps, &dem, &andwi, &sndwi,
         &ratiob1, &ratiob2, &ratiob7, &intratiob1, &intratiob2, &intratiob7,
         &slpratiob1, &slpratiob2, &slpratiob7, &wv, &oz, &rolutt, &transt,
         &sphalbt, &normext, &tsmax, &tsmin, &nbfic, &nbfi, &ttv);
@@ -590,6 +725,39 @@ int compute_l8_sr_refl
         return (ERROR);
     }
 
+    /* Select the reference or fast-math routines.  For fast-math, set up the
+       sampled differences for the accuracy report. */
+    if (fast_math)
+    {
+        atmcorlamb2_func = atmcorlamb2_fast;
+        subaeroret_func = subaeroret_fast;
+        if (init_fast_math_stats ("AOT", (long) nlines * nsamps, &aot_stats)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the fast-math samples");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (ib = 0; ib <= DN_L8_BAND7; ib++)
+        {
+            if (!input->proc_band[ib])
+                continue;
+            sprintf (stats_name, "SR band %d", ib+1);
+            if (init_fast_math_stats (stats_name, (long) nlines * nsamps,
+                &sr_stats[ib]) != SUCCESS)
+            {
+                sprintf (errmsg, "Allocating the fast-math samples");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+    else
+    {
+        atmcorlamb2_func = atmcorlamb2_new;
+        subaeroret_func = subaeroret_new;
+    }
+
     /* Initialize the geolocation space applications */
     if (!get_geoloc_info (xml_metadata, &space_def))
     {
@@ -606,19 +774,69 @@ int compute_l8_sr_refl
         return (ERROR);
     }
 
+    /* If checkpointing, then hash the TOA reflectance and QA inputs and try to
+       restore the aerosol inversion results from a previous run */
+    if (ckpt_file != NULL && hash_aero_inputs (nlines, nsamps,
+        SR_L8_BAND7+1, (void **) sband, sizeof (int16), qaband, xts, auxnm,
+        intrefnm, transmnm, spheranm, cmgdemnm, rationm, fast_math,
+        aero_adapt_tol, &aero_hash) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to hash the aerosol inversion inputs.  "
+            "Processing will continue without the checkpoint.");
+        error_handler (false, FUNC_NAME, errmsg);
+        ckpt_file = NULL;
+    }
+    if (ckpt_file != NULL)
+    {
+        if (read_aero_checkpoint (ckpt_file, sat, nlines, nsamps,
+            L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, false, aero_hash, btgo,
+            broatm, bttatmg, bsatm, tgo_arr, xrorayp_arr, normext_p0a3_arr,
+            roatm_iaMax, roatm_coef, ttatmg_coef, satm_coef, ipflag, taero,
+            teps) == SUCCESS)
+        {
+            aero_restored = true;
+            printf ("Restored the aerosol inversion results from checkpoint "
+                "%s\n", ckpt_file);
+        }
+    }
+
+    /* If this scene is a row of a strip, then locate it within the previous
+       row and use the LUTs and auxiliary data already read for the strip */
+    if (strip != NULL)
+    {
+        begin_strip_row (strip, xml_metadata, pixsize);
+        if (get_strip_aux (strip, intrefnm, auxnm, tts, indts, &rolutt,
+            &transt, &sphalbt, &normext, &tsmax, &tsmin, &nbfic, &nbfi, &ttv,
+            &dem, &andwi, &sndwi, &ratiob1, &ratiob2, &ratiob7, &intratiob1,
+            &intratiob2, &intratiob7, &slpratiob1, &slpratiob2, &slpratiob7,
+            &wv, &oz, &strip_aux) != SUCCESS)
+        {
+            sprintf (errmsg, "Sharing the LUTs and auxiliary data of the "
+                "strip");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
     /* Initialize the look up tables and atmospheric correction variables.
        view zenith initialized to 0.0 (xtv)
        azimuthal difference between sun and obs angle initialize to 0.0 (xfi)
        surface pressure is initialized to the pressure at the center of the
            scene (using the DEM) (pres)
        water vapor is initialized to the value at the center of the scene (uwv)
-       ozone is initialized to the value at the center of the scene (uoz) */
-    retval = init_sr_refl (nlines, nsamps, input, space, anglehdf, intrefnm,
-        transmnm, spheranm, cmgdemnm, rationm, auxnm, &xtv, &xmuv, &xfi,
-        &cosxfi, &pres, &uoz, &uwv, &xtsstep, &xtsmin, &xtvstep, &xtvmin,
-        tsmax, tsmin, tts, ttv, indts, rolutt, transt, sphalbt, normext,
-        nbfic, nbfi, dem, andwi, sndwi, ratiob1, ratiob2, ratiob7, intratiob1,
-        intratiob2, intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
+       ozone is initialized to the value at the center of the scene (uoz)
+       These are only needed for the aerosol inversion and its coefficients,
+       and for the angle grid, so they aren't needed if the inversion was
+       restored and the scene center geometry is used. */
+    retval = SUCCESS;
+    if (!aero_restored || sza != NULL)
+        retval = init_sr_refl (nlines, nsamps, input, space, anglehdf,
+            intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm,
+            strip_aux, &xtv, &xmuv, &xfi, &cosxfi, &pres, &uoz, &uwv,
+            &xtsstep, &xtsmin, &xtvstep, &xtvmin, tsmax, tsmin, tts, ttv,
+            indts, rolutt, transt, sphalbt, normext, nbfic, nbfi, dem, andwi,
+            sndwi, ratiob1, ratiob2, ratiob7, intratiob1, intratiob2,
+            intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Error initializing the lookup tables and "
@@ -627,6 +845,17 @@ int compute_l8_sr_refl
         return (ERROR);
     }
 
+    /* The first row of a strip hands the arrays it read over to the strip,
+       which frees them once all the rows are done */
+    if (strip != NULL && !strip_aux && (!aero_restored || sza != NULL))
+    {
+        keep_strip_aux (strip, intrefnm, auxnm, tts, indts, rolutt, transt,
+            sphalbt, normext, tsmax, tsmin, nbfic, nbfi, ttv, dem, andwi,
+            sndwi, ratiob1, ratiob2, ratiob7, intratiob1, intratiob2,
+            intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
+        strip_aux = true;
+    }
+
     /* Loop through all the reflectance bands and perform atmospheric
        corrections based on climatology */
     mytime = time(NULL);
@@ -636,41 +865,57 @@ int compute_l8_sr_refl
     {
         printf (" %d ...", ib+1);
 
-        /* Get the parameters for the atmospheric correction */
-        /* rotoa is not defined for this call, which is ok, but the
-           roslamb value is not valid upon output. Just set it to 0.0 to
-           be consistent. */
-        rotoa = 0.0;
-        raot550nm = aot550nm[1];
-        eps = 2.5;
-        retval = atmcorlamb2 (input->meta.sat, xts, xtv, xmus, xmuv, xfi,
-            cosxfi, raot550nm, ib, pres, tpres, aot550nm, rolutt, transt,
-            xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin,
-            nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray, ogtransa1,
-            ogtransb0, ogtransb1, wvtransa, wvtransb, oztransa, rotoa,
-            &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next, eps);
-        if (retval != SUCCESS)
+        /* Use the band-related parameters from the checkpoint, if they were
+           restored */
+        if (aero_restored)
         {
-            sprintf (errmsg, "Performing lambertian atmospheric correction "
-                "type 2.");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            tgo = btgo[ib];
+            roatm = broatm[ib];
+            ttatmg = bttatmg[ib];
+            satm = bsatm[ib];
         }
+        else
+        {
+            /* Get the parameters for the atmospheric correction */
+            /* rotoa is not defined for this call, which is ok, but the
+               roslamb value is not valid upon output. Just set it to 0.0 to
+               be consistent. */
+            rotoa = 0.0;
+            raot550nm = aot550nm[1];
+            eps = 2.5;
+            retval = atmcorlamb2 (input->meta.sat, xts, xtv, xmus, xmuv, xfi,
+                cosxfi, raot550nm, ib, pres, tpres, aot550nm, rolutt, transt,
+                xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
+                tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
+                ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb, oztransa,
+                rotoa, &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next,
+                eps);
+            if (retval != SUCCESS)
+            {
+                sprintf (errmsg, "Performing lambertian atmospheric correction "
+                    "type 2.");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
 
-        /* Save these band-related parameters for later */
-        btgo[ib] = tgo;
-        broatm[ib] = roatm;
-        bttatmg[ib] = ttatmg;
-        bsatm[ib] = satm;
+            /* Save these band-related parameters for later */
+            btgo[ib] = tgo;
+            broatm[ib] = roatm;
+            bttatmg[ib] = ttatmg;
+            bsatm[ib] = satm;
+        }
 
-        /* Perform atmospheric corrections for bands 1-7 */
+        /* Perform atmospheric corrections for bands 1-7, unless the band
+           isn't processed */
+        if (!input->proc_band[ib])
+            continue;
 #ifdef _OPENMP
         #pragma omp parallel for private (i, j, curr_pix, rotoa, roslamb)
 #endif
         for (i = 0; i < nlines; i++)
         {
-            curr_pix = i * nsamps;
-            for (j = 0; j < nsamps; j++, curr_pix++)
+            curr_pix = i * nsamps + spans[i].start;
+            for (j = spans[i].start; j < spans[i].end; j++, curr_pix++)
             {
                 /* If this pixel is not fill.  Otherwise fill pixels have
                    already been marked in the TOA calculations. */
@@ -705,11 +950,14 @@ int compute_l8_sr_refl
     }  /* for ib */
     printf ("\n");
 
-    /* Start the retrieval of atmospheric correction parameters for each band */
+    /* Start the retrieval of atmospheric correction parameters for each band.
+       The retrieval and the aerosol inversion are skipped if the results were
+       restored from the checkpoint. */
     mytime = time(NULL);
-    printf ("Starting retrieval of atmospheric correction parameters ... %s",
-        ctime(&mytime));
-    for (ib = 0; ib <= SR_L8_BAND7; ib++)
+    if (!aero_restored)
+        printf ("Starting retrieval of atmospheric correction parameters "
+            "... %s", ctime(&mytime));
+    for (ib = 0; !aero_restored && ib <= SR_L8_BAND7; ib++)
     {
         /* Get the parameters for the atmospheric correction */
         /* rotoa is not defined for this call, which is ok, but the
@@ -734,7 +982,7 @@ int compute_l8_sr_refl
                 sprintf (errmsg, "Performing lambertian atmospheric correction "
                     "type 2 for band %d.", ib);
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                return (ERROR);
             }
 
             /* Store the AOT-related variables for use in the atmospheric
@@ -751,7 +999,7 @@ int compute_l8_sr_refl
         xrorayp_arr[ib] = xrorayp;
     }
 
-    for (ib = 0; ib <= SR_L8_BAND7; ib++)
+    for (ib = 0; !aero_restored && ib <= SR_L8_BAND7; ib++)
     {
         /* Get the polynomial coefficients for roatm */
         for (ia = 0; ia < NAOT_VALS; ia++)
@@ -801,19 +1049,40 @@ int compute_l8_sr_refl
     xb = eps1 - eps3;
     xe = eps2 - eps3;
 
-    /* Start the aerosol inversion */
+    /* Start the aerosol inversion, unless the results were restored */
     mytime = time(NULL);
-    printf ("Aerosol Inversion using %d x %d aerosol window ... %s",
-        L8_AERO_WINDOW, L8_AERO_WINDOW, ctime(&mytime));
+    if (!aero_restored)
+        printf ("Aerosol Inversion using %d x %d aerosol window ... %s",
+            L8_AERO_WINDOW, L8_AERO_WINDOW, ctime(&mytime));
     tmp_percent = 0;
+
+    /* The adaptive inversion does the coarse lattice windows in the first
+       pass and the remaining windows in the second pass */
+    npasses = 1;
+    if (aero_adapt_tol > 0.0 && !aero_restored)
+    {
+        npasses = 2;
+        printf ("Adaptive aerosol inversion with a %d x %d window coarse "
+            "lattice and an AOT tolerance of %g\n", AERO_COARSE_STEP,
+            AERO_COARSE_STEP, aero_adapt_tol);
+        if (init_fast_math_stats ("Adaptive AOT", (long) nlines * nsamps,
+            &adapt_stats) != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the adaptive inversion samples");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    for (pass = 0; !aero_restored && pass < npasses; pass++)
 #ifdef _OPENMP
-    #pragma omp parallel for private (i, j, center_line, center_samp, nearest_line, nearest_samp, curr_pix, center_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, lcmg1, u, v, one_minus_u, one_minus_v, one_minus_u_x_one_minus_v, one_minus_u_x_v, u_x_one_minus_v, u_x_v, ratio_pix11, ratio_pix12, ratio_pix21, ratio_pix22, rb1, rb2, slpr11, slpr12, slpr21, slpr22, intr11, intr12, intr21, intr22, slprb1, slprb2, slprb7, intrb1, intrb2, intrb7, xndwi, ndwi_th1, ndwi_th2, iband, iband1, iband3, iaots, retval, eps, residual, residual1, residual2, residual3, raot, sraot1, sraot3, xc, xf, coefa, coefb, epsmin, corf, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4, erelc, troatm)
+    #pragma omp parallel for private (i, j, center_line, center_samp, nearest_line, nearest_samp, curr_pix, center_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, lcmg1, u, v, one_minus_u, one_minus_v, one_minus_u_x_one_minus_v, one_minus_u_x_v, u_x_one_minus_v, u_x_v, ratio_pix11, ratio_pix12, ratio_pix21, ratio_pix22, rb1, rb2, slpr11, slpr12, slpr21, slpr22, intr11, intr12, intr21, intr22, slprb1, slprb2, slprb7, intrb1, intrb2, intrb7, xndwi, ndwi_th1, ndwi_th2, iband, iband1, iband3, iaots, retval, eps, residual, residual1, residual2, residual3, raot, sraot1, sraot3, xc, xf, coefa, coefb, epsmin, corf, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4, erelc, troatm, iaots_ref, raot_ref, residual_ref, adapt_aero, adapt_eps, adapt_sample) reduction (+:adapt_interp, adapt_invert, strip_reused)
 #endif
     for (i = L8_HALF_AERO_WINDOW; i < nlines; i += L8_AERO_WINDOW)
     {
 #ifndef _OPENMP
         /* update status, but not if multi-threaded */
-        curr_tmp_percent = 100 * i / nlines;
+        curr_tmp_percent = (100 * pass + 100 * i / nlines) / npasses;
         if (curr_tmp_percent > tmp_percent)
         {
             tmp_percent = curr_tmp_percent;
@@ -835,6 +1104,12 @@ int compute_l8_sr_refl
             center_samp = j;
             center_pix = curr_pix;
 
+            /* For the adaptive inversion, only process the coarse lattice
+               windows in the first pass and the others in the second pass */
+            if (npasses > 1 && is_coarse_aero_window (i, j, L8_AERO_WINDOW,
+                L8_HALF_AERO_WINDOW) != (pass == 0))
+                continue;
+
             /* If this pixel is fill */
             if (level1_qa_is_fill (qaband[curr_pix]))
             {
@@ -943,6 +1218,56 @@ int compute_l8_sr_refl
                 continue;
             }
 
+            /* Reuse the aerosols of the previous row of the strip where it
+               covers this window with a clear window */
+            if (strip != NULL && get_strip_aero (strip, center_line,
+                center_samp, &adapt_aero, &adapt_eps))
+            {
+                strip_reused++;
+                ipflag[center_pix] |= (1 << IPFLAG_CLEAR);
+                taero[center_pix] = adapt_aero;
+                teps[center_pix] = adapt_eps;
+
+                /* Reset the looping variables to the center of the aerosol
+                   window and skip to the next window */
+                i = center_line;
+                j = center_samp;
+                curr_pix = center_pix;
+                continue;
+            }
+
+            /* In the second pass of the adaptive inversion, interpolate the
+               aerosols from the coarse lattice if the lattice windows
+               around this one agree.  A sample of those windows is still
+               inverted to report the differences. */
+            adapt_sample = false;
+            if (pass == 1)
+            {
+                if (interp_coarse_aero (ipflag, taero, teps, nlines, nsamps,
+                    L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, aero_adapt_tol,
+                    center_line, center_samp, &adapt_aero, &adapt_eps))
+                {
+                    adapt_interp++;
+                    if (center_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+                        adapt_sample = true;
+                    else
+                    {
+                        ipflag[center_pix] |= (1 << IPFLAG_CLEAR);
+                        taero[center_pix] = adapt_aero;
+                        teps[center_pix] = adapt_eps;
+
+                        /* Reset the looping variables to the center of the
+                           aerosol window and skip to the next window */
+                        i = center_line;
+                        j = center_samp;
+                        curr_pix = center_pix;
+                        continue;
+                    }
+                }
+                else
+                    adapt_invert++;
+            }
+
             /* Get the lat/long for the current pixel (which may not be the
                center of the aerosol window), for the center of that pixel */
             img.l = i + 0.5;
@@ -953,7 +1278,17 @@ int compute_l8_sr_refl
                 sprintf (errmsg, "Mapping line/sample (%d, %d) to "
                     "geolocation coords", i, j);
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                mapping_error = true;
+
+                /* Reset the looping variables to the center of the aerosol
+                   window and skip to the next window */
+                i = center_line;
+                j = center_samp;
+                curr_pix = center_pix;
+                continue;
             }
             lat = geo.lat * RAD2DEG;
             lon = geo.lon * RAD2DEG;
@@ -1159,10 +1494,20 @@ int compute_l8_sr_refl
                      intr22 * u_x_v;
 
             /* Calculate NDWI variables for the band ratios */
-            xndwi = ((double) sband[SR_L8_BAND5][curr_pix] -
-                     (double) (sband[SR_L8_BAND7][curr_pix] * 0.5)) /
-                    ((double) sband[SR_L8_BAND5][curr_pix] +
-                     (double) (sband[SR_L8_BAND7][curr_pix] * 0.5));
+            if (fast_math)
+            {
+                xndwi = ((float) sband[SR_L8_BAND5][curr_pix] -
+                         sband[SR_L8_BAND7][curr_pix] * 0.5f) /
+                        ((float) sband[SR_L8_BAND5][curr_pix] +
+                         sband[SR_L8_BAND7][curr_pix] * 0.5f);
+            }
+            else
+            {
+                xndwi = ((double) sband[SR_L8_BAND5][curr_pix] -
+                         (double) (sband[SR_L8_BAND7][curr_pix] * 0.5)) /
+                        ((double) sband[SR_L8_BAND5][curr_pix] +
+                         (double) (sband[SR_L8_BAND7][curr_pix] * 0.5));
+            }
 
             if (xndwi > ndwi_th1)
                 xndwi = ndwi_th1;
@@ -1193,17 +1538,30 @@ int compute_l8_sr_refl
             iband3 = DN_L8_BAND1;   /* coastal aerosol */
             eps = LOW_EPS;
             iaots = 0;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
             /* Save the data */
             residual1 = residual;
+
+            /* Compare the low eps retrieval against the reference for the
+               fast-math accuracy report */
+            if (fast_math && center_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+            {
+                iaots_ref = 0;
+                subaeroret_new (input->meta.sat, iband1, iband3, erelc,
+                    troatm, tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef,
+                    ttatmg_coef, satm_coef, normext_p0a3_arr, &raot_ref,
+                    &residual_ref, &iaots_ref, LOW_EPS);
+                aot_stats.diff[center_pix / FAST_MATH_SAMPLE_STRIDE] =
+                    raot - raot_ref;
+            }
             sraot1 = raot;
 
             /* Retrieve the aerosol information for moderate eps 1.75 */
             eps = MOD_EPS;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
@@ -1213,7 +1571,7 @@ int compute_l8_sr_refl
 
             /* Retrieve the aerosol information for high eps 2.5 */
             eps = HIGH_EPS;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
@@ -1232,7 +1590,7 @@ int compute_l8_sr_refl
 
             if (epsmin >= LOW_EPS && epsmin <= HIGH_EPS)
             {
-                subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+                subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                     tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                     satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
             }
@@ -1264,7 +1622,7 @@ int compute_l8_sr_refl
                 iband = DN_L8_BAND5;
                 rotoa = aerob5[curr_pix] * SCALE_FACTOR;
                 raot550nm = raot;
-                atmcorlamb2_new (input->meta.sat, tgo_arr[iband],
+                atmcorlamb2_func (input->meta.sat, tgo_arr[iband],
                     xrorayp_arr[iband], aot550nm[roatm_iaMax[iband]],
                     &roatm_coef[iband][0], &ttatmg_coef[iband][0],
                     &satm_coef[iband][0], raot550nm, iband,
@@ -1275,7 +1633,7 @@ int compute_l8_sr_refl
                 iband = DN_L8_BAND4;
                 rotoa = aerob4[curr_pix] * SCALE_FACTOR;
                 raot550nm = raot;
-                atmcorlamb2_new (input->meta.sat, tgo_arr[iband],
+                atmcorlamb2_func (input->meta.sat, tgo_arr[iband],
                     xrorayp_arr[iband], aot550nm[roatm_iaMax[iband]],
                     &roatm_coef[iband][0], &ttatmg_coef[iband][0],
                     &satm_coef[iband][0], raot550nm, iband,
@@ -1306,6 +1664,12 @@ int compute_l8_sr_refl
                 teps[center_pix] = DEFAULT_EPS;
             }
 
+            /* Compare the interpolated aerosols against the inversion for
+               the adaptive accuracy report */
+            if (adapt_sample)
+                adapt_stats.diff[center_pix / FAST_MATH_SAMPLE_STRIDE] =
+                    adapt_aero - taero[center_pix];
+
             /* Reset the looping variables to the center of the aerosol window
                versus the actual non-fill/non-cloud pixel that was processed
                so that we get the correct center for the next aerosol window */
@@ -1317,10 +1681,67 @@ int compute_l8_sr_refl
 
 #ifndef _OPENMP
     /* update status */
-    printf ("100%%\n");
-    fflush (stdout);
+    if (!aero_restored)
+    {
+        printf ("100%%\n");
+        fflush (stdout);
+    }
 #endif
 
+    /* Report the windows which were interpolated from the coarse lattice
+       and the differences from the full inversion */
+    if (npasses > 1)
+    {
+        printf ("Adaptive aerosol inversion interpolated %ld of %ld land "
+            "windows off the coarse lattice (%.1f%%)\n", adapt_interp,
+            adapt_interp + adapt_invert, (adapt_interp + adapt_invert > 0) ?
+            100.0 * adapt_interp / (adapt_interp + adapt_invert) : 0.0);
+        report_fast_math_stats (&adapt_stats);
+        free_fast_math_stats (&adapt_stats);
+    }
+
+    /* Errors can't be returned from within the threaded inversion loop, so
+       check for them now that the loop is complete */
+    if (mapping_error)
+    {
+        sprintf (errmsg, "Error mapping the aerosol windows to geolocation "
+            "coordinates");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Keep the aerosol windows of this row for the next row of the strip */
+    if (strip != NULL)
+    {
+        if (!aero_restored)
+            printf ("Reused %ld aerosol windows from the previous row of the "
+                "strip\n", strip_reused);
+        if (save_strip_aero (strip, xml_metadata, pixsize, nlines, nsamps,
+            ipflag, taero, teps) != SUCCESS)
+        {
+            sprintf (errmsg, "Saving the aerosol windows of the strip");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Save the aerosol inversion results so a failure in the remaining
+       processing doesn't require the inversion to be rerun.  Not being able
+       to write the checkpoint isn't fatal to the processing. */
+    if (ckpt_file != NULL && !aero_restored)
+    {
+        if (write_aero_checkpoint (ckpt_file, sat, nlines, nsamps,
+            L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, aero_hash, btgo, broatm,
+            bttatmg, bsatm, tgo_arr, xrorayp_arr, normext_p0a3_arr,
+            roatm_iaMax, roatm_coef, ttatmg_coef, satm_coef, ipflag, taero,
+            teps) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write the aerosol checkpoint.  "
+                "Processing will continue.");
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
     /* Done with the aerob* arrays */
     free (aerob1);  aerob1 = NULL;
     free (aerob2);  aerob2 = NULL;
@@ -1328,23 +1749,27 @@ int compute_l8_sr_refl
     free (aerob5);  aerob5 = NULL;
     free (aerob7);  aerob7 = NULL;
 
-    /* Done with the ratiob* arrays */
-    free (andwi);  andwi = NULL;
-    free (sndwi);  sndwi = NULL;
-    free (ratiob1);  ratiob1 = NULL;
-    free (ratiob2);  ratiob2 = NULL;
-    free (ratiob7);  ratiob7 = NULL;
-    free (intratiob1);  intratiob1 = NULL;
-    free (intratiob2);  intratiob2 = NULL;
-    free (intratiob7);  intratiob7 = NULL;
-    free (slpratiob1);  slpratiob1 = NULL;
-    free (slpratiob2);  slpratiob2 = NULL;
-    free (slpratiob7);  slpratiob7 = NULL;
-
-    /* Done with the DEM, water vapor, and ozone arrays */
-    free (dem);  dem = NULL;
-    free (wv);  wv = NULL;
-    free (oz);  oz = NULL;
+    /* The LUT and auxiliary arrays of a strip are freed by free_strip */
+    if (!strip_aux)
+    {
+        /* Done with the ratiob* arrays */
+        free (andwi);  andwi = NULL;
+        free (sndwi);  sndwi = NULL;
+        free (ratiob1);  ratiob1 = NULL;
+        free (ratiob2);  ratiob2 = NULL;
+        free (ratiob7);  ratiob7 = NULL;
+        free (intratiob1);  intratiob1 = NULL;
+        free (intratiob2);  intratiob2 = NULL;
+        free (intratiob7);  intratiob7 = NULL;
+        free (slpratiob1);  slpratiob1 = NULL;
+        free (slpratiob2);  slpratiob2 = NULL;
+        free (slpratiob7);  slpratiob7 = NULL;
+
+        /* Done with the DEM, water vapor, and ozone arrays */
+        free (dem);  dem = NULL;
+        free (wv);  wv = NULL;
+        free (oz);  oz = NULL;
+    }
 
 #ifdef WRITE_TAERO
     /* Write the ipflag values for comparison with other algorithms */
@@ -1362,8 +1787,14 @@ int compute_l8_sr_refl
     mytime = time(NULL);
     printf ("Computing median of clear pixels in NxN windows %s",
         ctime(&mytime));
-    median_aerosol = find_median_aerosol_l8 (ipflag, taero, L8_AERO_WINDOW,
-        L8_HALF_AERO_WINDOW, nlines, nsamps);
+    if (input->roi_set && input->roi.nshards > 0)
+        median_aerosol = find_shard_median_aerosol (input,
+            xml_metadata->global.product_id, auxnm, intrefnm, fast_math,
+            ipflag, taero, L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, nlines,
+            nsamps);
+    else
+        median_aerosol = find_median_aerosol_l8 (ipflag, taero,
+            L8_AERO_WINDOW, L8_HALF_AERO_WINDOW, nlines, nsamps);
     if (median_aerosol == 0.0)
     {   /* error message already printed */
         error_handler (true, FUNC_NAME, errmsg);
@@ -1397,7 +1828,7 @@ int compute_l8_sr_refl
     printf ("Interpolating the aerosol values in the NxN windows %s",
         ctime(&mytime));
     aerosol_interp_l8 (xml_metadata, L8_AERO_WINDOW, L8_HALF_AERO_WINDOW,
-        sband, qaband, ipflag, taero, median_aerosol, nlines, nsamps);
+        sband, qaband, spans, ipflag, taero, median_aerosol, nlines, nsamps);
 
 #ifdef WRITE_TAERO
     /* Write the ipflag values for comparison with other algorithms */
@@ -1418,7 +1849,57 @@ int compute_l8_sr_refl
     printf ("Interpolating the teps values in the NxN windows %s",
         ctime(&mytime));
     aerosol_interp_l8 (xml_metadata, L8_AERO_WINDOW, L8_HALF_AERO_WINDOW,
-        sband, qaband, ipflag, teps, DEFAULT_EPS, nlines, nsamps);
+        sband, qaband, spans, ipflag, teps, DEFAULT_EPS, nlines, nsamps);
+
+    /* Set up the atmospheric coefficients for the per-pixel geometry, over
+       the range of solar zenith angles in the scene.  Otherwise use the scene
+       center coefficients for every pixel. */
+    if (sza != NULL)
+    {
+        sza_min = SHRT_MAX;
+        sza_max = SHRT_MIN;
+#ifdef _OPENMP
+        #pragma omp parallel for private (i, j, curr_pix) reduction (min:sza_min) reduction (max:sza_max)
+#endif
+        for (i = 0; i < nlines; i++)
+        {
+            curr_pix = i * nsamps + spans[i].start;
+            for (j = spans[i].start; j < spans[i].end; j++, curr_pix++)
+            {
+                if (level1_qa_is_fill (qaband[curr_pix]) ||
+                    sza[curr_pix] == PPA_FILL)
+                    continue;
+                if (sza[curr_pix] < sza_min)
+                    sza_min = sza[curr_pix];
+                if (sza[curr_pix] > sza_max)
+                    sza_max = sza[curr_pix];
+            }
+        }
+        if (sza_min > sza_max)
+            sza_min = sza_max = (int) (xts * 100.0);
+
+        angle_min[GRID_SZA] = sza_min * 0.01;
+        angle_max[GRID_SZA] = sza_max * 0.01;
+        angle_min[GRID_VZA] = angle_max[GRID_VZA] = xtv;
+        angle_min[GRID_RAA] = angle_max[GRID_RAA] = xfi;
+
+        mytime = time(NULL);
+        printf ("Computing the atmospheric coefficients for solar zenith "
+            "angles %.2f to %.2f ... %s", angle_min[GRID_SZA],
+            angle_max[GRID_SZA], ctime(&mytime));
+        retval = init_angle_grid (input->meta.sat, SR_L8_BAND7+1, angle_min,
+            angle_max, pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin,
+            xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts,
+            indts, ttv, uoz, uwv, tauray, ogtransa1, ogtransb0, ogtransb1,
+            wvtransa, wvtransb, oztransa, &grid);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Setting up the angle grid for the per-pixel "
+                "geometry");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
 
     /* Perform the second level of atmospheric correction using the aerosols */
     mytime = time(NULL);
@@ -1428,14 +1909,28 @@ int compute_l8_sr_refl
        isn't spanned */
     for (ib = 0; ib <= DN_L8_BAND7; ib++)
     {
+        if (!input->proc_band[ib])
+            continue;
         printf ("  Band %d\n", ib+1);
+
+        /* Start each pixel with the scene center coefficients; they are
+           replaced by the interpolated coefficients for per-pixel geometry */
+        px_tgo = tgo_arr[ib];
+        px_xrorayp = xrorayp_arr[ib];
+        px_roatm_upper = aot550nm[roatm_iaMax[ib]];
+        for (ia = 0; ia < NCOEF; ia++)
+        {
+            px_roatm_coef[ia] = roatm_coef[ib][ia];
+            px_ttatmg_coef[ia] = ttatmg_coef[ib][ia];
+            px_satm_coef[ia] = satm_coef[ib][ia];
+        }
 #ifdef _OPENMP
-        #pragma omp parallel for private (i, j, curr_pix, rsurf, rotoa, raot550nm, eps, retval, tmpf, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next)
+        #pragma omp parallel for private (i, j, curr_pix, rsurf, rotoa, raot550nm, eps, retval, tmpf, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next, roslamb_ref) firstprivate (px_tgo, px_xrorayp, px_roatm_upper, px_roatm_coef, px_ttatmg_coef, px_satm_coef)
 #endif
         for (i = 0; i < nlines; i++)
         {
-            curr_pix = i * nsamps;
-            for (j = 0; j < nsamps; j++, curr_pix++)
+            curr_pix = i * nsamps + spans[i].start;
+            for (j = spans[i].start; j < spans[i].end; j++, curr_pix++)
             {
                 /* If this pixel is fill, then don't process */
                 if (level1_qa_is_fill (qaband[curr_pix]))
@@ -1453,10 +1948,26 @@ int compute_l8_sr_refl
                     broatm[ib]) * btgo[ib];
                 raot550nm = taero[curr_pix];
                 eps = teps[curr_pix];
-                atmcorlamb2_new (input->meta.sat, tgo_arr[ib], xrorayp_arr[ib],
-                    aot550nm[roatm_iaMax[ib]], &roatm_coef[ib][0],
-                    &ttatmg_coef[ib][0], &satm_coef[ib][0], raot550nm, ib,
-                    normext_p0a3_arr[ib], rotoa, &roslamb, eps);
+                if (sza != NULL)
+                    interp_angle_grid (&grid, ib, sza[curr_pix] * 0.01, xtv,
+                        xfi, &px_tgo, &px_xrorayp, &px_roatm_upper,
+                        px_roatm_coef, px_ttatmg_coef, px_satm_coef);
+                atmcorlamb2_func (input->meta.sat, px_tgo, px_xrorayp,
+                    px_roatm_upper, px_roatm_coef, px_ttatmg_coef,
+                    px_satm_coef, raot550nm, ib, normext_p0a3_arr[ib], rotoa,
+                    &roslamb, eps);
+
+                /* Compare against the reference correction for the
+                   fast-math accuracy report */
+                if (fast_math && curr_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+                {
+                    atmcorlamb2_new (input->meta.sat, px_tgo, px_xrorayp,
+                        px_roatm_upper, px_roatm_coef, px_ttatmg_coef,
+                        px_satm_coef, raot550nm, ib, normext_p0a3_arr[ib],
+                        rotoa, &roslamb_ref, eps);
+                    sr_stats[ib].diff[curr_pix / FAST_MATH_SAMPLE_STRIDE] =
+                        roslamb - roslamb_ref;
+                }
 
                 /* If this is the coastal aerosol band then set the aerosol
                    bits in the QA band */
@@ -1495,10 +2006,94 @@ int compute_l8_sr_refl
         }  /* end for i */
     }  /* end for ib */
 
+    /* Report the fast-math differences from the reference */
+    if (fast_math)
+    {
+        printf ("Fast-math differences from the reference (every %d pixels):\n",
+            FAST_MATH_SAMPLE_STRIDE);
+        report_fast_math_stats (&aot_stats);
+        free_fast_math_stats (&aot_stats);
+        for (ib = 0; ib <= DN_L8_BAND7; ib++)
+        {
+            if (!input->proc_band[ib])
+                continue;
+            report_fast_math_stats (&sr_stats[ib]);
+            free_fast_math_stats (&sr_stats[ib]);
+        }
+    }
+
     /* Free memory for arrays no longer needed */
     free (taero);
     free (teps);
- 
+    if (sza != NULL)
+        free_angle_grid (&grid);
+
+    /* Free the spatial mapping pointer */
+    free (space);
+
+    /* Free the data arrays, unless they belong to the strip */
+    if (!strip_aux)
+    {
+        free (rolutt);
+        free (transt);
+        free (sphalbt);
+        free (normext);
+        free (tsmax);
+        free (tsmin);
+        free (nbfic);
+        free (nbfi);
+        free (ttv);
+    }
+
+    /* Successful completion */
+    mytime = time(NULL);
+    printf ("Surface reflectance correction complete ... %s\n", ctime(&mytime));
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_l8_sr_refl
+
+PURPOSE:  Writes the Landsat 8 surface reflectance bands and the aerosol QA band to
+the SR output product, and appends the bands to the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the surface reflectance product
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only the bands in the output subset are written and appended to the XML
+     file (see set_input_bands).  The aerosol QA band is always written.
+******************************************************************************/
+int write_l8_sr_refl
+(
+    Input_t *input,     /* I: input structure for the Landsat 8 product */
+    Espa_internal_meta_t *xml_metadata,
+                        /* I/O: XML metadata structure */
+    char *xml_infile,   /* I: input XML filename */
+    int nlines,         /* I: number of lines in reflectance bands */
+    int16 **sband,      /* I: surface reflectance bands, nlines x nsamps */
+    uint8 *ipflag       /* I: aerosol QA band, nlines x nsamps */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "write_l8_sr_refl";   /* function name */
+    Sat_t sat = input->meta.sat;             /* satellite */
+    int ib;                      /* looping variable for bands */
+    time_t mytime;               /* timing variable */
+    Output_t *sr_output = NULL;  /* output structure and metadata for the SR
+                                    product */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    char envi_file[STR_SIZE];    /* ENVI filename */
+    char *cptr = NULL;           /* pointer to the file extension */
+
     /* Write the data to the output file */
     mytime = time(NULL);
     printf ("Writing surface reflectance corrected data to the output "
@@ -1507,7 +2102,8 @@ int compute_l8_sr_refl
     /* Open the output file */
     sr_output = open_output (xml_metadata, input, OUTPUT_SR);
     if (sr_output == NULL)
-    {   /* error message already printed */
+    {
+        sprintf (errmsg, "Opening the surface reflectance output product");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -1515,6 +2111,8 @@ int compute_l8_sr_refl
     /* Loop through the reflectance bands and write the data */
     for (ib = 0; ib <= DN_L8_BAND7; ib++)
     {
+        if (!is_output_band (input, OUTPUT_SR, ib))
+            continue;
         printf ("  Band %d: %s\n", ib+1,
             sr_output->metadata.band[ib].file_name);
         if (put_output_lines (sr_output, sband[ib], ib, 0, nlines,
@@ -1547,8 +2145,8 @@ int compute_l8_sr_refl
     }
 
     /* Append the surface reflectance bands (1-7) to the XML file */
-    if (append_metadata (7, sr_output->metadata.band, xml_infile) !=
-        SUCCESS)
+    if (append_output_bands (sr_output, input, OUTPUT_SR, SR_L8_BAND1,
+        SR_L8_BAND7, xml_infile) != SUCCESS)
     {
         sprintf (errmsg, "Appending surface reflectance bands to the "
             "XML file.");
@@ -1567,9 +2165,6 @@ int compute_l8_sr_refl
         return (ERROR);
     }
 
-    /* Free memory for ipflag data */
-    free (ipflag);
-
     /* Create the ENVI header for the aerosol QA band */
     if (create_envi_struct (&sr_output->metadata.band[SR_L8_AEROSOL],
         &xml_metadata->global, &envi_hdr) != SUCCESS)
@@ -1603,22 +2198,5 @@ int compute_l8_sr_refl
     close_output (sat, sr_output, OUTPUT_SR);
     free_output (sr_output, OUTPUT_SR);
 
-    /* Free the spatial mapping pointer */
-    free (space);
-
-    /* Free the data arrays */
-    free (rolutt);
-    free (transt);
-    free (sphalbt);
-    free (normext);
-    free (tsmax);
-    free (tsmin);
-    free (nbfic);
-    free (nbfi);
-    free (ttv);
-
-    /* Successful completion */
-    mytime = time(NULL);
-    printf ("Surface reflectance correction complete ... %s\n", ctime(&mytime));
     return (SUCCESS);
 }
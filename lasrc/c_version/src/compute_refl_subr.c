@@ -38,6 +38,12 @@ at the USGS EROS
 NOTES:
 1. The view angle is set to 0.0 and this never changes.
 2. The DEM is used to calculate the surface pressure.
+3. In strip mode, the LUTs and auxiliary data are only read for the first
+   row of the strip (luts_read is false).  The other rows pass in the arrays
+   of the strip and only the scene center values are computed.
+4. If processing a region of interest or a row shard, then the scene center
+   is still the center of the full scene, so the pressure, water vapor, and
+   ozone are the same as for a full-scene run.
 ******************************************************************************/
 int init_sr_refl
 (
@@ -52,6 +58,9 @@ int init_sr_refl
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    bool luts_read,     /* I: were the LUTs and auxiliary data already read
+                              (for a previous row of the strip)?  If so, only
+                              the scene center values are computed. */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
@@ -143,33 +152,39 @@ int init_sr_refl
     *xtsstep = 4.0;
     *xtvmin = 2.84090;
     *xtvstep = 6.52107 - *xtvmin;
-    retval = readluts (sat, tsmax, tsmin, ttv, tts, nbfic, nbfi, indts, rolutt,
-        transt, sphalbt, normext, *xtsstep, *xtsmin, anglehdf, intrefnm,
-        transmnm, spheranm);
-    if (retval != SUCCESS)
-    {
-        sprintf (errmsg, "Reading the LUTs");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
 
-    if (sat == SAT_LANDSAT_8)
-        printf ("The LUTs for urban clean case v2.0 have been read.  We can "
-            "now perform atmospheric correction.\n");
-    else if (sat == SAT_SENTINEL_2)
-        printf ("The LUTs for urban clean case v3.0 have been read.  We can "
-            "now perform atmospheric correction.\n");
-
-    /* Read the auxiliary data files used as input to the reflectance
-       calculations */
-    retval = read_auxiliary_files (cmgdemnm, rationm, auxnm, dem, andwi, sndwi,
-        ratiob1, ratiob2, ratiob7, intratiob1, intratiob2, intratiob7,
-        slpratiob1, slpratiob2, slpratiob7, wv, oz);
-    if (retval != SUCCESS)
+    /* Read the LUTs and the auxiliary data, unless they were already read
+       for the strip */
+    if (!luts_read)
     {
-        sprintf (errmsg, "Reading the auxiliary files");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        retval = readluts (sat, tsmax, tsmin, ttv, tts, nbfic, nbfi, indts,
+            rolutt, transt, sphalbt, normext, *xtsstep, *xtsmin, anglehdf,
+            intrefnm, transmnm, spheranm);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the LUTs");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (sat == SAT_LANDSAT_8)
+            printf ("The LUTs for urban clean case v2.0 have been read.  We "
+                "can now perform atmospheric correction.\n");
+        else if (sat == SAT_SENTINEL_2)
+            printf ("The LUTs for urban clean case v3.0 have been read.  We "
+                "can now perform atmospheric correction.\n");
+
+        /* Read the auxiliary data files used as input to the reflectance
+           calculations */
+        retval = read_auxiliary_files (cmgdemnm, rationm, auxnm, dem, andwi,
+            sndwi, ratiob1, ratiob2, ratiob7, intratiob1, intratiob2,
+            intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the auxiliary files");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
     }
 
     /* Getting parameters for atmospheric correction */
@@ -179,9 +194,18 @@ int init_sr_refl
     *uwv = 0.5;
 
     /* Use scene center (and center of the pixel) to compute atmospheric
-       parameters */
-    img.l = nlines * 0.5 + 0.5;
-    img.s = nsamps * 0.5 + 0.5;
+       parameters.  The geolocation is relative to the processing window
+       when processing an ROI. */
+    if (input->roi_set)
+    {
+        img.l = input->roi.full_nlines * 0.5 + 0.5 - input->roi.line0;
+        img.s = input->roi.full_nsamps * 0.5 + 0.5 - input->roi.samp0;
+    }
+    else
+    {
+        img.l = nlines * 0.5 + 0.5;
+        img.s = nsamps * 0.5 + 0.5;
+    }
     img.is_fill = false;
     if (!from_space (space, &img, &geo))
     {
@@ -16,6 +16,9 @@ NOTES:
 #include "time.h"
 #include "aero_interp.h"
 #include "poly_coeff.h"
+#include "checkpoint.h"
+#include "fast_math.h"
+#include "shard.h"
 
 /******************************************************************************
 MODULE:  read_s2_toa_refl
@@ -34,6 +37,8 @@ PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
+  1. If only a subset of the bands is processed (see set_input_bands), then
+     the other bands are not read and their toaband arrays are NULL.
 ******************************************************************************/
 int read_s2_toa_refl
 (
@@ -121,9 +126,12 @@ int read_s2_toa_refl
         return (ERROR);
     }
 
-    /* Loop through the Sentinel-2 bands */
+    /* Loop through the Sentinel-2 bands which are processed */
     for (ib = DN_S2_BAND1; ib <= DN_S2_BAND12; ib++)
     {
+        if (!input->proc_band[ib])
+            continue;
+
         switch (ib)
         {
             /* 10m bands read as-is (4) */
@@ -234,19 +242,47 @@ NOTES:
    clear (valid land pixel aerosols) and water (valid water pixel aerosols).
    Those final aerosol values are used for the surface reflectance corrections.
 5. Cloud-based QA information is not processed in this algorithm.
+6. If a checkpoint file is specified and it contains the aerosol inversion
+   results for the same inputs, then the LUT initialization, the atmospheric
+   coefficient retrieval, and the aerosol inversion are skipped and the saved
+   results are used.  Otherwise the aerosol inversion results are saved to the
+   checkpoint file once the inversion completes.  The checkpoint is removed
+   by the caller after the SR products are successfully written.
+7. The computations are done in memory; the SR bands are returned in sband
+   and the aerosol QA in ipflag.  write_s2_sr_refl writes them to the output
+   product.  Errors are returned to the caller rather than exiting, so this
+   routine can be called from liblasrc.
+8. If fast_math is specified, the aerosol inversion and the atmospheric
+   correction use the single-precision, approximate transcendental versions
+   of subaeroret and atmcorlamb2.  Every FAST_MATH_SAMPLE_STRIDE pixel is also
+   run through the reference routines with the same inputs, and the
+   distribution of the differences in the retrieved AOT (low eps retrieval)
+   and the surface reflectance is reported at the end.  The differences are
+   per-routine; the compounded effect of a fast-math AOT on the reflectance
+   is not included, as that would require a full reference inversion.
+9. If only a subset of the bands is processed (see set_input_bands), then
+   the climatology and aerosol corrections are skipped for the other bands
+   and their toaband and sband arrays are NULL.  The atmospheric
+   coefficients are still retrieved for all the bands, so the checkpoint is
+   complete.
+10. If aero_adapt_tol is positive, the aerosol inversion is adaptive, as for
+   L8 (see compute_l8_sr_refl).  S2 windows are only screened for fill
+   before the inversion, so a window off the coarse lattice is interpolated
+   whenever the surrounding lattice windows are clear and agree.
 ******************************************************************************/
 int compute_s2_sr_refl
 (
     Input_t *input,     /* I: input structure for the Landsat product */
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
-    char *xml_infile,   /* I: input XML filename */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
     uint16 **toaband,   /* I: input TOA reflectance bands, nlines x nsamps */
     int16 **sband,      /* O: output SR bands, nlines x nsamps */
+    uint8 *ipflag,      /* O: aerosol QA band, nlines x nsamps; array should
+                              be all zeros on input to this routine */
     float xts,          /* I: scene center solar zenith angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
     char *anglehdf,     /* I: angle HDF filename */
@@ -255,7 +291,14 @@ int compute_s2_sr_refl
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *ckpt_file,    /* I: aerosol checkpoint filename (NULL if not
+                              checkpointing) */
+    bool fast_math,     /* I: use the fast-math inversion and correction and
+                              report the differences from the reference */
+    float aero_adapt_tol/* I: AOT tolerance for interpolating the aerosol
+                              windows from the coarse lattice; 0.0 inverts
+                              every window */
 )
 {
     char errmsg[STR_SIZE];                     /* error message */
@@ -282,6 +325,10 @@ int compute_s2_sr_refl
     float next;
     float erelc[NSR_BANDS];   /* band ratio variable for refl bands */
     float troatm[NSR_BANDS];  /* atmospheric reflectance table for refl bands */
+    float btgo[NSR_BANDS];    /* other gaseous transmittance for refl bands */
+    float broatm[NSR_BANDS];  /* atmospheric reflectance for refl bands */
+    float bttatmg[NSR_BANDS]; /* ttatmg for refl bands */
+    float bsatm[NSR_BANDS];   /* atmosphere spherical albedo for refl bands */
 
     int iband1, iband3; /* band indices (zero-based) */
     float raot;         /* AOT reflectance */
@@ -312,10 +359,26 @@ int compute_s2_sr_refl
     float xcmg, ycmg;     /* x/y location for CMG */
     float xndwi;          /* calculated NDWI value */
     float median_aerosol; /* median aerosol value for clear pixels */
-    uint8 *ipflag = NULL; /* QA flag to assist with aerosol interpolation,
-                             nlines x nsamps */
     float *taero = NULL;  /* aerosol values for each pixel, nlines x nsamps */
     float *teps = NULL;   /* angstrom coeff for each pixel, nlines x nsamps */
+    bool aero_restored = false; /* were the aerosol inversion results restored
+                                   from the checkpoint file? */
+    uint64_t aero_hash = 0;     /* hash of the aerosol inversion inputs */
+    int mapping_error = false;  /* did the geolocation mapping fail for any
+                                   aerosol window? */
+    int pass;             /* current pass of the aerosol inversion */
+    int npasses;          /* number of passes of the aerosol inversion; the
+                             adaptive inversion does the coarse lattice in
+                             the first pass */
+    float adapt_aero;     /* aerosol interpolated from the coarse lattice */
+    float adapt_eps;      /* angstrom coeff interpolated from the lattice */
+    bool adapt_sample;    /* is this interpolated window also inverted for
+                             the adaptive accuracy report? */
+    long adapt_interp = 0;   /* number of windows interpolated from the
+                                coarse lattice */
+    long adapt_invert = 0;   /* number of non-fill windows off the lattice
+                                which were inverted */
+    Fast_math_stats_t adapt_stats;  /* adaptive AOT differences */
 
     /* Vars for forward/inverse mapping space */
     Geoloc_t *space = NULL;       /* structure for geolocation information */
@@ -357,6 +420,18 @@ int compute_s2_sr_refl
     float tts[22];         /* sun angle table */
     int32 indts[22];       /* index for sun angle table */
     int iaots;             /* index for AOTs */
+    int iaots_ref;         /* index for AOTs for the fast-math samples */
+    float raot_ref;        /* reference AOT for the fast-math samples */
+    float residual_ref;    /* reference residual for the fast-math samples */
+    float roslamb_ref;     /* reference surface reflectance for the fast-math
+                              samples */
+    Atmcorlamb2_func_t atmcorlamb2_func;  /* reference or fast-math
+                                             atmospheric correction */
+    Subaeroret_func_t subaeroret_func;    /* reference or fast-math aerosol
+                                             retrieval */
+    Fast_math_stats_t aot_stats;          /* fast-math AOT differences */
+    Fast_math_stats_t sr_stats[NSR_BANDS];/* fast-math SR differences */
+    char stats_name[STR_SIZE];            /* name for the SR differences */
 
     /* Atmospheric correction coefficient variables */
     float tgo_arr[NREFL_BANDS];     /* per-band other gaseous transmittance */
@@ -422,11 +497,6 @@ int compute_s2_sr_refl
 
     /* Output file info */
     time_t mytime;               /* timing variable */
-    Output_t *sr_output = NULL;  /* output structure and metadata for the SR
-                                    product */
-    Envi_header_t envi_hdr;      /* output ENVI header information */
-    char envi_file[STR_SIZE];    /* ENVI filename */
-    char *cptr = NULL;           /* pointer to the file extension */
 
     /* Table constants */
     float aot550nm[NAOT_VALS] =  /* AOT look-up table */
@@ -476,7 +546,7 @@ int compute_s2_sr_refl
 
     /* Allocate memory for the many arrays needed to do the surface reflectance
        computations */
-    retval = s2_memory_allocation_sr (nlines, nsamps, &ipflag, &taero, &teps,
+    retval = s2_memory_allocation_sr (nlines, nsamps, &taero, &teps,
         &dem, &andwi, &sndwi, &ratiob1, &ratiob2, &ratiob7, &intratiob1,
         &intratiob2, &intratiob7, &slpratiob1, &slpratiob2, &slpratiob7, &wv,
         &oz, &rolutt, &transt, &sphalbt, &normext, &tsmax, &tsmin, &nbfic,
@@ -489,6 +559,39 @@ int compute_s2_sr_refl
         return (ERROR);
     }
 
+    /* Select the reference or fast-math routines.  For fast-math, set up the
+       sampled differences for the accuracy report. */
+    if (fast_math)
+    {
+        atmcorlamb2_func = atmcorlamb2_fast;
+        subaeroret_func = subaeroret_fast;
+        if (init_fast_math_stats ("AOT", (long) nlines * nsamps, &aot_stats)
+            != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the fast-math samples");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (ib = 0; ib <= DN_S2_BAND12; ib++)
+        {
+            if (!input->proc_band[ib])
+                continue;
+            sprintf (stats_name, "SR band %d", ib+1);
+            if (init_fast_math_stats (stats_name, (long) nlines * nsamps,
+                &sr_stats[ib]) != SUCCESS)
+            {
+                sprintf (errmsg, "Allocating the fast-math samples");
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+    }
+    else
+    {
+        atmcorlamb2_func = atmcorlamb2_new;
+        subaeroret_func = subaeroret_new;
+    }
+
     /* Initialize the geolocation space applications */
     if (!get_geoloc_info (xml_metadata, &space_def))
     {
@@ -505,19 +608,50 @@ int compute_s2_sr_refl
         return (ERROR);
     }
 
+    /* If checkpointing, then hash the TOA reflectance and QA inputs and try to
+       restore the aerosol inversion results from a previous run.  The QA band
+       is hashed before the fill pixels are flagged below. */
+    if (ckpt_file != NULL && hash_aero_inputs (nlines, nsamps,
+        SR_S2_BAND12+1, (void **) toaband, sizeof (uint16), qaband, xts,
+        auxnm, intrefnm, transmnm, spheranm, cmgdemnm, rationm, fast_math,
+        aero_adapt_tol, &aero_hash) != SUCCESS)
+    {
+        sprintf (errmsg, "Unable to hash the aerosol inversion inputs.  "
+            "Processing will continue without the checkpoint.");
+        error_handler (false, FUNC_NAME, errmsg);
+        ckpt_file = NULL;
+    }
+    if (ckpt_file != NULL)
+    {
+        if (read_aero_checkpoint (ckpt_file, sat, nlines, nsamps,
+            S2_AERO_WINDOW, 0, true, aero_hash, btgo, broatm, bttatmg, bsatm,
+            tgo_arr, xrorayp_arr, normext_p0a3_arr, roatm_iaMax, roatm_coef,
+            ttatmg_coef, satm_coef, ipflag, taero, teps) == SUCCESS)
+        {
+            aero_restored = true;
+            printf ("Restored the aerosol inversion results from checkpoint "
+                "%s\n", ckpt_file);
+        }
+    }
+
     /* Initialize the look up tables and atmospheric correction variables.
        view zenith initialized to 0.0 (xtv)
        azimuthal difference between sun and obs angle initialize to 0.0 (xfi)
        surface pressure is initialized to the pressure at the center of the
            scene (using the DEM) (pres)
        water vapor is initialized to the value at the center of the scene (uwv)
-       ozone is initialized to the value at the center of the scene (uoz) */
-    retval = init_sr_refl (nlines, nsamps, input, space, anglehdf, intrefnm,
-        transmnm, spheranm, cmgdemnm, rationm, auxnm, &xtv, &xmuv, &xfi,
-        &cosxfi, &pres, &uoz, &uwv, &xtsstep, &xtsmin, &xtvstep, &xtvmin,
-        tsmax, tsmin, tts, ttv, indts, rolutt, transt, sphalbt, normext,
-        nbfic, nbfi, dem, andwi, sndwi, ratiob1, ratiob2, ratiob7, intratiob1,
-        intratiob2, intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
+       ozone is initialized to the value at the center of the scene (uoz)
+       These are only needed for the aerosol inversion and its coefficients,
+       so they aren't needed if the inversion was restored. */
+    retval = SUCCESS;
+    if (!aero_restored)
+        retval = init_sr_refl (nlines, nsamps, input, space, anglehdf,
+            intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm, false,
+            &xtv, &xmuv, &xfi, &cosxfi, &pres, &uoz, &uwv, &xtsstep, &xtsmin,
+            &xtvstep, &xtvmin, tsmax, tsmin, tts, ttv, indts, rolutt, transt,
+            sphalbt, normext, nbfic, nbfi, dem, andwi, sndwi, ratiob1, ratiob2,
+            ratiob7, intratiob1, intratiob2, intratiob7, slpratiob1,
+            slpratiob2, slpratiob7, wv, oz);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Error initializing the lookup tables and "
@@ -538,7 +672,15 @@ int compute_s2_sr_refl
         printf ("band %d ...", ib+1); fflush(stdout);
 
         /* Get the parameters for the atmospheric correction */
-        if (ib != SR_S2_BAND9)  /* skip the water vapor band */
+        if (aero_restored)
+        {
+            /* Use the band-related parameters from the checkpoint */
+            tgo = btgo[ib];
+            roatm = broatm[ib];
+            ttatmg = bttatmg[ib];
+            satm = bsatm[ib];
+        }
+        else if (ib != SR_S2_BAND9)  /* skip the water vapor band */
         {
             /* rotoa is not defined for this call, which is ok, but the
                roslamb value is not valid upon output. Just set it to 0.0 to
@@ -568,7 +710,16 @@ int compute_s2_sr_refl
             satm = 0.0;
         }
 
-        /* Perform atmospheric corrections for reflectance bands */
+        /* Save these band-related parameters for the checkpoint */
+        btgo[ib] = tgo;
+        broatm[ib] = roatm;
+        bttatmg[ib] = ttatmg;
+        bsatm[ib] = satm;
+
+        /* Perform atmospheric corrections for reflectance bands, unless the
+           band isn't processed */
+        if (!input->proc_band[ib])
+            continue;
 #ifdef _OPENMP
         #pragma omp parallel for private (i, j, curr_pix, roslamb)
 #endif
@@ -605,11 +756,16 @@ int compute_s2_sr_refl
     }  /* for ib */
     printf ("\n");
 
-    /* Start the retrieval of atmospheric correction parameters for each band */
+    /* Start the retrieval of atmospheric correction parameters for each band.
+       The retrieval and the aerosol inversion are skipped if the results were
+       restored from the checkpoint. */
     mytime = time(NULL);
-    printf ("Starting retrieval of atmospheric correction parameters ... %s",
-        ctime(&mytime)); fflush(stdout);
-    for (ib = 0; ib <= SR_S2_BAND12; ib++)
+    if (!aero_restored)
+    {
+        printf ("Starting retrieval of atmospheric correction parameters "
+            "... %s", ctime(&mytime)); fflush(stdout);
+    }
+    for (ib = 0; !aero_restored && ib <= SR_S2_BAND12; ib++)
     {
         /* Get the parameters for the atmospheric correction */
         /* rotoa is not defined for this call, which is ok, but the
@@ -634,7 +790,7 @@ int compute_s2_sr_refl
                 sprintf (errmsg, "Performing lambertian atmospheric correction "
                     "type 2 for band %d.", ib);
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                return (ERROR);
             }
 
             /* Store the AOT-related variables for use in the atmospheric
@@ -651,7 +807,7 @@ int compute_s2_sr_refl
         xrorayp_arr[ib] = xrorayp;
     }
 
-    for (ib = 0; ib <= SR_S2_BAND12; ib++)
+    for (ib = 0; !aero_restored && ib <= SR_S2_BAND12; ib++)
     {
         /* Get the polynomial coefficients for roatm */
         for (ia = 0; ia < NAOT_VALS; ia++)
@@ -701,19 +857,42 @@ int compute_s2_sr_refl
     xb = eps1 - eps3;
     xe = eps2 - eps3;
 
-    /* Start the aerosol inversion */
+    /* Start the aerosol inversion, unless the results were restored */
     mytime = time(NULL);
-    printf ("Aerosol Inversion using %d x %d aerosol window ... %s",
-        S2_AERO_WINDOW, S2_AERO_WINDOW, ctime(&mytime)); fflush(stdout);
+    if (!aero_restored)
+    {
+        printf ("Aerosol Inversion using %d x %d aerosol window ... %s",
+            S2_AERO_WINDOW, S2_AERO_WINDOW, ctime(&mytime)); fflush(stdout);
+    }
     tmp_percent = 0;
+
+    /* The adaptive inversion does the coarse lattice windows in the first
+       pass and the remaining windows in the second pass */
+    npasses = 1;
+    if (aero_adapt_tol > 0.0 && !aero_restored)
+    {
+        npasses = 2;
+        printf ("Adaptive aerosol inversion with a %d x %d window coarse "
+            "lattice and an AOT tolerance of %g\n", AERO_COARSE_STEP,
+            AERO_COARSE_STEP, aero_adapt_tol);
+        if (init_fast_math_stats ("Adaptive AOT", (long) nlines * nsamps,
+            &adapt_stats) != SUCCESS)
+        {
+            sprintf (errmsg, "Allocating the adaptive inversion samples");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    for (pass = 0; !aero_restored && pass < npasses; pass++)
 #ifdef _OPENMP
-    #pragma omp parallel for private (i, j, curr_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, lcmg1, u, v, one_minus_u, one_minus_v, one_minus_u_x_one_minus_v, one_minus_u_x_v, u_x_one_minus_v, u_x_v, ratio_pix11, ratio_pix12, ratio_pix21, ratio_pix22, rb1, rb2, slpr11, slpr12, slpr21, slpr22, intr11, intr12, intr21, intr22, slprb1, slprb2, slprb7, intrb1, intrb2, intrb7, xndwi, ndwi_th1, ndwi_th2, iline, isamp, curr_win_pix, pix_count, iband, iband1, iband3, iaots, retval, eps, residual, residual1, residual2, residual3, raot, xc, xf, coefa, coefb, epsmin, resepsmin, corf, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros4, ros5, erelc, troatm)
+    #pragma omp parallel for private (i, j, curr_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, lcmg1, u, v, one_minus_u, one_minus_v, one_minus_u_x_one_minus_v, one_minus_u_x_v, u_x_one_minus_v, u_x_v, ratio_pix11, ratio_pix12, ratio_pix21, ratio_pix22, rb1, rb2, slpr11, slpr12, slpr21, slpr22, intr11, intr12, intr21, intr22, slprb1, slprb2, slprb7, intrb1, intrb2, intrb7, xndwi, ndwi_th1, ndwi_th2, iline, isamp, curr_win_pix, pix_count, iband, iband1, iband3, iaots, retval, eps, residual, residual1, residual2, residual3, raot, xc, xf, coefa, coefb, epsmin, resepsmin, corf, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros4, ros5, erelc, troatm, iaots_ref, raot_ref, residual_ref, adapt_aero, adapt_eps, adapt_sample) reduction (+:adapt_interp, adapt_invert)
 #endif
     for (i = 0; i < nlines; i+=S2_AERO_WINDOW)
     {
 #ifndef _OPENMP
         /* update status, but not if multi-threaded */
-        curr_tmp_percent = 100 * i / nlines;
+        curr_tmp_percent = (100 * pass + 100 * i / nlines) / npasses;
         if (curr_tmp_percent > tmp_percent)
         {
             tmp_percent = curr_tmp_percent;
@@ -728,6 +907,12 @@ int compute_s2_sr_refl
         curr_pix = i * nsamps;
         for (j = 0; j < nsamps; j+=S2_AERO_WINDOW, curr_pix+=S2_AERO_WINDOW)
         {
+            /* For the adaptive inversion, only process the coarse lattice
+               windows in the first pass and the others in the second pass */
+            if (npasses > 1 &&
+                is_coarse_aero_window (i, j, S2_AERO_WINDOW, 0) != (pass == 0))
+                continue;
+
             /* If this pixel is fill */
             if (level1_qa_is_fill (qaband[curr_pix]))
             {
@@ -735,6 +920,41 @@ int compute_s2_sr_refl
                 continue;
             }
 
+            /* In the second pass of the adaptive inversion, interpolate the
+               aerosols from the coarse lattice if the lattice windows
+               around this one agree.  A sample of those windows is still
+               inverted to report the differences. */
+            adapt_sample = false;
+            if (pass == 1)
+            {
+                if (interp_coarse_aero (ipflag, taero, teps, nlines, nsamps,
+                    S2_AERO_WINDOW, 0, aero_adapt_tol, i, j, &adapt_aero,
+                    &adapt_eps))
+                {
+                    adapt_interp++;
+                    if (curr_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+                        adapt_sample = true;
+                    else
+                    {
+                        ipflag[curr_pix] = (1 << IPFLAG_CLEAR);
+                        for (iline = i; iline < i+S2_AERO_WINDOW &&
+                             iline < nlines; iline++)
+                        {
+                            curr_win_pix = iline * nsamps + j;
+                            for (isamp = j; isamp < j+S2_AERO_WINDOW &&
+                                 isamp < nsamps; isamp++, curr_win_pix++)
+                            {
+                                taero[curr_win_pix] = adapt_aero;
+                                teps[curr_win_pix] = adapt_eps;
+                            }
+                        }
+                        continue;
+                    }
+                }
+                else
+                    adapt_invert++;
+            }
+
             /* Get the lat/long for the current pixel (which may not be the
                center of the aerosol window), for the center of that pixel */
             img.l = i + 0.5;
@@ -745,7 +965,11 @@ int compute_s2_sr_refl
                 sprintf (errmsg, "Mapping line/sample (%d, %d) to "
                     "geolocation coords", i, j);
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                mapping_error = true;
+                continue;
             }
             lat = geo.lat * RAD2DEG;
             lon = geo.lon * RAD2DEG;
@@ -951,10 +1175,20 @@ int compute_s2_sr_refl
                      intr22 * u_x_v;
 
             /* Calculate NDWI variables for the band ratios */
-            xndwi = ((double) sband[SR_S2_BAND8A][curr_pix] -
-                     (double) (sband[SR_S2_BAND12][curr_pix] * 0.5)) /
-                    ((double) sband[SR_S2_BAND8A][curr_pix] +
-                     (double) (sband[SR_S2_BAND12][curr_pix] * 0.5));
+            if (fast_math)
+            {
+                xndwi = ((float) sband[SR_S2_BAND8A][curr_pix] -
+                         sband[SR_S2_BAND12][curr_pix] * 0.5f) /
+                        ((float) sband[SR_S2_BAND8A][curr_pix] +
+                         sband[SR_S2_BAND12][curr_pix] * 0.5f);
+            }
+            else
+            {
+                xndwi = ((double) sband[SR_S2_BAND8A][curr_pix] -
+                         (double) (sband[SR_S2_BAND12][curr_pix] * 0.5)) /
+                        ((double) sband[SR_S2_BAND8A][curr_pix] +
+                         (double) (sband[SR_S2_BAND12][curr_pix] * 0.5));
+            }
 
             if (xndwi > ndwi_th1)
                 xndwi = ndwi_th1;
@@ -1006,16 +1240,29 @@ int compute_s2_sr_refl
             iband3 = DN_S2_BAND1;  /* coastal aerosol */
             eps = LOW_EPS;
             iaots = 0;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
             /* Save the data */
             residual1 = residual;
 
+            /* Compare the low eps retrieval against the reference for the
+               fast-math accuracy report */
+            if (fast_math && curr_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+            {
+                iaots_ref = 0;
+                subaeroret_new (input->meta.sat, iband1, iband3, erelc,
+                    troatm, tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef,
+                    ttatmg_coef, satm_coef, normext_p0a3_arr, &raot_ref,
+                    &residual_ref, &iaots_ref, LOW_EPS);
+                aot_stats.diff[curr_pix / FAST_MATH_SAMPLE_STRIDE] =
+                    raot - raot_ref;
+            }
+
             /* Retrieve the aerosol information for moderate eps 1.75 */
             eps = MOD_EPS;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
@@ -1024,7 +1271,7 @@ int compute_s2_sr_refl
 
             /* Retrieve the aerosol information for high eps 2.5 */
             eps = HIGH_EPS;
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
 
@@ -1059,7 +1306,7 @@ int compute_s2_sr_refl
             }
             eps = epsmin;
 
-            subaeroret_new (input->meta.sat, iband1, iband3, erelc, troatm,
+            subaeroret_func (input->meta.sat, iband1, iband3, erelc, troatm,
                 tgo_arr, xrorayp_arr, roatm_iaMax, roatm_coef, ttatmg_coef,
                 satm_coef, normext_p0a3_arr, &raot, &residual, &iaots, eps);
             corf = raot / xmus;
@@ -1087,7 +1334,7 @@ int compute_s2_sr_refl
                 rotoa /= pix_count;
 
                 raot550nm = raot;
-                atmcorlamb2_new (input->meta.sat, tgo_arr[iband],
+                atmcorlamb2_func (input->meta.sat, tgo_arr[iband],
                     xrorayp_arr[iband], aot550nm[roatm_iaMax[iband]],
                     &roatm_coef[iband][0], &ttatmg_coef[iband][0],
                     &satm_coef[iband][0], raot550nm, iband,
@@ -1113,7 +1360,7 @@ int compute_s2_sr_refl
                 rotoa /= pix_count;
 
                 raot550nm = raot;
-                atmcorlamb2_new (input->meta.sat, tgo_arr[iband],
+                atmcorlamb2_func (input->meta.sat, tgo_arr[iband],
                     xrorayp_arr[iband], aot550nm[roatm_iaMax[iband]],
                     &roatm_coef[iband][0], &ttatmg_coef[iband][0],
                     &satm_coef[iband][0], raot550nm, iband,
@@ -1149,6 +1396,12 @@ int compute_s2_sr_refl
                 ipflag[curr_pix] = (1 << IPFLAG_FAILED);
             }
 
+            /* Compare the interpolated aerosols against the inversion for
+               the adaptive accuracy report */
+            if (adapt_sample)
+                adapt_stats.diff[curr_pix / FAST_MATH_SAMPLE_STRIDE] =
+                    adapt_aero - taero[curr_pix];
+
             /* Fill in the remaining taero and teps values for the window,
                using the current pixel */
             for (iline = i; iline < i+S2_AERO_WINDOW; iline++)
@@ -1169,10 +1422,52 @@ int compute_s2_sr_refl
 
 #ifndef _OPENMP
     /* update status */
-    printf ("100%%\n");
-    fflush (stdout);
+    if (!aero_restored)
+    {
+        printf ("100%%\n");
+        fflush (stdout);
+    }
 #endif
 
+    /* Report the windows which were interpolated from the coarse lattice
+       and the differences from the full inversion */
+    if (npasses > 1)
+    {
+        printf ("Adaptive aerosol inversion interpolated %ld of %ld "
+            "non-fill windows off the coarse lattice (%.1f%%)\n",
+            adapt_interp, adapt_interp + adapt_invert,
+            (adapt_interp + adapt_invert > 0) ?
+            100.0 * adapt_interp / (adapt_interp + adapt_invert) : 0.0);
+        report_fast_math_stats (&adapt_stats);
+        free_fast_math_stats (&adapt_stats);
+    }
+
+    /* Errors can't be returned from within the threaded inversion loop, so
+       check for them now that the loop is complete */
+    if (mapping_error)
+    {
+        sprintf (errmsg, "Error mapping the aerosol windows to geolocation "
+            "coordinates");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Save the aerosol inversion results so a failure in the remaining
+       processing doesn't require the inversion to be rerun.  Not being able
+       to write the checkpoint isn't fatal to the processing. */
+    if (ckpt_file != NULL && !aero_restored)
+    {
+        if (write_aero_checkpoint (ckpt_file, sat, nlines, nsamps,
+            S2_AERO_WINDOW, 0, aero_hash, btgo, broatm, bttatmg, bsatm,
+            tgo_arr, xrorayp_arr, normext_p0a3_arr, roatm_iaMax, roatm_coef,
+            ttatmg_coef, satm_coef, ipflag, taero, teps) != SUCCESS)
+        {
+            sprintf (errmsg, "Unable to write the aerosol checkpoint.  "
+                "Processing will continue.");
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
     /* Done with the ratiob* arrays */
     free (andwi);  andwi = NULL;
     free (sndwi);  sndwi = NULL;
@@ -1207,8 +1502,13 @@ int compute_s2_sr_refl
     mytime = time(NULL);
     printf ("Computing median of clear pixels in NxN windows %s",
         ctime(&mytime)); fflush(stdout);
-    median_aerosol = find_median_aerosol_s2 (ipflag, taero, S2_AERO_WINDOW,
-        nlines, nsamps);
+    if (input->roi_set && input->roi.nshards > 0)
+        median_aerosol = find_shard_median_aerosol (input,
+            xml_metadata->global.product_id, auxnm, intrefnm, fast_math,
+            ipflag, taero, S2_AERO_WINDOW, 0, nlines, nsamps);
+    else
+        median_aerosol = find_median_aerosol_s2 (ipflag, taero,
+            S2_AERO_WINDOW, nlines, nsamps);
     if (median_aerosol == 0.0)
     {   /* error message already printed */
         error_handler (true, FUNC_NAME, errmsg);
@@ -1272,11 +1572,13 @@ int compute_s2_sr_refl
     /* Loop through all the bands */
     for (ib = 0; ib <= DN_S2_BAND12; ib++)
     {
+        if (!input->proc_band[ib])
+            continue;
         printf ("  Band %d\n", ib+1); fflush(stdout);
         if (ib != DN_S2_BAND10)
         {
 #ifdef _OPENMP
-        #pragma omp parallel for private (i, j, curr_pix, rsurf, rotoa, raot550nm, eps, retval, tmpf, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next)
+        #pragma omp parallel for private (i, j, curr_pix, rsurf, rotoa, raot550nm, eps, retval, tmpf, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next, roslamb_ref)
 #endif
             for (i = 0; i < nlines; i++)
             {
@@ -1291,11 +1593,24 @@ int compute_s2_sr_refl
                     rotoa = toaband[ib][curr_pix] * SCALE_FACTOR;
                     raot550nm = taero[curr_pix];
                     eps = teps[curr_pix];
-                    atmcorlamb2_new (input->meta.sat, tgo_arr[ib],
+                    atmcorlamb2_func (input->meta.sat, tgo_arr[ib],
                         xrorayp_arr[ib], aot550nm[roatm_iaMax[ib]],
                         &roatm_coef[ib][0], &ttatmg_coef[ib][0],
                         &satm_coef[ib][0], raot550nm, ib, normext_p0a3_arr[ib],
                         rotoa, &roslamb, eps);
+
+                    /* Compare against the reference correction for the
+                       fast-math accuracy report */
+                    if (fast_math && curr_pix % FAST_MATH_SAMPLE_STRIDE == 0)
+                    {
+                        atmcorlamb2_new (input->meta.sat, tgo_arr[ib],
+                            xrorayp_arr[ib], aot550nm[roatm_iaMax[ib]],
+                            &roatm_coef[ib][0], &ttatmg_coef[ib][0],
+                            &satm_coef[ib][0], raot550nm, ib,
+                            normext_p0a3_arr[ib], rotoa, &roslamb_ref, eps);
+                        sr_stats[ib].diff[curr_pix / FAST_MATH_SAMPLE_STRIDE]
+                            = roslamb - roslamb_ref;
+                    }
     
                     /* If this is the coastal aerosol band then set the aerosol
                        bits in the QA band */
@@ -1347,10 +1662,90 @@ int compute_s2_sr_refl
         }
     }  /* end for ib */
 
+    /* Report the fast-math differences from the reference */
+    if (fast_math)
+    {
+        printf ("Fast-math differences from the reference (every %d pixels):\n",
+            FAST_MATH_SAMPLE_STRIDE);
+        report_fast_math_stats (&aot_stats);
+        free_fast_math_stats (&aot_stats);
+        for (ib = 0; ib <= DN_S2_BAND12; ib++)
+        {
+            if (!input->proc_band[ib])
+                continue;
+            if (ib != DN_S2_BAND10)
+                report_fast_math_stats (&sr_stats[ib]);
+            free_fast_math_stats (&sr_stats[ib]);
+        }
+    }
+
     /* Free memory for arrays no longer needed */
     free (taero);
     free (teps);
- 
+
+    /* Free the spatial mapping pointer */
+    free (space);
+
+    /* Free the data arrays */
+    free (rolutt);
+    free (transt);
+    free (sphalbt);
+    free (normext);
+    free (tsmax);
+    free (tsmin);
+    free (nbfic);
+    free (nbfi);
+    free (ttv);
+
+    /* Successful completion */
+    mytime = time(NULL);
+    printf ("Surface reflectance correction complete ... %s\n", ctime(&mytime));
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_s2_sr_refl
+
+PURPOSE:  Writes the Sentinel-2 surface reflectance bands and the aerosol QA band to
+the SR output product, and appends the bands to the XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing the surface reflectance product
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only the bands in the output subset are written and appended to the XML
+     file (see set_input_bands).  The aerosol QA band is always written.
+******************************************************************************/
+int write_s2_sr_refl
+(
+    Input_t *input,     /* I: input structure for the Sentinel-2 product */
+    Espa_internal_meta_t *xml_metadata,
+                        /* I/O: XML metadata structure */
+    char *xml_infile,   /* I: input XML filename */
+    int nlines,         /* I: number of lines in reflectance bands */
+    int16 **sband,      /* I: surface reflectance bands, nlines x nsamps */
+    uint8 *ipflag       /* I: aerosol QA band, nlines x nsamps */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "write_s2_sr_refl";   /* function name */
+    Sat_t sat = input->meta.sat;             /* satellite */
+    int ib;                      /* looping variable for bands */
+    time_t mytime;               /* timing variable */
+    Output_t *sr_output = NULL;  /* output structure and metadata for the SR
+                                    product */
+    Envi_header_t envi_hdr;      /* output ENVI header information */
+    char envi_file[STR_SIZE];    /* ENVI filename */
+    char *cptr = NULL;           /* pointer to the file extension */
+
     /* Write the data to the output file */
     mytime = time(NULL);
     printf ("Writing surface reflectance corrected data to the output "
@@ -1359,7 +1754,8 @@ int compute_s2_sr_refl
     /* Open the output file */
     sr_output = open_output (xml_metadata, input, OUTPUT_SR);
     if (sr_output == NULL)
-    {   /* error message already printed */
+    {
+        sprintf (errmsg, "Opening the surface reflectance output product");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
@@ -1367,6 +1763,8 @@ int compute_s2_sr_refl
     /* Loop through the reflectance bands and write the data */
     for (ib = 0; ib <= DN_S2_BAND12; ib++)
     {
+        if (!is_output_band (input, OUTPUT_SR, ib))
+            continue;
         printf ("  Band %d: %s\n", ib+1,
             sr_output->metadata.band[ib].file_name);
         if (put_output_lines (sr_output, sband[ib], ib, 0, nlines,
@@ -1399,8 +1797,8 @@ int compute_s2_sr_refl
     }
 
     /* Append the surface reflectance bands to the XML file */
-    if (append_metadata (NREFL_S2_BANDS, sr_output->metadata.band, xml_infile)
-        != SUCCESS)
+    if (append_output_bands (sr_output, input, OUTPUT_SR, SR_S2_BAND1,
+        SR_S2_BAND12, xml_infile) != SUCCESS)
     {
         sprintf (errmsg, "Appending surface reflectance bands to the "
             "XML file.");
@@ -1419,9 +1817,6 @@ int compute_s2_sr_refl
         return (ERROR);
     }
 
-    /* Free memory for ipflag data */
-    free (ipflag);
-
     /* Create the ENVI header for the aerosol QA band */
     if (create_envi_struct (&sr_output->metadata.band[SR_S2_AEROSOL],
         &xml_metadata->global, &envi_hdr) != SUCCESS)
@@ -1455,23 +1850,5 @@ int compute_s2_sr_refl
     close_output (sat, sr_output, OUTPUT_SR);
     free_output (sr_output, OUTPUT_SR);
 
-    /* Free the spatial mapping pointer */
-    free (space);
-
-    /* Free the data arrays */
-    free (rolutt);
-    free (transt);
-    free (sphalbt);
-    free (normext);
-    free (tsmax);
-    free (tsmin);
-    free (nbfic);
-    free (nbfi);
-    free (ttv);
-
-    /* Successful completion */
-    mytime = time(NULL);
-    printf ("Surface reflectance correction complete ... %s\n", ctime(&mytime));
     return (SUCCESS);
 }
-
@@ -0,0 +1,388 @@
+/*****************************************************************************
+FILE: estimate.c
+
+PURPOSE: Contains functions for estimating the peak memory, wall time, and
+I/O volume of a lasrc run without running it, so jobs can be packed by the
+cluster scheduler.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. Only the XML file, the QA band, and the sizes of the LUT and auxiliary
+   files are read.  The memory is computed from the arrays lasrc allocates
+   for the scene, and the wall time from the number of valid band-pixels
+   and clear aerosol windows, which is where the per-scene cost differences
+   come from.
+2. The S2 QA band is generated from the TOA bands, so it isn't available
+   without reading them.  The S2 estimate treats every pixel as valid and
+   clear, which makes it an upper bound.
+3. The features and estimates are also written on a single COST_ESTIMATE
+   line, which calibrate_lasrc_cost.py reads back along with the measured
+   wall time and peak RSS of the run to fit the model coefficients.
+*****************************************************************************/
+#include <sys/stat.h>
+#include "estimate.h"
+
+/* Thread counts for which the wall time is estimated */
+static int cost_nthreads[COST_NTHREADS] = {1, 2, 4, 8, 16, 32};
+
+/* Bytes per MB */
+#define BYTES_PER_MB (1024.0 * 1024.0)
+
+/* Maximum length of a coefficient name in the cost model file */
+#define COST_NAME_LEN 64
+
+/******************************************************************************
+MODULE:  init_cost_model
+
+PURPOSE:  Initializes the cost model with the default coefficients.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void init_cost_model
+(
+    Cost_model_t *model     /* O: cost model with the default coefficients */
+)
+{
+    model->rss_scale = 1.0;
+    model->rss_offset_mb = 50.0;
+    model->serial_sec = 20.0;
+    model->serial_sec_per_mpix = 0.6;
+    model->band_sec_per_mpix = 0.15;
+    model->window_sec_per_mwin = 400.0;
+}
+
+
+/******************************************************************************
+MODULE:  read_cost_model
+
+PURPOSE:  Reads the coefficients of the cost model from a file of
+"name value" lines.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error opening or parsing the cost model file
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Blank lines and lines starting with # are skipped.
+******************************************************************************/
+int read_cost_model
+(
+    char *model_file,       /* I: cost model file written by
+                                  calibrate_lasrc_cost.py */
+    Cost_model_t *model     /* I/O: cost model; coefficients which aren't in
+                                  the file keep their values */
+)
+{
+    char FUNC_NAME[] = "read_cost_model";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char line[STR_SIZE];     /* current line of the file */
+    char name[COST_NAME_LEN];/* name of the current coefficient */
+    int nline = 0;           /* current line number of the file */
+    double value;            /* value of the current coefficient */
+    FILE *fptr = NULL;       /* cost model file pointer */
+
+    fptr = fopen (model_file, "r");
+    if (fptr == NULL)
+    {
+        sprintf (errmsg, "Opening the cost model file: %s", model_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    while (fgets (line, sizeof (line), fptr) != NULL)
+    {
+        nline++;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf (line, "%63s %lf", name, &value) != 2)
+        {
+            sprintf (errmsg, "Invalid line %d in the cost model file: %s",
+                nline, model_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fptr);
+            return (ERROR);
+        }
+
+        if (!strcmp (name, "rss_scale"))
+            model->rss_scale = value;
+        else if (!strcmp (name, "rss_offset_mb"))
+            model->rss_offset_mb = value;
+        else if (!strcmp (name, "serial_sec"))
+            model->serial_sec = value;
+        else if (!strcmp (name, "serial_sec_per_mpix"))
+            model->serial_sec_per_mpix = value;
+        else if (!strcmp (name, "band_sec_per_mpix"))
+            model->band_sec_per_mpix = value;
+        else if (!strcmp (name, "window_sec_per_mwin"))
+            model->window_sec_per_mwin = value;
+        else
+        {
+            sprintf (errmsg, "Unknown coefficient in the cost model file: "
+                "%s", name);
+            error_handler (false, FUNC_NAME, errmsg);
+        }
+    }
+
+    fclose (fptr);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  file_mb
+
+PURPOSE:  Returns the size of a file in MB, or 0 if it doesn't exist.
+
+RETURN VALUE:
+Type = double
+Value           Description
+-----           -----------
+>= 0.0          Size of the file (MB)
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static double file_mb
+(
+    char *filename          /* I: name of the file */
+)
+{
+    struct stat statbuf;    /* file status */
+
+    if (filename[0] == '\0' || stat (filename, &statbuf) != 0)
+        return (0.0);
+    return (statbuf.st_size / BYTES_PER_MB);
+}
+
+
+/******************************************************************************
+MODULE:  get_cost_features
+
+PURPOSE:  Computes the features of the scene which drive the cost model, from
+the input metadata and the QA band.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the QA band
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. lasrc_set_lut_files must be called before this routine if process_sr is
+     set, so the LUT and auxiliary file sizes can be included in the reads.
+  2. The allocations mirror memory_allocation_main and the L8/S2
+     memory_allocation_sr routines, including the DEM array, which is
+     allocated with the size of a pointer per element.
+******************************************************************************/
+int get_cost_features
+(
+    Lasrc_ctx_t *ctx,       /* I: context for the current scene */
+    bool process_sr,        /* I: will the SR products be processed? */
+    bool write_toa,         /* I: will the TOA products be written? */
+    Cost_features_t *features  /* O: features of the scene */
+)
+{
+    char FUNC_NAME[] = "get_cost_features";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Input_t *input = ctx->input;  /* input structure */
+    int ib;                  /* looping variable for bands */
+    int nband_ttl;           /* total number of output bands */
+    int nsr_bands;           /* number of SR bands in the LUTs */
+    int aero_window;         /* size of the aerosol window */
+    long pix;                /* looping variable for pixels */
+    double pix_bytes;        /* bytes allocated per pixel */
+    double fixed_bytes;      /* bytes allocated for the LUTs and aux data */
+    uint16 *qaband = NULL;   /* QA band, nlines x nsamps */
+
+    memset (features, 0, sizeof (Cost_features_t));
+    features->npix = (long) ctx->nlines * ctx->nsamps;
+
+    nband_ttl = (ctx->sat == SAT_LANDSAT_8) ? NBAND_L8_TTL_OUT :
+        NBAND_S2_TTL_OUT;
+    for (ib = 0; ib < nband_ttl-1; ib++)
+    {
+        if (input->proc_band[ib])
+            features->nbands++;
+    }
+
+    /* Count the valid and clear pixels from the L8 QA band */
+    if (ctx->sat == SAT_LANDSAT_8)
+    {
+        qaband = malloc (features->npix * sizeof (uint16));
+        if (qaband == NULL)
+        {
+            sprintf (errmsg, "Allocating memory for the QA band");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        if (get_input_qa_lines (input, 0, 0, ctx->nlines, qaband) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the QA band");
+            error_handler (true, FUNC_NAME, errmsg);
+            free (qaband);
+            return (ERROR);
+        }
+
+        for (pix = 0; pix < features->npix; pix++)
+        {
+            if (level1_qa_is_fill (qaband[pix]))
+                continue;
+            features->nvalid++;
+            if (!is_cloud_or_shadow (qaband[pix]))
+                features->nclear++;
+        }
+        free (qaband);
+    }
+    else
+    {
+        features->nvalid = features->npix;
+        features->nclear = features->npix;
+    }
+
+    aero_window = (ctx->sat == SAT_LANDSAT_8) ? L8_AERO_WINDOW :
+        S2_AERO_WINDOW;
+    if (process_sr)
+        features->nclear_windows = (double) features->nclear /
+            (aero_window * aero_window);
+
+    /* Memory: qaband and ipflag, the band arrays, the L8 sza and radsat, and
+       for the SR the aerosol arrays plus the LUTs and aux data */
+    pix_bytes = sizeof (uint16) + sizeof (uint8);
+    if (ctx->sat == SAT_LANDSAT_8)
+        pix_bytes += 2 * sizeof (int16) + features->nbands * sizeof (int16);
+    else
+        pix_bytes += features->nbands * (sizeof (uint16) + sizeof (int16));
+
+    fixed_bytes = 0.0;
+    if (process_sr)
+    {
+        pix_bytes += 2 * sizeof (float);
+        if (ctx->sat == SAT_LANDSAT_8)
+            pix_bytes += 5 * sizeof (int16);   /* aerob1-aerob7 */
+
+        nsr_bands = (ctx->sat == SAT_LANDSAT_8) ? NSR_L8_BANDS :
+            NSR_S2_BANDS;
+        fixed_bytes = (double) DEM_NBLAT * DEM_NBLON * sizeof (int16 *) +
+            11.0 * RATIO_NBLAT * RATIO_NBLON * sizeof (int16) +
+            (double) CMG_NBLAT * CMG_NBLON * (sizeof (int16) + sizeof (uint8))
+            + (double) nsr_bands * NPRES_VALS * NAOT_VALS *
+            (NSOLAR_VALS + NSUNANGLE_VALS + 2) * sizeof (float) +
+            5.0 * NVIEW_ZEN_VALS * NSOLAR_ZEN_VALS * sizeof (float);
+    }
+    features->alloc_mb = (pix_bytes * features->npix + fixed_bytes) /
+        BYTES_PER_MB;
+
+    /* Reads: the processed bands, the QA band, and the L8 solar zenith band
+       at 16 bits per pixel, plus the LUT and aux files for the SR */
+    features->read_mb = (features->nbands + 1 +
+        (ctx->sat == SAT_LANDSAT_8 ? 1 : 0)) * features->npix *
+        sizeof (uint16) / BYTES_PER_MB;
+    if (process_sr)
+    {
+        features->read_mb += file_mb (ctx->anglehdf) +
+            file_mb (ctx->intrefnm) + file_mb (ctx->transmnm) +
+            file_mb (ctx->spheranm) + file_mb (ctx->cmgdemnm) +
+            file_mb (ctx->rationm) + file_mb (ctx->auxnm);
+    }
+
+    /* Writes: the processed bands, the aerosol QA, and the L8 radsat band.
+       The L8 TOA bands 1-7 are also written if requested. */
+    features->write_mb = (features->nbands * sizeof (int16) +
+        sizeof (uint8)) * features->npix / BYTES_PER_MB;
+    if (ctx->sat == SAT_LANDSAT_8)
+    {
+        features->write_mb += features->npix * sizeof (uint16) /
+            BYTES_PER_MB;
+        if (write_toa && process_sr)
+            features->write_mb += (SR_L8_BAND7 + 1) * features->npix *
+                sizeof (int16) / BYTES_PER_MB;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_cost_estimate
+
+PURPOSE:  Prints the estimated peak RSS, wall time, and I/O volume of the
+scene.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The COST_ESTIMATE line is parsed by calibrate_lasrc_cost.py, so its
+     fields need to stay in sync with that script.
+******************************************************************************/
+void report_cost_estimate
+(
+    char *xml_infile,       /* I: XML filename of the scene */
+    Cost_model_t *model,    /* I: cost model */
+    Cost_features_t *features  /* I: features of the scene */
+)
+{
+    int it;                  /* looping variable for thread counts */
+    double mpix;             /* millions of pixels */
+    double mvalid_band_pix;  /* millions of valid band-pixels */
+    double mwin;             /* millions of clear aerosol windows */
+    double serial_sec;       /* serial wall time (s) */
+    double parallel_sec;     /* threaded wall time for one thread (s) */
+    double rss_mb;           /* estimated peak RSS (MB) */
+
+    mpix = features->npix / 1.0e6;
+    mvalid_band_pix = features->nvalid * (double) features->nbands / 1.0e6;
+    mwin = features->nclear_windows / 1.0e6;
+    serial_sec = model->serial_sec + model->serial_sec_per_mpix * mpix;
+    parallel_sec = model->band_sec_per_mpix * mvalid_band_pix +
+        model->window_sec_per_mwin * mwin;
+    rss_mb = model->rss_scale * features->alloc_mb + model->rss_offset_mb;
+
+    printf ("Cost estimate for %s:\n", xml_infile);
+    printf ("  Pixels: %ld (%.1f%% valid, %.1f%% clear), %d bands\n",
+        features->npix, (features->npix > 0) ?
+        100.0 * features->nvalid / features->npix : 0.0,
+        (features->npix > 0) ? 100.0 * features->nclear / features->npix :
+        0.0, features->nbands);
+    printf ("  Peak RSS: %.0f MB\n", rss_mb);
+    printf ("  I/O: %.0f MB read, %.0f MB written\n", features->read_mb,
+        features->write_mb);
+    printf ("  Wall time:");
+    for (it = 0; it < COST_NTHREADS; it++)
+        printf (" %d thread%s %.0f s%s", cost_nthreads[it],
+            (cost_nthreads[it] == 1) ? "" : "s",
+            serial_sec + parallel_sec / cost_nthreads[it],
+            (it < COST_NTHREADS-1) ? "," : "\n");
+
+    printf ("COST_ESTIMATE npix=%ld nvalid=%ld nclear=%ld nbands=%d "
+        "nclear_windows=%.0f alloc_mb=%.1f read_mb=%.1f write_mb=%.1f "
+        "rss_mb=%.1f serial_sec=%.1f parallel_sec=%.1f\n", features->npix,
+        features->nvalid, features->nclear, features->nbands,
+        features->nclear_windows, features->alloc_mb, features->read_mb,
+        features->write_mb, rss_mb, serial_sec, parallel_sec);
+}
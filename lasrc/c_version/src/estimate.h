@@ -0,0 +1,73 @@
+#ifndef _ESTIMATE_H_
+#define _ESTIMATE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "lasrc_lib.h"
+
+/* Number of thread counts for which the wall time is estimated */
+#define COST_NTHREADS 6
+
+/* Coefficients of the cost model.  The peak RSS is scaled from the bytes
+   lasrc allocates for the scene, and the wall time for T threads is
+       serial_sec + serial_sec_per_mpix * Mpix
+           + (band_sec_per_mpix * Mvalid_band_pix
+              + window_sec_per_mwin * Mclear_windows) / T
+   The defaults are rough values for a current Xeon; calibrate_lasrc_cost.py
+   fits them to the runs on the actual hardware. */
+typedef struct {
+    double rss_scale;           /* scale applied to the allocated bytes */
+    double rss_offset_mb;       /* RSS beyond the allocations (MB) */
+    double serial_sec;          /* fixed serial time (s) */
+    double serial_sec_per_mpix; /* serial time (reads, writes, TOA) per
+                                   million pixels (s) */
+    double band_sec_per_mpix;   /* threaded correction time per million
+                                   valid band-pixels (s) */
+    double window_sec_per_mwin; /* threaded inversion time per million clear
+                                   aerosol windows (s) */
+} Cost_model_t;
+
+/* Features of a scene which drive the cost model */
+typedef struct {
+    long npix;              /* number of pixels in the processed window */
+    long nvalid;            /* number of non-fill pixels */
+    long nclear;            /* number of non-fill, non-cloud/shadow pixels */
+    int nbands;             /* number of bands processed */
+    double nclear_windows;  /* number of clear aerosol windows */
+    double alloc_mb;        /* memory allocated by lasrc (MB) */
+    double read_mb;         /* input bands and aux files read (MB) */
+    double write_mb;        /* output bands written (MB) */
+} Cost_features_t;
+
+/* Prototypes */
+void init_cost_model
+(
+    Cost_model_t *model     /* O: cost model with the default coefficients */
+);
+
+int read_cost_model
+(
+    char *model_file,       /* I: cost model file written by
+                                  calibrate_lasrc_cost.py */
+    Cost_model_t *model     /* I/O: cost model; coefficients which aren't in
+                                  the file keep their values */
+);
+
+int get_cost_features
+(
+    Lasrc_ctx_t *ctx,       /* I: context for the current scene */
+    bool process_sr,        /* I: will the SR products be processed? */
+    bool write_toa,         /* I: will the TOA products be written? */
+    Cost_features_t *features  /* O: features of the scene */
+);
+
+void report_cost_estimate
+(
+    char *xml_infile,       /* I: XML filename of the scene */
+    Cost_model_t *model,    /* I: cost model */
+    Cost_features_t *features  /* I: features of the scene */
+);
+
+#endif
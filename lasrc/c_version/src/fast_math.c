@@ -0,0 +1,177 @@
+/*****************************************************************************
+FILE: fast_math.c
+
+PURPOSE: Contains functions for collecting and reporting the differences
+between the fast-math and reference surface reflectance paths.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The fast-math path runs the aerosol inversion and atmospheric correction
+   in single precision with approximate transcendental functions.  Every
+   FAST_MATH_SAMPLE_STRIDE pixel is also run through the reference path, and
+   the distribution of the differences is reported at the end of the
+   processing so the error can be checked against the error budget.
+*****************************************************************************/
+#include "fast_math.h"
+
+/******************************************************************************
+MODULE:  compare_floats
+
+PURPOSE:  Comparison function for sorting the sampled differences with
+qsort.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              a < b
+0               a == b
+1               a > b
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int compare_floats
+(
+    const void *a,   /* I: first value */
+    const void *b    /* I: second value */
+)
+{
+    float fa = *(const float *) a;
+    float fb = *(const float *) b;
+
+    if (fa < fb)
+        return (-1);
+    else if (fa > fb)
+        return (1);
+    else
+        return (0);
+}
+
+
+/******************************************************************************
+MODULE:  init_fast_math_stats
+
+PURPOSE:  Allocates the sampled differences for a quantity and marks them as
+not processed.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating memory
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Sample k corresponds to pixel k * FAST_MATH_SAMPLE_STRIDE.  Each sample
+     is written by a single thread, so no locking is needed.
+******************************************************************************/
+int init_fast_math_stats
+(
+    char *name,                /* I: name of the quantity being compared */
+    long npix,                 /* I: number of pixels being sampled */
+    Fast_math_stats_t *stats   /* O: initialized statistics */
+)
+{
+    char FUNC_NAME[] = "init_fast_math_stats";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    long i;                  /* looping variable for the samples */
+
+    snprintf (stats->name, sizeof (stats->name), "%s", name);
+    stats->nsamples = npix / FAST_MATH_SAMPLE_STRIDE + 1;
+    stats->diff = malloc (stats->nsamples * sizeof (float));
+    if (stats->diff == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the %s samples", name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (i = 0; i < stats->nsamples; i++)
+        stats->diff[i] = NAN;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  report_fast_math_stats
+
+PURPOSE:  Prints the distribution of the absolute differences between the
+fast-math and reference results for the sampled pixels.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The processed samples are compacted to the front of the diff array and
+     sorted, so the statistics can only be reported once.
+******************************************************************************/
+void report_fast_math_stats
+(
+    Fast_math_stats_t *stats   /* I: statistics to be reported */
+)
+{
+    long i;                  /* looping variable for the samples */
+    long count = 0;          /* number of processed samples */
+    double bias = 0.0;       /* mean signed difference */
+    double sumsq = 0.0;      /* sum of the squared differences */
+
+    for (i = 0; i < stats->nsamples; i++)
+    {
+        if (isnan (stats->diff[i]))
+            continue;
+        bias += stats->diff[i];
+        sumsq += (double) stats->diff[i] * stats->diff[i];
+        stats->diff[count++] = fabsf (stats->diff[i]);
+    }
+
+    if (count == 0)
+    {
+        printf ("  %-12s no samples\n", stats->name);
+        return;
+    }
+
+    qsort (stats->diff, count, sizeof (float), compare_floats);
+    printf ("  %-12s n=%ld bias=%.3e rms=%.3e |diff| p50=%.3e p95=%.3e "
+        "p99=%.3e max=%.3e\n", stats->name, count, bias / count,
+        sqrt (sumsq / count), stats->diff[count / 2],
+        stats->diff[(long) (0.95 * (count - 1))],
+        stats->diff[(long) (0.99 * (count - 1))], stats->diff[count - 1]);
+}
+
+
+/******************************************************************************
+MODULE:  free_fast_math_stats
+
+PURPOSE:  Frees the sampled differences.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_fast_math_stats
+(
+    Fast_math_stats_t *stats   /* I/O: statistics to be freed */
+)
+{
+    free (stats->diff);
+    stats->diff = NULL;
+    stats->nsamples = 0;
+}
@@ -0,0 +1,95 @@
+#ifndef _FAST_MATH_H_
+#define _FAST_MATH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "common.h"
+#include "espa_metadata.h"
+#include "error_handler.h"
+
+/* Every FAST_MATH_SAMPLE_STRIDE pixel is also processed with the reference
+   (double precision, libm) path when running in fast-math mode, for the
+   accuracy report.  A prime stride keeps the samples from lining up with the
+   aerosol windows. */
+#define FAST_MATH_SAMPLE_STRIDE 997
+
+/* Differences between the fast-math and reference results for the sampled
+   pixels */
+typedef struct {
+    char name[STR_SIZE];  /* name of the quantity being compared */
+    long nsamples;        /* number of possible samples */
+    float *diff;          /* fast-math minus reference for each sample; NAN
+                             for samples which were not processed */
+} Fast_math_stats_t;
+
+/******************************************************************************
+MODULE:  fast_expf
+
+PURPOSE: Approximates expf using a range reduction to 2^n * 2^f and a
+polynomial for 2^f.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+exp(x)          Approximate exponential of x (relative error < 1.0e-6)
+
+NOTES:
+1. This is an inline function so it should be fast as the function call overhead
+   is eliminated by dropping the code inline with the original application.
+2. x is clamped to the range of normal single-precision results.
+******************************************************************************/
+static inline float fast_expf
+(
+    float x                 /* I: exponent */
+)
+{
+    float t;                /* x in base 2 */
+    float f;                /* fractional part of t, [-0.5, 0.5] */
+    float p;                /* 2^f */
+    int n;                  /* integer part of t */
+    union {
+        float f;
+        int32_t i;
+    } pow2n;                /* 2^n built directly from the exponent bits */
+
+    if (x < -87.0f)
+        x = -87.0f;
+    else if (x > 88.0f)
+        x = 88.0f;
+
+    t = x * 1.442695041f;   /* log2(e) */
+    n = (int) (t < 0.0f ? t - 0.5f : t + 0.5f);
+    f = t - (float) n;
+
+    /* Taylor series of 2^f = exp(f ln2) to the 6th order */
+    p = 1.0f + f * (0.6931471806f + f * (0.2402265070f + f * (0.0555041087f +
+        f * (0.0096181291f + f * (0.0013333558f + f * 0.0001540353f)))));
+
+    pow2n.i = (int32_t) (n + 127) << 23;
+    return (p * pow2n.f);
+}
+
+/* Prototypes */
+int init_fast_math_stats
+(
+    char *name,                /* I: name of the quantity being compared */
+    long npix,                 /* I: number of pixels being sampled */
+    Fast_math_stats_t *stats   /* O: initialized statistics */
+);
+
+void report_fast_math_stats
+(
+    Fast_math_stats_t *stats   /* I: statistics to be reported */
+);
+
+void free_fast_math_stats
+(
+    Fast_math_stats_t *stats   /* I/O: statistics to be freed */
+);
+
+#endif
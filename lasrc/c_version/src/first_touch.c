@@ -0,0 +1,194 @@
+/*****************************************************************************
+FILE: first_touch.c
+
+PURPOSE: Contains functions for allocating the full-scene arrays so that their
+memory pages are first touched by the same OpenMP threads that will process
+them, and for reporting where those pages ended up on NUMA systems.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. Linux places a memory page on the NUMA node of the thread which first
+   writes to it.  calloc'ing the arrays and then reading/writing them from the
+   master thread places every page on a single node, while the line-based
+   OpenMP loops run on all sockets.
+2. The line-based loops in the TOA and SR computations use the default
+   (static) schedule over lines, so the initialization here uses the same
+   static schedule over lines.  The threads need to be bound to cores (i.e.
+   OMP_PROC_BIND and OMP_PLACES) for the placement to remain valid across all
+   the processing stages.
+*****************************************************************************/
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "first_touch.h"
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+/* Flags for get_mempolicy, as defined in numaif.h.  Defined here to avoid a
+   dependency on libnuma. */
+#ifndef MPOL_F_NODE
+    #define MPOL_F_NODE (1<<0)
+#endif
+#ifndef MPOL_F_ADDR
+    #define MPOL_F_ADDR (1<<1)
+#endif
+
+/******************************************************************************
+MODULE:  first_touch_alloc
+
+PURPOSE:  Allocates a nlines x nsamps array and zeros it using the same static
+OpenMP line partitioning as the processing loops.  This is a replacement for
+calloc on the full-scene arrays.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error allocating the memory
+non-NULL        Pointer to the zeroed array
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The memory should be freed with free().
+******************************************************************************/
+void *first_touch_alloc
+(
+    int nlines,          /* I: number of lines in the array */
+    int nsamps,          /* I: number of samples in the array */
+    size_t elem_size     /* I: size of each element in bytes */
+)
+{
+    int line;                /* looping variable for the lines */
+    size_t line_size;        /* number of bytes in each line */
+    char *arr = NULL;        /* array to be allocated */
+
+    line_size = (size_t) nsamps * elem_size;
+    arr = malloc ((size_t) nlines * line_size);
+    if (arr == NULL)
+        return (NULL);
+
+    /* Zero the array, touching each line from the thread that will own that
+       line in the processing loops */
+#ifdef _OPENMP
+    #pragma omp parallel for schedule (static) private (line)
+#endif
+    for (line = 0; line < nlines; line++)
+        memset (&arr[line * line_size], 0, line_size);
+
+    return ((void *) arr);
+}
+
+
+/******************************************************************************
+MODULE:  report_thread_binding
+
+PURPOSE:  Prints the number of OpenMP threads and their binding policy, and
+warns if the threads are not bound to places.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void report_thread_binding ()
+{
+#ifdef _OPENMP
+    omp_proc_bind_t bind;    /* thread binding policy */
+    char *bind_str[] = {"false", "true", "master", "close", "spread"};
+
+    bind = omp_get_proc_bind ();
+    printf ("  OpenMP threads: %d, OMP_PROC_BIND: %s, OMP_PLACES: %s\n",
+        omp_get_max_threads (), (bind >= 0 && bind <= 4) ? bind_str[bind] :
+        "unknown", getenv ("OMP_PLACES") ? getenv ("OMP_PLACES") : "unset");
+    if (bind == omp_proc_bind_false)
+        printf ("  WARNING: OpenMP threads are not bound.  Set OMP_PROC_BIND="
+            "close and OMP_PLACES=cores to keep the memory placement local "
+            "to the processing threads.\n");
+#else
+    printf ("  OpenMP threading is not enabled.\n");
+#endif
+}
+
+
+/******************************************************************************
+MODULE:  report_first_touch_placement
+
+PURPOSE:  Reports how many lines of the array reside on the NUMA node of the
+thread which processes them (local) versus on another node (remote).
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The first page of each line is sampled.  The line ownership follows the
+     static schedule used by first_touch_alloc and the processing loops.
+  2. Only available on Linux.  Lines for which the node cannot be determined
+     are counted as unknown.
+******************************************************************************/
+void report_first_touch_placement
+(
+    const char *label,   /* I: name of the array for reporting */
+    void *arr,           /* I: array allocated via first_touch_alloc */
+    int nlines,          /* I: number of lines in the array */
+    int nsamps,          /* I: number of samples in the array */
+    size_t elem_size     /* I: size of each element in bytes */
+)
+{
+    int line;                /* looping variable for the lines */
+    long nlocal = 0;         /* number of lines on the thread's node */
+    long nremote = 0;        /* number of lines on another node */
+    long nunknown = 0;       /* number of lines with unknown placement */
+    size_t line_size;        /* number of bytes in each line */
+#ifdef __linux__
+    unsigned cpu;            /* CPU of the current thread */
+    unsigned thread_node;    /* NUMA node of the current thread */
+    int page_node;           /* NUMA node of the current page */
+#endif
+
+    if (arr == NULL)
+        return;
+    line_size = (size_t) nsamps * elem_size;
+
+#ifdef __linux__
+#ifdef _OPENMP
+    #pragma omp parallel private (line, cpu, thread_node, page_node) reduction (+:nlocal, nremote, nunknown)
+#endif
+    {
+        if (syscall (SYS_getcpu, &cpu, &thread_node, NULL) != 0)
+            thread_node = (unsigned) -1;
+
+#ifdef _OPENMP
+        #pragma omp for schedule (static)
+#endif
+        for (line = 0; line < nlines; line++)
+        {
+            if (thread_node == (unsigned) -1 ||
+                syscall (SYS_get_mempolicy, &page_node, NULL, 0,
+                ((char *) arr) + line * line_size,
+                MPOL_F_NODE | MPOL_F_ADDR) != 0)
+                nunknown++;
+            else if ((unsigned) page_node == thread_node)
+                nlocal++;
+            else
+                nremote++;
+        }
+    }
+#else
+    nunknown = nlines;
+#endif
+
+    printf ("  Memory placement for %s: %ld local lines, %ld remote lines, "
+        "%ld unknown\n", label, nlocal, nremote, nunknown);
+}
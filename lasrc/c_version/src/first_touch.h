@@ -0,0 +1,28 @@
+#ifndef _FIRST_TOUCH_H_
+#define _FIRST_TOUCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* Prototypes */
+void *first_touch_alloc
+(
+    int nlines,          /* I: number of lines in the array */
+    int nsamps,          /* I: number of samples in the array */
+    size_t elem_size     /* I: size of each element in bytes */
+);
+
+void report_thread_binding ();
+
+void report_first_touch_placement
+(
+    const char *label,   /* I: name of the array for reporting */
+    void *arr,           /* I: array allocated via first_touch_alloc */
+    int nlines,          /* I: number of lines in the array */
+    int nsamps,          /* I: number of samples in the array */
+    size_t elem_size     /* I: size of each element in bytes */
+);
+
+#endif
@@ -22,6 +22,10 @@ NOTES:
   1. The input files should be character a pointer set to NULL on input. Memory
      for these pointers is allocated by this routine. The caller is responsible
      for freeing the allocated memory upon successful return.
+  2. The estimate option takes an optional cost model file, which has to be
+     given as --estimate=file.
+  3. The shard option is given as --shard=n/N for row shard n of N.  The
+     merge_shards option only needs the XML file.
 ******************************************************************************/
 int get_args
 (
@@ -32,6 +36,32 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    char **ckpt_file,     /* O: address of the aerosol checkpoint file; NULL
+                                if checkpointing was not requested */
+    Roi_type_t *roi_type, /* O: type of region of interest; ROI_NONE if the
+                                full scene is processed */
+    double *roi_coords,   /* O: UL line/samp and LR line/samp (ROI_PIXEL) or
+                                UL x/y and LR x/y (ROI_PROJ) of the region of
+                                interest [4] */
+    bool *fast_math,      /* O: use the fast-math SR path and report its
+                                differences from the reference */
+    char **bands,         /* O: address of the comma-separated list of bands
+                                to be output; NULL if all bands are output */
+    bool *pixel_angles,   /* O: correct the L8 SR with the per-pixel solar
+                                zenith rather than the scene center */
+    float *aero_adapt_tol,/* O: AOT tolerance for the adaptive aerosol
+                                inversion; 0.0 if not adaptive */
+    bool *strip,          /* O: process the XML files as the rows of a
+                                strip */
+    bool *estimate,       /* O: only estimate the cost of the run */
+    char **cost_model_file,/* O: address of the cost model file for the
+                                estimate; NULL if the defaults are used */
+    int *ishard,          /* O: row shard of the scene to be processed
+                                (1-based) */
+    int *nshards,         /* O: number of row shards of the scene; 0 if the
+                                scene isn't sharded */
+    int *merge_nshards,   /* O: number of row shards to be merged into the
+                                full-scene product; 0 if not merging */
     bool *verbose         /* O: verbose flag */
 )
 {
@@ -39,6 +69,9 @@ int get_args
     int option_index;                /* index for the command-line option */
     static int verbose_flag=0;       /* verbose flag */
     static int write_toa_flag=0;     /* write TOA flag */
+    static int fast_math_flag=0;     /* fast-math flag */
+    static int pixel_angles_flag=0;  /* per-pixel angles flag */
+    static int strip_flag=0;         /* strip flag */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static int version_flag=0;       /* flag to print version number instead
@@ -47,9 +80,20 @@ int get_args
     {
         {"verbose", no_argument, &verbose_flag, 1},
         {"write_toa", no_argument, &write_toa_flag, 1},
+        {"fast_math", no_argument, &fast_math_flag, 1},
+        {"pixel_angles", no_argument, &pixel_angles_flag, 1},
+        {"strip", no_argument, &strip_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"aux", required_argument, 0, 'a'},
         {"process_sr", required_argument, 0, 'p'},
+        {"checkpoint", required_argument, 0, 'c'},
+        {"roi", required_argument, 0, 'r'},
+        {"roi_proj", required_argument, 0, 'm'},
+        {"bands", required_argument, 0, 'b'},
+        {"adaptive_aero", required_argument, 0, 'd'},
+        {"estimate", optional_argument, 0, 'e'},
+        {"shard", required_argument, 0, 's'},
+        {"merge_shards", required_argument, 0, 'g'},
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, &version_flag, 1},
         {0, 0, 0, 0}
@@ -58,7 +102,16 @@ int get_args
     /* Initialize the flags to false */
     *verbose = false;
     *write_toa = false;
+    *fast_math = false;
+    *pixel_angles = false;
+    *strip = false;
+    *estimate = false;
+    *ishard = 0;
+    *nshards = 0;          /* default is to process the scene in one piece */
+    *merge_nshards = 0;
+    *aero_adapt_tol = 0.0; /* default is to invert every aerosol window */
     *process_sr = true;    /* default is to process SR products */
+    *roi_type = ROI_NONE;  /* default is to process the full scene */
 
     /* Loop through all the cmd-line options */
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
@@ -92,6 +145,79 @@ int get_args
                 *aux_infile = strdup (optarg);
                 break;
      
+            case 'c':  /* aerosol checkpoint file */
+                *ckpt_file = strdup (optarg);
+                break;
+     
+            case 'b':  /* subset of the bands to be output */
+                *bands = strdup (optarg);
+                break;
+     
+            case 'e':  /* estimate the cost, optionally with a cost model */
+                *estimate = true;
+                if (optarg != NULL)
+                    *cost_model_file = strdup (optarg);
+                break;
+     
+            case 's':  /* row shard of the scene */
+                if (sscanf (optarg, "%d/%d", ishard, nshards) != 2 ||
+                    *nshards < 1 || *ishard < 1 || *ishard > *nshards)
+                {
+                    sprintf (errmsg, "Invalid value for shard: %s.  Expected "
+                        "n/N with 1 <= n <= N.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+     
+            case 'g':  /* number of row shards to be merged */
+                if (sscanf (optarg, "%d", merge_nshards) != 1 ||
+                    *merge_nshards < 1)
+                {
+                    sprintf (errmsg, "Invalid value for merge_shards: %s.  "
+                        "Expected the number of shards.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+     
+            case 'd':  /* AOT tolerance for the adaptive aerosol inversion */
+                if (sscanf (optarg, "%f", aero_adapt_tol) != 1 ||
+                    *aero_adapt_tol < 0.0)
+                {
+                    sprintf (errmsg, "Invalid value for adaptive_aero: %s.  "
+                        "Expected a non-negative AOT tolerance.", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+     
+            case 'r':  /* region of interest in lines/samples */
+            case 'm':  /* region of interest in projection coordinates */
+                if (*roi_type != ROI_NONE)
+                {
+                    sprintf (errmsg, "Only one of roi and roi_proj may be "
+                        "specified");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                if (sscanf (optarg, "%lf,%lf,%lf,%lf", &roi_coords[0],
+                    &roi_coords[1], &roi_coords[2], &roi_coords[3]) != 4)
+                {
+                    sprintf (errmsg, "Invalid value for %s: %s.  Expected "
+                        "four comma-separated values.",
+                        (c == 'r') ? "roi" : "roi_proj", optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                *roi_type = (c == 'r') ? ROI_PIXEL : ROI_PROJ;
+                break;
+     
             case 'p':  /* process SR products */
                 if (!strcmp (optarg, "true"))
                     *process_sr = true;
@@ -133,8 +259,9 @@ int get_args
         return (ERROR);
     }
 
-    /* Make sure the auxiliary file was specified */
-    if (*aux_infile == NULL)
+    /* Make sure the auxiliary file was specified, unless only merging the
+       shards of a scene */
+    if (*aux_infile == NULL && *merge_nshards == 0)
     {
         sprintf (errmsg, "Input auxiliary file for water vapor and ozone is "
             "a required argument");
@@ -148,6 +275,34 @@ int get_args
         *verbose = true;
     if (write_toa_flag)
         *write_toa = true;
+    if (fast_math_flag)
+        *fast_math = true;
+    if (pixel_angles_flag)
+        *pixel_angles = true;
+    if (strip_flag)
+        *strip = true;
+
+    /* The checkpoint and the ROI are specific to a single scene */
+    if (*strip && (*ckpt_file != NULL || *roi_type != ROI_NONE))
+    {
+        sprintf (errmsg, "The checkpoint and ROI options are not supported "
+            "when processing a strip");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
+
+    /* A shard is processed as a region of interest, with the scene-wide
+       aerosol windows of a single-process run */
+    if (*nshards > 0 && (*strip || *ckpt_file != NULL ||
+        *roi_type != ROI_NONE || *aero_adapt_tol > 0.0))
+    {
+        sprintf (errmsg, "The strip, checkpoint, ROI, and adaptive_aero "
+            "options are not supported when processing a shard");
+        error_handler (true, FUNC_NAME, errmsg);
+        usage ();
+        return (ERROR);
+    }
 
     return (SUCCESS);
 }
@@ -13,6 +13,7 @@ NOTES:
 *****************************************************************************/
 
 #include "input.h"
+#include "lasrc.h"
 
 /******************************************************************************
 MODULE:  open_input
@@ -308,6 +309,340 @@ void free_input
 }
 
 
+/******************************************************************************
+MODULE:  read_window_lines
+
+PURPOSE:  Reads lines of data from an open raw binary band.  If a region of
+interest is being processed, then only the samples within the processing
+window are read for each line.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error occurred seeking or reading the data
+SUCCESS    Successful completion
+
+NOTES:
+  1. The caller is expected to report the band-specific error message.
+******************************************************************************/
+static int read_window_lines
+(
+    FILE *fp,         /* I: pointer to the open raw binary band */
+    int full_nsamps,  /* I: number of samples in each line of the band file */
+    int line0,        /* I: first line of the processing window in the band */
+    int samp0,        /* I: first sample of the processing window in the band */
+    int iline,        /* I: current line to read, relative to line0 */
+    int nlines,       /* I: number of lines to read */
+    int nsamps,       /* I: number of samples to read from each line */
+    int nbytes,       /* I: number of bytes per pixel */
+    void *out_arr     /* O: output array to populate, nlines x nsamps */
+)
+{
+    int line;         /* looping variable for lines */
+    long loc;         /* current location in the input file */
+
+    /* If complete lines are read, then read them all at once */
+    if (samp0 == 0 && nsamps == full_nsamps)
+    {
+        loc = (long) (line0 + iline) * full_nsamps * nbytes;
+        if (fseek (fp, loc, SEEK_SET))
+            return (ERROR);
+        return (read_raw_binary (fp, nlines, nsamps, nbytes, out_arr));
+    }
+
+    /* Otherwise read the window samples one line at a time */
+    for (line = 0; line < nlines; line++)
+    {
+        loc = ((long) (line0 + iline + line) * full_nsamps + samp0) * nbytes;
+        if (fseek (fp, loc, SEEK_SET))
+            return (ERROR);
+        if (read_raw_binary (fp, 1, nsamps, nbytes,
+            (char *) out_arr + (long) line * nsamps * nbytes) != SUCCESS)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_input_roi
+
+PURPOSE:  Limits the input to a region of interest (ROI).  The ROI is grown
+to whole aerosol windows plus a halo of ROI_HALO_WINDOWS aerosol windows on
+each side, clipped to the scene.  The input sizes are then reset to this
+processing window, and all following reads are offset to the window.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      The ROI is not within the scene
+SUCCESS    Successful completion
+
+NOTES:
+  1. The processing window starts on the aerosol window grid of the full
+     scene, so the aerosol windows match those of a full-scene run.
+  2. The thermal, QA, and per-pixel angle bands must be the same size as the
+     reflectance bands.  Lower-resolution S2 bands are read with the window
+     scaled to their resolution, which works since the S2 aerosol window is a
+     multiple of the 20m and 60m resolutions.
+******************************************************************************/
+int set_input_roi
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int ul_line,     /* I: UL line of the ROI (0-based) */
+    int ul_samp,     /* I: UL sample of the ROI (0-based) */
+    int lr_line,     /* I: LR line of the ROI (0-based, inclusive) */
+    int lr_samp,     /* I: LR sample of the ROI (0-based, inclusive) */
+    int aero_window  /* I: size of the aerosol window */
+)
+{
+    char FUNC_NAME[] = "set_input_roi";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Roi_t *roi = &this->roi;  /* pointer to the ROI in the input structure */
+    int halo = ROI_HALO_WINDOWS * aero_window;  /* halo size in pixels */
+    int end_line, end_samp;   /* last line/sample (exclusive) of the
+                                 processing window */
+
+    /* Make sure the ROI falls within the scene */
+    if (ul_line < 0 || ul_samp < 0 || lr_line < ul_line ||
+        lr_samp < ul_samp || lr_line >= this->size.nlines ||
+        lr_samp >= this->size.nsamps)
+    {
+        sprintf (errmsg, "ROI lines %d-%d, samples %d-%d are not within the "
+            "scene (%d lines x %d samples)", ul_line, lr_line, ul_samp,
+            lr_samp, this->size.nlines, this->size.nsamps);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (this->nband_th != 0 && (this->size_th.nlines != this->size.nlines ||
+        this->size_th.nsamps != this->size.nsamps))
+    {
+        sprintf (errmsg, "ROI processing requires the thermal bands to be "
+            "the same size as the reflectance bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if ((this->nband_qa != 0 && (this->size_qa.nlines != this->size.nlines ||
+         this->size_qa.nsamps != this->size.nsamps)) ||
+        (this->open_ppa && (this->size_ppa.nlines != this->size.nlines ||
+         this->size_ppa.nsamps != this->size.nsamps)))
+    {
+        sprintf (errmsg, "ROI processing requires the QA and per-pixel angle "
+            "bands to be the same size as the reflectance bands");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Grow the ROI to the aerosol window grid plus the halo and clip it to
+       the scene */
+    roi->full_nlines = this->size.nlines;
+    roi->full_nsamps = this->size.nsamps;
+    roi->full_nlines_pan = this->size_pan.nlines;
+    roi->full_nsamps_pan = this->size_pan.nsamps;
+
+    roi->line0 = (ul_line / aero_window) * aero_window - halo;
+    if (roi->line0 < 0)
+        roi->line0 = 0;
+    roi->samp0 = (ul_samp / aero_window) * aero_window - halo;
+    if (roi->samp0 < 0)
+        roi->samp0 = 0;
+
+    end_line = (lr_line / aero_window + 1) * aero_window + halo;
+    if (end_line > roi->full_nlines)
+        end_line = roi->full_nlines;
+    end_samp = (lr_samp / aero_window + 1) * aero_window + halo;
+    if (end_samp > roi->full_nsamps)
+        end_samp = roi->full_nsamps;
+
+    roi->nlines = end_line - roi->line0;
+    roi->nsamps = end_samp - roi->samp0;
+    roi->out_line0 = ul_line - roi->line0;
+    roi->out_samp0 = ul_samp - roi->samp0;
+    roi->out_nlines = lr_line - ul_line + 1;
+    roi->out_nsamps = lr_samp - ul_samp + 1;
+    roi->ishard = 0;
+    roi->nshards = 0;
+
+    /* Reset the input sizes to the processing window */
+    this->size.nlines = roi->nlines;
+    this->size.nsamps = roi->nsamps;
+    if (this->nband_th != 0)
+    {
+        this->size_th.nlines = roi->nlines;
+        this->size_th.nsamps = roi->nsamps;
+    }
+    if (this->nband_qa != 0)
+    {
+        this->size_qa.nlines = roi->nlines;
+        this->size_qa.nsamps = roi->nsamps;
+    }
+    if (this->open_ppa)
+    {
+        this->size_ppa.nlines = roi->nlines;
+        this->size_ppa.nsamps = roi->nsamps;
+    }
+    if (this->nband_pan != 0)
+    {
+        this->size_pan.nlines = (long) roi->nlines * roi->full_nlines_pan /
+            roi->full_nlines;
+        this->size_pan.nsamps = (long) roi->nsamps * roi->full_nsamps_pan /
+            roi->full_nsamps;
+    }
+    this->roi_set = true;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  set_input_bands
+
+PURPOSE:  Limits the output to a subset of the bands.  The bands are flagged
+as output, and the output bands plus the bands needed by the aerosol
+inversion and the aerosol QA are flagged as processed.  Bands which aren't
+processed are not read, corrected, or allocated.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      A band in the list is not valid for this satellite
+SUCCESS    Successful completion
+
+NOTES:
+  1. The bands are specified by their band number with an optional leading
+     'b' and leading zeros, so 4, b4, and B04 are all band 4.  L8 bands are
+     1-7 and 9-11 (the pan band is never output).  S2 bands are 1-12 and 8a.
+  2. L8 bands 1, 2, 4, 5, and 7 and S2 bands 1, 2, 4, 8a, and 12 are always
+     processed for surface reflectance.  Band 1 provides the aerosol QA.
+  3. Since the fill pixels are flagged from the bands which are processed,
+     and the saturation flags are only set for the bands which are read, the
+     radsat band only flags saturation in the processed bands.
+******************************************************************************/
+int set_input_bands
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    char *band_list, /* I: comma-separated list of the bands to be output */
+    bool process_sr  /* I: will SR data be processed? */
+)
+{
+    char FUNC_NAME[] = "set_input_bands";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *list = NULL;        /* copy of the band list for strtok */
+    char *token = NULL;       /* current band in the list */
+    char *cptr = NULL;        /* pointer into the current band */
+    char *endptr = NULL;      /* end of the band number */
+    int ib;                   /* looping variable for bands */
+    int band_num;             /* band number of the current band */
+    int sr_band;              /* SR_L8_* or SR_S2_* index of the band */
+    int nout_bands;           /* number of bands which could be output */
+    int nbands = 0;           /* number of bands in the list */
+    bool is_8a;               /* is this S2 band 8a? */
+    int l8_inv_bands[] = {SR_L8_BAND1, SR_L8_BAND2, SR_L8_BAND4, SR_L8_BAND5,
+                          SR_L8_BAND7};   /* L8 bands used by the inversion */
+    int s2_inv_bands[] = {SR_S2_BAND1, SR_S2_BAND2, SR_S2_BAND4, SR_S2_BAND8A,
+                          SR_S2_BAND12};  /* S2 bands used by the inversion */
+
+    /* Only the bands in the list are output */
+    if (this->meta.sat == SAT_LANDSAT_8)
+        nout_bands = SR_L8_BAND11 + 1;
+    else
+        nout_bands = SR_S2_BAND12 + 1;
+    for (ib = 0; ib < nout_bands; ib++)
+    {
+        this->out_band[ib] = false;
+        this->proc_band[ib] = false;
+    }
+
+    list = strdup (band_list);
+    if (list == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the band list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    for (token = strtok (list, ","); token != NULL;
+         token = strtok (NULL, ","))
+    {
+        /* Parse the band number, with an optional leading b and trailing a */
+        cptr = token;
+        if (*cptr == 'b' || *cptr == 'B')
+            cptr++;
+        band_num = (int) strtol (cptr, &endptr, 10);
+        is_8a = false;
+        if (endptr != cptr && (*endptr == 'a' || *endptr == 'A'))
+        {
+            is_8a = true;
+            endptr++;
+        }
+
+        /* Map the band number to the output band */
+        sr_band = -1;
+        if (endptr != cptr && *endptr == '\0')
+        {
+            if (this->meta.sat == SAT_LANDSAT_8 && !is_8a)
+            {
+                if (band_num >= 1 && band_num <= 7)
+                    sr_band = SR_L8_BAND1 + band_num - 1;
+                else if (band_num >= 9 && band_num <= 11)
+                    sr_band = SR_L8_BAND9 + band_num - 9;
+            }
+            else if (this->meta.sat == SAT_SENTINEL_2)
+            {
+                if (is_8a && band_num == 8)
+                    sr_band = SR_S2_BAND8A;
+                else if (!is_8a && band_num >= 1 && band_num <= 8)
+                    sr_band = SR_S2_BAND1 + band_num - 1;
+                else if (!is_8a && band_num >= 9 && band_num <= 12)
+                    sr_band = SR_S2_BAND9 + band_num - 9;
+            }
+        }
+
+        if (sr_band < 0)
+        {
+            sprintf (errmsg, "Invalid band in the band list: %s", token);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (list);
+            return (ERROR);
+        }
+
+        this->out_band[sr_band] = true;
+        this->proc_band[sr_band] = true;
+        nbands++;
+    }
+    free (list);
+
+    if (nbands == 0)
+    {
+        sprintf (errmsg, "No bands were specified in the band list");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The surface reflectance needs the inversion bands, even if they are
+       not output */
+    if (process_sr)
+    {
+        for (ib = 0; ib < (int) (sizeof (l8_inv_bands) / sizeof (int)); ib++)
+        {
+            if (this->meta.sat == SAT_LANDSAT_8)
+                this->proc_band[l8_inv_bands[ib]] = true;
+            else
+                this->proc_band[s2_inv_bands[ib]] = true;
+        }
+    }
+    this->bands_set = true;
+
+    return (SUCCESS);
+}
+
+
 /******************************************************************************
 MODULE:  get_input_refl_lines
 
@@ -339,7 +674,11 @@ int get_input_refl_lines
 {
     char FUNC_NAME[] = "get_input_refl_line";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    long loc;                 /* current location in the input file */
+    int factor = 1;           /* ratio of the band pixel size to the pixel size
+                                 of the reflectance bands (S2) */
+    int full_nsamps;          /* number of samples in the band file */
+    int line0 = 0;            /* first line of the processing window */
+    int samp0 = 0;            /* first sample of the processing window */
   
     /* Check the parameters */
     if (this == NULL) 
@@ -370,18 +709,20 @@ int get_input_refl_lines
     /* Check the number of lines */
     if (nsamps == -99)
         nsamps = this->size.nsamps;
-  
-    /* Read the data, but first seek to the correct line */
-    loc = (long) iline * nsamps * sizeof (uint16);
-    if (fseek (this->fp_bin[iband], loc, SEEK_SET))
+
+    /* Determine the processing window within this band */
+    full_nsamps = nsamps;
+    if (this->roi_set)
     {
-        strcpy (errmsg, "Seeking to the current line in the input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        factor = this->size.nsamps / nsamps;
+        full_nsamps = this->roi.full_nsamps / factor;
+        line0 = this->roi.line0 / factor;
+        samp0 = this->roi.samp0 / factor;
     }
-
-    if (read_raw_binary (this->fp_bin[iband], nlines, nsamps, sizeof (uint16),
-        out_arr) != SUCCESS)
+  
+    /* Read the data */
+    if (read_window_lines (this->fp_bin[iband], full_nsamps, line0, samp0,
+        iline, nlines, nsamps, sizeof (uint16), out_arr) != SUCCESS)
     {
         sprintf (errmsg, "Reading %d lines from reflectance band %d starting "
             "at line %d", nlines, iband, iline);
@@ -421,7 +762,9 @@ int get_input_th_lines
 {
     char FUNC_NAME[] = "get_input_th_line";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    long loc;                 /* current location in the input file */
+    int full_nsamps;          /* number of samples in the band file */
+    int line0 = 0;            /* first line of the processing window */
+    int samp0 = 0;            /* first sample of the processing window */
   
     /* Check the parameters */
     if (this == NULL) 
@@ -449,17 +792,19 @@ int get_input_th_lines
         return (ERROR);
     }
   
-    /* Read the data, but first seek to the correct line */
-    loc = (long) iline * this->size_th.nsamps * sizeof (uint16);
-    if (fseek (this->fp_bin_th[iband], loc, SEEK_SET))
+    /* Determine the processing window within this band */
+    full_nsamps = this->size_th.nsamps;
+    if (this->roi_set)
     {
-        strcpy (errmsg, "Seeking to the current line in the input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        full_nsamps = this->roi.full_nsamps;
+        line0 = this->roi.line0;
+        samp0 = this->roi.samp0;
     }
-
-    if (read_raw_binary (this->fp_bin_th[iband], nlines, this->size_th.nsamps,
-        sizeof (uint16), out_arr) != SUCCESS)
+  
+    /* Read the data */
+    if (read_window_lines (this->fp_bin_th[iband], full_nsamps, line0,
+        samp0, iline, nlines, this->size_th.nsamps, sizeof (uint16), out_arr)
+        != SUCCESS)
     {
         sprintf (errmsg, "Reading %d lines from thermal band %d starting at "
             "line %d", nlines, iband, iline);
@@ -499,7 +844,9 @@ int get_input_pan_lines
 {
     char FUNC_NAME[] = "get_input_pan_line";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    long loc;                 /* current location in the input file */
+    int full_nsamps;          /* number of samples in the band file */
+    int line0 = 0;            /* first line of the processing window */
+    int samp0 = 0;            /* first sample of the processing window */
   
     /* Check the parameters */
     if (this == NULL) 
@@ -527,17 +874,21 @@ int get_input_pan_lines
         return (ERROR);
     }
   
-    /* Read the data, but first seek to the correct line */
-    loc = (long) iline * this->size_pan.nsamps * sizeof (uint16);
-    if (fseek (this->fp_bin_pan[iband], loc, SEEK_SET))
+    /* Determine the processing window within this band */
+    full_nsamps = this->size_pan.nsamps;
+    if (this->roi_set)
     {
-        strcpy (errmsg, "Seeking to the current line in the input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        full_nsamps = this->roi.full_nsamps_pan;
+        line0 = (long) this->roi.line0 * this->roi.full_nlines_pan /
+            this->roi.full_nlines;
+        samp0 = (long) this->roi.samp0 * this->roi.full_nsamps_pan /
+            this->roi.full_nsamps;
     }
-
-    if (read_raw_binary (this->fp_bin_pan[iband], nlines, this->size_pan.nsamps,
-        sizeof (uint16), out_arr) != SUCCESS)
+  
+    /* Read the data */
+    if (read_window_lines (this->fp_bin_pan[iband], full_nsamps, line0,
+        samp0, iline, nlines, this->size_pan.nsamps, sizeof (uint16), out_arr)
+        != SUCCESS)
     {
         sprintf (errmsg, "Reading %d lines from pan band %d starting at "
             "line %d", nlines, iband, iline);
@@ -577,7 +928,9 @@ int get_input_qa_lines
 {
     char FUNC_NAME[] = "get_input_qa_line";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    long loc;                 /* current location in the input file */
+    int full_nsamps;          /* number of samples in the band file */
+    int line0 = 0;            /* first line of the processing window */
+    int samp0 = 0;            /* first sample of the processing window */
   
     /* Check the parameters */
     if (this == NULL) 
@@ -605,17 +958,19 @@ int get_input_qa_lines
         return (ERROR);
     }
   
-    /* Read the data, but first seek to the correct line */
-    loc = (long) iline * this->size_qa.nsamps * sizeof (uint16);
-    if (fseek (this->fp_bin_qa[iband], loc, SEEK_SET))
+    /* Determine the processing window within this band */
+    full_nsamps = this->size_qa.nsamps;
+    if (this->roi_set)
     {
-        strcpy (errmsg, "Seeking to the current line in the input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        full_nsamps = this->roi.full_nsamps;
+        line0 = this->roi.line0;
+        samp0 = this->roi.samp0;
     }
-
-    if (read_raw_binary (this->fp_bin_qa[iband], nlines, this->size_qa.nsamps,
-        sizeof (uint16), out_arr) != SUCCESS)
+  
+    /* Read the data */
+    if (read_window_lines (this->fp_bin_qa[iband], full_nsamps, line0,
+        samp0, iline, nlines, this->size_qa.nsamps, sizeof (uint16), out_arr)
+        != SUCCESS)
     {
         sprintf (errmsg, "Reading %d lines from QA band %d starting at "
             "line %d", nlines, iband, iline);
@@ -643,18 +998,28 @@ SUCCESS    Successful completion
 NOTES:
   1. The Input_t data structure needs to be populated and memory allocated
      before calling this routine.  Use open_input to do that.
+  2. If the QA array is provided, the angle values for the Level-1 fill pixels
+     are set to PPA_FILL as they are read.  This replaces the separate masking
+     of the angle bands (and the rewrite of those files) before running lasrc.
+     The QA array must contain the same lines as are being read.
 ******************************************************************************/
 int get_input_ppa_lines
 (
     Input_t *this,   /* I: pointer to input data structure */
     int iline,       /* I: current line to read (0-based) */
     int nlines,      /* I: number of lines to read */
-    int16 *sza_arr /* O: output solar zenith array to populate */
+    uint16 *qa_arr,  /* I: Level-1 QA values for the same lines, used to
+                           mask the fill pixels; NULL if no masking */
+    int16 *sza_arr   /* O: output solar zenith array to populate */
 )
 {
     char FUNC_NAME[] = "get_input_ppa_lines";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
-    long loc;                 /* current location in the input file */
+    int full_nsamps;          /* number of samples in the band file */
+    int line0 = 0;            /* first line of the processing window */
+    int samp0 = 0;            /* first sample of the processing window */
+    long i;                   /* looping variable for pixels */
+    long npix;                /* number of pixels read */
   
     /* Check the parameters */
     if (this == NULL) 
@@ -676,23 +1041,36 @@ int get_input_ppa_lines
         return (ERROR);
     }
   
-    /* Read the solar zenith data, but first seek to the correct line */
-    loc = (long) iline * this->size_ppa.nsamps * sizeof (int16);
-    if (fseek (this->fp_bin_sza, loc, SEEK_SET))
+    /* Determine the processing window within this band */
+    full_nsamps = this->size_ppa.nsamps;
+    if (this->roi_set)
     {
-        strcpy (errmsg, "Seeking to the current line in the sza input file");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        full_nsamps = this->roi.full_nsamps;
+        line0 = this->roi.line0;
+        samp0 = this->roi.samp0;
     }
-
-    if (read_raw_binary (this->fp_bin_sza, nlines, this->size_ppa.nsamps,
-        sizeof (int16), sza_arr) != SUCCESS)
+  
+    /* Read the solar zenith data */
+    if (read_window_lines (this->fp_bin_sza, full_nsamps, line0, samp0,
+        iline, nlines, this->size_ppa.nsamps, sizeof (int16), sza_arr)
+        != SUCCESS)
     {
         sprintf (errmsg, "Reading %d lines from solar zenith band starting "
             "at line %d", nlines, iline);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+
+    /* Mask the fill pixels using the Level-1 QA band */
+    if (qa_arr != NULL)
+    {
+        npix = (long) nlines * this->size_ppa.nsamps;
+        for (i = 0; i < npix; i++)
+        {
+            if (level1_qa_is_fill (qa_arr[i]))
+                sza_arr[i] = PPA_FILL;
+        }
+    }
   
     return (SUCCESS);
 }
@@ -751,6 +1129,8 @@ int get_xml_input
     this->meta.fill = INPUT_FILL;
     this->size.nsamps = this->size.nlines = -1;
     this->meta.gain_set = false;
+    this->roi_set = false;
+    this->bands_set = false;
 
     /* use S2 refl band count as it's the largest */
     this->nband = 0;
@@ -762,6 +1142,8 @@ int get_xml_input
         this->file_name[ib] = NULL;
         this->open[ib] = false;
         this->fp_bin[ib] = NULL;
+        this->out_band[ib] = true;
+        this->proc_band[ib] = true;
     }
 
     /* use L8 thermal band count as it's the largest */
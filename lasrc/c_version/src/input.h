@@ -11,6 +11,7 @@
 #include "raw_binary_io.h"
 
 #define INPUT_FILL (0)
+#define PPA_FILL (-32768)
 #define ANGLE_FILL (-999.0)
 #define WRS_FILL (-1)
 #define GAIN_BIAS_FILL (-999.0)
@@ -53,6 +54,30 @@ typedef struct {
     float k2_const[NBAND_L8_THM_MAX]; /* K2 const for thermal bands (L8 only) */
 } Input_meta_t;
 
+/* Structure for the region of interest (ROI) being processed.  All values
+   are in reflectance band pixels. */
+typedef struct {
+    int full_nlines;         /* number of lines in the full scene */
+    int full_nsamps;         /* number of samples in the full scene */
+    int full_nlines_pan;     /* number of lines in the full-scene pan band */
+    int full_nsamps_pan;     /* number of samples in the full-scene pan band */
+    int line0;               /* first line of the processing window (ROI plus
+                                the aerosol halo) in the full scene */
+    int samp0;               /* first sample of the processing window */
+    int nlines;              /* number of lines in the processing window */
+    int nsamps;              /* number of samples in the processing window */
+    int out_line0;           /* first line of the ROI in the processing
+                                window */
+    int out_samp0;           /* first sample of the ROI in the processing
+                                window */
+    int out_nlines;          /* number of lines in the ROI */
+    int out_nsamps;          /* number of samples in the ROI */
+    int ishard;              /* row shard of the scene the ROI is (1-based);
+                                0 if the ROI isn't a shard */
+    int nshards;             /* number of row shards of the scene; 0 if the
+                                ROI isn't a shard */
+} Roi_t;
+
 /* Structure for the input data */
 typedef struct {
     Input_meta_t meta;         /* input metadata */
@@ -67,6 +92,18 @@ typedef struct {
     Img_coord_info_t size_qa;  /* input QA file size */
     Img_coord_info_t size_ppa; /* input per-pixel angle file size */
 
+    bool roi_set;              /* is only a region of interest processed? If
+                                  so, the sizes above are for the processing
+                                  window and the reads are offset to it */
+    Roi_t roi;                 /* region of interest, if roi_set */
+
+    bool bands_set;            /* is only a subset of the bands output? */
+    bool out_band[NBAND_REFL_MAX];  /* is the band output?  Indexed by the
+                                  SR_L8_* or SR_S2_* band */
+    bool proc_band[NBAND_REFL_MAX]; /* is the band processed?  These are the
+                                  output bands plus the bands needed by the
+                                  aerosol inversion and the aerosol QA */
+
     float scale_factor;       /* scale factor for reflectance bands */
     float scale_factor_th;    /* scale factor for thermal bands */
     float scale_factor_pan;   /* scale factor for pan bands */
@@ -109,6 +146,23 @@ void free_input
     Input_t *this    /* I: pointer to input data structure */
 );
 
+int set_input_roi
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    int ul_line,     /* I: UL line of the ROI (0-based) */
+    int ul_samp,     /* I: UL sample of the ROI (0-based) */
+    int lr_line,     /* I: LR line of the ROI (0-based, inclusive) */
+    int lr_samp,     /* I: LR sample of the ROI (0-based, inclusive) */
+    int aero_window  /* I: size of the aerosol window */
+);
+
+int set_input_bands
+(
+    Input_t *this,   /* I/O: pointer to input data structure */
+    char *band_list, /* I: comma-separated list of the bands to be output */
+    bool process_sr  /* I: will SR data be processed? */
+);
+
 int get_input_refl_lines
 (
     Input_t *this,   /* I: pointer to input data structure */
@@ -153,7 +207,9 @@ int get_input_ppa_lines
     Input_t *this,   /* I: pointer to input data structure */
     int iline,       /* I: current line to read (0-based) */
     int nlines,      /* I: number of lines to read */
-    int16 *sza_arr  /* O: output solar zenith array to populate */
+    uint16 *qa_arr,  /* I: Level-1 QA values for the same lines, used to
+                           mask the fill pixels; NULL if no masking */
+    int16 *sza_arr   /* O: output solar zenith array to populate */
 );
 
 int get_xml_input
@@ -1,81 +1,97 @@
 #include <sys/stat.h>
 #include <unistd.h>
-#include "lasrc.h"
+#include "lasrc_lib.h"
+#include "estimate.h"
+#include "roi.h"
+#include "shard.h"
 
 /******************************************************************************
-MODULE:  lasrc (Landsat Surface Reflectance Code - LaSRC)
+MODULE:  process_scene
 
-PURPOSE:  Computes the surface reflectance values for the Landsat 8 and
-Sentinel 2 products.
+PURPOSE:  Computes and writes the TOA and surface reflectance products for a
+single Landsat 8 or Sentinel-2 scene, or for the next row of a Landsat 8
+strip.
 
 RETURN VALUE:
 Type = int
 Value           Description
 -----           -----------
-ERROR           An error occurred during processing of the surface reflectance
+ERROR           An error occurred processing the scene
 SUCCESS         Processing was successful
 
 PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
 at the USGS EROS
 
 NOTES:
-**Landsat 8:
-1. Bands 1-7 are corrected to surface reflectance.  Band 8 (pand band) is not
-   processed.  Band 9 (cirrus band) is corrected to TOA reflectance.  Bands
-   10 and 11 are corrected to brightness temperature.
-2. SDstart and SDreaddata have minor memory leaks.  Ultimately both call
-   HAregister_atom which makes a malloc call and the memory is never freed.
-3. Conversion algorithms for TOA reflectance and TOA brightness temperature are
-   available from
-   http://landsat.usgs.gov/Landsat8_Using_Product.php
-4. The TOA and SR corrections utilize solar and view angles.  Previous versions
-   simply corrected every pixel for the solar angles at the scene center.
-   However as of version 1.0.0, the solar and view angles are read from the
-   per-pixel angle bands and better reflect the angle at that location within
-   the scene.  These solar/view angles are scaled int16s and therefore need to
-   be unscaled (multiply by 0.01) before using.  They are in units of degrees.
-5. The solar angles from band to band are fairly stable, thus a single array of
-   per-pixel angles will be used.  The array can be from a "representative
-   band" for the reflectance bands or it can be an average of the reflectance
-   bands. We will use band 4 as the representative band for these per-pixel
-   angle values.
-6. The view/observation angles from band to band are a bit more unstable
-   (particularly the view azimuth) near nadir.  A single array of per-pixel
-   angles will still be used, however the information near nadir may be slightly
-   affected.  We will use band 4 as the representative band for these per-pixel
-   angle values.
-
-**Sentinel 2:
-1. Bands 1-12, including band 8a, are corrected to surface reflectance.
-2. All bands are converted to 10m band resolution. Thus 20m and 60m bands are
-   read and then converted to 10m.
+  1. If strip is not NULL, then the scene is processed as the next row of
+     the strip and the LUTs, auxiliary data, and overlapping aerosol windows
+     of the previous rows are reused (see strip.c).
+  2. If cost_model is not NULL, then only the QA band is read and the
+     estimated cost of processing the scene is reported (see estimate.c).
+     Nothing is written.
+  3. If nshards is not zero, then only row shard ishard of the scene is
+     processed, as a region of interest, and its bands are appended to
+     <input>_shard<ishard>.xml.  The shards of the scene are combined with
+     --merge_shards once all of them have been processed (see shard.c).
 ******************************************************************************/
-int main (int argc, char *argv[])
+static int process_scene
+(
+    char *xml_infile,     /* I: input XML filename */
+    char *aux_infile,     /* I: input auxiliary filename for water vapor and
+                                ozone */
+    bool process_sr,      /* I: process the surface reflectance products */
+    bool write_toa,       /* I: write the TOA reflectance products */
+    char *ckpt_file,      /* I: aerosol checkpoint filename; NULL if the
+                                aerosol inversion is not checkpointed */
+    Roi_type_t roi_type,  /* I: type of region of interest; ROI_NONE if the
+                                full scene is processed */
+    double roi_coords[4], /* I: UL/LR coordinates of the region of
+                                interest */
+    bool fast_math,       /* I: use the fast-math SR path */
+    char *bands,          /* I: comma-separated list of the bands to be
+                                output; NULL if all bands are output */
+    bool pixel_angles,    /* I: use the per-pixel solar zenith for the SR */
+    float aero_adapt_tol, /* I: AOT tolerance for the adaptive aerosol
+                                inversion; 0.0 if not adaptive */
+    Lasrc_strip_t *strip, /* I/O: L8 strip this scene is the next row of;
+                                NULL if the scene is processed on its own */
+    Cost_model_t *cost_model, /* I: cost model for estimating the cost of
+                                the run; NULL if the scene is processed */
+    int ishard,           /* I: row shard of the scene to be processed
+                                (1-based) */
+    int nshards,          /* I: number of row shards of the scene; 0 if the
+                                scene isn't sharded */
+    bool verbose          /* I: verbose flag for printing messages */
+)
 {
-    bool verbose;            /* verbose flag for printing messages */
-    char FUNC_NAME[] = "main"; /* function name */
+    char FUNC_NAME[] = "process_scene"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
     char envi_file[STR_SIZE];/* ENVI filename */
     char *aux_path = NULL;   /* path for Landsat auxiliary data */
-    char *xml_infile = NULL; /* input XML filename */
-    char *aux_infile = NULL; /* input auxiliary filename for water vapor
-                                and ozone*/
     char *cptr = NULL;       /* pointer to the file extension */
-    char aux_year[5];        /* string to contain the year of auxiliary file */
+    char *roi_xml_file = NULL; /* XML filename for the ROI product */
+    char *out_xml = NULL;    /* XML filename for the output bands; the input
+                                XML file unless processing an ROI */
+    char roi_suffix[STR_SIZE]; /* suffix of the ROI XML filename */
 
     int retval;              /* return status */
+    int status = ERROR;      /* status of processing the scene */
     int ib;                  /* looping variable for input bands */
     int i;                   /* looping variables */
-    Sat_t sat;               /* satellite */
+    Sat_t sat = SAT_NULL;    /* satellite */
     Input_t *input = NULL;       /* input structure for the Landsat product */
     Output_t *toa_output = NULL; /* output structure and metadata for the TOA
                                     product */
     Output_t *radsat_output = NULL; /* output structure and metadata for the
                                        RADSAT product */
     Espa_internal_meta_t xml_metadata;  /* XML metadata structure */
+    Espa_internal_meta_t roi_metadata;  /* XML metadata structure for the
+                                           ROI product */
+    Espa_internal_meta_t *out_meta = NULL; /* metadata for the output bands;
+                                           the input metadata unless
+                                           processing an ROI */
     Espa_global_meta_t *gmeta = NULL;   /* pointer to global meta */
     Envi_header_t envi_hdr;      /* output ENVI header information */
-    struct stat statbuf;     /* buffer for the file stat function */
 
     int16 *sza = NULL;       /* L8 per-pixel solar zenith angles,
                                 nlines x nsamps */
@@ -87,69 +103,37 @@ int main (int argc, char *argv[])
     uint16 *radsat = NULL;   /* L8 QA band for radiometric saturation of the
                                 Level-1 product, nlines x nsamps */
     float xts;               /* scene center solar zenith angle (deg) */
-    float xmus;              /* cosine of solar zenith angle */
-    bool process_sr = true;  /* this is set to false if the solar zenith
-                                is too large and the surface reflectance
-                                cannot be calculated or if the user specifies
-                                that surface reflectance processing will not
-                                be completed and only TOA processing will be
-                                done */
-    bool write_toa = false;  /* this is set to true if the user specifies
-                                TOA products should be output for delivery */
     float pixsize;           /* pixel size for the reflectance bands */
     int nlines, nsamps;      /* number of lines/samples in the reflectance and
                                 thermal (L8) bands */
+    int roi_ul_line, roi_ul_samp;  /* UL line/sample of the ROI */
+    int roi_lr_line, roi_lr_samp;  /* LR line/sample of the ROI */
 
-    /* The following arguments are all names of the LUTs. The first five are
-       all tables of coefficients generated by the 6S software and provided
-       as input to this application. */
-    char anglehdf[STR_SIZE];  /* angle HDF filename */
-    char intrefnm[STR_SIZE];  /* intrinsic reflectance filename */
-    char transmnm[STR_SIZE];  /* transmission filename */
-    char spheranm[STR_SIZE];  /* spherical albedo filename */
-    char cmgdemnm[STR_SIZE];  /* climate modeling grid DEM filename */
-    char rationm[STR_SIZE];   /* ratio averages filename ("ratio map" used by
-                                 the aerosol retrieval algorithm) */
-    char auxnm[STR_SIZE];     /* auxiliary filename for ozone and water vapor*/
-
-    /* Read the command-line arguments */
-    retval = get_args (argc, argv, &xml_infile, &aux_infile, &process_sr,
-        &write_toa, &verbose);
-    if (retval != SUCCESS)
-    {   /* get_args already printed the error message */
-        exit (ERROR);
-    }
-
-    printf ("Starting TOA and surface reflectance processing ...\n");
-
-    /* Provide user information if verbose is turned on */
-    if (verbose)
-    {
-        printf ("  XML input file: %s\n", xml_infile);
-        printf ("  AUX input file: %s\n", aux_infile);
-        if (!process_sr)
-        {
-            printf ("    **Surface reflectance corrections will not be "
-                "completed.  Only top of atmosphere corrections will be "
-                "completed.\n");
-        }
-    }
+    Lasrc_ctx_t ctx;         /* liblasrc context for this scene, which also
+                                holds the names of the LUTs */
+    uint8 *ipflag = NULL;    /* aerosol QA band for the SR product,
+                                nlines x nsamps */
+    Cost_features_t features;  /* features of the scene for the estimate */
 
     /* Validate the input metadata file */
     if (validate_xml_file (xml_infile) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        return (ERROR);
     }
 
-    /* Initialize the metadata structure */
+    /* Initialize the metadata structures and the context, so everything
+       allocated below is released by the cleanup at the end whether or not
+       the scene is processed */
     init_metadata_struct (&xml_metadata);
+    roi_metadata.band = NULL;
+    memset (&ctx, 0, sizeof (Lasrc_ctx_t));
 
     /* Parse the metadata file into our internal metadata structure; also
        allocates space as needed for various pointers in the global and band
        metadata */
     if (parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
     {  /* Error messages already written */
-        exit (ERROR);
+        goto cleanup;
     }
 
     /* Open the reflectance product, set up the input data structure, and
@@ -160,7 +144,7 @@ int main (int argc, char *argv[])
         sprintf (errmsg, "Error opening/reading the input DN data: %s",
             xml_infile);
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        goto cleanup;
     }
     gmeta = &xml_metadata.global;
 
@@ -172,7 +156,16 @@ int main (int argc, char *argv[])
             "is not Landsat 8 or Sentinel-2.  This application only supports "
             "L8 or S2 products.");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        goto cleanup;
+    }
+
+    /* Strips are made up of Landsat WRS rows */
+    if (strip != NULL && sat != SAT_LANDSAT_8)
+    {
+        sprintf (errmsg, "Only Landsat 8 scenes can be processed as the rows "
+            "of a strip.");
+        error_handler (true, FUNC_NAME, errmsg);
+        goto cleanup;
     }
 
     /* Output some information from the input files if verbose */
@@ -201,13 +194,114 @@ int main (int argc, char *argv[])
         printf ("  Solar azimuth: %f\n", xml_metadata.global.solar_azimuth);
     }
 
+    /* If only a subset of the bands is output, then only those bands and the
+       bands needed by the aerosol inversion are read and processed */
+    if (bands != NULL)
+    {
+        if (set_input_bands (input, bands, process_sr) != SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
+        }
+    }
+
+    /* If processing a region of interest, then limit the input to the
+       processing window around the ROI and subset the metadata to that
+       window.  The output bands are written for the ROI only, to a separate
+       ROI product.  A row shard of the scene is processed the same way. */
+    out_meta = &xml_metadata;
+    out_xml = xml_infile;
+    if (roi_type != ROI_NONE || nshards > 0)
+    {
+        if (nshards > 0)
+        {
+            retval = shard_to_pixel (input->size.nlines, input->size.nsamps,
+                (sat == SAT_LANDSAT_8) ? L8_AERO_WINDOW : S2_AERO_WINDOW,
+                ishard, nshards, &roi_ul_line, &roi_ul_samp, &roi_lr_line,
+                &roi_lr_samp);
+            sprintf (roi_suffix, "_shard%d", ishard);
+        }
+        else
+        {
+            retval = roi_to_pixel (&xml_metadata, &input->size, roi_type,
+                roi_coords, &roi_ul_line, &roi_ul_samp, &roi_lr_line,
+                &roi_lr_samp);
+            strcpy (roi_suffix, "_roi");
+        }
+        if (retval != SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
+        }
+
+        if (set_input_roi (input, roi_ul_line, roi_ul_samp, roi_lr_line,
+            roi_lr_samp, (sat == SAT_LANDSAT_8) ? L8_AERO_WINDOW :
+            S2_AERO_WINDOW) != SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
+        }
+        input->roi.ishard = ishard;
+        input->roi.nshards = nshards;
+
+        /* Copy the metadata for the ROI product before the input metadata
+           is subset to the processing window */
+        roi_metadata = xml_metadata;
+        roi_metadata.band = malloc (xml_metadata.nbands *
+            sizeof (Espa_band_meta_t));
+        if (roi_metadata.band == NULL)
+        {
+            sprintf (errmsg, "Allocating the ROI band metadata");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
+        }
+        memcpy (roi_metadata.band, xml_metadata.band,
+            xml_metadata.nbands * sizeof (Espa_band_meta_t));
+
+        if (subset_xml_metadata (&roi_metadata, input->size.pixsize,
+            input->roi.full_nlines, input->roi.full_nsamps, roi_ul_line,
+            roi_ul_samp, input->roi.out_nlines, input->roi.out_nsamps) !=
+            SUCCESS ||
+            subset_xml_metadata (&xml_metadata, input->size.pixsize,
+            input->roi.full_nlines, input->roi.full_nsamps, input->roi.line0,
+            input->roi.samp0, input->roi.nlines, input->roi.nsamps) !=
+            SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
+        }
+
+        if (create_roi_xml (xml_infile, roi_suffix, &roi_metadata,
+            &roi_xml_file) != SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
+        }
+        out_meta = &roi_metadata;
+        out_xml = roi_xml_file;
+
+        if (nshards > 0)
+            printf ("Processing shard %d of %d: ", ishard, nshards);
+        printf ("Processing ROI lines %d-%d, samples %d-%d within window "
+            "lines %d-%d, samples %d-%d.  ROI product: %s\n", roi_ul_line,
+            roi_lr_line, roi_ul_samp, roi_lr_samp, input->roi.line0,
+            input->roi.line0 + input->roi.nlines - 1, input->roi.samp0,
+            input->roi.samp0 + input->roi.nsamps - 1, roi_xml_file);
+    }
+
     /* Pull the needed metadata from the XML file and input structure */
     xts = gmeta->solar_zenith;
     pixsize = (float) input->size.pixsize[0];
-    xmus = cos (xts * DEG2RAD);
     nlines = input->size.nlines;
     nsamps = input->size.nsamps;
 
+    /* Set up the library context for the TOA and SR computations */
+    if (lasrc_init_ctx (input, &xml_metadata, nlines, nsamps, pixsize, &ctx)
+        != SUCCESS)
+    {   /* error message already printed */
+        goto cleanup;
+    }
+    ctx.ckpt_file = ckpt_file;
+    ctx.fast_math = fast_math;
+    ctx.pixel_angles = pixel_angles;
+    ctx.aero_adapt_tol = aero_adapt_tol;
+    ctx.strip = strip;
+
     /* If this is OLI-only data, then surface reflectance can not be
        processed */
     if (input->meta.inst == INST_OLI && process_sr)
@@ -218,7 +312,7 @@ int main (int argc, char *argv[])
             "command-line argument to process. (oli-only cannot be corrected "
             "to surface reflectance)");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        goto cleanup;
     }
 
     /* If this is a Sentinel product and TOA reflectance was requested, then
@@ -232,6 +326,15 @@ int main (int argc, char *argv[])
         error_handler (false, FUNC_NAME, errmsg);
     }
 
+    /* The per-pixel angles are only read for L8 */
+    if (sat == SAT_SENTINEL_2 && pixel_angles)
+    {
+        sprintf (errmsg, "This is a Sentinel-2 product and the per-pixel "
+            "angles are not available.  The scene center geometry will be "
+            "used for the surface reflectance corrections.");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+
 
     /* The surface reflectance algorithm cannot be implemented for solar
        zenith angles greater than 76 degrees.  Need to flag if the current
@@ -244,43 +347,7 @@ int main (int argc, char *argv[])
             "Use the --process_sr=false command-line argument. "
             "(solar zenith angle out of range)");
         error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Allocate memory for all the data arrays. Note: sza and radsat are only
-       used for L8, toaband is for S2 only. */
-    if (verbose)
-        printf ("Allocating memory for the data arrays ...\n");
-    retval = memory_allocation_main (sat, nlines, nsamps, &sza, &qaband,
-        &radsat, &sband, &toaband);
-    if (retval != SUCCESS)
-    {   /* get_args already printed the error message */
-        sprintf (errmsg, "Error allocating memory for the data arrays from "
-            "the main application.");
-        error_handler (false, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Read the QA band for L8 */
-    if (sat == SAT_LANDSAT_8)
-    {
-        if (get_input_qa_lines (input, 0, 0, nlines, qaband) != SUCCESS)
-        {
-            sprintf (errmsg, "Reading QA band");
-            error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
-    }
-
-    /* Read the scaled solar zenith per pixel angle bands, in degrees */
-    if (sat == SAT_LANDSAT_8)
-    {
-        if (get_input_ppa_lines (input, 0, nlines, sza) != SUCCESS)
-        {
-            sprintf (errmsg, "Reading per-pixel solar and view angle bands");
-            error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+        goto cleanup;
     }
 
     /* Get the L8 auxiliary directory and the full pathname of the auxiliary
@@ -300,91 +367,72 @@ int main (int argc, char *argv[])
             error_handler (false, FUNC_NAME, errmsg);
         }
 
-        /* Grab the year of the auxiliary input file to be used for the correct
-           location of the auxiliary file in the auxiliary directory */
-        strncpy (aux_year, &aux_infile[5], 4);
-        aux_year[4] = '\0';
-
         /* Set up the look-up table files and make sure they exist */
-        if (sat == SAT_LANDSAT_8)
-        {
-            sprintf (anglehdf, "%s/LDCMLUT/ANGLE_NEW.hdf", aux_path);
-            sprintf (intrefnm, "%s/LDCMLUT/RES_LUT_V3.0-URBANCLEAN-V2.0.hdf",
-                aux_path);
-            sprintf (transmnm,"%s/LDCMLUT/TRANS_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
-                aux_path);
-            sprintf (spheranm, "%s/LDCMLUT/AERO_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
-                aux_path);
-        }
-        else if (sat == SAT_SENTINEL_2)
-        {
-            sprintf (anglehdf, "%s/MSILUT/ANGLE_NEW.hdf", aux_path);
-            sprintf (intrefnm, "%s/MSILUT/RES_LUT_V3.0-URBANCLEAN-V3.0.hdf",
-                aux_path);
-            sprintf (transmnm,"%s/MSILUT/TRANS_LUT_V3.0-URBANCLEAN-V3.0.ASCII",
-                aux_path);
-            sprintf (spheranm, "%s/MSILUT/AERO_LUT_V3.0-URBANCLEAN-V3.0.ASCII",
-                aux_path);
-        }
-
-        sprintf (cmgdemnm, "%s/CMGDEM.hdf", aux_path);
-        sprintf (rationm, "%s/ratiomapndwiexp.hdf", aux_path);
-        sprintf (auxnm, "%s/LADS/%s/%s", aux_path, aux_year, aux_infile);
-
-        if (stat (anglehdf, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find anglehdf data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", anglehdf);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
-
-        if (stat (intrefnm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find intrefnm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", intrefnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
+        if (lasrc_set_lut_files (aux_path, aux_infile, &ctx) != SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
         }
+    }
 
-        if (stat (transmnm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find transmnm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", transmnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
+    /* If only the cost of the run is being estimated, then report it from
+       the QA band and the sizes of the inputs and stop here */
+    if (cost_model != NULL)
+    {
+        if (get_cost_features (&ctx, process_sr, write_toa, &features) !=
+            SUCCESS)
+        {   /* error message already printed */
+            goto cleanup;
         }
+        report_cost_estimate (xml_infile, cost_model, &features);
+        status = SUCCESS;
+        goto cleanup;
+    }
 
-        if (stat (spheranm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find spheranm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", spheranm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+    /* Allocate memory for all the data arrays. Note: sza and radsat are only
+       used for L8, toaband is for S2 only. */
+    if (verbose)
+        printf ("Allocating memory for the data arrays ...\n");
+    retval = memory_allocation_main (sat, nlines, nsamps, &sza, &qaband,
+        &radsat, &sband, &ipflag, &toaband, input->proc_band);
+    if (retval != SUCCESS)
+    {   /* get_args already printed the error message */
+        sprintf (errmsg, "Error allocating memory for the data arrays from "
+            "the main application.");
+        error_handler (false, FUNC_NAME, errmsg);
+        goto cleanup;
+    }
 
-        if (stat (cmgdemnm, &statbuf) == -1)
-        {
-            sprintf (errmsg, "Could not find cmgdemnm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", cmgdemnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
+    /* Report the thread binding and the NUMA placement of the full-scene
+       arrays, which were first touched by the processing threads */
+    if (verbose)
+    {
+        report_thread_binding ();
+        report_first_touch_placement ("qaband", qaband, nlines, nsamps,
+            sizeof (uint16));
+        report_first_touch_placement ("sband", sband[0], nlines, nsamps,
+            sizeof (int16));
+    }
 
-        if (stat (rationm, &statbuf) == -1)
+    /* Read the QA band for L8 */
+    if (sat == SAT_LANDSAT_8)
+    {
+        if (get_input_qa_lines (input, 0, 0, nlines, qaband) != SUCCESS)
         {
-            sprintf (errmsg, "Could not find rationm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", rationm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
+            sprintf (errmsg, "Reading QA band");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
         }
+    }
 
-        if (stat (auxnm, &statbuf) == -1)
+    /* Read the scaled solar zenith per pixel angle bands, in degrees.  The
+       fill pixels are masked using the QA band as the angles are read. */
+    if (sat == SAT_LANDSAT_8)
+    {
+        if (get_input_ppa_lines (input, 0, nlines, qaband, sza) != SUCCESS)
         {
-            sprintf (errmsg, "Could not find auxnm data file: %s\n  Check "
-                "LASRC_AUX_DIR environment variable.", auxnm);
-            error_handler (false, FUNC_NAME, errmsg);
-            exit (ERROR);
+            sprintf (errmsg, "Reading per-pixel solar and view angle bands");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
         }
     }
 
@@ -395,14 +443,13 @@ int main (int argc, char *argv[])
     {
         /* Compute the TOA reflectance and TOA brightness temp */
         printf ("Calculating L8 TOA reflectance and TOA brightness temps...\n");
-        retval = compute_l8_toa_refl (input, &xml_metadata, qaband, nlines,
-            nsamps, gmeta->instrument, sza, sband, radsat);
+        retval = lasrc_compute_toa (&ctx, qaband, sza, sband, radsat);
         if (retval != SUCCESS)
         {
             sprintf (errmsg, "Error computing L8 TOA reflectance and TOA "
                 "brightness temperatures.");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
     }
     else if (sat == SAT_SENTINEL_2)
@@ -414,7 +461,7 @@ int main (int argc, char *argv[])
         {
             sprintf (errmsg, "Error reading S2 TOA reflectance bands.");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
     }
 
@@ -423,11 +470,11 @@ int main (int argc, char *argv[])
     {
         /* Open the TOA output file, and set up the bands according to whether
            the TOA reflectance bands will be written. */
-        toa_output = open_output (&xml_metadata, input, OUTPUT_TOA);
+        toa_output = open_output (out_meta, input, OUTPUT_TOA);
         if (toa_output == NULL)
         {   /* error message already printed */
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
         printf ("Writing TOA reflectance corrected data to the output "
                 "files ...\n");
@@ -439,6 +486,8 @@ int main (int argc, char *argv[])
         {
             for (ib = SR_L8_BAND1; ib <= SR_L8_BAND7; ib++)
             {
+                if (!is_output_band (input, OUTPUT_TOA, ib))
+                    continue;
                 printf ("  Band %d: %s\n", ib+1,
                     toa_output->metadata.band[ib].file_name);
                 if (put_output_lines (toa_output, sband[ib], ib, 0, nlines,
@@ -447,16 +496,16 @@ int main (int argc, char *argv[])
                     sprintf (errmsg, "Writing output TOA data for band %d",
                         ib+1);
                     error_handler (true, FUNC_NAME, errmsg);
-                    exit (ERROR);
+                    goto cleanup;
                 }
 
                 /* Create the ENVI header file this band */
                 if (create_envi_struct (&toa_output->metadata.band[ib],
-                    &xml_metadata.global, &envi_hdr) != SUCCESS)
+                    &out_meta->global, &envi_hdr) != SUCCESS)
                 {
                     sprintf (errmsg, "Creating ENVI header structure.");
                     error_handler (true, FUNC_NAME, errmsg);
-                    exit (ERROR);
+                    goto cleanup;
                 }
           
                 /* Write the ENVI header */
@@ -467,18 +516,18 @@ int main (int argc, char *argv[])
                 {
                     sprintf (errmsg, "Writing ENVI header file.");
                     error_handler (true, FUNC_NAME, errmsg);
-                    exit (ERROR);
+                    goto cleanup;
                 }
             }
 
             /* Append the TOA reflectance bands, bands 1-7, to the XML file */
-            if (append_metadata (7, toa_output->metadata.band, xml_infile) !=
-                SUCCESS)
+            if (append_output_bands (toa_output, input, OUTPUT_TOA,
+                SR_L8_BAND1, SR_L8_BAND7, out_xml) != SUCCESS)
             {
                 sprintf (errmsg, "Appending TOA reflectance bands to XML "
                     "file.");
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                goto cleanup;
             }
         }
 
@@ -486,10 +535,13 @@ int main (int argc, char *argv[])
            processing. */
         for (ib = SR_L8_BAND9; ib <= SR_L8_BAND11; ib++)
         {
-            /* If processing OLI-only, then bands 10 and 11 don't exist */
+            /* If processing OLI-only, then bands 10 and 11 don't exist.  Skip
+               the bands which aren't in the output subset. */
             if (!strcmp (gmeta->instrument, "OLI") &&
                 (ib == SR_L8_BAND10 || ib == SR_L8_BAND11))
                 continue;
+            if (!is_output_band (input, OUTPUT_TOA, ib))
+                continue;
             
             printf ("  Band %d: %s\n", ib+2,
                 toa_output->metadata.band[ib].file_name);
@@ -498,16 +550,16 @@ int main (int argc, char *argv[])
             {
                 sprintf (errmsg, "Writing output TOA data for band %d", ib+2);
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                goto cleanup;
             }
 
             /* Create the ENVI header file this band */
             if (create_envi_struct (&toa_output->metadata.band[ib],
-                &xml_metadata.global, &envi_hdr) != SUCCESS)
+                &out_meta->global, &envi_hdr) != SUCCESS)
             {
                 sprintf (errmsg, "Creating ENVI header structure.");
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                goto cleanup;
             }
   
             /* Write the ENVI header */
@@ -518,17 +570,17 @@ int main (int argc, char *argv[])
             {
                 sprintf (errmsg, "Writing ENVI header file.");
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                goto cleanup;
             }
 
             /* Append the TOA cirrus/thermal band to the XML file */
-            if (append_metadata (1, &toa_output->metadata.band[ib], xml_infile)
+            if (append_metadata (1, &toa_output->metadata.band[ib], out_xml)
                 != SUCCESS)
             {
                 sprintf (errmsg, "Appending TOA cirrus/thermal band to XML "
                     "file.");
                 error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                goto cleanup;
             }
         }
 
@@ -539,16 +591,20 @@ int main (int argc, char *argv[])
             /* Remove the TOA bands 1-7 that were created by the open routine,
                since they aren't actually used */
             for (ib = SR_L8_BAND1; ib <= SR_L8_BAND7; ib++)
-                unlink (toa_output->metadata.band[ib].file_name);
+            {
+                if (is_output_band (input, OUTPUT_TOA, ib))
+                    unlink (toa_output->metadata.band[ib].file_name);
+            }
         }
         free_output (toa_output, OUTPUT_TOA);
+        toa_output = NULL;
 
         /* Open the RADSAT output file */
-        radsat_output = open_output (&xml_metadata, input, OUTPUT_RADSAT);
+        radsat_output = open_output (out_meta, input, OUTPUT_RADSAT);
         if (radsat_output == NULL)
         {   /* error message already printed */
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
         printf ("Writing RADSAT data to the output files ...\n");
 
@@ -558,16 +614,16 @@ int main (int argc, char *argv[])
         {
             sprintf (errmsg, "Writing output RADSAT data");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
 
         /* Create the ENVI header file this band */
         if (create_envi_struct (&radsat_output->metadata.band[SR_RADSAT],
-            &xml_metadata.global, &envi_hdr) != SUCCESS)
+            &out_meta->global, &envi_hdr) != SUCCESS)
         {
             sprintf (errmsg, "Creating ENVI header structure.");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
           
         /* Write the ENVI header */
@@ -578,22 +634,24 @@ int main (int argc, char *argv[])
         {
             sprintf (errmsg, "Writing ENVI header file.");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
 
         /* Append the RADSAT band to the XML file */
         if (append_metadata (1, &radsat_output->metadata.band[SR_RADSAT],
-            xml_infile) != SUCCESS)
+            out_xml) != SUCCESS)
         {
             sprintf (errmsg, "Appending the RADSAT band to XML file.");
             error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
+            goto cleanup;
         }
 
         /* Close output radsat product, cleanup bands, and free the memory */
         close_output (sat, radsat_output, OUTPUT_RADSAT);
         free_output (radsat_output, OUTPUT_RADSAT);
+        radsat_output = NULL;
         free (radsat);
+        radsat = NULL;
     }
 
     /* Only continue with the surface reflectance corrections if SR processing
@@ -604,70 +662,345 @@ int main (int argc, char *argv[])
            the data to the SR output file */
         printf ("Performing atmospheric corrections for each reflectance "
             "band ...\n");
-        if (sat == SAT_LANDSAT_8)
+        retval = lasrc_compute_sr (&ctx, qaband, sza, toaband, sband,
+            ipflag);
+        if (retval != SUCCESS)
         {
-            retval = compute_l8_sr_refl (input, &xml_metadata, xml_infile,
-                qaband, nlines, nsamps, pixsize, sband, xts, xmus, anglehdf,
-                intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm);
-            if (retval != SUCCESS)
-            {
-                sprintf (errmsg, "Error computing L8 surface reflectance");
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
+            sprintf (errmsg, "Error computing surface reflectance");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
         }
-        else if (sat == SAT_SENTINEL_2)
+
+        /* Write the SR and aerosol QA bands to the output product */
+        if (sat == SAT_LANDSAT_8)
+            retval = write_l8_sr_refl (input, out_meta, out_xml,
+                nlines, sband, ipflag);
+        else
+            retval = write_s2_sr_refl (input, out_meta, out_xml,
+                nlines, sband, ipflag);
+        if (retval != SUCCESS)
         {
-            retval = compute_s2_sr_refl (input, &xml_metadata, xml_infile,
-                qaband, nlines, nsamps, pixsize, toaband, sband, xts, xmus,
-                anglehdf, intrefnm, transmnm, spheranm, cmgdemnm, rationm,
-                auxnm);
-            if (retval != SUCCESS)
-            {
-                sprintf (errmsg, "Error computing S2 surface reflectance");
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
+            sprintf (errmsg, "Error writing the surface reflectance product");
+            error_handler (true, FUNC_NAME, errmsg);
+            goto cleanup;
         }
+
+        /* The SR products are complete, so the aerosol checkpoint is no
+           longer needed */
+        if (ckpt_file != NULL)
+            remove (ckpt_file);
     }  /* end if process_sr */
-  
-    /* Free the metadata structure */
+    status = SUCCESS;
+
+cleanup:
+    /* Close the output products left open by an error */
+    if (toa_output != NULL)
+    {
+        close_output (sat, toa_output, OUTPUT_TOA);
+        free_output (toa_output, OUTPUT_TOA);
+    }
+    if (radsat_output != NULL)
+    {
+        close_output (sat, radsat_output, OUTPUT_RADSAT);
+        free_output (radsat_output, OUTPUT_RADSAT);
+    }
+
+    /* Free the metadata structure.  The ROI metadata shares everything but
+       the band array with the input metadata. */
     free_metadata (&xml_metadata);
+    free (roi_metadata.band);
 
     /* Close the input product */
     printf ("Closing input/output and freeing pointers ...\n");
-    close_input (input);
-    free_input (input);
+    if (input != NULL)
+    {
+        close_input (input);
+        free_input (input);
+    }
 
-    /* Free the filename pointers */
-    free (xml_infile);
-    free (aux_infile);
+    /* Free the ROI XML filename */
+    free (roi_xml_file);
+
+    /* Free the liblasrc context */
+    lasrc_free_ctx (&ctx);
 
-    /* Free memory for band data */
+    /* Free memory for band data; the arrays which weren't allocated are
+       NULL */
     free (qaband);
-    if (sat == SAT_LANDSAT_8)
+    free (ipflag);
+    free (sza);
+    free (radsat);
+    if (sband != NULL)
     {
-        free (sza);
-        for (i = 0; i < NBAND_L8_TTL_OUT-1; i++)
+        for (i = 0; i < ((sat == SAT_LANDSAT_8) ? NBAND_L8_TTL_OUT :
+            NBAND_S2_TTL_OUT) - 1; i++)
             free (sband[i]);
     }
-    else if (sat == SAT_SENTINEL_2)
+    if (toaband != NULL)
     {
         for (i = 0; i < NBAND_S2_TTL_OUT-1; i++)
-        {
             free (toaband[i]);
-            free (sband[i]);
-        }
-        free (toaband);
     }
+    free (toaband);
     free (sband);
 
+    return (status);
+}
+
+
+/******************************************************************************
+MODULE:  lasrc (Landsat Surface Reflectance Code - LaSRC)
+
+PURPOSE:  Computes the surface reflectance values for the Landsat 8 and
+Sentinel 2 products.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred during processing of the surface reflectance
+SUCCESS         Processing was successful
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+**Landsat 8:
+1. Bands 1-7 are corrected to surface reflectance.  Band 8 (pand band) is not
+   processed.  Band 9 (cirrus band) is corrected to TOA reflectance.  Bands
+   10 and 11 are corrected to brightness temperature.
+2. SDstart and SDreaddata have minor memory leaks.  Ultimately both call
+   HAregister_atom which makes a malloc call and the memory is never freed.
+3. Conversion algorithms for TOA reflectance and TOA brightness temperature are
+   available from
+   http://landsat.usgs.gov/Landsat8_Using_Product.php
+4. The TOA and SR corrections utilize solar and view angles.  Previous versions
+   simply corrected every pixel for the solar angles at the scene center.
+   However as of version 1.0.0, the solar and view angles are read from the
+   per-pixel angle bands and better reflect the angle at that location within
+   the scene.  These solar/view angles are scaled int16s and therefore need to
+   be unscaled (multiply by 0.01) before using.  They are in units of degrees.
+5. The solar angles from band to band are fairly stable, thus a single array of
+   per-pixel angles will be used.  The array can be from a "representative
+   band" for the reflectance bands or it can be an average of the reflectance
+   bands. We will use band 4 as the representative band for these per-pixel
+   angle values.
+6. The view/observation angles from band to band are a bit more unstable
+   (particularly the view azimuth) near nadir.  A single array of per-pixel
+   angles will still be used, however the information near nadir may be slightly
+   affected.  We will use band 4 as the representative band for these per-pixel
+   angle values.
+7. The per-pixel angle bands are masked with the Level-1 QA fill as they are
+   read, so they don't need to be masked (and rewritten) ahead of time.
+
+**Sentinel 2:
+1. Bands 1-12, including band 8a, are corrected to surface reflectance.
+2. All bands are converted to 10m band resolution. Thus 20m and 60m bands are
+   read and then converted to 10m.
+
+**Strips:
+1. With --strip, the XML files are the consecutive WRS rows of one Landsat 8
+   path acquisition, in order along the path.  Each row is processed and
+   written as its own product, but the LUTs and auxiliary data are only read
+   once, and each row reuses the clear aerosol windows of the previous row
+   where the two overlap.
+
+**Estimates:
+1. With --estimate, nothing is processed.  The peak memory, the wall time for
+   a range of thread counts, and the I/O volume of each scene are estimated
+   from the XML file, the QA band, and the sizes of the LUT and auxiliary
+   files, for packing the runs on the cluster.  The default cost model can
+   be replaced by one fit to past runs with calibrate_lasrc_cost.py and
+   passed as --estimate=cost_model_file.
+
+**Shards:
+1. With --shard=n/N, only row shard n of the N shards of the scene is
+   processed, so the shards of a large scene can be run as separate
+   processes on one or more nodes sharing the working directory.  The shards
+   exchange their clear aerosols for the scene median through that
+   directory, so all N shards need to be running, or have run, at the same
+   time.  Once all of them have finished, --merge_shards=N combines their
+   bands into the full-scene product.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    bool verbose;            /* verbose flag for printing messages */
+    bool fast_math;          /* use the fast-math SR path */
+    bool pixel_angles;       /* use the per-pixel solar zenith for the SR */
+    bool strip_mode;         /* process the XML files as the rows of a strip */
+    bool estimate;           /* only estimate the cost of the run */
+    float aero_adapt_tol;    /* AOT tolerance for the adaptive aerosol
+                                inversion; 0.0 if not adaptive */
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int retval;              /* return status */
+    char *xml_infile = NULL; /* input XML filename, or the comma-separated
+                                list of row XML filenames for a strip */
+    char *aux_infile = NULL; /* input auxiliary filename for water vapor
+                                and ozone*/
+    char *ckpt_file = NULL;  /* aerosol checkpoint filename, NULL if the
+                                aerosol inversion is not checkpointed */
+    char *bands = NULL;      /* comma-separated list of the bands to be
+                                output, NULL if all bands are output */
+    char *cost_model_file = NULL; /* cost model file for the estimate, NULL
+                                if the default cost model is used */
+    char *row_xml = NULL;    /* XML filename of the current row of the strip */
+    char *next_xml = NULL;   /* remaining row XML filenames of the strip */
+    int nrows = 0;           /* number of rows of the strip processed */
+    bool process_sr = true;  /* this is set to false if the solar zenith
+                                is too large and the surface reflectance
+                                cannot be calculated or if the user specifies
+                                that surface reflectance processing will not
+                                be completed and only TOA processing will be
+                                done */
+    bool write_toa = false;  /* this is set to true if the user specifies
+                                TOA products should be output for delivery */
+    Roi_type_t roi_type;     /* type of region of interest; ROI_NONE if the
+                                full scene is processed */
+    double roi_coords[4];    /* UL/LR coordinates of the region of interest */
+    Lasrc_strip_t strip;     /* LUTs, auxiliary data, and aerosol windows
+                                shared by the rows of a strip */
+    Cost_model_t model;      /* cost model for the estimate */
+    Cost_model_t *cost_model = NULL; /* cost model if only estimating the
+                                cost of the run; NULL otherwise */
+    int ishard;              /* row shard of the scene to be processed */
+    int nshards;             /* number of row shards of the scene; 0 if the
+                                scene isn't sharded */
+    int merge_nshards;       /* number of row shards to be merged; 0 if not
+                                merging the shards */
+
+    /* Read the command-line arguments */
+    retval = get_args (argc, argv, &xml_infile, &aux_infile, &process_sr,
+        &write_toa, &ckpt_file, &roi_type, roi_coords, &fast_math, &bands,
+        &pixel_angles, &aero_adapt_tol, &strip_mode, &estimate,
+        &cost_model_file, &ishard, &nshards, &merge_nshards, &verbose);
+    if (retval != SUCCESS)
+    {   /* get_args already printed the error message */
+        exit (ERROR);
+    }
+
+    /* If merging the shards of a scene, then that is all that is done */
+    if (merge_nshards > 0)
+    {
+        if (merge_shards (xml_infile, merge_nshards) != SUCCESS)
+        {   /* error message already printed */
+            exit (ERROR);
+        }
+        free (xml_infile);
+        free (aux_infile);
+        printf ("Merging of %d shards complete.\n", merge_nshards);
+        exit (SUCCESS);
+    }
+
+    /* Set up the cost model if only estimating the cost of the run */
+    if (estimate)
+    {
+        init_cost_model (&model);
+        if (cost_model_file != NULL &&
+            read_cost_model (cost_model_file, &model) != SUCCESS)
+        {   /* error message already printed */
+            exit (ERROR);
+        }
+        cost_model = &model;
+    }
+
+    printf ("Starting TOA and surface reflectance processing ...\n");
+
+    /* Provide user information if verbose is turned on */
+    if (verbose)
+    {
+        printf ("  XML input file: %s\n", xml_infile);
+        printf ("  AUX input file: %s\n", aux_infile);
+        if (ckpt_file != NULL)
+            printf ("  Aerosol checkpoint file: %s\n", ckpt_file);
+        if (fast_math)
+            printf ("  Fast-math surface reflectance enabled\n");
+        if (pixel_angles)
+            printf ("  Per-pixel solar zenith surface reflectance enabled\n");
+        if (aero_adapt_tol > 0.0)
+            printf ("  Adaptive aerosol inversion AOT tolerance: %g\n",
+                aero_adapt_tol);
+        if (bands != NULL)
+            printf ("  Output bands: %s\n", bands);
+        if (roi_type == ROI_PIXEL)
+            printf ("  ROI UL/LR line/samp: %g,%g %g,%g\n", roi_coords[0],
+                roi_coords[1], roi_coords[2], roi_coords[3]);
+        else if (roi_type == ROI_PROJ)
+            printf ("  ROI UL/LR proj x/y: %f,%f %f,%f\n", roi_coords[0],
+                roi_coords[1], roi_coords[2], roi_coords[3]);
+        if (strip_mode)
+            printf ("  Processing the XML files as the rows of a strip\n");
+        if (nshards > 0)
+            printf ("  Processing row shard %d of %d\n", ishard, nshards);
+        if (estimate)
+            printf ("  Only estimating the cost of the run%s%s\n",
+                (cost_model_file != NULL) ? " with cost model " : "",
+                (cost_model_file != NULL) ? cost_model_file : "");
+        if (!process_sr)
+        {
+            printf ("    **Surface reflectance corrections will not be "
+                "completed.  Only top of atmosphere corrections will be "
+                "completed.\n");
+        }
+    }
+
+
+    /* Process the scene on its own */
+    if (!strip_mode)
+    {
+        if (process_scene (xml_infile, aux_infile, process_sr, write_toa,
+            ckpt_file, roi_type, roi_coords, fast_math, bands, pixel_angles,
+            aero_adapt_tol, NULL, cost_model, ishard, nshards, verbose) !=
+            SUCCESS)
+        {   /* error message already printed */
+            exit (ERROR);
+        }
+    }
+
+    /* Process the rows of the strip in order, each one picking up the LUTs,
+       auxiliary data, and aerosol windows of the rows before it */
+    else
+    {
+        init_strip (&strip);
+        next_xml = xml_infile;
+        while (next_xml != NULL)
+        {
+            row_xml = next_xml;
+            next_xml = strchr (row_xml, ',');
+            if (next_xml != NULL)
+                *next_xml++ = '\0';
+
+            printf ("Processing row %d of the strip: %s\n", nrows+1,
+                row_xml);
+            if (process_scene (row_xml, aux_infile, process_sr, write_toa,
+                ckpt_file, roi_type, roi_coords, fast_math, bands,
+                pixel_angles, aero_adapt_tol, &strip, cost_model, 0, 0,
+                verbose) != SUCCESS)
+            {
+                sprintf (errmsg, "Processing row %d of the strip: %s",
+                    nrows+1, row_xml);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+            nrows++;
+        }
+        free_strip (&strip);
+    }
+
+    /* Free the filename pointers */
+    free (xml_infile);
+    free (aux_infile);
+    free (ckpt_file);
+    free (bands);
+    free (cost_model_file);
+
     /* Indicate successful completion of processing */
     printf ("Surface reflectance processing complete!\n");
     exit (SUCCESS);
 }
 
 
+
 /******************************************************************************
 MODULE:  usage
 
@@ -697,7 +1030,13 @@ void usage ()
     printf ("usage: lasrc "
             "--xml=input_xml_filename "
             "--aux=input_auxiliary_filename "
-            "--process_sr=true:false --write_toa [--verbose] [--version]\n");
+            "--process_sr=true:false --write_toa [--checkpoint=filename] "
+            "[--roi=ul_line,ul_samp,lr_line,lr_samp | "
+            "--roi_proj=ul_x,ul_y,lr_x,lr_y] [--bands=band_list] "
+            "[--fast_math] [--pixel_angles] [--adaptive_aero=aot_tolerance] "
+            "[--strip] [--estimate[=cost_model_file]] [--shard=n/N] "
+            "[--verbose] [--version]\n");
+    printf ("       lasrc --xml=input_xml_filename --merge_shards=N\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML file to be processed\n");
@@ -717,6 +1056,74 @@ void usage ()
             "to the output file. This argument has no relevance for Sentinel-2 "
             "products, since they are input as TOA reflectance, and therefore "
             "is ignored.\n");
+    printf ("    -checkpoint: name of a file in which to save the results of "
+            "the aerosol inversion.  If the file exists from a previous run "
+            "on the same inputs, the aerosol inversion is skipped and the "
+            "saved results are used.  The file is removed once the surface "
+            "reflectance products have been written.\n");
+    printf ("    -roi: only process the region of interest with the "
+            "specified 0-based UL and LR (inclusive) line/sample of the "
+            "reflectance bands.  The ROI plus a small halo of aerosol windows "
+            "is read and processed, and the output bands cover only the ROI. "
+            "They are written to an ROI product whose XML file is the input "
+            "XML filename with _roi added before the .xml extension.  The "
+            "output band filenames are the same as for a full-scene run.\n");
+    printf ("    -roi_proj: same as -roi, but the UL and LR corners of the "
+            "region of interest are specified as projection x/y "
+            "coordinates.\n");
+    printf ("    -bands: comma-separated list of the bands to be output, "
+            "e.g. b2,b3,b4,b8 for S2 or 4,5 for L8.  L8 bands are 1-7 and "
+            "9-11, and S2 bands are 1-12 and 8a.  Only these bands are "
+            "corrected and written, along with the aerosol QA and radsat "
+            "bands.  The bands needed by the aerosol inversion (L8 bands 1, "
+            "2, 4, 5, and 7; S2 bands 1, 2, 4, 8a, and 12) are always read "
+            "and corrected.  The radsat band only flags saturation in the "
+            "bands which are read.  The default is all bands.\n");
+    printf ("    -fast_math: run the aerosol inversion and atmospheric "
+            "correction in single precision with approximate transcendental "
+            "functions.  A sample of the pixels is also run through the "
+            "reference routines, and the distribution of the differences is "
+            "reported at the end of the surface reflectance processing.\n");
+    printf ("    -pixel_angles: correct the L8 surface reflectance with the "
+            "per-pixel solar zenith angle rather than the scene center solar "
+            "zenith.  The atmospheric coefficients are computed on a one "
+            "degree grid spanning the solar zenith angles in the scene and "
+            "interpolated for each pixel.  Ignored for S2.\n");
+    printf ("    -adaptive_aero: invert the aerosols on a coarse lattice of "
+            "every %d aerosol windows first, and interpolate the windows in "
+            "between when the surrounding lattice windows are clear and "
+            "their AOTs agree within the specified tolerance (e.g. 0.02).  "
+            "Other windows are inverted as usual.  The number of "
+            "interpolated windows and the AOT differences from the full "
+            "inversion for a sample of them are reported.  The default is "
+            "to invert every window.\n", AERO_COARSE_STEP);
+    printf ("    -strip: process the consecutive WRS rows of one Landsat 8 "
+            "path acquisition as a strip.  The -xml value is then a "
+            "comma-separated list of the row XML files, in order along the "
+            "path.  Each row is written as its own product.  The LUTs and "
+            "auxiliary data are read once for the strip, and each row reuses "
+            "the clear aerosol windows of the previous row where the rows "
+            "overlap.  Not supported with -checkpoint, -roi, or "
+            "-roi_proj.\n");
+    printf ("    -estimate: don't process the scene, but estimate the peak "
+            "memory, the wall time for 1 to 32 threads, and the I/O volume "
+            "of processing it with the other options given.  Only the XML "
+            "file and the QA band are read.  An optional cost model file "
+            "fit to past runs by calibrate_lasrc_cost.py replaces the "
+            "default cost model coefficients.\n");
+    printf ("    -shard: only process row shard n of the N shards of the "
+            "scene, e.g. 2/4, so the shards can be run as separate processes "
+            "on one or more nodes sharing the working directory.  The bands "
+            "are written with _shard<n> added to their filenames and "
+            "appended to the input XML filename with _shard<n> added before "
+            "the .xml extension.  The shards exchange their clear aerosols "
+            "through the working directory, so all N shards need to be run "
+            "at the same time.  Not supported with -strip, -checkpoint, "
+            "-roi, -roi_proj, or -adaptive_aero.\n");
+    printf ("    -merge_shards: once all N shards of the scene have been "
+            "processed, combine their bands into the full-scene bands, "
+            "append those to the input XML file, and remove the shard "
+            "products.  -aux is not needed.\n");
     printf ("    -verbose: should intermediate messages be printed? (default "
             "is false)\n");
     printf ("    -version: print the LaSRC version. When this parameter is "
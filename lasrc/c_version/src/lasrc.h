@@ -11,6 +11,8 @@
 #include "input.h"
 #include "output.h"
 #include "lut_subr.h"
+#include "valid_span.h"
+#include "strip.h"
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "parse_metadata.h"
@@ -36,6 +38,32 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    char **ckpt_file,     /* O: address of the aerosol checkpoint file; NULL
+                                if checkpointing was not requested */
+    Roi_type_t *roi_type, /* O: type of region of interest; ROI_NONE if the
+                                full scene is processed */
+    double *roi_coords,   /* O: UL line/samp and LR line/samp (ROI_PIXEL) or
+                                UL x/y and LR x/y (ROI_PROJ) of the region of
+                                interest [4] */
+    bool *fast_math,      /* O: use the fast-math SR path and report its
+                                differences from the reference */
+    char **bands,         /* O: address of the comma-separated list of bands
+                                to be output; NULL if all bands are output */
+    bool *pixel_angles,   /* O: correct the L8 SR with the per-pixel solar
+                                zenith rather than the scene center */
+    float *aero_adapt_tol,/* O: AOT tolerance for the adaptive aerosol
+                                inversion; 0.0 if not adaptive */
+    bool *strip,          /* O: process the XML files as the rows of a
+                                strip */
+    bool *estimate,       /* O: only estimate the cost of the run */
+    char **cost_model_file,/* O: address of the cost model file for the
+                                estimate; NULL if the defaults are used */
+    int *ishard,          /* O: row shard of the scene to be processed
+                                (1-based) */
+    int *nshards,         /* O: number of row shards of the scene; 0 if the
+                                scene isn't sharded */
+    int *merge_nshards,   /* O: number of row shards to be merged into the
+                                full-scene product; 0 if not merging */
     bool *verbose         /* O: verbose flag */
 );
 
@@ -53,6 +81,7 @@ int compute_l8_toa_refl
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans,/* I: valid span of each line, from the QA band */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     char *instrument,   /* I: instrument to be processed (OLI, TIRS) */
@@ -78,21 +107,35 @@ int compute_l8_sr_refl
     Input_t *input,     /* I: input structure for the Landsat product */
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
-    char *xml_infile,   /* I: input XML filename */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
+    Valid_span_t *spans,/* I: valid span of each line, from the QA band */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
     int16 **sband,      /* I/O: input TOA and output surface reflectance */
+    uint8 *ipflag,      /* O: aerosol QA band, nlines x nsamps; array should
+                              be all zeros on input to this routine */
     float xts,          /* I: solar zenith angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
+    int16 *sza,         /* I: scaled per-pixel solar zenith angles (degrees),
+                              nlines x nsamps; NULL to correct with the scene
+                              center geometry */
     char *anglehdf,     /* I: angle HDF filename */
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *ckpt_file,    /* I: aerosol checkpoint filename (NULL if not
+                              checkpointing) */
+    bool fast_math,     /* I: use the fast-math inversion and correction and
+                              report the differences from the reference */
+    float aero_adapt_tol,/* I: AOT tolerance for interpolating the aerosol
+                              windows from the coarse lattice; 0.0 inverts
+                              every window */
+    Lasrc_strip_t *strip/* I/O: strip of WRS rows this scene belongs to;
+                              NULL if the scene is processed on its own */
 );
 
 int compute_s2_sr_refl
@@ -100,13 +143,14 @@ int compute_s2_sr_refl
     Input_t *input,     /* I: input structure for the Landsat product */
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
-    char *xml_infile,   /* I: input XML filename */
     uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
     uint16 **toaband,   /* I: input TOA reflectance bands, nlines x nsamps */
     int16 **sband,      /* O: output SR bands, nlines x nsamps */
+    uint8 *ipflag,      /* O: aerosol QA band, nlines x nsamps; array should
+                              be all zeros on input to this routine */
     float xts,          /* I: scene center solar zenith angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
     char *anglehdf,     /* I: angle HDF filename */
@@ -115,7 +159,36 @@ int compute_s2_sr_refl
     char *spheranm,     /* I: spherical albedo filename */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    char *ckpt_file,    /* I: aerosol checkpoint filename (NULL if not
+                              checkpointing) */
+    bool fast_math,     /* I: use the fast-math inversion and correction and
+                              report the differences from the reference */
+    float aero_adapt_tol/* I: AOT tolerance for interpolating the aerosol
+                              windows from the coarse lattice; 0.0 inverts
+                              every window */
+);
+
+int write_l8_sr_refl
+(
+    Input_t *input,     /* I: input structure for the Landsat 8 product */
+    Espa_internal_meta_t *xml_metadata,
+                        /* I/O: XML metadata structure */
+    char *xml_infile,   /* I: input XML filename */
+    int nlines,         /* I: number of lines in reflectance bands */
+    int16 **sband,      /* I: surface reflectance bands, nlines x nsamps */
+    uint8 *ipflag       /* I: aerosol QA band, nlines x nsamps */
+);
+
+int write_s2_sr_refl
+(
+    Input_t *input,     /* I: input structure for the Sentinel-2 product */
+    Espa_internal_meta_t *xml_metadata,
+                        /* I/O: XML metadata structure */
+    char *xml_infile,   /* I: input XML filename */
+    int nlines,         /* I: number of lines in reflectance bands */
+    int16 **sband,      /* I: surface reflectance bands, nlines x nsamps */
+    uint8 *ipflag       /* I: aerosol QA band, nlines x nsamps */
 );
 
 int init_sr_refl
@@ -131,6 +204,9 @@ int init_sr_refl
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    bool luts_read,     /* I: were the LUTs and auxiliary data already read
+                              (for a previous row of the strip)?  If so, only
+                              the scene center values are computed. */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
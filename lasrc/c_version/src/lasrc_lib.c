@@ -0,0 +1,409 @@
+/*****************************************************************************
+FILE: lasrc_lib.c
+
+PURPOSE: Contains the liblasrc entry points, which allow the TOA and surface
+reflectance corrections to be run on caller-supplied memory buffers from
+within another application.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. None of these routines exit.  Errors are reported via error_handler and
+   ERROR is returned to the caller.
+2. The library doesn't read the input bands or write the output products.
+   The lasrc application uses these same routines, along with its own input
+   and output handling.
+3. The HDF4 library used to read the LUTs and auxiliary files is not
+   thread-safe.  Applications processing multiple scenes concurrently need to
+   serialize the calls to lasrc_compute_sr unless the HDF4 library was built
+   thread-safe.
+4. For L8 the valid span of each line is built from the QA band on the first
+   call to lasrc_compute_toa or lasrc_compute_sr, and is reused for the rest
+   of the scene.  The same QA band must therefore be passed to both.
+*****************************************************************************/
+#include <sys/stat.h>
+#include "lasrc_lib.h"
+
+
+/******************************************************************************
+MODULE:  get_valid_spans
+
+PURPOSE:  Builds the L8 valid span index for the context, if it hasn't
+already been built.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error building the valid spans
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int get_valid_spans
+(
+    Lasrc_ctx_t *ctx,    /* I/O: context for the current scene */
+    uint16 *qaband       /* I: QA band for the input image, nlines x nsamps */
+)
+{
+    char FUNC_NAME[] = "get_valid_spans";   /* function name */
+    char errmsg[STR_SIZE];                  /* error message */
+
+    if (ctx->spans != NULL)
+        return (SUCCESS);
+
+    ctx->spans = build_valid_spans (qaband, ctx->nlines, ctx->nsamps);
+    if (ctx->spans == NULL)
+    {
+        sprintf (errmsg, "Building the valid span of each line");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+/******************************************************************************
+MODULE:  lasrc_init_ctx
+
+PURPOSE:  Initializes the context for processing a scene, using the input
+metadata and the size of the reflectance bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The scene is not a supported L8 or S2 product
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The LUT filenames are empty, and checkpointing and fast-math are
+     disabled on return.  Use lasrc_set_lut_files to set up the LUT
+     filenames.
+******************************************************************************/
+int lasrc_init_ctx
+(
+    Input_t *input,      /* I: input structure (only input->meta is used) */
+    Espa_internal_meta_t *xml_metadata,
+                         /* I: XML metadata structure */
+    int nlines,          /* I: number of lines in the reflectance bands */
+    int nsamps,          /* I: number of samples in the reflectance bands */
+    float pixsize,       /* I: pixel size for the reflectance bands */
+    Lasrc_ctx_t *ctx     /* O: initialized context */
+)
+{
+    char FUNC_NAME[] = "lasrc_init_ctx";   /* function name */
+    char errmsg[STR_SIZE];                 /* error message */
+
+    memset (ctx, 0, sizeof (Lasrc_ctx_t));
+
+    /* Verify that we have either an L8 or S2 product */
+    if (input->meta.sat != SAT_LANDSAT_8 && input->meta.sat != SAT_SENTINEL_2)
+    {
+        sprintf (errmsg, "The satellite identified from the input metadata "
+            "is not Landsat 8 or Sentinel-2.  This application only supports "
+            "L8 or S2 products.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    ctx->input = input;
+    ctx->xml_metadata = xml_metadata;
+    ctx->sat = input->meta.sat;
+    ctx->nlines = nlines;
+    ctx->nsamps = nsamps;
+    ctx->pixsize = pixsize;
+    ctx->xts = xml_metadata->global.solar_zenith;
+    ctx->xmus = cos (ctx->xts * DEG2RAD);
+    ctx->ckpt_file = NULL;
+    ctx->fast_math = false;
+    ctx->pixel_angles = false;
+    ctx->aero_adapt_tol = 0.0;
+    ctx->strip = NULL;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lasrc_set_lut_files
+
+PURPOSE:  Sets up the names of the LUTs and auxiliary files needed for the
+surface reflectance corrections, and verifies that they exist.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           One of the LUT or auxiliary files does not exist
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The auxiliary file is expected to be in the LADS/<year> directory of
+     aux_path, where the year comes from the auxiliary filename.
+******************************************************************************/
+int lasrc_set_lut_files
+(
+    char *aux_path,      /* I: directory containing the LUTs and the LADS
+                               auxiliary directory */
+    char *aux_infile,    /* I: name of the auxiliary file containing water
+                               vapor and ozone */
+    Lasrc_ctx_t *ctx     /* I/O: context to be updated with the filenames */
+)
+{
+    char FUNC_NAME[] = "lasrc_set_lut_files";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char aux_year[5];        /* string to contain the year of auxiliary file */
+    char *lut_file[7];       /* LUT and auxiliary filenames to be checked */
+    char *lut_name[7] = {"anglehdf", "intrefnm", "transmnm", "spheranm",
+        "cmgdemnm", "rationm", "auxnm"};
+    int i;                   /* looping variable */
+    struct stat statbuf;     /* buffer for the file stat function */
+
+    /* Grab the year of the auxiliary input file to be used for the correct
+       location of the auxiliary file in the auxiliary directory */
+    if (strlen (aux_infile) < 9)
+    {
+        sprintf (errmsg, "Invalid auxiliary filename: %s", aux_infile);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strncpy (aux_year, &aux_infile[5], 4);
+    aux_year[4] = '\0';
+
+    /* Set up the look-up table files */
+    if (ctx->sat == SAT_LANDSAT_8)
+    {
+        sprintf (ctx->anglehdf, "%s/LDCMLUT/ANGLE_NEW.hdf", aux_path);
+        sprintf (ctx->intrefnm,
+            "%s/LDCMLUT/RES_LUT_V3.0-URBANCLEAN-V2.0.hdf", aux_path);
+        sprintf (ctx->transmnm,
+            "%s/LDCMLUT/TRANS_LUT_V3.0-URBANCLEAN-V2.0.ASCII", aux_path);
+        sprintf (ctx->spheranm,
+            "%s/LDCMLUT/AERO_LUT_V3.0-URBANCLEAN-V2.0.ASCII", aux_path);
+    }
+    else if (ctx->sat == SAT_SENTINEL_2)
+    {
+        sprintf (ctx->anglehdf, "%s/MSILUT/ANGLE_NEW.hdf", aux_path);
+        sprintf (ctx->intrefnm,
+            "%s/MSILUT/RES_LUT_V3.0-URBANCLEAN-V3.0.hdf", aux_path);
+        sprintf (ctx->transmnm,
+            "%s/MSILUT/TRANS_LUT_V3.0-URBANCLEAN-V3.0.ASCII", aux_path);
+        sprintf (ctx->spheranm,
+            "%s/MSILUT/AERO_LUT_V3.0-URBANCLEAN-V3.0.ASCII", aux_path);
+    }
+
+    sprintf (ctx->cmgdemnm, "%s/CMGDEM.hdf", aux_path);
+    sprintf (ctx->rationm, "%s/ratiomapndwiexp.hdf", aux_path);
+    sprintf (ctx->auxnm, "%s/LADS/%s/%s", aux_path, aux_year, aux_infile);
+
+    /* Make sure the files exist */
+    lut_file[0] = ctx->anglehdf;
+    lut_file[1] = ctx->intrefnm;
+    lut_file[2] = ctx->transmnm;
+    lut_file[3] = ctx->spheranm;
+    lut_file[4] = ctx->cmgdemnm;
+    lut_file[5] = ctx->rationm;
+    lut_file[6] = ctx->auxnm;
+    for (i = 0; i < 7; i++)
+    {
+        if (stat (lut_file[i], &statbuf) == -1)
+        {
+            sprintf (errmsg, "Could not find %s data file: %s\n  Check "
+                "LASRC_AUX_DIR environment variable.", lut_name[i],
+                lut_file[i]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lasrc_compute_toa
+
+PURPOSE:  Computes the L8 TOA reflectance and brightness temperatures from the
+Level-1 DNs in sband.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the TOA reflectance, or this isn't L8
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. S2 products are already TOA reflectance, so this only applies to L8.
+******************************************************************************/
+int lasrc_compute_toa
+(
+    Lasrc_ctx_t *ctx,    /* I: context for the current scene */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    int16 *sza,          /* I: scaled per-pixel solar zenith angles (degrees),
+                               nlines x nsamps */
+    int16 **sband,       /* O: output TOA reflectance and brightness temp
+                               values (scaled) */
+    uint16 *radsat       /* O: radiometric saturation QA band, nlines x nsamps;
+                               array should be all zeros on input */
+)
+{
+    char FUNC_NAME[] = "lasrc_compute_toa";   /* function name */
+    char errmsg[STR_SIZE];                    /* error message */
+
+    if (ctx->sat != SAT_LANDSAT_8)
+    {
+        sprintf (errmsg, "TOA reflectance is only computed for Landsat 8");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (get_valid_spans (ctx, qaband) != SUCCESS)
+        return (ERROR);
+
+    if (compute_l8_toa_refl (ctx->input, ctx->xml_metadata, qaband,
+        ctx->spans, ctx->nlines, ctx->nsamps, ctx->xml_metadata->global.instrument, sza,
+        sband, radsat) != SUCCESS)
+    {
+        sprintf (errmsg, "Error computing L8 TOA reflectance and TOA "
+            "brightness temperatures.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lasrc_compute_sr
+
+PURPOSE:  Computes the surface reflectance and aerosol QA for the scene.  This
+loads the LUTs, retrieves the atmospheric coefficients, inverts the aerosols,
+and applies the atmospheric correction.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error computing the surface reflectance
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. lasrc_set_lut_files must be called before this routine.
+  2. For S2 the QA band is updated to flag the pixels which are fill in any
+     of the TOA bands.
+  3. If pixel_angles is set, the L8 atmospheric correction uses the
+     coefficients for the solar zenith of each pixel.  sza is ignored for S2.
+  4. If strip is set, the L8 scene is processed as the next row of the strip
+     (see strip.c).  The strip is ignored for S2.
+******************************************************************************/
+int lasrc_compute_sr
+(
+    Lasrc_ctx_t *ctx,    /* I: context for the current scene */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    int16 *sza,          /* I: L8 scaled per-pixel solar zenith angles
+                               (degrees), nlines x nsamps; only used if
+                               pixel_angles is set */
+    uint16 **toaband,    /* I: S2 TOA reflectance bands, nlines x nsamps;
+                               not used for L8 */
+    int16 **sband,       /* I/O: L8 TOA reflectance on input (not used for S2);
+                               surface reflectance on output */
+    uint8 *ipflag        /* O: aerosol QA band, nlines x nsamps; array should
+                               be all zeros on input */
+)
+{
+    char FUNC_NAME[] = "lasrc_compute_sr";   /* function name */
+    char errmsg[STR_SIZE];                   /* error message */
+    int retval = ERROR;                      /* return status */
+
+    /* The surface reflectance algorithm cannot be implemented for solar
+       zenith angles greater than 76 degrees */
+    if (ctx->xts > 76.0)
+    {
+        sprintf (errmsg, "Solar zenith angle is too large to allow for surface "
+            "reflectance processing. (solar zenith angle out of range)");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (ctx->auxnm[0] == '\0')
+    {
+        sprintf (errmsg, "The LUT filenames have not been set up");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (ctx->sat == SAT_LANDSAT_8)
+    {
+        if (get_valid_spans (ctx, qaband) != SUCCESS)
+            return (ERROR);
+
+        retval = compute_l8_sr_refl (ctx->input, ctx->xml_metadata, qaband,
+            ctx->spans, ctx->nlines, ctx->nsamps, ctx->pixsize, sband, ipflag,
+            ctx->xts, ctx->xmus, ctx->pixel_angles ? sza : NULL,
+            ctx->anglehdf, ctx->intrefnm, ctx->transmnm, ctx->spheranm,
+            ctx->cmgdemnm, ctx->rationm, ctx->auxnm, ctx->ckpt_file,
+            ctx->fast_math, ctx->aero_adapt_tol, ctx->strip);
+    }
+    else if (ctx->sat == SAT_SENTINEL_2)
+    {
+        retval = compute_s2_sr_refl (ctx->input, ctx->xml_metadata, qaband,
+            ctx->nlines, ctx->nsamps, ctx->pixsize, toaband, sband, ipflag,
+            ctx->xts, ctx->xmus, ctx->anglehdf, ctx->intrefnm, ctx->transmnm,
+            ctx->spheranm, ctx->cmgdemnm, ctx->rationm, ctx->auxnm,
+            ctx->ckpt_file, ctx->fast_math, ctx->aero_adapt_tol);
+    }
+
+    if (retval != SUCCESS)
+    {
+        sprintf (errmsg, "Error computing the surface reflectance");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lasrc_free_ctx
+
+PURPOSE:  Frees the memory allocated within the context.  The input structure
+and XML metadata belong to the caller and are not freed.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void lasrc_free_ctx
+(
+    Lasrc_ctx_t *ctx     /* I/O: context to be freed */
+)
+{
+    free (ctx->spans);
+    ctx->spans = NULL;
+}
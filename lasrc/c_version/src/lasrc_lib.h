@@ -0,0 +1,101 @@
+#ifndef _LASRC_LIB_H_
+#define _LASRC_LIB_H_
+
+#include "lasrc.h"
+#include "valid_span.h"
+
+/* Context for processing a single scene via liblasrc.  All the per-scene
+   state lives in the context or in the caller-supplied buffers, so separate
+   scenes can be processed from separate threads with separate contexts. */
+typedef struct {
+    Input_t *input;          /* input structure; only input->meta is used by
+                                the library, so the caller may populate it
+                                directly without opening any input files */
+    Espa_internal_meta_t *xml_metadata;
+                             /* XML metadata; used for the geolocation and
+                                the per-band metadata */
+    Sat_t sat;               /* satellite */
+    int nlines;              /* number of lines in the reflectance bands */
+    int nsamps;              /* number of samples in the reflectance bands */
+    float pixsize;           /* pixel size for the reflectance bands */
+    float xts;               /* scene center solar zenith angle (deg) */
+    float xmus;              /* cosine of solar zenith angle */
+    char anglehdf[STR_SIZE]; /* angle HDF filename */
+    char intrefnm[STR_SIZE]; /* intrinsic reflectance filename */
+    char transmnm[STR_SIZE]; /* transmission filename */
+    char spheranm[STR_SIZE]; /* spherical albedo filename */
+    char cmgdemnm[STR_SIZE]; /* climate modeling grid DEM filename */
+    char rationm[STR_SIZE];  /* ratio averages filename */
+    char auxnm[STR_SIZE];    /* auxiliary filename for ozone and water vapor */
+    char *ckpt_file;         /* aerosol checkpoint filename; NULL if the
+                                aerosol inversion is not checkpointed */
+    bool fast_math;          /* use the single-precision, approximate
+                                transcendental SR path and report its
+                                differences from the reference path */
+    bool pixel_angles;       /* correct the L8 SR with the per-pixel solar
+                                zenith angles via the angle grid, rather
+                                than the scene center geometry */
+    float aero_adapt_tol;    /* AOT tolerance for interpolating aerosol
+                                windows from the coarse lattice; 0.0 inverts
+                                every window */
+    Lasrc_strip_t *strip;    /* L8 strip of WRS rows this scene is the next
+                                row of; NULL if processed on its own.  Owned
+                                by the caller. */
+    Valid_span_t *spans;     /* L8 valid span of each line; built from the QA
+                                band on first use, freed by lasrc_free_ctx */
+} Lasrc_ctx_t;
+
+/* Prototypes */
+int lasrc_init_ctx
+(
+    Input_t *input,      /* I: input structure (only input->meta is used) */
+    Espa_internal_meta_t *xml_metadata,
+                         /* I: XML metadata structure */
+    int nlines,          /* I: number of lines in the reflectance bands */
+    int nsamps,          /* I: number of samples in the reflectance bands */
+    float pixsize,       /* I: pixel size for the reflectance bands */
+    Lasrc_ctx_t *ctx     /* O: initialized context */
+);
+
+int lasrc_set_lut_files
+(
+    char *aux_path,      /* I: directory containing the LUTs and the LADS
+                               auxiliary directory */
+    char *aux_infile,    /* I: name of the auxiliary file containing water
+                               vapor and ozone */
+    Lasrc_ctx_t *ctx     /* I/O: context to be updated with the filenames */
+);
+
+int lasrc_compute_toa
+(
+    Lasrc_ctx_t *ctx,    /* I: context for the current scene */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    int16 *sza,          /* I: scaled per-pixel solar zenith angles (degrees),
+                               nlines x nsamps */
+    int16 **sband,       /* O: output TOA reflectance and brightness temp
+                               values (scaled) */
+    uint16 *radsat       /* O: radiometric saturation QA band, nlines x nsamps;
+                               array should be all zeros on input */
+);
+
+int lasrc_compute_sr
+(
+    Lasrc_ctx_t *ctx,    /* I: context for the current scene */
+    uint16 *qaband,      /* I: QA band for the input image, nlines x nsamps */
+    int16 *sza,          /* I: L8 scaled per-pixel solar zenith angles
+                               (degrees), nlines x nsamps; only used if
+                               pixel_angles is set */
+    uint16 **toaband,    /* I: S2 TOA reflectance bands, nlines x nsamps;
+                               not used for L8 */
+    int16 **sband,       /* I/O: L8 TOA reflectance on input (not used for S2);
+                               surface reflectance on output */
+    uint8 *ipflag        /* O: aerosol QA band, nlines x nsamps; array should
+                               be all zeros on input */
+);
+
+void lasrc_free_ctx
+(
+    Lasrc_ctx_t *ctx     /* I/O: context to be freed */
+);
+
+#endif
@@ -12,6 +12,7 @@ LICENSE TYPE:  NASA Open Source Agreement Version 1.3
 NOTES:
 *****************************************************************************/
 #include "lut_subr.h"
+#include "fast_math.h"
 #include "hdf.h"
 #include "mfhdf.h"
 
@@ -19,6 +20,14 @@ float l8_lambda[] = {0.443, 0.480, 0.585, 0.655, 0.865, 1.61, 2.2};
 float s2_lambda[] = {0.443, 0.490, 0.560, 0.655, 0.705, 0.740, 0.783,
                      0.842, 0.865, 0.945, 1.375, 1.61, 2.19};
 
+/* log (lambda / 0.55) for the fast-math AOT spectral dependency */
+float l8_log_lambda[] = {-0.2163485, -0.1361322, 0.0616936, 0.1747170,
+                         0.4528112, 1.0740712, 1.3862944};
+float s2_log_lambda[] = {-0.2163485, -0.1155129, 0.0180185, 0.1747170,
+                         0.2482795, 0.2967319, 0.3532144, 0.4258617,
+                         0.4528112, 0.5412666, 0.9162907, 1.0740712,
+                         1.3817385};
+
 /******************************************************************************
 MODULE:  atmcorlamb2_new
 
@@ -119,6 +128,89 @@ void atmcorlamb2_new
 }
 
 
+/******************************************************************************
+MODULE:  atmcorlamb2_fast
+
+PURPOSE:  Fast-math version of atmcorlamb2_new.  Computes the roatm, ttatmg,
+and satm from input coefficients and applies the Lambertian atmospheric
+correction in single precision.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The spectral dependency of the AOT, pow (lambda / 0.55, -eps), is
+     computed as fast_expf (-eps * log (lambda / 0.55)) using the tabulated
+     logs.
+  2. The arguments are the same as atmcorlamb2_new so the two can be used
+     interchangeably via Atmcorlamb2_func_t.
+******************************************************************************/
+void atmcorlamb2_fast
+(
+    Sat_t sat,                /* I: satellite */
+    float tgo,                /* I: other gaseous transmittance  */
+    float xrorayp,            /* I: reflectance of the atmosphere due to
+                                    molecular (Rayleigh) scattering */
+    float roatm_upper,        /* I: roatm upper bound poly_fit, given band */
+    float roatm_coef[NCOEF],  /* I: poly_fit coefficients for roatm  */
+    float ttatmg_coef[NCOEF], /* I: poly_fit coefficients for ttatmg */
+    float satm_coef[NCOEF],   /* I: poly_fit coefficients for satm */
+    float raot550nm,          /* I: nearest value of AOT */
+    int iband,                /* I: band index (0-based) */
+    float normext_ib_0_3,     /* I: normext[iband][0][3] */
+    float rotoa,              /* I: top of atmosphere reflectance */
+    float *roslamb,           /* O: lambertian surface reflectance */
+    float eps                 /* I: angstroem coefficient; spectral dependency
+                                    of the AOT */
+)
+{
+    float mraot550nm;      /* nearest value of AOT -- modified local variable */
+    int max_band_indx = 0; /* maximum band index for L8 or S2 */
+    float *log_lambda = NULL;  /* log band wavelength pointer for L8 or S2 */
+    float roatm;           /* intrinsic atmospheric reflectance */
+    float ttatmg;          /* total atmospheric transmission */
+    float satm;            /* spherical albedo */
+    float ros;             /* lambertian surface reflectance */
+
+    /* Setup L8 or S2 variables */
+    if (sat == SAT_LANDSAT_8)
+    {
+        log_lambda = l8_log_lambda;
+        max_band_indx = DN_L8_BAND7;
+    }
+    else if (sat == SAT_SENTINEL_2)
+    {
+        log_lambda = s2_log_lambda;
+        max_band_indx = DN_S2_BAND12;
+    }
+
+    /* Modifiy the AOT value based on the angstroem coefficient and lambda
+       values */
+    if (eps < 0.0f || iband > max_band_indx)
+        mraot550nm = raot550nm;
+    else
+        mraot550nm = (raot550nm / normext_ib_0_3) *
+            fast_expf (-eps * log_lambda[iband]);
+
+    /* Check the upper limit of the modified AOT value */
+    if (mraot550nm >= roatm_upper)
+        mraot550nm = roatm_upper;
+
+    /* Compute the intrinsic atmospheric reflectance, total atmospheric
+       transmission, and spherical albedo from the coefficients (Horner) */
+    roatm = ((roatm_coef[0] * mraot550nm + roatm_coef[1]) * mraot550nm +
+        roatm_coef[2]) * mraot550nm + roatm_coef[3];
+    ttatmg = ((ttatmg_coef[0] * mraot550nm + ttatmg_coef[1]) * mraot550nm +
+        ttatmg_coef[2]) * mraot550nm + ttatmg_coef[3];
+    satm = ((satm_coef[0] * mraot550nm + satm_coef[1]) * mraot550nm +
+        satm_coef[2]) * mraot550nm + satm_coef[3];
+
+    /* Perform atmospheric correction */
+    ros = (rotoa / tgo - roatm) / ttatmg;
+    *roslamb = ros / (1.0f + satm * ros);
+}
+
+
 /******************************************************************************
 MODULE:  atmcorlamb2
 
@@ -2060,6 +2152,10 @@ NOTES:
      calling routine to free this memory.
   2. Each array passed into this function is passed in as the address to that
      1D, 2D, nD array.
+  3. The nlines x nsamps arrays are allocated via first_touch_alloc so their
+     pages are placed on the NUMA node of the threads processing those lines.
+  4. proc_band is indexed by the sband band, so for L8 it covers the
+     reflectance, cirrus, and thermal bands.
 ******************************************************************************/
 int memory_allocation_main
 (
@@ -2072,7 +2168,11 @@ int memory_allocation_main
                                nlines x nsamps */
     int16 ***sband,      /* O: output surface reflectance and brightness temp
                                bands */
-    uint16 ***toaband    /* O: S2 TOA reflectance bands */
+    uint8 **ipflag,      /* O: aerosol QA band for the SR product,
+                               nlines x nsamps */
+    uint16 ***toaband,   /* O: S2 TOA reflectance bands */
+    bool *proc_band      /* I: is the band processed?  The sband and toaband
+                               arrays of unprocessed bands are left NULL */
 )
 {
     char FUNC_NAME[] = "memory_allocation_main"; /* function name */
@@ -2083,7 +2183,7 @@ int memory_allocation_main
     /* Solar zenith array and radiometric sat are only used for L8 */
     if (sat == SAT_LANDSAT_8)
     {
-        *sza = calloc (nlines*nsamps, sizeof (int16));
+        *sza = first_touch_alloc (nlines, nsamps, sizeof (int16));
         if (*sza == NULL)
         {
             sprintf (errmsg, "Error allocating memory for sza");
@@ -2091,7 +2191,7 @@ int memory_allocation_main
             return (ERROR);
         }
 
-        *radsat = calloc (nlines*nsamps, sizeof (uint16));
+        *radsat = first_touch_alloc (nlines, nsamps, sizeof (uint16));
         if (*radsat == NULL)
         {
             sprintf (errmsg, "Error allocating memory for radsat");
@@ -2113,7 +2213,10 @@ int memory_allocation_main
         }
         for (i = 0; i < nband_ttl-1; i++)
         {
-            (*toaband)[i] = calloc (nlines*nsamps, sizeof (uint16));
+            if (!proc_band[i])
+                continue;
+            (*toaband)[i] = first_touch_alloc (nlines, nsamps,
+                sizeof (uint16));
             if ((*toaband)[i] == NULL)
             {
                 sprintf (errmsg, "Error allocating memory for toaband");
@@ -2123,7 +2226,7 @@ int memory_allocation_main
         }
     }
 
-    *qaband = calloc (nlines*nsamps, sizeof (uint16));
+    *qaband = first_touch_alloc (nlines, nsamps, sizeof (uint16));
     if (*qaband == NULL)
     {
         sprintf (errmsg, "Error allocating memory for qaband");
@@ -2131,6 +2234,14 @@ int memory_allocation_main
         return (ERROR);
     }
 
+    *ipflag = first_touch_alloc (nlines, nsamps, sizeof (uint8));
+    if (*ipflag == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for ipflag");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Given that the QA band is its own separate array of uint16s, we need
        one less band for the signed image data */
     *sband = calloc (nband_ttl-1, sizeof (int16*));
@@ -2142,7 +2253,10 @@ int memory_allocation_main
     }
     for (i = 0; i < nband_ttl-1; i++)
     {
-        (*sband)[i] = calloc (nlines*nsamps, sizeof (int16));
+        if (!proc_band[i])
+            continue;
+        (*sband)[i] = first_touch_alloc (nlines, nsamps,
+            sizeof (int16));
         if ((*sband)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for sband");
@@ -2174,6 +2288,8 @@ NOTES:
      calling routine to free this memory.
   2. Each array passed into this function is passed in as the address to that
      1D, 2D, nD array.
+  3. The nlines x nsamps arrays are allocated via first_touch_alloc so their
+     pages are placed on the NUMA node of the threads processing those lines.
 ******************************************************************************/
 int l8_memory_allocation_sr
 (
@@ -2189,8 +2305,6 @@ int l8_memory_allocation_sr
                                (TOA refl), nlines x nsamps */
     int16 **aerob7,      /* O: atmospherically corrected band 7 data
                                (TOA refl), nlines x nsamps */
-    uint8 **ipflag,      /* O: QA flag to assist with aerosol interpolation,
-                               nlines x nsamps */
     float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
     float **teps,        /* O: eps (angstrom coefficient) for each pixel,
                                nlines x nsamps*/
@@ -2236,7 +2350,7 @@ int l8_memory_allocation_sr
     /* Setup L8 number of SR bands */
     nsr_bands = NSR_L8_BANDS;
 
-    *aerob1 = calloc (nlines*nsamps, sizeof (int16));
+    *aerob1 = first_touch_alloc (nlines, nsamps, sizeof (int16));
     if (*aerob1 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for aerob1");
@@ -2244,7 +2358,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *aerob2 = calloc (nlines*nsamps, sizeof (int16));
+    *aerob2 = first_touch_alloc (nlines, nsamps, sizeof (int16));
     if (*aerob2 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for aerob2");
@@ -2252,7 +2366,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *aerob4 = calloc (nlines*nsamps, sizeof (int16));
+    *aerob4 = first_touch_alloc (nlines, nsamps, sizeof (int16));
     if (*aerob4 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for aerob4");
@@ -2260,7 +2374,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *aerob5 = calloc (nlines*nsamps, sizeof (int16));
+    *aerob5 = first_touch_alloc (nlines, nsamps, sizeof (int16));
     if (*aerob5 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for aerob5");
@@ -2268,7 +2382,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *aerob7 = calloc (nlines*nsamps, sizeof (int16));
+    *aerob7 = first_touch_alloc (nlines, nsamps, sizeof (int16));
     if (*aerob7 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for aerob7");
@@ -2276,7 +2390,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *taero = calloc (nlines*nsamps, sizeof (float));
+    *taero = first_touch_alloc (nlines, nsamps, sizeof (float));
     if (*taero == NULL)
     {
         sprintf (errmsg, "Error allocating memory for taero");
@@ -2284,7 +2398,7 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *teps = calloc (nlines*nsamps, sizeof (float));
+    *teps = first_touch_alloc (nlines, nsamps, sizeof (float));
     if (*teps == NULL)
     {
         sprintf (errmsg, "Error allocating memory for teps");
@@ -2292,14 +2406,6 @@ int l8_memory_allocation_sr
         return (ERROR);
     }
 
-    *ipflag = calloc (nlines*nsamps, sizeof (uint8));
-    if (*ipflag == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for ipflag");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Allocate memory for all the climate modeling grid files */
     *dem = calloc (DEM_NBLAT * DEM_NBLON, sizeof (int16*));
     if (*dem == NULL)
@@ -2512,13 +2618,13 @@ NOTES:
      calling routine to free this memory.
   2. Each array passed into this function is passed in as the address to that
      1D, 2D, nD array.
+  3. The nlines x nsamps arrays are allocated via first_touch_alloc so their
+     pages are placed on the NUMA node of the threads processing those lines.
 ******************************************************************************/
 int s2_memory_allocation_sr
 (
     int nlines,          /* I: number of lines in the scene */
     int nsamps,          /* I: number of samples in the scene */
-    uint8 **ipflag,      /* O: QA flag to assist with aerosol interpolation,
-                               nlines x nsamps */
     float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
     float **teps,        /* O: eps (angstrom coefficient) for each pixel,
                                nlines x nsamps*/
@@ -2564,8 +2670,8 @@ int s2_memory_allocation_sr
     /* Setup S2 number of SR bands */
     nsr_bands = NSR_S2_BANDS;
 
-    /* Allocate memory for aero, eps, and ipflag */
-    *taero = calloc (nlines*nsamps, sizeof (float));
+    /* Allocate memory for aero and eps */
+    *taero = first_touch_alloc (nlines, nsamps, sizeof (float));
     if (*taero == NULL)
     {
         sprintf (errmsg, "Error allocating memory for taero");
@@ -2573,7 +2679,7 @@ int s2_memory_allocation_sr
         return (ERROR);
     }
 
-    *teps = calloc (nlines*nsamps, sizeof (float));
+    *teps = first_touch_alloc (nlines, nsamps, sizeof (float));
     if (*teps == NULL)
     {
         sprintf (errmsg, "Error allocating memory for teps");
@@ -2581,14 +2687,6 @@ int s2_memory_allocation_sr
         return (ERROR);
     }
 
-    *ipflag = calloc (nlines*nsamps, sizeof (uint8));
-    if (*ipflag == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for ipflag");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Allocate memory for all the climate modeling grid files */
     *dem = calloc (DEM_NBLAT * DEM_NBLON, sizeof (int16*));
     if (*dem == NULL)
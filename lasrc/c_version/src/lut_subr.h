@@ -10,6 +10,29 @@
 #include "espa_metadata.h"
 #include "espa_geoloc.h"
 #include "error_handler.h"
+#include "first_touch.h"
+
+/* Atmospheric correction and aerosol retrieval routines, so the reference
+   (atmcorlamb2_new, subaeroret_new) or fast-math (atmcorlamb2_fast,
+   subaeroret_fast) versions can be selected once per scene */
+typedef void (*Atmcorlamb2_func_t)
+(
+    Sat_t sat, float tgo, float xrorayp, float roatm_upper,
+    float roatm_coef[NCOEF], float ttatmg_coef[NCOEF], float satm_coef[NCOEF],
+    float raot550nm, int iband, float normext_ib_0_3, float rotoa,
+    float *roslamb, float eps
+);
+
+typedef void (*Subaeroret_func_t)
+(
+    Sat_t sat, int iband1, int iband3, float erelc[NSR_BANDS],
+    float troatm[NSR_BANDS], float tgo_arr[NREFL_BANDS],
+    float xrorayp_arr[NREFL_BANDS], int roatm_iaMax[NREFL_BANDS],
+    float roatm_coef[NREFL_BANDS][NCOEF],
+    float ttatmg_coef[NREFL_BANDS][NCOEF],
+    float satm_coef[NREFL_BANDS][NCOEF], float normext_p0a3_arr[NREFL_BANDS],
+    float *raot, float *residual, int *iaots, float eps
+);
 
 /* Prototypes */
 void atmcorlamb2_new
@@ -31,6 +54,25 @@ void atmcorlamb2_new
                                     of the AOT */
 );
 
+void atmcorlamb2_fast
+(
+    Sat_t sat,                /* I: satellite */
+    float tgo,                /* I: other gaseous transmittance  */
+    float xrorayp,            /* I: reflectance of the atmosphere due to
+                                    molecular (Rayleigh) scattering */
+    float roatm_upper,        /* I: roatm upper bound poly_fit, given band */
+    float roatm_coef[NCOEF],  /* I: poly_fit coefficients for roatm  */
+    float ttatmg_coef[NCOEF], /* I: poly_fit coefficients for ttatmg */
+    float satm_coef[NCOEF],   /* I: poly_fit coefficients for satm */
+    float raot550nm,          /* I: nearest value of AOT */
+    int iband,                /* I: band index (0-based) */
+    float normext_ib_0_3,     /* I: normext[iband][0][3] */
+    float rotoa,              /* I: top of atmosphere reflectance */
+    float *roslamb,           /* O: lambertian surface reflectance */
+    float eps                 /* I: angstroem coefficient; spectral dependency
+                                    of the AOT */
+);
+
 void subaeroret_new
 (
     Sat_t sat,                             /* I: satellite */
@@ -58,6 +100,33 @@ void subaeroret_new
     float eps        /* I: angstroem coefficient; spectral dependency of AOT */
 );
 
+void subaeroret_fast
+(
+    Sat_t sat,                             /* I: satellite */
+    int iband1,                            /* I: band 1 index (0-based) */
+    int iband3,                            /* I: band 3 index (0-based) */
+    float erelc[NSR_BANDS],                /* I: band ratio variable */
+    float troatm[NSR_BANDS],               /* I: toa reflectance */
+    float tgo_arr[NREFL_BANDS],            /* I: per-band other gaseous
+                                                 transmittance */
+    float xrorayp_arr[NREFL_BANDS],        /* I: per-band reflectance of the
+                                                 atmosphere due to molecular
+                                                 (Rayleigh) scattering */
+    int roatm_iaMax[NREFL_BANDS],          /* I: roatm_iaMax */
+    float roatm_coef[NREFL_BANDS][NCOEF],  /* I: per band polynomial
+                                                 coefficients for roatm */
+    float ttatmg_coef[NREFL_BANDS][NCOEF], /* I: per band polynomial
+                                                 coefficients for ttatmg */
+    float satm_coef[NREFL_BANDS][NCOEF],   /* I: per band polynomial
+                                                 coefficients for satm */
+    float normext_p0a3_arr[NREFL_BANDS],   /* I: normext[iband][0][3] */
+    float *raot,     /* O: AOT reflectance */
+    float *residual, /* O: model residual */
+    int *iaots,      /* I/O: AOT index that is passed in and out for multiple
+                             calls (0-based) */
+    float eps        /* I: angstroem coefficient; spectral dependency of AOT */
+);
+
 void subaeroret_water_new
 (
     Sat_t sat,                             /* I: satellite */
@@ -364,7 +433,11 @@ int memory_allocation_main
                                nlines x nsamps */
     int16 ***sband,      /* O: output surface reflectance and brightness temp
                                bands */
-    uint16 ***toaband    /* O: S2 TOA reflectance bands */
+    uint8 **ipflag,      /* O: aerosol QA band for the SR product,
+                               nlines x nsamps */
+    uint16 ***toaband,   /* O: S2 TOA reflectance bands */
+    bool *proc_band      /* I: is the band processed?  The sband and toaband
+                               arrays of unprocessed bands are left NULL */
 );
 
 int l8_memory_allocation_sr
@@ -381,8 +454,6 @@ int l8_memory_allocation_sr
                                (TOA refl), nlines x nsamps */
     int16 **aerob7,      /* O: atmospherically corrected band 7 data
                                (TOA refl), nlines x nsamps */
-    uint8 **ipflag,      /* O: QA flag to assist with aerosol interpolation,
-                               nlines x nsamps */
     float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
     float **teps,        /* O: eps (angstrom coefficient) for each pixel,
                                nlines x nsamps*/
@@ -427,8 +498,6 @@ int s2_memory_allocation_sr
 (
     int nlines,          /* I: number of lines in the scene */
     int nsamps,          /* I: number of samples in the scene */
-    uint8 **ipflag,      /* O: QA flag to assist with aerosol interpolation,
-                               nlines x nsamps */
     float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
     float **teps,        /* O: eps (angstrom coefficient) for each pixel,
                                nlines x nsamps*/
@@ -15,6 +15,7 @@ NOTES:
 #include <time.h>
 #include <ctype.h>
 #include "output.h"
+#include "write_metadata.h"
 
 /******************************************************************************
 MODULE:  open_output
@@ -30,6 +31,9 @@ NULL           Error occurred opening the file
 not-NULL       Successful completion
 
 NOTES:
+  1. The bands of a row shard of the scene have _shard<n> added to their
+     filenames, so the shards can be written side by side and then merged
+     into the full-scene bands (see merge_shards).
 ******************************************************************************/
 Output_t *open_output
 (
@@ -148,6 +152,20 @@ Output_t *open_output
     output->nband = nband;
     output->nlines = input->size.nlines;
     output->nsamps = input->size.nsamps;
+    output->win_nlines = input->size.nlines;
+    output->win_nsamps = input->size.nsamps;
+    output->win_line0 = 0;
+    output->win_samp0 = 0;
+
+    /* If processing a region of interest, then only the ROI within the
+       processing window is output */
+    if (input->roi_set)
+    {
+        output->nlines = input->roi.out_nlines;
+        output->nsamps = input->roi.out_nsamps;
+        output->win_line0 = input->roi.out_line0;
+        output->win_samp0 = input->roi.out_samp0;
+    }
     for (ib = 0; ib < output->nband; ib++)
         output->fp_bin[ib] = NULL;
  
@@ -401,13 +419,19 @@ Output_t *open_output
 
         /* Set up the filename with the scene name and band name and open the
            file for read/write access.  Don't open if this is OLI-only and
-           these are the thermal bands. */
-        if (((input->meta.sat == SAT_LANDSAT_8) &&
+           these are the thermal bands, or if the band isn't in the subset of
+           bands being output. */
+        if ((((input->meta.sat == SAT_LANDSAT_8) &&
             (ib != SR_L8_BAND10 && ib != SR_L8_BAND11)) ||
-             output->inst != INST_OLI)
+             output->inst != INST_OLI) &&
+            is_output_band (input, output_type, ib))
         {
-            sprintf (bmeta[ib].file_name, "%s_%s.img", scene_name,
-                bmeta[ib].name);
+            if (input->roi_set && input->roi.nshards > 0)
+                sprintf (bmeta[ib].file_name, "%s_%s_shard%d.img",
+                    scene_name, bmeta[ib].name, input->roi.ishard);
+            else
+                sprintf (bmeta[ib].file_name, "%s_%s.img", scene_name,
+                    bmeta[ib].name);
             output->fp_bin[ib] = open_raw_binary (bmeta[ib].file_name, "w+");
             if (output->fp_bin[ib] == NULL)
             {
@@ -474,10 +498,11 @@ int close_output
             continue;
         else
         {
-            /* No thermal bands are open for OLI-only scenes */
+            /* No thermal bands are open for OLI-only scenes, and bands
+               which aren't in the output subset aren't open */
             if ((sat == SAT_LANDSAT_8) &&
                  ((ib != SR_L8_BAND10 && ib != SR_L8_BAND11) ||
-                  output->inst != INST_OLI))
+                  output->inst != INST_OLI) && output->fp_bin[ib] != NULL)
                 close_raw_binary (output->fp_bin[ib]);
         }
     }
@@ -570,6 +595,9 @@ ERROR      Error occurred writing the output data
 SUCCESS    Successful completion
 
 NOTES:
+  1. The buffer and the line numbers are for the processing window.  If only
+     a region of interest within the window is output, then only the ROI
+     portion of the lines is written.
 ******************************************************************************/
 int put_output_lines
 (
@@ -585,6 +613,8 @@ int put_output_lines
     char FUNC_NAME[] = "put_output_lines";   /* function name */
     char errmsg[STR_SIZE];    /* error message */
     long loc;                 /* current location in the output file */
+    int line;                 /* looping variable for lines */
+    int oline;                /* current line in the output file */
   
     /* Check the parameters */
     if (output == (Output_t *)NULL) 
@@ -605,19 +635,53 @@ int put_output_lines
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    if (iline < 0 || iline >= output->nlines)
+    if (iline < 0 || iline >= output->win_nlines)
     {
         sprintf (errmsg, "Invalid line number.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    if (nlines < 0 || iline+nlines > output->nlines)
+    if (nlines < 0 || iline+nlines > output->win_nlines)
     {
         sprintf (errmsg, "Line plus number of lines to be written exceeds "
             "the predefined size of the image.");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+
+    /* If only part of the processing window is output, then write the
+       output portion of each line */
+    if (output->win_nsamps != output->nsamps ||
+        output->win_nlines != output->nlines)
+    {
+        for (line = iline; line < iline + nlines; line++)
+        {
+            oline = line - output->win_line0;
+            if (oline < 0 || oline >= output->nlines)
+                continue;
+
+            loc = (long) oline * output->nsamps * nbytes;
+            if (fseek (output->fp_bin[iband], loc, SEEK_SET))
+            {
+                sprintf (errmsg, "Seeking to the current line in the output "
+                    "file for band %d", iband);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            if (write_raw_binary (output->fp_bin[iband], 1, output->nsamps,
+                nbytes, (char *) buf + ((long) (line - iline) *
+                output->win_nsamps + output->win_samp0) * nbytes) != SUCCESS)
+            {
+                sprintf (errmsg, "Error writing the output line(s) for band "
+                    "%d.", iband);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        return (SUCCESS);
+    }
   
     /* Write the data, but first seek to the correct line */
     loc = (long) iline * output->nsamps * nbytes;
@@ -675,3 +739,97 @@ char *upper_case_str
     return up_str;
 }
 
+
+
+/******************************************************************************
+MODULE:  is_output_band
+
+PURPOSE:  Determines whether the band is written to the output product, given
+the subset of bands being output.
+
+RETURN VALUE:
+Type = bool
+Value      Description
+-----      -----------
+true       The band is output
+false      The band is not in the subset of bands being output
+
+NOTES:
+  1. The band subset only applies to the reflectance, cirrus, and thermal
+     bands.  The aerosol QA and RADSAT bands are always output.
+******************************************************************************/
+bool is_output_band
+(
+    Input_t *input,         /* I: input structure with the band subset */
+    Myoutput_t output_type, /* I: are we processing TOA, SR, RADSAT outputs? */
+    int iband               /* I: output band (0-based) */
+)
+{
+    if (!input->bands_set || output_type == OUTPUT_RADSAT)
+        return (true);
+
+    if ((input->meta.sat == SAT_LANDSAT_8 && iband > SR_L8_BAND11) ||
+        (input->meta.sat == SAT_SENTINEL_2 && iband > SR_S2_BAND12))
+        return (true);
+
+    return (input->out_band[iband]);
+}
+
+
+/******************************************************************************
+MODULE:  append_output_bands
+
+PURPOSE:  Appends the output bands in the specified range, which are in the
+subset of bands being output, to the XML file.
+
+RETURN VALUE:
+Type = int
+Value      Description
+-----      -----------
+ERROR      Error appending the bands to the XML file
+SUCCESS    Successful completion
+
+NOTES:
+******************************************************************************/
+int append_output_bands
+(
+    Output_t *output,       /* I: output structure with the band metadata */
+    Input_t *input,         /* I: input structure with the band subset */
+    Myoutput_t output_type, /* I: are we processing TOA, SR, RADSAT outputs? */
+    int first_band,         /* I: first band to append (0-based) */
+    int last_band,          /* I: last band to append (0-based, inclusive) */
+    char *xml_file          /* I: XML file to append the bands to */
+)
+{
+    char FUNC_NAME[] = "append_output_bands";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    int ib;                   /* looping variable for bands */
+    int nbands = 0;           /* number of bands to append */
+    Espa_band_meta_t *bmeta = NULL;  /* band metadata of the output bands */
+
+    bmeta = malloc ((last_band - first_band + 1) * sizeof (Espa_band_meta_t));
+    if (bmeta == NULL)
+    {
+        sprintf (errmsg, "Allocating the band metadata to be appended");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Shallow copies are fine since the bands are only being written */
+    for (ib = first_band; ib <= last_band; ib++)
+    {
+        if (is_output_band (input, output_type, ib))
+            bmeta[nbands++] = output->metadata.band[ib];
+    }
+
+    if (nbands > 0 && append_metadata (nbands, bmeta, xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Appending the output bands to the XML file");
+        error_handler (true, FUNC_NAME, errmsg);
+        free (bmeta);
+        return (ERROR);
+    }
+
+    free (bmeta);
+    return (SUCCESS);
+}
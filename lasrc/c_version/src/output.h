@@ -29,6 +29,12 @@ typedef struct {
   int nband;            /* Number of output bands */
   int nlines;           /* Number of output lines */
   int nsamps;           /* Number of output samples */
+  int win_nlines;       /* Number of lines in the data buffers being written */
+  int win_nsamps;       /* Number of samples in the data buffers being
+                           written; larger than nsamps when only a region of
+                           interest within the processing window is output */
+  int win_line0;        /* First line of the output within the buffers */
+  int win_samp0;        /* First sample of the output within the buffers */
   Espa_internal_meta_t metadata;  /* Metadata container to hold the band
                            metadata for the output bands; global metadata
                            won't be valid */
@@ -84,4 +90,21 @@ char *upper_case_str
     char *str    /* I: string to be converted to upper case */
 );
 
+bool is_output_band
+(
+    Input_t *input,         /* I: input structure with the band subset */
+    Myoutput_t output_type, /* I: are we processing TOA, SR, RADSAT outputs? */
+    int iband               /* I: output band (0-based) */
+);
+
+int append_output_bands
+(
+    Output_t *output,       /* I: output structure with the band metadata */
+    Input_t *input,         /* I: input structure with the band subset */
+    Myoutput_t output_type, /* I: are we processing TOA, SR, RADSAT outputs? */
+    int first_band,         /* I: first band to append (0-based) */
+    int last_band,          /* I: last band to append (0-based, inclusive) */
+    char *xml_file          /* I: XML file to append the bands to */
+);
+
 #endif
@@ -0,0 +1,344 @@
+/*****************************************************************************
+FILE: roi.c
+
+PURPOSE: Contains functions for processing a region of interest (ROI) within
+the scene rather than the full scene.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The ROI is processed within a larger processing window (see
+   set_input_roi), and the in-memory metadata is subset to that window so the
+   geolocation of the window pixels is correct.  The output bands only cover
+   the ROI and are appended to a separate XML file for the ROI product.
+*****************************************************************************/
+#include "roi.h"
+
+/******************************************************************************
+MODULE:  roi_to_pixel
+
+PURPOSE:  Converts the ROI to UL/LR lines and samples of the reflectance
+bands.  Projection coordinates are converted using the projection corners
+and the pixel size of the reflectance bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Invalid ROI type
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. A projection coordinate is converted to the pixel which contains it.
+     The projection corners are the pixel centers if the grid origin is
+     CENTER, otherwise they are the outer pixel corners.
+  2. The UL/LR ordering of the coordinates is not required; the extents are
+     sorted here.  Range checking is done by set_input_roi.
+******************************************************************************/
+int roi_to_pixel
+(
+    Espa_internal_meta_t *xml_metadata,
+                         /* I: XML metadata structure */
+    Img_coord_info_t *size, /* I: size of the reflectance bands */
+    Roi_type_t roi_type, /* I: type of ROI coordinates */
+    double *roi_coords,  /* I: UL line/samp, LR line/samp for ROI_PIXEL;
+                               UL x/y, LR x/y for ROI_PROJ */
+    int *ul_line,        /* O: UL line of the ROI */
+    int *ul_samp,        /* O: UL sample of the ROI */
+    int *lr_line,        /* O: LR line of the ROI (inclusive) */
+    int *lr_samp         /* O: LR sample of the ROI (inclusive) */
+)
+{
+    char FUNC_NAME[] = "roi_to_pixel";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_proj_meta_t *proj = &xml_metadata->global.proj_info;
+                              /* projection information for the scene */
+    double half = 0.0;        /* offset of the projection corner within the
+                                 UL pixel */
+    int tmp;                  /* temporary value for sorting */
+
+    if (roi_type == ROI_PIXEL)
+    {
+        *ul_line = (int) roi_coords[0];
+        *ul_samp = (int) roi_coords[1];
+        *lr_line = (int) roi_coords[2];
+        *lr_samp = (int) roi_coords[3];
+    }
+    else if (roi_type == ROI_PROJ)
+    {
+        if (!strcmp (proj->grid_origin, "CENTER"))
+            half = 0.5;
+
+        *ul_samp = (int) floor ((roi_coords[0] - proj->ul_corner[0]) /
+            size->pixsize[0] + half);
+        *ul_line = (int) floor ((proj->ul_corner[1] - roi_coords[1]) /
+            size->pixsize[1] + half);
+        *lr_samp = (int) floor ((roi_coords[2] - proj->ul_corner[0]) /
+            size->pixsize[0] + half);
+        *lr_line = (int) floor ((proj->ul_corner[1] - roi_coords[3]) /
+            size->pixsize[1] + half);
+    }
+    else
+    {
+        sprintf (errmsg, "Invalid ROI type: %d", roi_type);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Make sure UL is above and left of LR */
+    if (*lr_line < *ul_line)
+    {
+        tmp = *ul_line;
+        *ul_line = *lr_line;
+        *lr_line = tmp;
+    }
+    if (*lr_samp < *ul_samp)
+    {
+        tmp = *ul_samp;
+        *ul_samp = *lr_samp;
+        *lr_samp = tmp;
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  subset_xml_metadata
+
+PURPOSE:  Updates the XML metadata to describe a subset of the scene.  The
+projection corners, the lat/long corners, the bounding coordinates, and the
+size of each band are updated.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error setting up the geolocation for the subset
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Bands with a different pixel size than the reflectance bands (i.e. the
+     S2 20m and 60m bands) are subset to the same ground area.
+  2. The bounding coordinates are computed from the outer edges of the
+     subset.
+******************************************************************************/
+int subset_xml_metadata
+(
+    Espa_internal_meta_t *xml_metadata,
+                         /* I/O: XML metadata structure to be subset */
+    double *pixsize,     /* I: pixel size of the reflectance bands */
+    int full_nlines,     /* I: number of reflectance lines before the subset */
+    int full_nsamps,     /* I: number of reflectance samps before the subset */
+    int line0,           /* I: first reflectance line of the subset */
+    int samp0,           /* I: first reflectance sample of the subset */
+    int nlines,          /* I: number of reflectance lines in the subset */
+    int nsamps           /* I: number of reflectance samples in the subset */
+)
+{
+    char FUNC_NAME[] = "subset_xml_metadata";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    Espa_global_meta_t *gmeta = &xml_metadata->global;
+                              /* pointer to the global metadata */
+    Espa_band_meta_t *bmeta = NULL;  /* pointer to the current band */
+    Space_def_t space_def;    /* structure to define the space mapping */
+    Geoloc_t *space = NULL;   /* geolocation information */
+    Img_coord_float_t img;    /* coordinate in line/sample space */
+    Geo_coord_t geo;          /* coordinate in lat/long space */
+    double factor;            /* ratio of band pixel size to refl pixel size */
+    double lat, lon;          /* lat/long of the current edge pixel (deg) */
+    int ib;                   /* looping variable for bands */
+    int i;                    /* looping variable for edge pixels */
+    int nedge;                /* number of pixels along the current edge */
+    int edge;                 /* looping variable for the four edges */
+    int b_line0, b_samp0;     /* first line/sample of the band subset */
+    int b_size;               /* number of lines/samples in the band subset */
+
+    /* Update the projection corners */
+    gmeta->proj_info.ul_corner[0] += samp0 * pixsize[0];
+    gmeta->proj_info.ul_corner[1] -= line0 * pixsize[1];
+    gmeta->proj_info.lr_corner[0] -= (full_nsamps - samp0 - nsamps) *
+        pixsize[0];
+    gmeta->proj_info.lr_corner[1] += (full_nlines - line0 - nlines) *
+        pixsize[1];
+
+    /* Update the size of each band */
+    for (ib = 0; ib < xml_metadata->nbands; ib++)
+    {
+        bmeta = &xml_metadata->band[ib];
+        factor = bmeta->pixel_size[0] / pixsize[0];
+        b_line0 = (int) (line0 / factor);
+        b_samp0 = (int) (samp0 / factor);
+        b_size = (int) ceil (nlines / factor);
+        if (b_line0 + b_size > bmeta->nlines)
+            b_size = bmeta->nlines - b_line0;
+        bmeta->nlines = b_size;
+        b_size = (int) ceil (nsamps / factor);
+        if (b_samp0 + b_size > bmeta->nsamps)
+            b_size = bmeta->nsamps - b_samp0;
+        bmeta->nsamps = b_size;
+    }
+
+    /* Set up the geolocation for the subset */
+    if (!get_geoloc_info (xml_metadata, &space_def))
+    {
+        sprintf (errmsg, "Getting the space definition for the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    space = setup_mapping (&space_def);
+    if (space == NULL)
+    {
+        sprintf (errmsg, "Setting up the geolocation mapping for the subset");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Compute the bounding coordinates from the edges of the subset (top,
+       bottom, left, right) */
+    gmeta->bounding_coords[ESPA_WEST] = 180.0;
+    gmeta->bounding_coords[ESPA_EAST] = -180.0;
+    gmeta->bounding_coords[ESPA_NORTH] = -90.0;
+    gmeta->bounding_coords[ESPA_SOUTH] = 90.0;
+    img.is_fill = false;
+    for (edge = 0; edge < 4; edge++)
+    {
+        nedge = (edge < 2) ? nsamps : nlines;
+        for (i = 0; i <= nedge; i++)
+        {
+            if (edge == 0)
+            {   /* top edge */
+                img.l = 0.0;
+                img.s = i;
+            }
+            else if (edge == 1)
+            {   /* bottom edge */
+                img.l = nlines;
+                img.s = i;
+            }
+            else if (edge == 2)
+            {   /* left edge */
+                img.l = i;
+                img.s = 0.0;
+            }
+            else
+            {   /* right edge */
+                img.l = i;
+                img.s = nsamps;
+            }
+
+            if (!from_space (space, &img, &geo))
+            {
+                sprintf (errmsg, "Mapping line/sample (%f, %f) to "
+                    "geolocation coords", img.l, img.s);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (space);
+                return (ERROR);
+            }
+            lat = geo.lat * RAD2DEG;
+            lon = geo.lon * RAD2DEG;
+
+            if (lon < gmeta->bounding_coords[ESPA_WEST])
+                gmeta->bounding_coords[ESPA_WEST] = lon;
+            if (lon > gmeta->bounding_coords[ESPA_EAST])
+                gmeta->bounding_coords[ESPA_EAST] = lon;
+            if (lat > gmeta->bounding_coords[ESPA_NORTH])
+                gmeta->bounding_coords[ESPA_NORTH] = lat;
+            if (lat < gmeta->bounding_coords[ESPA_SOUTH])
+                gmeta->bounding_coords[ESPA_SOUTH] = lat;
+
+            /* Save the lat/long of the UL and LR corners */
+            if (edge == 0 && i == 0)
+            {
+                gmeta->ul_corner[0] = lat;
+                gmeta->ul_corner[1] = lon;
+            }
+            else if (edge == 1 && i == nedge)
+            {
+                gmeta->lr_corner[0] = lat;
+                gmeta->lr_corner[1] = lon;
+            }
+        }
+    }
+
+    free (space);
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_roi_xml
+
+PURPOSE:  Creates the XML file for the ROI product.  The file contains the
+global metadata for the ROI and no bands; the output bands are appended to it
+as they are written.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error creating the XML file
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The ROI XML filename is the input XML filename with the suffix ("_roi",
+     or "_shard<n>" for a row shard of the scene) added before the .xml
+     extension.
+******************************************************************************/
+int create_roi_xml
+(
+    char *xml_infile,    /* I: input XML filename */
+    char *suffix,        /* I: suffix added to the input XML filename */
+    Espa_internal_meta_t *roi_metadata,
+                         /* I: XML metadata structure for the ROI product */
+    char **roi_xml_file  /* O: address of the ROI XML filename; memory is
+                               allocated by this routine */
+)
+{
+    char FUNC_NAME[] = "create_roi_xml";   /* function name */
+    char errmsg[STR_SIZE];    /* error message */
+    char *cptr = NULL;        /* pointer to the file extension */
+    Espa_internal_meta_t xml_out;  /* XML metadata with the ROI global
+                                      metadata and no bands */
+
+    /* Determine the ROI XML filename */
+    *roi_xml_file = malloc (strlen (xml_infile) + strlen (suffix) +
+        strlen (".xml") + 1);
+    if (*roi_xml_file == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the ROI XML filename");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    strcpy (*roi_xml_file, xml_infile);
+    cptr = strrchr (*roi_xml_file, '.');
+    if (cptr == NULL || strcmp (cptr, ".xml"))
+        cptr = *roi_xml_file + strlen (*roi_xml_file);
+    sprintf (cptr, "%s.xml", suffix);
+
+    /* Write the global metadata for the ROI */
+    xml_out = *roi_metadata;
+    xml_out.nbands = 0;
+    xml_out.band = NULL;
+    if (write_metadata (&xml_out, *roi_xml_file) != SUCCESS)
+    {
+        sprintf (errmsg, "Writing the ROI XML file: %s", *roi_xml_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
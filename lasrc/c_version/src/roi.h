@@ -0,0 +1,49 @@
+#ifndef _ROI_H_
+#define _ROI_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include "lasrc.h"
+
+/* Prototypes */
+int roi_to_pixel
+(
+    Espa_internal_meta_t *xml_metadata,
+                         /* I: XML metadata structure */
+    Img_coord_info_t *size, /* I: size of the reflectance bands */
+    Roi_type_t roi_type, /* I: type of ROI coordinates */
+    double *roi_coords,  /* I: UL line/samp, LR line/samp for ROI_PIXEL;
+                               UL x/y, LR x/y for ROI_PROJ */
+    int *ul_line,        /* O: UL line of the ROI */
+    int *ul_samp,        /* O: UL sample of the ROI */
+    int *lr_line,        /* O: LR line of the ROI (inclusive) */
+    int *lr_samp         /* O: LR sample of the ROI (inclusive) */
+);
+
+int subset_xml_metadata
+(
+    Espa_internal_meta_t *xml_metadata,
+                         /* I/O: XML metadata structure to be subset */
+    double *pixsize,     /* I: pixel size of the reflectance bands */
+    int full_nlines,     /* I: number of reflectance lines before the subset */
+    int full_nsamps,     /* I: number of reflectance samps before the subset */
+    int line0,           /* I: first reflectance line of the subset */
+    int samp0,           /* I: first reflectance sample of the subset */
+    int nlines,          /* I: number of reflectance lines in the subset */
+    int nsamps           /* I: number of reflectance samples in the subset */
+);
+
+int create_roi_xml
+(
+    char *xml_infile,    /* I: input XML filename */
+    char *suffix,        /* I: suffix added to the input XML filename */
+    Espa_internal_meta_t *roi_metadata,
+                         /* I: XML metadata structure for the ROI product */
+    char **roi_xml_file  /* O: address of the ROI XML filename; memory is
+                               allocated by this routine */
+);
+
+#endif
@@ -0,0 +1,705 @@
+/*****************************************************************************
+FILE: shard.c
+
+PURPOSE: Contains functions for processing a scene as row shards in separate
+processes, on one node or on several nodes sharing a filesystem, and for
+merging the shard products into the full-scene product.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. A shard is a full-width band of rows on the aerosol window grid, and is
+   processed as a region of interest (see set_input_roi).  The halo of
+   aerosol windows around the shard is inverted by both neighboring shards,
+   which gives the same window values as a single-process run, so the
+   aerosol interpolation across the shard boundaries matches without
+   exchanging the boundary windows.
+2. The only scene-wide value in the aerosol processing is the median of the
+   clear aerosol windows, used to fill the failed windows.  Each shard writes
+   the clear aerosols of the windows it owns to an exchange file, waits for
+   the files of the other shards, and takes the median over all of them.
+   The exchange files are <product_id>_shard<n>of<N>_<hash>.aero in the
+   current directory, where <hash> identifies the inputs of the run (see
+   hash_shard_run), so the files left by a run on other inputs are never
+   mixed into the median.  All N shards need to be running (or to have
+   already run on the same inputs) for the shards to complete.
+3. Each shard writes its bands as <band>_shard<n>.img and appends them to
+   <input>_shard<n>.xml.  merge_shards concatenates the shard bands into the
+   full-scene bands, appends those to the input XML file, and removes the
+   shard files.
+*****************************************************************************/
+#include <unistd.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include "shard.h"
+#include "checkpoint.h"
+#include "quick_select.h"
+
+/* Size of the buffer for concatenating the shard bands (bytes) */
+#define SHARD_COPY_SIZE (4 * 1024 * 1024)
+
+/******************************************************************************
+MODULE:  shard_to_pixel
+
+PURPOSE:  Determines the lines and samples of a row shard of the scene.  The
+aerosol window rows are split evenly between the shards.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The shard is invalid or has no aerosol window rows
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+int shard_to_pixel
+(
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int ishard,          /* I: row shard of the scene (1-based) */
+    int nshards,         /* I: number of row shards of the scene */
+    int *ul_line,        /* O: UL line of the shard */
+    int *ul_samp,        /* O: UL sample of the shard */
+    int *lr_line,        /* O: LR line of the shard (inclusive) */
+    int *lr_samp         /* O: LR sample of the shard (inclusive) */
+)
+{
+    char FUNC_NAME[] = "shard_to_pixel";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int nwin_lines;          /* number of rows of aerosol windows */
+    int first_win;           /* first aerosol window row of the shard */
+    int end_win;             /* last aerosol window row of the shard
+                                (exclusive) */
+
+    nwin_lines = (nlines + aero_window - 1) / aero_window;
+    first_win = (long) (ishard - 1) * nwin_lines / nshards;
+    end_win = (long) ishard * nwin_lines / nshards;
+    if (ishard < 1 || ishard > nshards || end_win <= first_win)
+    {
+        sprintf (errmsg, "Shard %d of %d is invalid for a scene with %d rows "
+            "of aerosol windows", ishard, nshards, nwin_lines);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    *ul_line = first_win * aero_window;
+    *lr_line = end_win * aero_window - 1;
+    if (*lr_line >= nlines)
+        *lr_line = nlines - 1;
+    *ul_samp = 0;
+    *lr_samp = nsamps - 1;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  hash_shard_run
+
+PURPOSE:  Computes a hash identifying the inputs of a sharded run, which is
+the same for all the shards of the run.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error getting the status of an input file
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The shards each read a different part of the input bands, so the input
+     files are identified by their name, size, and modification time rather
+     than by their contents.
+******************************************************************************/
+static int hash_shard_run
+(
+    Input_t *input,      /* I: input structure, limited to the shard */
+    char *auxnm,         /* I: auxiliary filename for ozone and water vapor */
+    char *intrefnm,      /* I: intrinsic reflectance filename */
+    bool fast_math,      /* I: is the fast-math inversion being used? */
+    int aero_window,     /* I: size of the aerosol window */
+    uint64_t *run_hash   /* O: hash of the inputs of the run */
+)
+{
+    char FUNC_NAME[] = "hash_shard_run";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int ib;                  /* looping variable for the input files */
+    int nfiles;              /* number of input files */
+    char *files[NBAND_REFL_MAX+2];  /* input files of the run */
+    uint64_t hash;           /* hash of the inputs */
+    int64_t fsize;           /* size of the current input file */
+    int64_t fmtime;          /* modification time of the current input file */
+    struct stat statbuf;     /* input file status */
+
+    nfiles = 0;
+    for (ib = 0; ib < input->nband; ib++)
+        files[nfiles++] = input->file_name[ib];
+    if (input->nband_qa > 0)
+        files[nfiles++] = input->file_name_qa[0];
+    if (input->file_name_sza != NULL)
+        files[nfiles++] = input->file_name_sza;
+
+    hash = FNV1A_OFFSET_BASIS;
+    for (ib = 0; ib < nfiles; ib++)
+    {
+        if (files[ib] == NULL)
+            continue;
+        if (stat (files[ib], &statbuf) != 0)
+        {
+            sprintf (errmsg, "Getting the status of input file: %s",
+                files[ib]);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        fsize = statbuf.st_size;
+        fmtime = statbuf.st_mtime;
+        hash = fnv1a_hash (hash, files[ib], strlen (files[ib]));
+        hash = fnv1a_hash (hash, &fsize, sizeof (fsize));
+        hash = fnv1a_hash (hash, &fmtime, sizeof (fmtime));
+    }
+
+    hash = fnv1a_hash (hash, &input->roi.full_nlines,
+        sizeof (input->roi.full_nlines));
+    hash = fnv1a_hash (hash, &input->roi.full_nsamps,
+        sizeof (input->roi.full_nsamps));
+    hash = fnv1a_hash (hash, &input->roi.nshards,
+        sizeof (input->roi.nshards));
+    hash = fnv1a_hash (hash, &aero_window, sizeof (aero_window));
+    hash = fnv1a_hash (hash, auxnm, strlen (auxnm));
+    hash = fnv1a_hash (hash, intrefnm, strlen (intrefnm));
+    hash = fnv1a_hash (hash, &fast_math, sizeof (fast_math));
+
+    *run_hash = hash;
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  find_shard_median_aerosol
+
+PURPOSE:  Finds the median of the clear aerosol windows of the whole scene,
+from the windows of this shard and the ones exchanged by the other shards.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+zero            Error exchanging the clear aerosols with the other shards
+non-zero        Median aerosol value of the scene
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. Only the windows owned by this shard, not the ones in its halo, are
+     exchanged, so each window of the scene is counted once and the median
+     is the same as for a single-process run.
+  2. The exchange file is written under a temporary name and then renamed,
+     so the other shards never read a partial file.
+  3. The exchange files are named with the hash of the inputs of the run,
+     and the hash and shard stored in each file are checked before its
+     aerosols are used.  An exchange file left by an earlier run on the same
+     inputs holds the same aerosols and is used as is.
+******************************************************************************/
+float find_shard_median_aerosol
+(
+    Input_t *input,      /* I: input structure, limited to the shard */
+    char *product_id,    /* I: product ID of the scene */
+    char *auxnm,         /* I: auxiliary filename for ozone and water vapor */
+    char *intrefnm,      /* I: intrinsic reflectance filename */
+    bool fast_math,      /* I: is the fast-math inversion being used? */
+    uint8 *ipflag,       /* I: QA flag of the aerosol windows, nlines x
+                               nsamps */
+    float *taero,        /* I: aerosol values of the windows, nlines x
+                               nsamps */
+    int aero_window,     /* I: size of the aerosol window */
+    int half_aero_window,/* I: offset of the representative pixel in the
+                               aerosol window (half the window for L8, 0 for
+                               S2) */
+    int nlines,          /* I: number of lines in the processing window */
+    int nsamps           /* I: number of samples in the processing window */
+)
+{
+    char FUNC_NAME[] = "find_shard_median_aerosol";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char aero_file[STR_SIZE];/* exchange file of the current shard */
+    char tmp_file[STR_SIZE+8]; /* temporary name of this shard's exchange
+                                  file */
+    int ishard;              /* looping variable for the shards */
+    int line, samp;          /* looping variables for lines and samples */
+    int first_line;          /* first line owned by this shard */
+    int end_line;            /* last line owned by this shard (exclusive) */
+    int nwindows;            /* number of windows in the processing window */
+    int nclear;              /* number of clear windows of a shard */
+    int nbclrpix;            /* number of clear windows of the scene */
+    int waited;              /* seconds waited for the current shard */
+    long curr_pix;           /* current pixel in the processing window */
+    uint64_t run_hash;       /* hash of the inputs of the run */
+    float median;            /* median clear aerosol value */
+    float *aero = NULL;      /* clear aerosol values of this shard */
+    float *all_aero = NULL;  /* clear aerosol values of the scene */
+    FILE *fptr = NULL;       /* exchange file pointer */
+    struct stat statbuf;     /* exchange file status */
+    Shard_aero_header_t hdr; /* exchange file header */
+
+    /* Identify the run, so only the exchange files of this run are used */
+    if (hash_shard_run (input, auxnm, intrefnm, fast_math, aero_window,
+        &run_hash) != SUCCESS)
+    {
+        sprintf (errmsg, "Computing the hash of the shard inputs");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (0.0);
+    }
+
+    /* Gather the clear aerosols of the windows owned by this shard */
+    nwindows = ((nlines + aero_window - 1) / aero_window) *
+        ((nsamps + aero_window - 1) / aero_window);
+    aero = calloc (nwindows, sizeof (float));
+    if (aero == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for clear aerosol array");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (0.0);
+    }
+
+    first_line = input->roi.out_line0;
+    end_line = input->roi.out_line0 + input->roi.out_nlines;
+    nclear = 0;
+    for (line = half_aero_window; line < nlines; line += aero_window)
+    {
+        if (line < first_line || line >= end_line)
+            continue;
+        curr_pix = (long) line * nsamps + half_aero_window;
+        for (samp = half_aero_window; samp < nsamps;
+             samp += aero_window, curr_pix += aero_window)
+        {
+            if (btest (ipflag[curr_pix], IPFLAG_CLEAR))
+                aero[nclear++] = taero[curr_pix];
+        }
+    }
+
+    /* Write them for the other shards */
+    sprintf (aero_file, "%s_shard%dof%d_%016llx.aero", product_id,
+        input->roi.ishard, input->roi.nshards, (unsigned long long) run_hash);
+    sprintf (tmp_file, "%s.tmp", aero_file);
+    memset (&hdr, 0, sizeof (hdr));
+    memcpy (hdr.magic, SHARD_AERO_MAGIC, sizeof (hdr.magic));
+    hdr.run_hash = run_hash;
+    hdr.ishard = input->roi.ishard;
+    hdr.nshards = input->roi.nshards;
+    hdr.nclear = nclear;
+    fptr = fopen (tmp_file, "wb");
+    if (fptr == NULL ||
+        fwrite (&hdr, sizeof (hdr), 1, fptr) != 1 ||
+        fwrite (aero, sizeof (float), nclear, fptr) != (size_t) nclear ||
+        fclose (fptr) != 0 || rename (tmp_file, aero_file) != 0)
+    {
+        sprintf (errmsg, "Writing the shard aerosol exchange file: %s",
+            aero_file);
+        error_handler (true, FUNC_NAME, errmsg);
+        free (aero);
+        return (0.0);
+    }
+    free (aero);
+
+    /* Wait for the exchange files of all the shards and read them */
+    printf ("Waiting for the clear aerosols of the %d shards\n",
+        input->roi.nshards);
+    nbclrpix = 0;
+    for (ishard = 1; ishard <= input->roi.nshards; ishard++)
+    {
+        sprintf (aero_file, "%s_shard%dof%d_%016llx.aero", product_id,
+            ishard, input->roi.nshards, (unsigned long long) run_hash);
+        for (waited = 0; stat (aero_file, &statbuf) != 0;
+             waited += SHARD_POLL_SEC)
+        {
+            if (waited >= SHARD_WAIT_SEC)
+            {
+                sprintf (errmsg, "Timed out waiting for shard %d: %s",
+                    ishard, aero_file);
+                error_handler (true, FUNC_NAME, errmsg);
+                free (all_aero);
+                return (0.0);
+            }
+            sleep (SHARD_POLL_SEC);
+        }
+
+        fptr = fopen (aero_file, "rb");
+        if (fptr == NULL || fread (&hdr, sizeof (hdr), 1, fptr) != 1)
+        {
+            sprintf (errmsg, "Reading the shard aerosol exchange file: %s",
+                aero_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            if (fptr != NULL)
+                fclose (fptr);
+            free (all_aero);
+            return (0.0);
+        }
+
+        /* Make sure the file is for this shard of this run */
+        if (memcmp (hdr.magic, SHARD_AERO_MAGIC, sizeof (hdr.magic)) ||
+            hdr.run_hash != run_hash || hdr.ishard != ishard ||
+            hdr.nshards != input->roi.nshards || hdr.nclear < 0)
+        {
+            sprintf (errmsg, "Shard aerosol exchange file %s is not for "
+                "shard %d of the current inputs", aero_file, ishard);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fptr);
+            free (all_aero);
+            return (0.0);
+        }
+        nclear = hdr.nclear;
+
+        all_aero = realloc (all_aero, (nbclrpix + nclear + 1) *
+            sizeof (float));
+        if (all_aero == NULL)
+        {
+            sprintf (errmsg, "Error allocating memory for clear aerosol "
+                "array");
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fptr);
+            return (0.0);
+        }
+        if (fread (&all_aero[nbclrpix], sizeof (float), nclear, fptr) !=
+            (size_t) nclear)
+        {
+            sprintf (errmsg, "Reading the shard aerosol exchange file: %s",
+                aero_file);
+            error_handler (true, FUNC_NAME, errmsg);
+            fclose (fptr);
+            free (all_aero);
+            return (0.0);
+        }
+        fclose (fptr);
+        nbclrpix += nclear;
+    }
+
+    /* If no clear aerosols were available, then just return a default value */
+    if (nbclrpix == 0)
+        median = DEFAULT_AERO;
+    else
+    {
+        /* Get the median of the clear pixels */
+        median = quick_select (all_aero, nbclrpix);
+    }
+
+    free (all_aero);
+    return (median);
+}
+
+
+/******************************************************************************
+MODULE:  shard_band_hdr
+
+PURPOSE:  Determines the ENVI header filename of a band, the same way as for
+the bands written by lasrc.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static void shard_band_hdr
+(
+    char *file_name,     /* I: band filename */
+    char *envi_file      /* O: ENVI header filename */
+)
+{
+    char *cptr = NULL;   /* pointer to the file extension */
+
+    strcpy (envi_file, file_name);
+    cptr = strchr (envi_file, '.');
+    if (cptr == NULL)
+        cptr = envi_file + strlen (envi_file);
+    strcpy (cptr, ".hdr");
+}
+
+
+/******************************************************************************
+MODULE:  shard_xml_name
+
+PURPOSE:  Determines the XML filename of a row shard of the scene, the same
+way as create_roi_xml.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the filename
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+static int shard_xml_name
+(
+    char *xml_infile,    /* I: input XML filename */
+    char *suffix,        /* I: shard suffix added to the input XML filename */
+    char **shard_xml     /* O: address of the shard XML filename; memory is
+                               allocated and needs to be freed by the
+                               caller */
+)
+{
+    char *cptr = NULL;   /* pointer to the .xml extension */
+
+    *shard_xml = malloc (strlen (xml_infile) + strlen (suffix) +
+        strlen (".xml") + 1);
+    if (*shard_xml == NULL)
+        return (ERROR);
+    strcpy (*shard_xml, xml_infile);
+    cptr = strrchr (*shard_xml, '.');
+    if (cptr == NULL || strcmp (cptr, ".xml"))
+        cptr = *shard_xml + strlen (*shard_xml);
+    sprintf (cptr, "%s.xml", suffix);
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  merge_shards
+
+PURPOSE:  Merges the bands of the row shards of a scene into the full-scene
+bands and appends them to the input XML file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading the shard products or writing the merged bands
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The shards are full-width bands of rows in order down the scene, so each
+     full-scene band is the concatenation of the shard bands.
+  2. The shard bands, their ENVI headers and XML files, and the aerosol
+     exchange files are removed once the merged bands have been appended to
+     the input XML file.
+******************************************************************************/
+int merge_shards
+(
+    char *xml_infile,    /* I: input XML filename */
+    int nshards          /* I: number of row shards of the scene */
+)
+{
+    char FUNC_NAME[] = "merge_shards";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char suffix[STR_SIZE];   /* suffix of the shard XML filename */
+    char envi_file[STR_SIZE];/* ENVI header filename */
+    char *shard_xml = NULL;  /* shard XML filename */
+    char *cptr = NULL;       /* pointer to the shard suffix of a band */
+    char *buf = NULL;        /* buffer for concatenating the shard bands */
+    int ishard;              /* looping variable for the shards */
+    int ib;                  /* looping variable for the bands */
+    int nbands;              /* number of bands in the shard products */
+    size_t ifile;            /* looping variable for the exchange files */
+    size_t nbytes;           /* number of bytes read from a shard band */
+    glob_t aero_glob;        /* aerosol exchange files of a shard */
+    FILE *in_fptr = NULL;    /* shard band file pointer */
+    FILE *out_fptr = NULL;   /* merged band file pointer */
+    Espa_internal_meta_t xml_metadata;  /* input XML metadata */
+    Espa_internal_meta_t *shard_meta = NULL;  /* XML metadata of the shards */
+    Espa_band_meta_t *bmeta = NULL;     /* merged band metadata */
+    Envi_header_t envi_hdr;  /* merged band ENVI header */
+
+    /* Read the input XML file, for the global metadata of the scene */
+    init_metadata_struct (&xml_metadata);
+    if (parse_metadata (xml_infile, &xml_metadata) != SUCCESS)
+    {  /* Error messages already written */
+        return (ERROR);
+    }
+
+    /* Read the XML files of the shard products */
+    shard_meta = calloc (nshards, sizeof (Espa_internal_meta_t));
+    buf = malloc (SHARD_COPY_SIZE);
+    if (shard_meta == NULL || buf == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for merging the shards");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (ishard = 0; ishard < nshards; ishard++)
+    {
+        sprintf (suffix, "_shard%d", ishard+1);
+        init_metadata_struct (&shard_meta[ishard]);
+        if (shard_xml_name (xml_infile, suffix, &shard_xml) !=
+            SUCCESS ||
+            parse_metadata (shard_xml, &shard_meta[ishard]) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the XML file of shard %d", ishard+1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        free (shard_xml);
+
+        if (shard_meta[ishard].nbands != shard_meta[0].nbands)
+        {
+            sprintf (errmsg, "Shard %d has %d bands rather than %d.  Were all "
+                "the shards processed with the same options?", ishard+1,
+                shard_meta[ishard].nbands, shard_meta[0].nbands);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+    nbands = shard_meta[0].nbands;
+
+    bmeta = malloc (nbands * sizeof (Espa_band_meta_t));
+    if (bmeta == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the merged band metadata");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Concatenate the shards of each band */
+    printf ("Merging %d bands of %d shards ...\n", nbands, nshards);
+    for (ib = 0; ib < nbands; ib++)
+    {
+        /* The merged band is the band of the first shard, without the shard
+           suffix and with the lines of all the shards */
+        bmeta[ib] = shard_meta[0].band[ib];
+        cptr = strstr (bmeta[ib].file_name, "_shard1.");
+        if (cptr == NULL)
+        {
+            sprintf (errmsg, "Band %s of shard 1 isn't a shard band",
+                bmeta[ib].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        memmove (cptr, cptr + strlen ("_shard1"),
+            strlen (cptr + strlen ("_shard1")) + 1);
+        bmeta[ib].nlines = 0;
+
+        printf ("  %s\n", bmeta[ib].file_name);
+        out_fptr = fopen (bmeta[ib].file_name, "wb");
+        if (out_fptr == NULL)
+        {
+            sprintf (errmsg, "Opening the merged band: %s",
+                bmeta[ib].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        for (ishard = 0; ishard < nshards; ishard++)
+        {
+            if (strcmp (shard_meta[ishard].band[ib].name, bmeta[ib].name) ||
+                shard_meta[ishard].band[ib].nsamps != bmeta[ib].nsamps)
+            {
+                sprintf (errmsg, "Band %d of shard %d doesn't match band %s "
+                    "of shard 1", ib, ishard+1, bmeta[ib].name);
+                error_handler (true, FUNC_NAME, errmsg);
+                fclose (out_fptr);
+                return (ERROR);
+            }
+            bmeta[ib].nlines += shard_meta[ishard].band[ib].nlines;
+
+            in_fptr = fopen (shard_meta[ishard].band[ib].file_name, "rb");
+            if (in_fptr == NULL)
+            {
+                sprintf (errmsg, "Opening the shard band: %s",
+                    shard_meta[ishard].band[ib].file_name);
+                error_handler (true, FUNC_NAME, errmsg);
+                fclose (out_fptr);
+                return (ERROR);
+            }
+            while ((nbytes = fread (buf, 1, SHARD_COPY_SIZE, in_fptr)) > 0)
+            {
+                if (fwrite (buf, 1, nbytes, out_fptr) != nbytes)
+                {
+                    sprintf (errmsg, "Writing the merged band: %s",
+                        bmeta[ib].file_name);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    fclose (in_fptr);
+                    fclose (out_fptr);
+                    return (ERROR);
+                }
+            }
+            fclose (in_fptr);
+        }
+
+        if (fclose (out_fptr) != 0)
+        {
+            sprintf (errmsg, "Closing the merged band: %s",
+                bmeta[ib].file_name);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Write the ENVI header of the merged band */
+        if (create_envi_struct (&bmeta[ib], &xml_metadata.global,
+            &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Creating ENVI header structure.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        shard_band_hdr (bmeta[ib].file_name, envi_file);
+        if (write_envi_hdr (envi_file, &envi_hdr) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing ENVI header file.");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }
+
+    /* Append the merged bands to the input XML file */
+    if (append_metadata (nbands, bmeta, xml_infile) != SUCCESS)
+    {
+        sprintf (errmsg, "Appending the merged bands to the XML file.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Remove the shard products and the aerosol exchange files */
+    for (ishard = 0; ishard < nshards; ishard++)
+    {
+        for (ib = 0; ib < nbands; ib++)
+        {
+            unlink (shard_meta[ishard].band[ib].file_name);
+            shard_band_hdr (shard_meta[ishard].band[ib].file_name,
+                envi_file);
+            unlink (envi_file);
+        }
+        sprintf (suffix, "_shard%d", ishard+1);
+        if (shard_xml_name (xml_infile, suffix, &shard_xml) ==
+            SUCCESS)
+        {
+            unlink (shard_xml);
+            free (shard_xml);
+        }
+        sprintf (envi_file, "%s_shard%dof%d_*.aero",
+            xml_metadata.global.product_id, ishard+1, nshards);
+        if (glob (envi_file, 0, NULL, &aero_glob) == 0)
+        {
+            for (ifile = 0; ifile < aero_glob.gl_pathc; ifile++)
+                unlink (aero_glob.gl_pathv[ifile]);
+            globfree (&aero_glob);
+        }
+        free_metadata (&shard_meta[ishard]);
+    }
+
+    free (shard_meta);
+    free (bmeta);
+    free (buf);
+    free_metadata (&xml_metadata);
+    return (SUCCESS);
+}
@@ -0,0 +1,68 @@
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include "lasrc.h"
+
+/* Longest time a shard waits for the clear aerosols of the other shards
+   (seconds), and how often it checks for them */
+#define SHARD_WAIT_SEC 14400
+#define SHARD_POLL_SEC 2
+
+/* Identifier at the start of each aerosol exchange file */
+#define SHARD_AERO_MAGIC "LASRCAER"
+
+/* Header of the aerosol exchange file of a shard.  The header is followed by
+   the nclear clear aerosol values of the windows owned by the shard. */
+typedef struct {
+    char magic[8];          /* SHARD_AERO_MAGIC, not NULL-terminated */
+    uint64_t run_hash;      /* hash of the inputs of the run */
+    int ishard;             /* row shard which wrote the file (1-based) */
+    int nshards;            /* number of row shards of the scene */
+    int nclear;             /* number of clear aerosol values */
+} Shard_aero_header_t;
+
+/* Prototypes */
+int shard_to_pixel
+(
+    int nlines,          /* I: number of lines in the scene */
+    int nsamps,          /* I: number of samples in the scene */
+    int aero_window,     /* I: size of the aerosol window */
+    int ishard,          /* I: row shard of the scene (1-based) */
+    int nshards,         /* I: number of row shards of the scene */
+    int *ul_line,        /* O: UL line of the shard */
+    int *ul_samp,        /* O: UL sample of the shard */
+    int *lr_line,        /* O: LR line of the shard (inclusive) */
+    int *lr_samp         /* O: LR sample of the shard (inclusive) */
+);
+
+float find_shard_median_aerosol
+(
+    Input_t *input,      /* I: input structure, limited to the shard */
+    char *product_id,    /* I: product ID of the scene */
+    char *auxnm,         /* I: auxiliary filename for ozone and water vapor */
+    char *intrefnm,      /* I: intrinsic reflectance filename */
+    bool fast_math,      /* I: is the fast-math inversion being used? */
+    uint8 *ipflag,       /* I: QA flag of the aerosol windows, nlines x
+                               nsamps */
+    float *taero,        /* I: aerosol values of the windows, nlines x
+                               nsamps */
+    int aero_window,     /* I: size of the aerosol window */
+    int half_aero_window,/* I: offset of the representative pixel in the
+                               aerosol window (half the window for L8, 0 for
+                               S2) */
+    int nlines,          /* I: number of lines in the processing window */
+    int nsamps           /* I: number of samples in the processing window */
+);
+
+int merge_shards
+(
+    char *xml_infile,    /* I: input XML filename */
+    int nshards          /* I: number of row shards of the scene */
+);
+
+#endif
@@ -0,0 +1,487 @@
+/*****************************************************************************
+FILE: strip.c
+
+PURPOSE: Contains functions for sharing the LUTs, the auxiliary data, and the
+aerosol inversion between the consecutive WRS rows of a Landsat path
+acquisition which are processed as a strip.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. The rows of a strip are acquired at the same time with the same auxiliary
+   day, so the LUTs and the CMG auxiliary arrays are identical for all of
+   them.  They are read for the first row and then owned by the strip until
+   free_strip is called.
+2. Adjacent rows overlap by roughly 10%.  Where they do, the clear aerosol
+   windows of the previous row are reused for the current row rather than
+   inverted again.  Rows which don't share the previous row's pixel grid
+   (projection, zone, pixel size, and whole-pixel offset) invert every
+   window.
+3. The aerosol windows of the two rows aren't necessarily aligned, so the
+   previous row's window containing the center of the current window is
+   used.  That window's value was inverted from a pixel at most one window
+   away, which is the same spacing the inversion itself uses when the
+   center pixel of a window is fill, water, or cloud.
+*****************************************************************************/
+#include "strip.h"
+#include "lasrc.h"
+
+/******************************************************************************
+MODULE:  init_strip
+
+PURPOSE:  Initializes an empty strip, before its first row is processed.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void init_strip
+(
+    Lasrc_strip_t *strip    /* O: strip to be initialized */
+)
+{
+    memset (strip, 0, sizeof (Lasrc_strip_t));
+}
+
+
+/******************************************************************************
+MODULE:  get_strip_aux
+
+PURPOSE:  Replaces the LUT and auxiliary arrays allocated for the current row
+with the arrays already read for a previous row of the strip.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           The current row doesn't use the strip's LUT and aux files
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. If the strip's arrays haven't been read yet, then nothing is changed and
+     shared is false.  Otherwise the current row's arrays are freed, the
+     pointers are set to the strip's arrays, and shared is true.  The
+     strip's arrays must not be freed by the caller.
+******************************************************************************/
+int get_strip_aux
+(
+    Lasrc_strip_t *strip,   /* I: strip for the current row */
+    char *intrefnm,         /* I: intrinsic reflectance LUT of this row */
+    char *auxnm,            /* I: ozone and water vapor file of this row */
+    float tts[NSOLAR_ZEN_VALS],   /* O: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* O: index for the sun angle table */
+    float **rolutt,         /* I/O: intrinsic reflectance table */
+    float **transt,         /* I/O: transmission table */
+    float **sphalbt,        /* I/O: spherical albedo table */
+    float **normext,        /* I/O: aerosol extinction coefficient table */
+    float **tsmax,          /* I/O: maximum scattering angle table */
+    float **tsmin,          /* I/O: minimum scattering angle table */
+    float **nbfic,          /* I/O: communitive number of azimuth angles */
+    float **nbfi,           /* I/O: number of azimuth angles */
+    float **ttv,            /* I/O: view angle table */
+    int16 **dem,            /* I/O: CMG DEM */
+    int16 **andwi,          /* I/O: avg NDWI */
+    int16 **sndwi,          /* I/O: standard NDWI */
+    int16 **ratiob1,        /* I/O: mean band1 ratio */
+    int16 **ratiob2,        /* I/O: mean band2 ratio */
+    int16 **ratiob7,        /* I/O: mean band7 ratio */
+    int16 **intratiob1,     /* I/O: integer band1 ratio */
+    int16 **intratiob2,     /* I/O: integer band2 ratio */
+    int16 **intratiob7,     /* I/O: integer band7 ratio */
+    int16 **slpratiob1,     /* I/O: slope band1 ratio */
+    int16 **slpratiob2,     /* I/O: slope band2 ratio */
+    int16 **slpratiob7,     /* I/O: slope band7 ratio */
+    uint16 **wv,            /* I/O: water vapor values */
+    uint8 **oz,             /* I/O: ozone values */
+    bool *shared            /* O: were the strip's arrays returned? */
+)
+{
+    char FUNC_NAME[] = "get_strip_aux";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+
+    *shared = false;
+    if (!strip->aux_read)
+        return (SUCCESS);
+
+    /* All the rows of a strip are from the same acquisition, so they need to
+       use the same LUTs and auxiliary day */
+    if (strcmp (intrefnm, strip->intrefnm) || strcmp (auxnm, strip->auxnm))
+    {
+        sprintf (errmsg, "The LUT and auxiliary files of this row don't "
+            "match those of the strip.  All the rows of a strip must be from "
+            "the same acquisition.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    memcpy (tts, strip->tts, sizeof (strip->tts));
+    memcpy (indts, strip->indts, sizeof (strip->indts));
+
+    free (*rolutt);  *rolutt = strip->rolutt;
+    free (*transt);  *transt = strip->transt;
+    free (*sphalbt);  *sphalbt = strip->sphalbt;
+    free (*normext);  *normext = strip->normext;
+    free (*tsmax);  *tsmax = strip->tsmax;
+    free (*tsmin);  *tsmin = strip->tsmin;
+    free (*nbfic);  *nbfic = strip->nbfic;
+    free (*nbfi);  *nbfi = strip->nbfi;
+    free (*ttv);  *ttv = strip->ttv;
+    free (*dem);  *dem = strip->dem;
+    free (*andwi);  *andwi = strip->andwi;
+    free (*sndwi);  *sndwi = strip->sndwi;
+    free (*ratiob1);  *ratiob1 = strip->ratiob1;
+    free (*ratiob2);  *ratiob2 = strip->ratiob2;
+    free (*ratiob7);  *ratiob7 = strip->ratiob7;
+    free (*intratiob1);  *intratiob1 = strip->intratiob1;
+    free (*intratiob2);  *intratiob2 = strip->intratiob2;
+    free (*intratiob7);  *intratiob7 = strip->intratiob7;
+    free (*slpratiob1);  *slpratiob1 = strip->slpratiob1;
+    free (*slpratiob2);  *slpratiob2 = strip->slpratiob2;
+    free (*slpratiob7);  *slpratiob7 = strip->slpratiob7;
+    free (*wv);  *wv = strip->wv;
+    free (*oz);  *oz = strip->oz;
+
+    *shared = true;
+    printf ("Using the LUTs and auxiliary data already read for the "
+        "strip\n");
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  keep_strip_aux
+
+PURPOSE:  Hands the LUT and auxiliary arrays read for the first row of the
+strip over to the strip, so the remaining rows can share them.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The arrays are owned by the strip after this call and are freed by
+     free_strip.
+******************************************************************************/
+void keep_strip_aux
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    char *intrefnm,         /* I: intrinsic reflectance LUT of this row */
+    char *auxnm,            /* I: ozone and water vapor file of this row */
+    float tts[NSOLAR_ZEN_VALS],   /* I: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* I: index for the sun angle table */
+    float *rolutt,          /* I: intrinsic reflectance table */
+    float *transt,          /* I: transmission table */
+    float *sphalbt,         /* I: spherical albedo table */
+    float *normext,         /* I: aerosol extinction coefficient table */
+    float *tsmax,           /* I: maximum scattering angle table */
+    float *tsmin,           /* I: minimum scattering angle table */
+    float *nbfic,           /* I: communitive number of azimuth angles */
+    float *nbfi,            /* I: number of azimuth angles */
+    float *ttv,             /* I: view angle table */
+    int16 *dem,             /* I: CMG DEM */
+    int16 *andwi,           /* I: avg NDWI */
+    int16 *sndwi,           /* I: standard NDWI */
+    int16 *ratiob1,         /* I: mean band1 ratio */
+    int16 *ratiob2,         /* I: mean band2 ratio */
+    int16 *ratiob7,         /* I: mean band7 ratio */
+    int16 *intratiob1,      /* I: integer band1 ratio */
+    int16 *intratiob2,      /* I: integer band2 ratio */
+    int16 *intratiob7,      /* I: integer band7 ratio */
+    int16 *slpratiob1,      /* I: slope band1 ratio */
+    int16 *slpratiob2,      /* I: slope band2 ratio */
+    int16 *slpratiob7,      /* I: slope band7 ratio */
+    uint16 *wv,             /* I: water vapor values */
+    uint8 *oz               /* I: ozone values */
+)
+{
+    strcpy (strip->intrefnm, intrefnm);
+    strcpy (strip->auxnm, auxnm);
+    memcpy (strip->tts, tts, sizeof (strip->tts));
+    memcpy (strip->indts, indts, sizeof (strip->indts));
+
+    strip->rolutt = rolutt;
+    strip->transt = transt;
+    strip->sphalbt = sphalbt;
+    strip->normext = normext;
+    strip->tsmax = tsmax;
+    strip->tsmin = tsmin;
+    strip->nbfic = nbfic;
+    strip->nbfi = nbfi;
+    strip->ttv = ttv;
+    strip->dem = dem;
+    strip->andwi = andwi;
+    strip->sndwi = sndwi;
+    strip->ratiob1 = ratiob1;
+    strip->ratiob2 = ratiob2;
+    strip->ratiob7 = ratiob7;
+    strip->intratiob1 = intratiob1;
+    strip->intratiob2 = intratiob2;
+    strip->intratiob7 = intratiob7;
+    strip->slpratiob1 = slpratiob1;
+    strip->slpratiob2 = slpratiob2;
+    strip->slpratiob7 = slpratiob7;
+    strip->wv = wv;
+    strip->oz = oz;
+    strip->aux_read = true;
+}
+
+
+/******************************************************************************
+MODULE:  begin_strip_row
+
+PURPOSE:  Locates the current row of the strip within the previous row, so
+the aerosol windows of the previous row can be reused where they overlap.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The rows are only aligned if they share the projection, zone, and pixel
+     size, and the UL corners are a whole number of pixels apart.
+******************************************************************************/
+void begin_strip_row
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    Espa_internal_meta_t *xml_metadata,
+                            /* I: XML metadata of the current row */
+    float pixsize           /* I: pixel size of the reflectance bands */
+)
+{
+    Espa_proj_meta_t *proj = &xml_metadata->global.proj_info;
+    double line_offset;     /* line offset from the previous row */
+    double samp_offset;     /* sample offset from the previous row */
+
+    strip->aligned = false;
+    if (!strip->have_prev)
+        return;
+
+    if (proj->proj_type != strip->prev_proj_type ||
+        proj->utm_zone != strip->prev_zone ||
+        fabs (pixsize - strip->prev_pixsize) > 0.001)
+    {
+        printf ("This row doesn't share the projection or pixel size of the "
+            "previous row of the strip.  All its aerosol windows will be "
+            "inverted.\n");
+        return;
+    }
+
+    line_offset = (strip->prev_ul[1] - proj->ul_corner[1]) / pixsize;
+    samp_offset = (proj->ul_corner[0] - strip->prev_ul[0]) / pixsize;
+    if (fabs (line_offset - round (line_offset)) > 0.01 ||
+        fabs (samp_offset - round (samp_offset)) > 0.01)
+    {
+        printf ("This row isn't on the pixel grid of the previous row of "
+            "the strip.  All its aerosol windows will be inverted.\n");
+        return;
+    }
+
+    strip->line_offset = (int) round (line_offset);
+    strip->samp_offset = (int) round (samp_offset);
+    strip->aligned = true;
+    printf ("This row starts at line %d, sample %d of the previous row of "
+        "the strip\n", strip->line_offset, strip->samp_offset);
+}
+
+
+/******************************************************************************
+MODULE:  get_strip_aero
+
+PURPOSE:  Looks up the aerosols of the previous row of the strip for an
+aerosol window of the current row.
+
+RETURN VALUE:
+Type = bool
+Value           Description
+-----           -----------
+false           The window isn't covered by a clear window of the previous
+                row
+true            The aerosols of the previous row were returned
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The strip is only read, so this may be called from multiple threads.
+******************************************************************************/
+bool get_strip_aero
+(
+    Lasrc_strip_t *strip,   /* I: strip for the current row */
+    int line,               /* I: center line of the current window */
+    int samp,               /* I: center sample of the current window */
+    float *aero,            /* O: aerosol value of the previous row */
+    float *eps              /* O: angstrom coefficient of the previous row */
+)
+{
+    int prev_line;          /* line in the previous row */
+    int prev_samp;          /* sample in the previous row */
+    long win;               /* window of the previous row */
+
+    if (!strip->aligned)
+        return (false);
+
+    prev_line = line + strip->line_offset;
+    prev_samp = samp + strip->samp_offset;
+    if (prev_line < 0 || prev_samp < 0)
+        return (false);
+    prev_line /= L8_AERO_WINDOW;
+    prev_samp /= L8_AERO_WINDOW;
+    if (prev_line >= strip->prev_nwlines || prev_samp >= strip->prev_nwsamps)
+        return (false);
+
+    win = (long) prev_line * strip->prev_nwsamps + prev_samp;
+    if (!(strip->prev_ipflag[win] & (1 << IPFLAG_CLEAR)))
+        return (false);
+
+    *aero = strip->prev_taero[win];
+    *eps = strip->prev_teps[win];
+    return (true);
+}
+
+
+/******************************************************************************
+MODULE:  save_strip_aero
+
+PURPOSE:  Saves the aerosol windows of the current row of the strip, for use
+by the next row.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the window arrays
+SUCCESS         No errors encountered
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. This needs to be called right after the aerosol inversion, while the
+     window values are only stored at the window centers and before the
+     invalid windows are filled.
+******************************************************************************/
+int save_strip_aero
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    Espa_internal_meta_t *xml_metadata,
+                            /* I: XML metadata of the current row */
+    float pixsize,          /* I: pixel size of the reflectance bands */
+    int nlines,             /* I: number of lines in the current row */
+    int nsamps,             /* I: number of samples in the current row */
+    uint8 *ipflag,          /* I: aerosol QA, nlines x nsamps */
+    float *taero,           /* I: aerosol values, nlines x nsamps */
+    float *teps             /* I: angstrom coefficients, nlines x nsamps */
+)
+{
+    char FUNC_NAME[] = "save_strip_aero";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    Espa_proj_meta_t *proj = &xml_metadata->global.proj_info;
+    int line, samp;          /* center line/sample of the current window */
+    int nwlines, nwsamps;    /* number of lines/samples of windows */
+    long pix;                /* pixel of the current window center */
+    long win;                /* current window */
+
+    nwlines = (nlines + L8_AERO_WINDOW - 1) / L8_AERO_WINDOW;
+    nwsamps = (nsamps + L8_AERO_WINDOW - 1) / L8_AERO_WINDOW;
+    free (strip->prev_ipflag);
+    free (strip->prev_taero);
+    free (strip->prev_teps);
+    strip->prev_ipflag = calloc ((long) nwlines * nwsamps, sizeof (uint8));
+    strip->prev_taero = calloc ((long) nwlines * nwsamps, sizeof (float));
+    strip->prev_teps = calloc ((long) nwlines * nwsamps, sizeof (float));
+    if (strip->prev_ipflag == NULL || strip->prev_taero == NULL ||
+        strip->prev_teps == NULL)
+    {
+        sprintf (errmsg, "Allocating the aerosol windows of the strip");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Windows whose center is past the end of the row aren't inverted, so
+       they are left as not clear */
+    for (line = L8_HALF_AERO_WINDOW; line < nlines; line += L8_AERO_WINDOW)
+    {
+        win = (long) (line / L8_AERO_WINDOW) * nwsamps;
+        pix = (long) line * nsamps + L8_HALF_AERO_WINDOW;
+        for (samp = L8_HALF_AERO_WINDOW; samp < nsamps;
+             samp += L8_AERO_WINDOW, pix += L8_AERO_WINDOW, win++)
+        {
+            strip->prev_ipflag[win] = ipflag[pix];
+            strip->prev_taero[win] = taero[pix];
+            strip->prev_teps[win] = teps[pix];
+        }
+    }
+
+    strip->have_prev = true;
+    strip->prev_proj_type = proj->proj_type;
+    strip->prev_zone = proj->utm_zone;
+    strip->prev_ul[0] = proj->ul_corner[0];
+    strip->prev_ul[1] = proj->ul_corner[1];
+    strip->prev_pixsize = pixsize;
+    strip->prev_nwlines = nwlines;
+    strip->prev_nwsamps = nwsamps;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_strip
+
+PURPOSE:  Frees the LUTs, auxiliary data, and aerosol windows of the strip.
+
+RETURN VALUE:
+Type = None
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void free_strip
+(
+    Lasrc_strip_t *strip    /* I/O: strip to be freed */
+)
+{
+    free (strip->rolutt);
+    free (strip->transt);
+    free (strip->sphalbt);
+    free (strip->normext);
+    free (strip->tsmax);
+    free (strip->tsmin);
+    free (strip->nbfic);
+    free (strip->nbfi);
+    free (strip->ttv);
+    free (strip->dem);
+    free (strip->andwi);
+    free (strip->sndwi);
+    free (strip->ratiob1);
+    free (strip->ratiob2);
+    free (strip->ratiob7);
+    free (strip->intratiob1);
+    free (strip->intratiob2);
+    free (strip->intratiob7);
+    free (strip->slpratiob1);
+    free (strip->slpratiob2);
+    free (strip->slpratiob7);
+    free (strip->wv);
+    free (strip->oz);
+    free (strip->prev_ipflag);
+    free (strip->prev_taero);
+    free (strip->prev_teps);
+    init_strip (strip);
+}
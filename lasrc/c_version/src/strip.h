@@ -0,0 +1,172 @@
+#ifndef _STRIP_H_
+#define _STRIP_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "common.h"
+#include "espa_metadata.h"
+
+/* State carried from row to row when the consecutive WRS rows of one Landsat
+   path acquisition are processed as a strip.  The LUTs and the auxiliary
+   data are read for the first row and shared by the others, and the aerosol
+   windows of each row are kept so the next row can reuse them where the two
+   rows overlap. */
+typedef struct {
+    /* LUTs and auxiliary data shared by the rows of the strip */
+    bool aux_read;              /* have the LUTs and aux data been read? */
+    char intrefnm[STR_SIZE];    /* intrinsic reflectance LUT of the strip */
+    char auxnm[STR_SIZE];       /* ozone and water vapor file of the strip */
+    float tts[NSOLAR_ZEN_VALS]; /* sun angle table */
+    int32 indts[NSUNANGLE_VALS];/* index for the sun angle table */
+    float *rolutt;              /* intrinsic reflectance table */
+    float *transt;              /* transmission table */
+    float *sphalbt;             /* spherical albedo table */
+    float *normext;             /* aerosol extinction coefficient table */
+    float *tsmax;               /* maximum scattering angle table */
+    float *tsmin;               /* minimum scattering angle table */
+    float *nbfic;               /* communitive number of azimuth angles */
+    float *nbfi;                /* number of azimuth angles */
+    float *ttv;                 /* view angle table */
+    int16 *dem;                 /* CMG DEM */
+    int16 *andwi;               /* avg NDWI */
+    int16 *sndwi;               /* standard NDWI */
+    int16 *ratiob1;             /* mean band1 ratio */
+    int16 *ratiob2;             /* mean band2 ratio */
+    int16 *ratiob7;             /* mean band7 ratio */
+    int16 *intratiob1;          /* integer band1 ratio */
+    int16 *intratiob2;          /* integer band2 ratio */
+    int16 *intratiob7;          /* integer band7 ratio */
+    int16 *slpratiob1;          /* slope band1 ratio */
+    int16 *slpratiob2;          /* slope band2 ratio */
+    int16 *slpratiob7;          /* slope band7 ratio */
+    uint16 *wv;                 /* water vapor values */
+    uint8 *oz;                  /* ozone values */
+
+    /* Aerosol windows of the previous row, one value per window */
+    bool have_prev;             /* has a previous row been saved? */
+    int prev_proj_type;         /* projection of the previous row */
+    int prev_zone;              /* UTM zone of the previous row */
+    double prev_ul[2];          /* UL corner x/y of the previous row */
+    float prev_pixsize;         /* pixel size of the previous row */
+    int prev_nwlines;           /* number of lines of windows */
+    int prev_nwsamps;           /* number of samples of windows */
+    uint8 *prev_ipflag;         /* aerosol QA of each window */
+    float *prev_taero;          /* aerosol value of each window */
+    float *prev_teps;           /* angstrom coefficient of each window */
+
+    /* Position of the current row within the previous row */
+    bool aligned;               /* do the rows share the same pixel grid? */
+    int line_offset;            /* previous row line of the current line 0 */
+    int samp_offset;            /* previous row sample of the current
+                                   sample 0 */
+} Lasrc_strip_t;
+
+/* Prototypes */
+void init_strip
+(
+    Lasrc_strip_t *strip    /* O: strip to be initialized */
+);
+
+int get_strip_aux
+(
+    Lasrc_strip_t *strip,   /* I: strip for the current row */
+    char *intrefnm,         /* I: intrinsic reflectance LUT of this row */
+    char *auxnm,            /* I: ozone and water vapor file of this row */
+    float tts[NSOLAR_ZEN_VALS],   /* O: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* O: index for the sun angle table */
+    float **rolutt,         /* I/O: intrinsic reflectance table */
+    float **transt,         /* I/O: transmission table */
+    float **sphalbt,        /* I/O: spherical albedo table */
+    float **normext,        /* I/O: aerosol extinction coefficient table */
+    float **tsmax,          /* I/O: maximum scattering angle table */
+    float **tsmin,          /* I/O: minimum scattering angle table */
+    float **nbfic,          /* I/O: communitive number of azimuth angles */
+    float **nbfi,           /* I/O: number of azimuth angles */
+    float **ttv,            /* I/O: view angle table */
+    int16 **dem,            /* I/O: CMG DEM */
+    int16 **andwi,          /* I/O: avg NDWI */
+    int16 **sndwi,          /* I/O: standard NDWI */
+    int16 **ratiob1,        /* I/O: mean band1 ratio */
+    int16 **ratiob2,        /* I/O: mean band2 ratio */
+    int16 **ratiob7,        /* I/O: mean band7 ratio */
+    int16 **intratiob1,     /* I/O: integer band1 ratio */
+    int16 **intratiob2,     /* I/O: integer band2 ratio */
+    int16 **intratiob7,     /* I/O: integer band7 ratio */
+    int16 **slpratiob1,     /* I/O: slope band1 ratio */
+    int16 **slpratiob2,     /* I/O: slope band2 ratio */
+    int16 **slpratiob7,     /* I/O: slope band7 ratio */
+    uint16 **wv,            /* I/O: water vapor values */
+    uint8 **oz,             /* I/O: ozone values */
+    bool *shared            /* O: were the strip's arrays returned? */
+);
+
+void keep_strip_aux
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    char *intrefnm,         /* I: intrinsic reflectance LUT of this row */
+    char *auxnm,            /* I: ozone and water vapor file of this row */
+    float tts[NSOLAR_ZEN_VALS],   /* I: sun angle table */
+    int32 indts[NSUNANGLE_VALS],  /* I: index for the sun angle table */
+    float *rolutt,          /* I: intrinsic reflectance table */
+    float *transt,          /* I: transmission table */
+    float *sphalbt,         /* I: spherical albedo table */
+    float *normext,         /* I: aerosol extinction coefficient table */
+    float *tsmax,           /* I: maximum scattering angle table */
+    float *tsmin,           /* I: minimum scattering angle table */
+    float *nbfic,           /* I: communitive number of azimuth angles */
+    float *nbfi,            /* I: number of azimuth angles */
+    float *ttv,             /* I: view angle table */
+    int16 *dem,             /* I: CMG DEM */
+    int16 *andwi,           /* I: avg NDWI */
+    int16 *sndwi,           /* I: standard NDWI */
+    int16 *ratiob1,         /* I: mean band1 ratio */
+    int16 *ratiob2,         /* I: mean band2 ratio */
+    int16 *ratiob7,         /* I: mean band7 ratio */
+    int16 *intratiob1,      /* I: integer band1 ratio */
+    int16 *intratiob2,      /* I: integer band2 ratio */
+    int16 *intratiob7,      /* I: integer band7 ratio */
+    int16 *slpratiob1,      /* I: slope band1 ratio */
+    int16 *slpratiob2,      /* I: slope band2 ratio */
+    int16 *slpratiob7,      /* I: slope band7 ratio */
+    uint16 *wv,             /* I: water vapor values */
+    uint8 *oz               /* I: ozone values */
+);
+
+void begin_strip_row
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    Espa_internal_meta_t *xml_metadata,
+                            /* I: XML metadata of the current row */
+    float pixsize           /* I: pixel size of the reflectance bands */
+);
+
+bool get_strip_aero
+(
+    Lasrc_strip_t *strip,   /* I: strip for the current row */
+    int line,               /* I: center line of the current window */
+    int samp,               /* I: center sample of the current window */
+    float *aero,            /* O: aerosol value of the previous row */
+    float *eps              /* O: angstrom coefficient of the previous row */
+);
+
+int save_strip_aero
+(
+    Lasrc_strip_t *strip,   /* I/O: strip for the current row */
+    Espa_internal_meta_t *xml_metadata,
+                            /* I: XML metadata of the current row */
+    float pixsize,          /* I: pixel size of the reflectance bands */
+    int nlines,             /* I: number of lines in the current row */
+    int nsamps,             /* I: number of samples in the current row */
+    uint8 *ipflag,          /* I: aerosol QA, nlines x nsamps */
+    float *taero,           /* I: aerosol values, nlines x nsamps */
+    float *teps             /* I: angstrom coefficients, nlines x nsamps */
+);
+
+void free_strip
+(
+    Lasrc_strip_t *strip    /* I/O: strip to be freed */
+);
+
+#endif
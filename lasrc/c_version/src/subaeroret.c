@@ -276,3 +276,250 @@ void subaeroret_new
         *iaots = MAX ((iaot2 - 3), 0);
     }
 }
+
+
+/******************************************************************************
+MODULE:  aot_residual_fast
+
+PURPOSE:  Fast-math helper for subaeroret_fast.  Corrects band 1 and the
+remaining bands with a valid band ratio for the specified AOT and returns the
+model residual.
+
+RETURN VALUE:
+Type = float
+Value           Description
+-----           -----------
+residual        Model residual for the specified AOT
+
+NOTES:
+******************************************************************************/
+static float aot_residual_fast
+(
+    Sat_t sat,                             /* I: satellite */
+    int iband1,                            /* I: band 1 index (0-based) */
+    int start_band,                        /* I: first band to be corrected */
+    int end_band,                          /* I: last band to be corrected */
+    float *tth,                            /* I: surface reflectance
+                                                 thresholds */
+    float *aot550nm,                       /* I: AOT values */
+    float erelc[NSR_BANDS],                /* I: band ratio variable */
+    float troatm[NSR_BANDS],               /* I: toa reflectance */
+    float tgo_arr[NREFL_BANDS],            /* I: per-band other gaseous
+                                                 transmittance */
+    float xrorayp_arr[NREFL_BANDS],        /* I: per-band Rayleigh
+                                                 reflectance */
+    int roatm_iaMax[NREFL_BANDS],          /* I: roatm_iaMax */
+    float roatm_coef[NREFL_BANDS][NCOEF],  /* I: roatm coefficients */
+    float ttatmg_coef[NREFL_BANDS][NCOEF], /* I: ttatmg coefficients */
+    float satm_coef[NREFL_BANDS][NCOEF],   /* I: satm coefficients */
+    float normext_p0a3_arr[NREFL_BANDS],   /* I: normext[iband][0][3] */
+    float raot550nm,                       /* I: AOT to be tested */
+    float eps,                             /* I: angstroem coefficient */
+    bool *testth                           /* O: surface reflectance test */
+)
+{
+    int ib;                 /* band index */
+    int nbval = 0;          /* number of values meeting criteria */
+    float ros1;             /* surface reflectance for band 1 */
+    float roslamb;          /* lambertian surface reflectance */
+    float residual = 0.0f;  /* model residual */
+
+    /* Atmospheric correction for band 1 */
+    ib = iband1;
+    atmcorlamb2_fast (sat, tgo_arr[ib], xrorayp_arr[ib],
+        aot550nm[roatm_iaMax[ib]], &roatm_coef[ib][0], &ttatmg_coef[ib][0],
+        &satm_coef[ib][0], raot550nm, ib, normext_p0a3_arr[ib], troatm[ib],
+        &roslamb, eps);
+
+    *testth = (roslamb - tth[iband1] < 0.0f);
+    ros1 = roslamb;
+
+    /* Atmospheric correction for each band */
+    for (ib = start_band; ib <= end_band; ib++)
+    {
+        /* Don't reprocess iband1 */
+        if ((erelc[ib] > 0.0f) && (ib != iband1))
+        {
+            atmcorlamb2_fast (sat, tgo_arr[ib], xrorayp_arr[ib],
+                aot550nm[roatm_iaMax[ib]], &roatm_coef[ib][0],
+                &ttatmg_coef[ib][0], &satm_coef[ib][0], raot550nm, ib,
+                normext_p0a3_arr[ib], troatm[ib], &roslamb, eps);
+
+            if (roslamb - tth[ib] < 0.0f)
+                *testth = true;
+            residual += (roslamb - erelc[ib] * ros1) *
+                        (roslamb - erelc[ib] * ros1);
+            nbval++;
+        }
+    }
+
+    return (sqrtf (residual) / nbval);
+}
+
+
+/******************************************************************************
+MODULE:  subaeroret_fast
+
+PURPOSE:  Fast-math version of subaeroret_new.  Retrieves the AOT which
+minimizes the model residual, in single precision using atmcorlamb2_fast.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The arguments are the same as subaeroret_new so the two can be used
+     interchangeably via Subaeroret_func_t.
+******************************************************************************/
+void subaeroret_fast
+(
+    Sat_t sat,                             /* I: satellite */
+    int iband1,                            /* I: band 1 index (0-based) */
+    int iband3,                            /* I: band 3 index (0-based) */
+    float erelc[NSR_BANDS],                /* I: band ratio variable */
+    float troatm[NSR_BANDS],               /* I: toa reflectance */
+    float tgo_arr[NREFL_BANDS],            /* I: per-band other gaseous
+                                                 transmittance */
+    float xrorayp_arr[NREFL_BANDS],        /* I: per-band reflectance of the
+                                                 atmosphere due to molecular
+                                                 (Rayleigh) scattering */
+    int roatm_iaMax[NREFL_BANDS],          /* I: roatm_iaMax */
+    float roatm_coef[NREFL_BANDS][NCOEF],  /* I: per band polynomial
+                                                 coefficients for roatm */
+    float ttatmg_coef[NREFL_BANDS][NCOEF], /* I: per band polynomial
+                                                 coefficients for ttatmg */
+    float satm_coef[NREFL_BANDS][NCOEF],   /* I: per band polynomial
+                                                 coefficients for satm */
+    float normext_p0a3_arr[NREFL_BANDS],   /* I: normext[iband][0][3] */
+    float *raot,     /* O: AOT reflectance */
+    float *residual, /* O: model residual */
+    int *iaots,      /* I/O: AOT index that is passed in and out for multiple
+                             calls (0-based) */
+    float eps        /* I: angstroem coefficient; spectral dependency of AOT */
+)
+{
+    int iaot;               /* aerosol optical thickness (AOT) index */
+    int start_band = 0;     /* starting band index for the loop */
+    int end_band = 0;       /* ending band index for the loop */
+    float raot550nm;        /* nearest input value of AOT */
+    float raot1, raot2;     /* AOT ratios that bracket the predicted ratio */
+    float raotsaved;        /* save the raot value */
+    float residual1, residual2;  /* residuals for storing and comparing */
+    float residualm;        /* local model residual */
+    bool testth;            /* surface reflectance test variable */
+    float xa, xb, xc, xd, xe, xf;  /* AOT ratio values */
+    float coefa, coefb;     /* AOT ratio coefficients */
+    float raotmin;          /* minimum AOT ratio */
+    int iaot2;              /* AOT index (0-based) */
+    int iaot1;              /* AOT index (0-based) */
+    float *tth = NULL;      /* pointer to the L8 or Sentinel tth array */
+    float l8_tth[NSR_BANDS] = {1.0e-03, 1.0e-03, 0.0, 1.0e-03, 0.0, 0.0,
+                               1.0e-04, 0.0};
+                            /* constant values for comparing against the
+                               L8 surface reflectance */
+    float s2_tth[NSR_BANDS] = {1.0e-03, 1.0e-03, 0.0, 1.0e-03, 0.0, 0.0, 0.0,
+                               0.0, 0.0, 0.0, 0.0, 0.0, 1.0e-04};
+                            /* constant values for comparing against the
+                               Sentinel surface reflectance */
+    float aot550nm[NAOT_VALS] = {0.01, 0.05, 0.1, 0.15, 0.2, 0.3, 0.4, 0.6,
+                                 0.8, 1.0, 1.2, 1.4, 1.6, 1.8, 2.0, 2.3, 2.6,
+                                 3.0, 3.5, 4.0, 4.5, 5.0}; /* AOT values */
+
+    /* Initialize variables based on the satellite type */
+    if (sat == SAT_LANDSAT_8)
+    {
+        tth = l8_tth;
+        start_band = DN_L8_BAND1;
+        end_band = DN_L8_BAND7;
+    }
+    else if (sat == SAT_SENTINEL_2)
+    {
+        tth = s2_tth;
+        start_band = DN_S2_BAND1;
+        end_band = DN_S2_BAND12;
+    }
+
+    /* Correct band 3 and band 1 with increasing AOT (using pre till ratio is
+       equal to erelc[2]) */
+    iaot = *iaots;
+    residual1 = 2000.0f;
+    residual2 = 1000.0f;
+    iaot2 = 0;
+    iaot1 = 0;
+    raot2 = 1.0e-06f;
+    raot1 = 0.0001f;
+    raot550nm = aot550nm[iaot];
+    *residual = aot_residual_fast (sat, iband1, start_band, end_band, tth,
+        aot550nm, erelc, troatm, tgo_arr, xrorayp_arr, roatm_iaMax,
+        roatm_coef, ttatmg_coef, satm_coef, normext_p0a3_arr, raot550nm, eps,
+        &testth);
+
+    /* Loop until we converge on a solution */
+    iaot++;
+    while ((iaot < NAOT_VALS) && (*residual < residual1) && (!testth))
+    {
+        /* Reset variables for this loop */
+        residual2 = residual1;
+        iaot2 = iaot1;
+        raot2 = raot1;
+        residual1 = *residual;
+        raot1 = raot550nm;
+        iaot1 = iaot;
+        raot550nm = aot550nm[iaot];
+        *residual = aot_residual_fast (sat, iband1, start_band, end_band, tth,
+            aot550nm, erelc, troatm, tgo_arr, xrorayp_arr, roatm_iaMax,
+            roatm_coef, ttatmg_coef, satm_coef, normext_p0a3_arr, raot550nm,
+            eps, &testth);
+
+        /* Move to the next AOT index */
+        iaot++;
+    }  /* while aot */
+
+    /* If a minimum local was not reached for raot1, then just use the
+       raot550nm value.  Otherwise continue to refine the raot. */
+    *raot = raot550nm;
+    if (iaot == 1)
+        return;
+
+    /* Refine the AOT ratio */
+    raotsaved = *raot;
+    xa = (raot1 * raot1) - (*raot * *raot);
+    xd = (raot2 * raot2) - (*raot * *raot);
+    xb = raot1 - *raot;
+    xe = raot2 - *raot;
+    xc = residual1 - *residual;
+    xf = residual2 - *residual;
+    coefa = (xc * xe - xb * xf) / (xa * xe - xb * xd);
+    coefb = (xa * xf - xc * xd) / (xa * xe - xb * xd);
+    raotmin = -coefb / (2.0f * coefa);
+
+    /* Validate the min AOT ratio */
+    if (raotmin < 0.01f || raotmin > 4.0f)
+        raotmin = *raot;
+
+    raot550nm = raotmin;
+    residualm = aot_residual_fast (sat, iband1, start_band, end_band, tth,
+        aot550nm, erelc, troatm, tgo_arr, xrorayp_arr, roatm_iaMax,
+        roatm_coef, ttatmg_coef, satm_coef, normext_p0a3_arr, raot550nm, eps,
+        &testth);
+    *raot = raot550nm;
+
+    /* Check the residuals and reset the AOT ratio */
+    if (residualm > *residual)
+    {
+        residualm = *residual;
+        *raot = raotsaved;
+    }
+    if (residualm > residual1)
+    {
+        residualm = residual1;
+        *raot = raot1;
+    }
+    if (residualm > residual2)
+    {
+        residualm = residual2;
+        *raot = raot2;
+    }
+
+    *residual = residualm;
+    *iaots = MAX ((iaot2 - 3), 0);
+}
@@ -0,0 +1,204 @@
+/*****************************************************************************
+FILE: valid_span.c
+
+PURPOSE: Contains functions for building and using an index of the valid
+(non-fill) samples in each line of a Landsat scene.
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+LICENSE TYPE:  NASA Open Source Agreement Version 1.3
+
+NOTES:
+1. Landsat Level-1 scenes are rotated within the UTM frame, so roughly a
+   quarter of the scene is fill along the left and right edges of each line.
+   Each line's span runs from its first to its last valid sample, so the
+   per-pixel loops can skip the edge fill entirely.  Interior fill within a
+   span is rare and is still handled by the per-pixel QA tests.
+2. The gaps outside the spans are set to fill directly, since the per-pixel
+   loops no longer visit them.
+*****************************************************************************/
+#include "valid_span.h"
+#include "lasrc.h"
+
+/******************************************************************************
+MODULE:  build_valid_spans
+
+PURPOSE:  Builds the valid span of each line from the Level-1 QA band.
+
+RETURN VALUE:
+Type = Valid_span_t *
+Value           Description
+-----           -----------
+NULL            Error allocating the memory
+non-NULL        Array of nlines valid spans
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+  1. The memory should be freed with free().
+******************************************************************************/
+Valid_span_t *build_valid_spans
+(
+    uint16 *qaband,      /* I: Level-1 QA band, nlines x nsamps */
+    int nlines,          /* I: number of lines in the QA band */
+    int nsamps           /* I: number of samples in the QA band */
+)
+{
+    char FUNC_NAME[] = "build_valid_spans";   /* function name */
+    char errmsg[STR_SIZE];       /* error message */
+    int line;                    /* looping variable for lines */
+    int start, end;              /* valid span of the current line */
+    uint16 *qa_line = NULL;      /* QA values for the current line */
+    Valid_span_t *spans = NULL;  /* valid spans to be returned */
+
+    spans = malloc (nlines * sizeof (Valid_span_t));
+    if (spans == NULL)
+    {
+        sprintf (errmsg, "Allocating memory for the valid spans");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (NULL);
+    }
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (line, start, end, qa_line)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        qa_line = &qaband[(long) line * nsamps];
+        for (start = 0; start < nsamps; start++)
+        {
+            if (!level1_qa_is_fill (qa_line[start]))
+                break;
+        }
+        for (end = nsamps; end > start; end--)
+        {
+            if (!level1_qa_is_fill (qa_line[end-1]))
+                break;
+        }
+        spans[line].start = start;
+        spans[line].end = end;
+    }
+
+    return (spans);
+}
+
+
+/******************************************************************************
+MODULE:  fill_span_gaps_int16
+
+PURPOSE:  Sets the int16 band samples outside the valid span of each line to
+the fill value.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void fill_span_gaps_int16
+(
+    int16 *band,         /* I/O: band to be filled, nlines x nsamps */
+    int16 fill,          /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+)
+{
+    int line, samp;      /* looping variables for lines and samples */
+    int16 *band_line;    /* band values for the current line */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (line, samp, band_line)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        band_line = &band[(long) line * nsamps];
+        for (samp = 0; samp < spans[line].start; samp++)
+            band_line[samp] = fill;
+        for (samp = spans[line].end; samp < nsamps; samp++)
+            band_line[samp] = fill;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  fill_span_gaps_uint16
+
+PURPOSE:  Sets the uint16 band samples outside the valid span of each line to
+the fill value.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void fill_span_gaps_uint16
+(
+    uint16 *band,        /* I/O: band to be filled, nlines x nsamps */
+    uint16 fill,         /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+)
+{
+    int line, samp;      /* looping variables for lines and samples */
+    uint16 *band_line;   /* band values for the current line */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (line, samp, band_line)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        band_line = &band[(long) line * nsamps];
+        for (samp = 0; samp < spans[line].start; samp++)
+            band_line[samp] = fill;
+        for (samp = spans[line].end; samp < nsamps; samp++)
+            band_line[samp] = fill;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  fill_span_gaps_uint8
+
+PURPOSE:  Sets the uint8 band samples outside the valid span of each line to
+the fill value.
+
+RETURN VALUE:
+Type = N/A
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+******************************************************************************/
+void fill_span_gaps_uint8
+(
+    uint8 *band,         /* I/O: band to be filled, nlines x nsamps */
+    uint8 fill,          /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+)
+{
+    int line;            /* looping variable for lines */
+    uint8 *band_line;    /* band values for the current line */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (line, band_line)
+#endif
+    for (line = 0; line < nlines; line++)
+    {
+        band_line = &band[(long) line * nsamps];
+        memset (band_line, fill, spans[line].start);
+        memset (&band_line[spans[line].end], fill,
+            nsamps - spans[line].end);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef _VALID_SPAN_H_
+#define _VALID_SPAN_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "common.h"
+
+/* Span of valid (non-fill) samples in a line, [start, end).  An empty line
+   has start == end. */
+typedef struct {
+    int start;          /* first valid sample in the line */
+    int end;            /* one past the last valid sample in the line */
+} Valid_span_t;
+
+/* Prototypes */
+Valid_span_t *build_valid_spans
+(
+    uint16 *qaband,      /* I: Level-1 QA band, nlines x nsamps */
+    int nlines,          /* I: number of lines in the QA band */
+    int nsamps           /* I: number of samples in the QA band */
+);
+
+void fill_span_gaps_int16
+(
+    int16 *band,         /* I/O: band to be filled, nlines x nsamps */
+    int16 fill,          /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+);
+
+void fill_span_gaps_uint16
+(
+    uint16 *band,        /* I/O: band to be filled, nlines x nsamps */
+    uint16 fill,         /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+);
+
+void fill_span_gaps_uint8
+(
+    uint8 *band,         /* I/O: band to be filled, nlines x nsamps */
+    uint8 fill,          /* I: fill value */
+    Valid_span_t *spans, /* I: valid span of each line */
+    int nlines,          /* I: number of lines in the band */
+    int nsamps           /* I: number of samples in the band */
+);
+
+#endif
@@ -284,6 +284,13 @@ class Ledaps():
                 return ERROR
 
             if process_sr == 'True':
+                # lndsr zeroes its dark target plane and aerosol grid from
+                # the threads of the aerosol retrieval; unless already
+                # specified, bind the threads to cores so those pages stay
+                # on the nodes of the threads which touched them
+                os.environ.setdefault('OMP_PROC_BIND', 'close')
+                os.environ.setdefault('OMP_PLACES', 'cores')
+
                 cmdstr = 'lndsr --pfile lndsr.{}.txt'.format(xml)
                 (status, output) = commands.getstatusoutput(cmdstr)
                 logger.info(output)
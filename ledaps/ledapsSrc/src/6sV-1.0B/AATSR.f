@@ -9,6 +9,7 @@ c
 c
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(8,1501),wli(8),wls(8)
       integer iwa,l,i
 c band 1 of AATSR  (0.525000 => 0.592500um)
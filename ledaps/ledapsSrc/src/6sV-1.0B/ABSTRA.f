@@ -30,7 +30,9 @@ c     total    absorption methane     ttmeth
 c     total    absorption carbon mono ttmoca
  
       common /sixs_atm/ z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       common /sixs_planesim/ zpl(34),ppl(34),tpl(34),whpl(34),wopl(34)
+c$omp threadprivate(/sixs_planesim/)
       real z,p,t,wh,wo
       real zpl,ppl,tpl,whpl,wopl
       integer iv,ivli(6),idatm,idatmp,i,id,idgaz,inu,k,n,nh
@@ -11,6 +11,7 @@
       integer j,i,nt,num_z
       common /aeroprof/ num_z,alt_z(0:nt_p_max),
      &taer_z(0:nt_p_max),taer55_z(0:nt_p_max)     
+c$omp threadprivate(/aeroprof/)
       
 
 
@@ -4,12 +4,15 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real ph,qh,uh
       common /sixs_aerbas/ ph(20,nqmax_p),qh(20,nqmax_p),uh(20,nqmax_p)
+c$omp threadprivate(/sixs_aerbas/)
       real cgaus_S(nqmax_p),pdgs_S(nqmax_p)
       real phasel,qhasel,uhasel
       common /sixs_phase/ phasel(20,nqmax_p),qhasel(20,nqmax_p),
      &uhasel(20,nqmax_p)
+c$omp threadprivate(/sixs_phase/)
       integer nbmu, nbmu_2
       real cosang(nqmax_p),weight(nqmax_p)
 c - to vary the number of quadratures
@@ -24,12 +27,17 @@ c - to vary the number of quadratures
       integer open_status
       character cwd*500
       character FILE*80
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 
       common /sixs_aer/ ext(20),ome(20),gasym(20),phase(20),qhase(20),
      &uhase(20)
+c$omp threadprivate(/sixs_aer/)
      
       real ex,sc,asy,vi
       common /sixs_coef/ ex(4,20),sc(4,20),asy(4,20),vi(4)
+c$omp threadprivate(/sixs_coef/)
 
       real wldisc(20)
 
@@ -48,7 +56,8 @@ c      if(iaer.eq.0) return
           write(*,*) 'AEROSO.f: Could not open ', FILE, ' for reading.'
           call getcwd(cwd)
           write(*,*) 'AEROSO.f: Current working directory: ', trim(cwd)
-          stop 'AEROSO.f: 6S processing error'
+          fail=.TRUE.
+          return
         endif
 
 	read (10,*) nbmu
@@ -150,6 +159,7 @@ c     (stratospherique aerosol model...)
 c     (user defined model from size distribution)
          if (iaer.ge.8.and.iaer.le.11) then
 	   call mie(iaer,wldis,ex,sc,asy,ipol)
+           if (fail) return
          endif
 
          do l=1,20
@@ -269,7 +279,8 @@ c     mixing parameters calculation
           write(*,*) 'AEROSO.f: Could not open ', FILE, ' for reading.'
           call getcwd(cwd)
           write(*,*) 'AEROSO.f: Current working directory: ', trim(cwd)
-          stop 'AEROSO.f: 6S processing error'
+          fail=.TRUE.
+          return
         endif
 	write(10,*) nbmu
         write(10,'(3x,A5,1x,5(1x,A10,1x),1x,A10)')'Wlgth','Nor_Ext_Co',
@@ -7,10 +7,13 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       double precision nnl, kk
       common /leafin/ nnl, vai, kk
+c$omp threadprivate(/leafin/)
       common /leafout/ refl, tran
+c$omp threadprivate(/leafout/)
 c
       double precision ke, kab, kw
       dimension refr(200), ke(200), kab(200), kw(200)
@@ -21,13 +24,18 @@ c
      & rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /cfresn/ rn, rk
+c$omp threadprivate(/cfresn/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
       common /msrmdata/ th10, rncoef, cab, cw, bq
+c$omp threadprivate(/msrmdata/)
 c
       data pi12/1.570796326794895d0/, pi/3.141592653589793d0/
       data eps4/.1d-3/
@@ -73,16 +81,21 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       double precision nnl, kk
       common /leafin/ nnl, vai, kk
+c$omp threadprivate(/leafin/)
       common /leafout/ refl, tran
+c$omp threadprivate(/leafout/)
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
 c
       data pi/3.141592653589793d0/, pi1/1.5707963268d0/, eps/.005d0/
 c
@@ -194,17 +207,21 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       dimension phis1(200), phis2(200), phis3(200), phis4(200)
       common /soildata/ phis1, phis2, phis3, phis4, rsl1, rsl2,
      & rsl3, rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
 c
       data pi/3.14159265358979d0/, eps/.1d-4/, eps3/.01d0/
 c
@@ -361,11 +378,14 @@ c
      & rsl3, rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
 c
       integr(x) = (1.d0 - exp(-x))/x
 *           print *, 'difr92'
@@ -430,7 +450,9 @@ c
       save bb, es, tms
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
 c
       data bb/1.d0/, es/0.d0/, tms/0.d0/, eps/.1d0/
 c
@@ -471,11 +493,14 @@ c
       save /aaa/, /ggg/
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /cfresn/ rn, rk
+c$omp threadprivate(/cfresn/)
 c
       data pi12/1.570796326794895d0/
 c
@@ -512,10 +537,12 @@ c
      & rsl3, rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
 c
       data a/.45098d0/, b/5.7829d0/, c, cts/2*13.7575d0/
       data ths1, ths2/2*.785398163d0/
@@ -551,6 +578,7 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       dimension phis1(200), phis2(200), phis3(200), phis4(200)
       common /soildata/phis1, phis2, phis3, phis4, rsl1, rsl2,
@@ -577,11 +605,14 @@ c
       save /aaa/, /ggg/, /ladak/
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/ gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
 c
       data pi/3.14159265358979d0/, pi4/6.28318531717958d0/,
      & pi12/.159154943d0/, pi14/.636619773d0/, eps5/.1d-2/
@@ -789,10 +820,15 @@ c
 c
       double precision nn, k, inex
       common /leafin/ nn, vai, k
+c$omp threadprivate(/leafin/)
       common /leafout/ refl, tran
+c$omp threadprivate(/leafout/)
       common /nagout/ inex
+c$omp threadprivate(/nagout/)
       common /tauin/ teta, ref
+c$omp threadprivate(/tauin/)
       common /tauout/ tau
+c$omp threadprivate(/tauout/)
 
 c     ******************************************************************
 c     determination of elementary reflectances et transmittances
@@ -870,7 +906,9 @@ c
 c
       double precision nn, k, inex
       common /leafin/ nn, vai, k
+c$omp threadprivate(/leafin/)
       common /nagout/ inex
+c$omp threadprivate(/nagout/)
 *                     print *, 's13aafin'
 
       if (k .gt. 4.d0) goto 10
@@ -930,7 +968,9 @@ c
       double precision k
 c
       common /tauin/ teta, ref
+c$omp threadprivate(/tauin/)
       common /tauout/ tau
+c$omp threadprivate(/tauout/)
 c
       data dr/1.745329251994330d-2/, eps/.1d-6/,
      &     pi12/1.570796326794895d0/
@@ -1180,6 +1220,9 @@ c
 c Gaussi kvadratuuri sqlmed ja kordajad, nq = 2*n, u=(-1., 1.)
       implicit double precision (a-h, o-z)
       dimension u(48), a(48)
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 c
 *              print *,'dakg'
       n = nq/2
@@ -1188,7 +1231,8 @@ c
      & 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 48), nq
 1     continue
       print *,  ' ***   dakg - inacceptable nq'
-      stop 'dakg'
+      fail=.TRUE.
+      return
 c
 2     continue
       u(2) = .577350269189626d0
@@ -1394,10 +1438,13 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       double precision nnl, kk
       common /leafin/ nnl, vai, kk
+c$omp threadprivate(/leafin/)
       common /leafout/ refl, tran
+c$omp threadprivate(/leafout/)
 c
       double precision ke, kab, kw
       dimension refr(200), ke(200), kab(200), kw(200)
@@ -1408,13 +1455,22 @@ c
      & rsl3, rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /cfresn/ rn, rk
+c$omp threadprivate(/cfresn/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
       common /msrmdata/ th10, rncoef, cab, cw, bq
+c$omp threadprivate(/msrmdata/)
+c
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 c
 c
       data pi/3.141592653589793d0/, pir/3.14159265/
@@ -1443,7 +1499,8 @@ c
 c
         if ((rlambda .gt. 2500.d0) .or. (rlambda .lt. 404.d0)) then
            print *, 'AKBRDF: wavelength out of range'
-           stop
+           fail=.TRUE.
+           return
         endif
 c
         if (rlambda .le. 800.d0) then
@@ -1546,17 +1603,25 @@ c
 c
       dimension u1(10), u2(10), a1(10), a2(10)
       common /count/ jl, jj, lg, jg, lf, nnx, n1, n2, u1, u2, a1, a2
+c$omp threadprivate(/count/)
 c
       dimension phis1(200), phis2(200), phis3(200), phis4(200)
       common /soildata/ phis1, phis2, phis3, phis4, rsl1, rsl2,
      & rsl3, rsl4, th2, rsl, rsoil, rr1soil, rrsoil
 c
       common /aaa/ rrl, ttl, ul, sl, clmp, clmp1, bi, bd, bqint
+c$omp threadprivate(/aaa/)
       common /ggg/gr, gt, g, g1, th, sth, cth, th1, sth1, cth1,
      & phi, sp, cp, th22, st, ct, st1, ct1, t10, t11, e1, e2,
      & s2, s3, ctg, ctg1, ctt1, stt1, calph, alp2, salp2, calp2,
      & alph, salph, alpp, difmy, difsig
+c$omp threadprivate(/ggg/)
       common /ladak/ ee, thm, sthm, cthm
+c$omp threadprivate(/ladak/)
+c
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 c
       data pi/3.141592653589793d0/, pi1/1.5707963268d0/
 c
@@ -1568,6 +1633,7 @@ c
       n  = n2 + n2
       ng = n + 1
       call dakg(uu, aa, n)
+      if (fail) return
 c
       do 20 i = 1, n2
          i1    = ng - i
@@ -1577,6 +1643,7 @@ c
       n  = n1 + n1
       ng = n + 1
       call dakg(uu, aa, n)
+      if (fail) return
 c
       do 21 i = 1, n1
          i1    = ng - i
@@ -23,6 +23,7 @@
        integer iaer,nt,ipol,iaer_prof
  
       common /sixs_del/ delta,sigma
+c$omp threadprivate(/sixs_del/)
 
 c
 c     atmospheric reflectances
@@ -1,5 +1,6 @@
       subroutine avhrr(iwa)
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(16,1501),wli(16),wls(16)
       real wlinf,wlsup,s
       integer iwa,l,i
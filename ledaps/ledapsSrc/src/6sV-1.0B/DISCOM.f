@@ -6,13 +6,16 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real phasel,qhasel,uhasel
       common /sixs_phase/ phasel(20,nqmax_p),qhasel(20,nqmax_p),
      &uhasel(20,nqmax_p)
+c$omp threadprivate(/sixs_phase/)
       real pha,qha,uha,alphal,betal,gammal,zetal
       common /sixs_polar/ pha(nqmax_p),qha(nqmax_p),uha(nqmax_p),
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
+c$omp threadprivate(/sixs_polar/)
       real nbmu 
 c - to vary the number of quadratures
 
@@ -42,15 +45,19 @@ c - to vary the number of quadratures
 
       common /sixs_aer/ext(20),ome(20),gasym(20),phase(20),qhase(20),
      &uhase(20)
+c$omp threadprivate(/sixs_aer/)
       common /sixs_disc/ roatm(3,20),dtdir(3,20),dtdif(3,20),
      a utdir(3,20),utdif(3,20),sphal(3,20),wldis(20),trayl(20),
      a traypl(20),rqatm(3,20),ruatm(3,20)
+c$omp threadprivate(/sixs_disc/)
       common /sixs_ffu/s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
 
 
       real alt_z,taer_z,taer55_z
       common /aeroprof/ num_z,alt_z(0:nt_p_max),taer_z(0:nt_p_max),
      &taer55_z(0:nt_p_max)
+c$omp threadprivate(/aeroprof/)
       integer iaer_prof
 
 
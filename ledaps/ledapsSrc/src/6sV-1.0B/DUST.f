@@ -4,12 +4,15 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real ph,qh,uh
       common /sixs_aerbas/ ph(20,nqmax_p),qh(20,nqmax_p),uh(20,nqmax_p)
+c$omp threadprivate(/sixs_aerbas/)
       real phr(20,nqdef_p),qhr(20,nqdef_p),uhr(20,nqdef_p)
 c - to vary the number of quadratures
       real ex,sc,asy,vi
       common /sixs_coef/ ex(4,20),sc(4,20),asy(4,20),vi(4)
+c$omp threadprivate(/sixs_coef/)
       real ex_m(20),sc_m(20),asy_m(20),vi_m
       integer i,j
 
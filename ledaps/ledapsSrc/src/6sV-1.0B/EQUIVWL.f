@@ -1,6 +1,7 @@
       subroutine equivwl(iinf,isup,step,wlmoy)
 
       common /sixs_ffu/s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real step,wlmoy,s,wlinf,wlsup,seb,wlwave,sbor,wl,swl,coef
       integer iinf,isup,l
 
@@ -8,6 +8,7 @@ c changed by J. Nieke to channel 30
 c
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(30,1501),wli(30),wls(30)
       integer iwa,l,i
 c band 1 of GLI (380nm at 1km)
@@ -1,5 +1,6 @@
       subroutine   goes(iwa)
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(2,1501),wli(2),wls(2)
       real s,wlinf,wlsup
       integer iwa,l,i
@@ -1,5 +1,6 @@
       subroutine  hrv(iwa)
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(8,1501),wli(8),wls(8)
       real s,wlinf,wlsup
       integer iwa,l,i
@@ -16,17 +16,25 @@ c
       real         pxlt,prl,ptl,prs,pc
       logical ier
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 C begin of Iaquinta and Pinty model parameter and declaration
         parameter (Pi=3.141592653589793)
         common /gauss_m/xgm (20),wgm (20),n
+c$omp threadprivate(/gauss_m/)
         real xgm,wgm
         integer n
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c
         integer ild
         common /ld/a_ld,b_ld,c_ld,d_ld
+c$omp threadprivate(/ld/)
         real a_ld,b_ld,c_ld,d_ld
         common /Ro/Ro_1_c,Ro_1_s,Ro_mult
+c$omp threadprivate(/ro/)
         real Ro_1_c,Ro_1_s,Ro_mult
         real Theta_i,Phi_i
         real Theta_v,Phi_v
@@ -65,11 +73,13 @@ C Check parameter validity
      +          (ild.ne.4).and.
      +          (ild.ne.5)) then
               print*,'Leaf angle distribution !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (xlt.le.0.) then
               print*,'Leaf area index < 0. !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (xlt.lt.1.) then
               print*,'Leaf area index < 1. !'
@@ -79,39 +89,48 @@ C Check parameter validity
             endif
             if (Rl.lt.0.) then
               print*,'Leaf reflectance < 0. !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Rl.gt..99) then
               print*,'Leaf reflectance > .99 !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Tl.lt.0.) then
               print*,'Leaf transmittance < 0. !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Tl.gt..99) then
               print*,'Leaf transmittance > .99 !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Rl+Tl.gt..99) then
               print*,'Single scattering albedo > .99 !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Rs.lt.0.) then
               print*,'Soil albedo < 0. !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (Rs.gt..99) then
               print*,'Soil albedo > .99 !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (c.lt.0.) then
               print*,'Hot-spot parameter < 0. !'
-              stop
+              fail=.TRUE.
+              return
             endif
             if (c.gt.2.) then
               print*,'Hot-spot parameter > 2. !'
-              stop
+              fail=.TRUE.
+              return
             endif
 C compute leaf area angle distribution
       call lad
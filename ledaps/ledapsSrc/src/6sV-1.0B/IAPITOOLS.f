@@ -1,12 +1,15 @@
         real function Ro_1 (Theta_i,Phi_i,Theta_e,Phi_e)
         common /gauss_m/xgm (20),wgm (20),n
+c$omp threadprivate(/gauss_m/)
         real xgm,wgm
         integer n
         real G_f,Geo,h,gamma_f
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c
         integer ild
         common /Ro/Ro_1_c,Ro_1_s,Ro_mult
+c$omp threadprivate(/ro/)
         real Ro_1_c,Ro_1_s,Ro_mult
         real Theta_i,Phi_i,Theta_e,Phi_e,xmui,xmu,xtmu
         real Gi,Ge,Ki,Ke,xLi
@@ -52,9 +55,11 @@ c
         real function Gamma_f (Theta_p,Phi_p,Theta,Phi)
         parameter (Pi=3.141592653589793)
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c,gl
         integer ild
         common /gauss_m/xgm (20),wgm (20),n
+c$omp threadprivate(/gauss_m/)
         real xgm,wgm
         integer n
         real Theta_p,Phi_p,Theta,Phi
@@ -117,9 +122,11 @@ c
         real function G_f (Theta)
         parameter (Pi=3.141592653589793)
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c,psi,gl
         integer ild
         common /gauss_m/xgm (20),wgm (20),n
+c$omp threadprivate(/gauss_m/)
         real xgm,wgm
         integer n
         real Theta
@@ -139,6 +146,7 @@ c
         real function Psi (Theta,xt)
         parameter (Pi=3.141592653589793)
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c
         integer ild
         real Theta,xt
@@ -175,6 +183,7 @@ c
         real function gl (Theta)
         parameter (Pi=3.141592653589793)
         common /ld/a_ld,b_ld,c_ld,d_ld
+c$omp threadprivate(/ld/)
         real a_ld,b_ld,c_ld,d_ld
         real Theta 
 c
@@ -221,16 +230,20 @@ c
         parameter (Pi=3.141592653589793)
         parameter (m=20)
         common /gauss_m/xgm (20),wgm (20),n
+c$omp threadprivate(/gauss_m/)
         real xgm,wgm,g_f
         integer n
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c
         integer ild
         common /Ro/Ro_1_c,Ro_1_s,Ro_mult
+c$omp threadprivate(/ro/)
         real Ro_1_c,Ro_1_s,Ro_mult
         real Theta_i,xmui,Gi
         double precision xdb
         common /l/dL,xL
+c$omp threadprivate(/l/)
         real dL,xL
         real xI0t,xI1t,xImt
         real xI (m+1,20)
@@ -435,9 +448,11 @@ c
         subroutine lad
         parameter (Pi=3.141592653589793)
         common /p/xLt,Rl,Tl,Rs,c,ild
+c$omp threadprivate(/p/)
         real xLt,Rl,Tl,Rs,c
         integer ild
         common /ld/a_ld,b_ld,c_ld,d_ld
+c$omp threadprivate(/ld/)
         real a_ld,b_ld,c_ld,d_ld
 c
         if (ild.eq.1) then
@@ -28,10 +28,13 @@
 
       common /sixs_aer/ext(20),ome(20),gasym(20),phase(20),qhase(20),
      &uhase(20)
+c$omp threadprivate(/sixs_aer/)
       common /sixs_disc/ roatm(3,20),dtdir(3,20),dtdif(3,20),
      a utdir(3,20),utdif(3,20),sphal(3,20),wldis(20),trayl(20),
      a traypl(20),rqatm(3,20),ruatm(3,20)
+c$omp threadprivate(/sixs_disc/)
       common /sixs_del/ delta,sigma
+c$omp threadprivate(/sixs_del/)
 
  
       mu=mu_p
@@ -30,8 +30,11 @@ c array for sos computation
       integer igmax,iaer_prof
 
       common/sixs_del/delta,sigma
+c$omp threadprivate(/sixs_del/)
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
       common /multorder/ igmax
+c$omp threadprivate(/multorder/)
      
  
       snt=nt
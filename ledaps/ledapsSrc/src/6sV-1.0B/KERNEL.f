@@ -9,10 +9,12 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real pha,qha,uha,alphal,betal,gammal,zetal
       common /sixs_polar/ pha(nqmax_p),qha(nqmax_p),uha(nqmax_p),
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
+c$omp threadprivate(/sixs_polar/)
       double precision psl(-1:nqmax_p,-mu:mu)
 c - to vary the number of quadratures
 
@@ -88,17 +90,21 @@ c
         xpl(j)=psl(2,j)
  1005 continue
       ij=ip1
-      do 32 j=0,mu
-        do 32 k=-mu,mu
+c$omp parallel do default(shared) private(j,k,l,bt,sbp)
+c$omp& copyin(/sixs_polar/)
+      do j=0,mu
+        do k=-mu,mu
           sbp=0.
-          if(is.gt.ij) goto 1
-          do 33 l=is,ij
+          if(is.le.ij) then
+          do l=is,ij
             bt=betal(l)
             sbp=sbp+dble(psl(l,j))*psl(l,k)*bt
-  33      continue
- 1        continue
+          enddo
+          endif
           if (abs(sbp).lt.1.E-30) sbp=0.
           bp(j,k)=sbp
-   32 continue
+        enddo
+      enddo
+c$omp end parallel do
       return
       end
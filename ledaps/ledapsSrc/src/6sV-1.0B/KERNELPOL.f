@@ -4,10 +4,12 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real pha,qha,uha,alphal,betal,gammal,zetal
       common /sixs_polar/ pha(nqmax_p),qha(nqmax_p),uha(nqmax_p),
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
+c$omp threadprivate(/sixs_polar/)
       double precision psl(-1:nqmax_p,-mu:mu),rsl(-1:nqmax_p,-mu:mu)
       double precision tsl(-1:nqmax_p,-mu:mu)
 c - to vary the number of quadratures
@@ -147,17 +149,19 @@ c      write(6,*) "xpl,xrl,xtl ",xpl(j),xrl(j),xtl(j),j
 c      stop
       
       ij=ip1
-      do 32 j=0,mu
-        do 32 k=-mu,mu
+c$omp parallel do default(shared) private(j,k,l,sbp,sgr,sgt,satt,
+c$omp& sarr,sart,r1,r2,r3) copyin(/sixs_polar/)
+      do j=0,mu
+        do k=-mu,mu
           sbp=0.
 	  sgr=0.
 	  sgt=0.
 	  satt=0.
 	  sarr=0.
 	  sart=0.
-          if(is.gt.ij) goto 1
+          if(is.le.ij) then
 c	  write(6,*) "is,ij ",is,ij
-          do 33 l=is,ij
+          do l=is,ij
 	    r1=tsl(l,j)*tsl(l,k)
 	    r2=rsl(l,j)*rsl(l,k)
 	    r3=psl(l,j)*gammal(l)
@@ -173,8 +177,8 @@ c 	      endif
      &          +r2*alphal(l)
             sart=sart+tsl(l,j)*rsl(l,k)*alphal(l)
      &          +rsl(l,j)*tsl(l,k)*zetal(l)
-  33      continue
- 1        continue
+          enddo
+          endif
  	  if (abs(sbp).lt.1.e-30) sbp =0.0
           bp(j,k)=sbp
  	  if (abs(sgr).lt.1.e-30) sgr =0.0
@@ -187,7 +191,9 @@ c 	      endif
           art(j,k)=sart
  	  if (abs(sarr).lt.1.e-30) sarr =0.0
           arr(j,k)=sarr
-   32 continue
+        enddo
+      enddo
+c$omp end parallel do
    35 continue
 c      stop
       return
@@ -1,6 +1,7 @@
       subroutine mas(iwa)
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(10,1501),wli(10),wls(10)
       integer iwa,l,i
 C first spectral band of Modis airborne simulator
@@ -9,6 +9,7 @@ c
 c
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(15,1501),wli(15),wls(15)
       integer iwa,l,i
 c band 1 of MERIS (cw=412nm bw=9.98nm)
@@ -1,5 +1,6 @@
       subroutine   meteo
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(1501)
       real s,wlinf,wlsup
       integer l,i
@@ -1,5 +1,6 @@
       subroutine   midsum
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       real z2(34),p2(34),t2(34),wh2(34),wo2(34)
       real z,p,t,wh,wo
       integer i
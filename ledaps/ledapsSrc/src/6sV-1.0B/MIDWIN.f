@@ -1,5 +1,6 @@
       subroutine   midwin
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       real z3(34),p3(34),t3(34),wh3(34),wo3(34)
       real z,p,t,wh,wo
       integer i
@@ -4,8 +4,10 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real ph,qh,uh
       common /sixs_aerbas/ ph(20,nqmax_p),qh(20,nqmax_p),uh(20,nqmax_p)
+c$omp threadprivate(/sixs_aerbas/)
       real cgaus_S(nqmax_p), pdgs_S(nqmax_p)
       integer nbmu, nbmu_2
       real cosang(nqmax_p),weight(nqmax_p)
@@ -25,6 +27,10 @@ c - to vary the number of quadratures
       
       common /mie_in/ rmax,rmin,icp,rn(20,4),ri(20,4),x1(4),x2(4),
      s x3(4),cij(4),irsunph,rsunph(50),nrsunph(50)
+c$omp threadprivate(/mie_in/)
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 
       real sigm, vi(4)
 
@@ -139,6 +145,7 @@ c relatif number of particle for each type of particle (has to be equal to 1)
 	 alpha=2.D+00*pi*r/wldis(l)
          call EXSCPHASE(alpha,rn(l,i),ri(l,i),Qext,Qsca,
      &     p11,q11,u11,ipol,cgaus_S,pdgs_S)
+         if (fail) return
          ext(l,i)=ext(l,i)+xndpr2*Qext
          sca(l,i)=sca(l,i)+xndpr2*Qsca
 
@@ -245,9 +252,13 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       double precision p11(nqmax_p),q11(nqmax_p),u11(nqmax_p)
       real cgaus_S(nqmax_p), pdgs_S(nqmax_p)
 c - to vary the number of quadratures      
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
 
       nbmu=nquad      
 
@@ -294,13 +305,15 @@ cjcc
 
       if (mu.ge.nser) then
          write(6,*) " Error, nser is too small, mu is equal to : ",mu
-         Stop
+         fail=.TRUE.
+         return
          endif
 
 
       if (mu.le.0) then
          write(6,*) " Error, mu is too small, mu is equal to : ",mu
-         Stop
+         fail=.TRUE.
+         return
          endif
 
 c --- Identification of the transition line. Below this line the Bessel 
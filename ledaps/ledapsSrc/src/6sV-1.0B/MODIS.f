@@ -1,6 +1,7 @@
       subroutine modis(iwa)
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(8,1501),wli(8),wls(8)
       integer iwa,l,i
 c band 1 of MODIS (vegetation monitoring at 250m)
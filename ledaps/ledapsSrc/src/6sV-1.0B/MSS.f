@@ -1,5 +1,6 @@
       subroutine   mss(iwa)
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(4,1501),wli(4),wls(4)
       real s,wlinf,wlsup
       integer iwa,l,i
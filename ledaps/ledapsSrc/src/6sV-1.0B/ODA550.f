@@ -3,7 +3,9 @@
  
       double precision bnz,bnz1
       common /sixs_atm/ z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       common /sixs_del/ delta,sigma
+c$omp threadprivate(/sixs_del/)
       real an5(34),an23(34)
       Real v,taer55,z,p,t,wh
       Real wo,delta,sigma,dz,bn5,bn51,bn23,bn231,az
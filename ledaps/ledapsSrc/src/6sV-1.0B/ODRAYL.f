@@ -6,7 +6,9 @@
 c     molecular optical depth
  
       common /sixs_atm/ z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       common /sixs_del/ delta,sigma
+c$omp threadprivate(/sixs_del/)
       real ns
       data pi /3.1415926/
       ak=1/wl
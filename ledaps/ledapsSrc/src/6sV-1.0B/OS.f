@@ -6,10 +6,12 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real pha,qha,uha,alphal,betal,gammal,zetal
       common /sixs_polar/ pha(nqmax_p),qha(nqmax_p),uha(nqmax_p),
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
+c$omp threadprivate(/sixs_polar/)
       real nbmu
 c - to vary the number of quadratures
 
@@ -56,8 +58,11 @@ CCCC End Variable for Look up table generation
 
      
       common/sixs_del/delta,sigma
+c$omp threadprivate(/sixs_del/)
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
       common /multorder/ igmax
+c$omp threadprivate(/multorder/)
 
       nbmu=nquad
 c the optical thickness above plane are recomputed to give o.t above pla
@@ -422,15 +427,18 @@ c     if is < ou = 2 kernels are a mixing of aerosols and molecules kern
 c     if is >2 aerosols kernels only
 c
       if(is-2)210,210,211
-  210 do455 k=1,mu
+  210 continue
+c$omp parallel do default(shared) private(k,i,j,xpk,ypk,ii1,ii2,x,y,z,
+c$omp& xpj,xi1,xi2,bpjk,bpjmk,xdb)
+      do k=1,mu
       xpk=xpl(k)
       ypk=xpl(-k)
-      do 455 i=0,nt
+      do i=0,nt
       ii1=0.
       ii2=0.
       x=xdel(i)
       y=ydel(i)
-      do477 j=1,mu
+      do j=1,mu
       xpj=xpl(j)
       z=gb(j)
       xi1=i1(i,j)
@@ -441,19 +449,24 @@ c
       ii2=ii2+xdb
       xdb=z*(xi1*bpjmk+xi2*bpjk)
       ii1=ii1+xdb
- 477  continue
+      enddo
       if (abs(ii2).lt.1.E-30) ii2=0.
       if (abs(ii1).lt.1.E-30) ii1=0.
       i2(i,k)=ii2
       i2(i,-k)=ii1
- 455  continue
+      enddo
+      enddo
+c$omp end parallel do
       goto 213
- 211  do45 k=1,mu
-      do 45 i=0,nt
+ 211  continue
+c$omp parallel do default(shared) private(k,i,j,ii1,ii2,x,z,xi1,xi2,
+c$omp& bpjk,bpjmk,xdb)
+      do k=1,mu
+      do i=0,nt
       ii1=0.
       ii2=0.
       x=xdel(i)
-      do47 j=1,mu
+      do j=1,mu
       z=gb(j)
       xi1=i1(i,j)
       xi2=i1(i,-j)
@@ -463,12 +476,14 @@ c
       ii2=ii2+xdb
       xdb=z*(xi1*bpjmk+xi2*bpjk)
       ii1=ii1+xdb
-   47 continue
+      enddo
       if (abs(ii2).lt.1.E-30) ii2=0.
       if (abs(ii1).lt.1.E-30) ii1=0.
       i2(i,k)=ii2
       i2(i,-k)=ii1
-   45 continue
+      enddo
+      enddo
+c$omp end parallel do
 c
 c     vertical integration, upward radiation
 c
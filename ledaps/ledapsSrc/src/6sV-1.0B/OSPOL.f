@@ -8,10 +8,12 @@ c - to vary the number of quadratures
       include "paramdef.inc"
       integer nquad
       common /num_quad/ nquad
+c$omp threadprivate(/num_quad/)
       real pha,qha,uha,alphal,betal,gammal,zetal
       common /sixs_polar/ pha(nqmax_p),qha(nqmax_p),uha(nqmax_p),
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
+c$omp threadprivate(/sixs_polar/)
 c - to vary the number of quadratures
 
 
@@ -68,10 +70,13 @@ CCCC End Variable for Look up table generation
       integer igmax,iaer_prof
 
       common/sixs_del/delta,sigma
+c$omp threadprivate(/sixs_del/)
 
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
 
       common /multorder/ igmax
+c$omp threadprivate(/multorder/)
 
 c the optical thickness above plane are recomputed to give o.t above pla
       
@@ -454,14 +459,19 @@ c     if is < ou = 2 kernels are a mixing of aerosols and molecules kern
 c     if is >2 aerosols kernels only
 c
         if(is-2)210,210,211
-  210   do455 k=1,mu
+  210 continue
+c$omp parallel do default(shared) private(k,i,j,xpk,xrk,xtk,ypk,yrk,ytk,
+c$omp& ii1,ii2,qq1,qq2,uu1,uu2,x,y,z,xpj,xrj,xtj,ypj,yrj,ytj,xi1,xi2,
+c$omp& xq1,xq2,xu1,xu2,bpjk,bpjmk,gtjk,gtjmk,gtkj,gtkmj,grjk,grjmk,grkj,
+c$omp& grkmj,arrjk,arrjmk,artjk,artjmk,artkj,artkmj,attjk,attjmk,xdb)
+        do k=1,mu
           xpk=xpl(k)
           xrk=xrl(k)
           xtk=xtl(k)
           ypk=xpl(-k)
           yrk=xrl(-k)
           ytk=xtl(-k)
-          do 455 i=0,nt
+          do i=0,nt
             ii1=0.
             ii2=0.
             qq1=0.
@@ -470,7 +480,7 @@ c
             uu2=0.
             x=xdel(i)
             y=ydel(i)
-            do477 j=1,mu
+            do j=1,mu
               z=gb(j)
               xpj=xpl(j)
               xrj=xrl(j)
@@ -523,7 +533,7 @@ c
               xdb=xi1*gtjmk-xi2*gtjk-xq1*artkmj-xq2*artkj
               xdb=xdb-xu1*attjmk-xu2*attjk
 	      uu1=uu1-xdb*z
- 477        continue
+            enddo
             if (abs(ii2).lt.1.E-30) ii2=0.
             if (abs(ii1).lt.1.E-30) ii1=0.
             if (abs(qq2).lt.1.E-30) qq2=0.
@@ -536,12 +546,19 @@ c
             q2(i,-k)=qq1
             u2(i,k)=uu2
             u2(i,-k)=uu1
- 455    continue
+          enddo
+        enddo
+c$omp end parallel do
         goto 213
 
 
- 211    do45 k=1,mu
-          do 45 i=0,nt
+ 211  continue
+c$omp parallel do default(shared) private(k,i,j,ii1,ii2,qq1,qq2,uu1,uu2,
+c$omp& x,z,xi1,xi2,xq1,xq2,xu1,xu2,bpjk,bpjmk,gtjk,gtjmk,gtkj,gtkmj,
+c$omp& grjk,grjmk,grkj,grkmj,arrjk,arrjmk,artjk,artjmk,artkj,artkmj,
+c$omp& attjk,attjmk,xdb)
+        do k=1,mu
+          do i=0,nt
             ii1=0.
             ii2=0.
             qq1=0.
@@ -549,7 +566,7 @@ c
             uu1=0.
             uu2=0.
             x=xdel(i)
-            do47 j=1,mu
+            do j=1,mu
               z=gb(j)
               xi1=i1(i,j)
               xi2=i1(i,-j)
@@ -595,7 +612,7 @@ c
               xdb=xi1*gtjmk-xi2*gtjk-xq1*artkmj-xq2*artkj
               xdb=xdb-xu1*attjmk-xu2*attjk
 	      uu1=uu1-xdb*z
-   47       continue
+            enddo
             if (abs(ii2).lt.1.E-30) ii2=0.
             if (abs(ii1).lt.1.E-30) ii1=0.
             if (abs(qq2).lt.1.E-30) qq2=0.
@@ -608,7 +625,9 @@ c
             q2(i,-k)=qq1
             u2(i,k)=uu2
             u2(i,-k)=uu1
-   45   continue
+          enddo
+        enddo
+c$omp end parallel do
 c
 c     vertical integration, upward radiation
 c
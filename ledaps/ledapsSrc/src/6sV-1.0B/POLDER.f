@@ -1,6 +1,7 @@
       subroutine polder(iwa)
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(8,1501),wli(8),wls(8)
       integer iwa,l,i
 c band 1 of POLDER (443 mic, polarized channel)
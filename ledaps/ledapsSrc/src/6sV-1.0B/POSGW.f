@@ -8,6 +8,7 @@
       integer month,jday,nc,nl,iwr
 
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
 c     goes west definition
  
@@ -4,6 +4,7 @@
       real tu,xlon,xlat,asol,phi0,avis,phiv
       integer month,jday,iwr
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
 c     landsat5 definition
 c     warning !!!
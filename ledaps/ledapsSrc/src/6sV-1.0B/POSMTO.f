@@ -7,6 +7,7 @@
       real teta,ylat,ylon,gam
       integer month,jday,nc,nl,iwr
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
 c     meteosat definition
  
@@ -6,6 +6,7 @@
       real ylat,cosy,siny,ylon,ylo1,zlat,zlon,xnum,xden
       integer month,jday,nc,iwr
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
 c     noaa 6 definition
 c     orbite inclination ai in radians
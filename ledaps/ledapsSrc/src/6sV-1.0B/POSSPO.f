@@ -5,6 +5,7 @@
       integer month,jday,iwr
 
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
 c     spot definition
 c     warning !!!
@@ -7,7 +7,9 @@
       real ps,xpp,uo3,uw,ftray
 
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       common /sixs_planesim/zpl(34),ppl(34),tpl(34),whpl(34),wopl(34)
+c$omp threadprivate(/sixs_planesim/)
 
 c log linear interpolation
       xpp=xpp+z(1)
@@ -1,5 +1,6 @@
        subroutine pressure(uw,uo3,xps)
        common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
        real z,p,t,wh,wo,xa,xb,xalt,xtemp,xwo,xwh,g
        real air,ro3,roair,ds
        integer i,isup,iinf,l,k
@@ -1,9 +1,13 @@
       subroutine print_error(tex)
+c the error is written to the listing, and to the standard output too
+c when the listing goes elsewhere (/dev/null for sixs_run)
       character *(*) tex
       logical ier
       integer iwr
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
       ier = .TRUE.
       write(iwr,'(a)')tex
+      if (iwr.ne.6) write(6,'(a)')tex
       return
       end
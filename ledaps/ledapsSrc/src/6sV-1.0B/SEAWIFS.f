@@ -1,5 +1,6 @@
       subroutine seawifs(iwa)
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(8,1501),wli(8),wls(8)
       real wlinf,wlsup,s
       integer iwa,l,i
@@ -0,0 +1,170 @@
+      function sixsrn(deck,ndeck,sixres) bind(c,name='sixs_run')
+      use iso_c_binding
+c**********************************************************************c
+c  C-callable entry point of 6S.  deck holds the ndeck characters of   c
+c  the input cards, one card per line, as they would be given to the   c
+c  sixsV1.0B program on its standard input.  The listing is written    c
+c  to /dev/null, on a unit shared by all the threads, and the main     c
+c  results are returned in sixres(20) (see sixs in main.f for the      c
+c  layout).  Returns 0 on success, and 1 if 6S failed (deck too long,  c
+c  bad input card or parameter), in which case the error has been      c
+c  written to the standard output and sixres is not set.               c
+c                                                                      c
+c  The 6S common blocks are thread private, so sixs_run may be called  c
+c  from several OpenMP threads at once.  The Kuusk BRDF model          c
+c  (AKTOOL.f) keeps tables in shared common blocks and is not safe to  c
+c  run from several threads.                                           c
+c**********************************************************************c
+      integer(c_int) sixsrn
+      integer(c_int), value :: ndeck
+      character(kind=c_char) deck(*)
+      real(c_float) sixres(*)
+      integer ndk,idk,iunull,i,istat
+      character*16384 deckbf
+      common /sixs_deck/ ndk,idk
+      common /sixs_deckc/ deckbf
+c$omp threadprivate(/sixs_deck/,/sixs_deckc/)
+c     unit of /dev/null, shared by all the threads (it isn't looked up
+c     by file name since stdin may be /dev/null too).  Units given by
+c     newunit are negative, 0 means not opened yet.
+      save iunull
+      data iunull /0/
+
+      if (ndeck.gt.len(deckbf)) then
+        write(*,*) 'sixs_run: 6S input deck too long'
+        sixsrn=1
+        return
+      endif
+      do i=1,ndeck
+        deckbf(i:i)=deck(i)
+      enddo
+      ndk=ndeck
+      idk=1
+
+c$omp critical (sixs_null)
+      if (iunull.eq.0)
+     s  open(newunit=iunull,file='/dev/null',action='write')
+c$omp end critical (sixs_null)
+      call sixs(iunull,sixres,istat)
+      ndk=0
+      sixsrn=istat
+      return
+      end
+
+
+      logical function sixsfm()
+c**********************************************************************c
+c  true if the 6S fast mode is on, i.e. SIXS_FAST is set and is        c
+c  neither empty nor 0.  Callers outside 6S use sixs_fast_mode, so     c
+c  they all agree on the mode 6S runs in.                              c
+c**********************************************************************c
+      character cfast*8
+      integer lfast
+
+      call get_environment_variable('SIXS_FAST',cfast,lfast)
+      sixsfm=lfast.gt.0.and..not.(lfast.eq.1.and.cfast(1:1).eq.'0')
+      return
+      end
+
+
+      function sixsfc() bind(c,name='sixs_fast_mode')
+      use iso_c_binding
+c**********************************************************************c
+c  C-callable sixsfm: returns 1 if the 6S fast mode is on, else 0.     c
+c**********************************************************************c
+      integer(c_int) sixsfc
+      logical sixsfm
+
+      sixsfc=0
+      if (sixsfm()) sixsfc=1
+      return
+      end
+
+
+      subroutine sixsrd(iread,cardln,ios)
+c**********************************************************************c
+c  reads the next input card, from the deck passed to sixs_run or else c
+c  from unit iread.  ios is negative at the end of the input.          c
+c**********************************************************************c
+      integer iread,ios
+      character*(*) cardln
+      integer ndk,idk,iend
+      character*16384 deckbf
+      common /sixs_deck/ ndk,idk
+      common /sixs_deckc/ deckbf
+c$omp threadprivate(/sixs_deck/,/sixs_deckc/)
+
+      if (ndk.le.0) then
+        read(iread,'(a)',iostat=ios) cardln
+        if (ios.ne.0) cardln=' '
+        return
+      endif
+
+      if (idk.gt.ndk) then
+        cardln=' '
+        ios=-1
+        return
+      endif
+      iend=index(deckbf(idk:ndk),char(10))
+      if (iend.eq.0) then
+        iend=ndk+1
+      else
+        iend=idk+iend-1
+      endif
+      cardln=deckbf(idk:iend-1)
+      idk=iend+1
+      ios=0
+      return
+      end
+
+
+      subroutine sixsrv(iread,vals,n)
+c**********************************************************************c
+c  reads n values from as many input cards as needed, for the spectral c
+c  inputs which are given over several lines.  Values are separated by c
+c  blanks or commas, and the rest of the last card is ignored.  On     c
+c  error, the message is written with print_error and fail is set.     c
+c**********************************************************************c
+      integer iread,n
+      real vals(n)
+      character cardln*2048
+      integer nv,ios,i,j,lc
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
+
+      nv=0
+      do while (nv.lt.n)
+        call sixsrd(iread,cardln,ios)
+        if (ios.ne.0) then
+          call print_error('sixsrv: not enough values in the 6S input')
+          fail=.TRUE.
+          return
+        endif
+        lc=len_trim(cardln)
+        i=1
+        do while (i.le.lc.and.nv.lt.n)
+          if (cardln(i:i).eq.' '.or.cardln(i:i).eq.','.or.
+     s        cardln(i:i).eq.char(9)) then
+            i=i+1
+          else
+            j=i
+            do while (j.lt.lc.and.cardln(j+1:j+1).ne.' '.and.
+     s                cardln(j+1:j+1).ne.','.and.
+     s                cardln(j+1:j+1).ne.char(9))
+              j=j+1
+            enddo
+            nv=nv+1
+            read(cardln(i:j),*,iostat=ios) vals(nv)
+            if (ios.ne.0) then
+              call print_error('sixsrv: bad value in the 6S input: '//
+     s          cardln(i:j))
+              fail=.TRUE.
+              return
+            endif
+            i=j+1
+          endif
+        enddo
+      enddo
+      return
+      end
@@ -10,6 +10,7 @@ c
       real wl,swl,si,pas
       integer iwr,i,iwl
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
  
       data (si(i),i=1,112) /
      a  69.30,  77.65,  86.00, 100.06, 114.12, 137.06, 160.00,
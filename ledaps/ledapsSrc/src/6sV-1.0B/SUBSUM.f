@@ -3,6 +3,7 @@
       real z4(34),p4(34),t4(34),wh4(34),wo4(34)
       real z,p,t,wh,wo
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
 c
 c     model: subarctique summer mc clatchey
 c
@@ -3,6 +3,7 @@
       real z5(34),p5(34),t5(34),wh5(34),wo5(34)
       real z,p,t,wh,wo
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       integer i
 c
 c     model: subarctique winter mc clatchey
@@ -1,6 +1,7 @@
       subroutine   tm(iwa)
       real s,wlinf,wlsup
       common /sixs_ffu/ s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       real sr(6,1501),wli(6),wls(6)
       integer iwa,l,i
  
@@ -3,6 +3,7 @@
       real z1(34),p1(34),t1(34),wh1(34),wo1(34)
       real z,p,t,wh,wo
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
 c
 c     model: tropical mc clatchey
 c
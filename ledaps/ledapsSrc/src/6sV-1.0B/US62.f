@@ -4,6 +4,7 @@
       real z6(34),p6(34),t6(34),wh6(34),wo6(34)
       real z,p,t,wh,wo
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
 c
 c     model: us standard 62 mc clatchey
 c
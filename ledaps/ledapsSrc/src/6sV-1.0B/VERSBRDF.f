@@ -25,6 +25,7 @@ c     errmsg       error messages.
       logical ier
       integer iwr,k,j
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
       data fmt (1) /'(i10)'/
       data fmt (2) /'(e10.3)'/
       data fmt (3) /'(1x, a10, 6 (i8, 2x))'/
@@ -1,5 +1,14 @@
-      program ssssss
+      subroutine sixs(iwrin,sixres,istat)
  
+c**********************************************************************c
+c  6S as a subroutine.  The input cards are read with sixsrd, from the c
+c  standard input or from the deck passed to sixs_run (SIXSRUN.f), the c
+c  listing is written to unit iwrin, and the main results are returned c
+c  in sixres (see the end of the computations for the layout).  istat  c
+c  is 0 on success and 1 if the processing failed (bad input card or   c
+c  parameter), in which case sixres is not set.  The stand-alone       c
+c  sixsV1.0B program is in sixsmain.f.                                 c
+c**********************************************************************c
 c**********************************************************************c
 c                                                                      c
 c                                                                      c
@@ -177,6 +186,7 @@ c****************************************************************************c
      s   rm(-mu_p:mu_p),gb(-mu_p:mu_p),rp(np_p),gp(np_p)
       dimension  xlmus(-mu_p:mu_p,np_p),xlmuv(-mu_p:mu_p,np_p)
       dimension angmu(10),angphi(13),brdfints(-mu_p:mu_p,np_p)
+     s    ,angmud(10),angphd(13)
      s    ,brdfdats(10,13),sbrdftmp(-1:1,1),sbrdf(1501),
      s     srm(-1:1),srp(1),
      s    brdfintv(-mu_p:mu_p,np_p),brdfdatv(10,13),robar(1501),
@@ -195,6 +205,7 @@ c****************************************************************************c
 	real dtr 
         real anglem,weightm,rm,gb,accu2,accu3
         real rp,gp,xlmus,xlmuv,angmu,angphi,brdfints,brdfdats
+        real angmud,angphd
         real brdfintv,brdfdatv,robar,robarp,robard,xlm1,xlm2
         real c,wldisc,ani,anr,aini,ainr,rocl,roel,zpl,ppl,tpl,whpl
         real wopl,xacc,s,wlinf,wlsup,delta
@@ -248,6 +259,10 @@ c variables related to surface polarization
 	real ropq,ropu,pveg,wspd,azw,razw
       integer open_status
       character cwd*500
+c variables for the input cards and the returned results
+      integer iwrin,ios,istat
+      real sixres(20)
+      character cardln*2048
 
 
 c***********************************************************************
@@ -255,6 +270,7 @@ c                 to vary the number of quadratures
 c***********************************************************************
       integer nquad
       common /num_quad/ nquad 
+c$omp threadprivate(/num_quad/)
 
 c***********************************************************************
 c                     the aerosol profile
@@ -263,6 +279,7 @@ c***********************************************************************
       real alt_z,taer_z,taer55_z,total_height,height_z(0:nt_p_max)
       common/aeroprof/num_z,alt_z(0:nt_p_max),taer_z(0:nt_p_max),
      &taer55_z(0:nt_p_max)
+c$omp threadprivate(/aeroprof/)
       character aer_model(15)*50
       
 c***********************************************************************
@@ -275,19 +292,27 @@ c***********************************************************************
       integer icp,irsunph,i1,i2
       character etiq1(8)*60,nsat(119)*17,atmid(7)*51,reflec(8)*71
       character FILE*80,FILE2*80
-      logical ier
+      logical ier,sixsfm
       integer igmax
 
       common/sixs_ier/iwr,ier
+c$omp threadprivate(/sixs_ier/)
+      logical fail
+      common/sixs_fail/fail
+c$omp threadprivate(/sixs_fail/)
       common /mie_in/ rmax,rmin,icp,rn(20,4),ri(20,4),x1(4),x2(4),
      s x3(4),cij(4),irsunph,rsunph(50),nrsunph(50)
+c$omp threadprivate(/mie_in/)
       common /multorder/ igmax
+c$omp threadprivate(/multorder/)
 c***********************************************************************
 c     for considering pixel and sensor  altitude
 c***********************************************************************
       real pps,palt,ftray
       common /sixs_planesim/zpl(34),ppl(34),tpl(34),whpl(34),wopl(34)
+c$omp threadprivate(/sixs_planesim/)
       common /sixs_test/xacc
+c$omp threadprivate(/sixs_test/)
 c***********************************************************************
 c     for considering aerosol and brdf
 c***********************************************************************
@@ -305,13 +330,18 @@ c***********************************************************************
 c                             return to 6s
 c***********************************************************************
       common /sixs_ffu/s(1501),wlinf,wlsup
+c$omp threadprivate(/sixs_ffu/)
       common /sixs_del/ delta,sigma
+c$omp threadprivate(/sixs_del/)
       common /sixs_atm/z(34),p(34),t(34),wh(34),wo(34)
+c$omp threadprivate(/sixs_atm/)
       common /sixs_aer/ext(20),ome(20),gasym(20),phase(20),qhase(20),
      suhase(20)
+c$omp threadprivate(/sixs_aer/)
       common /sixs_disc/ roatm(3,20),dtdir(3,20),dtdif(3,20),
      s utdir(3,20),utdif(3,20),sphal(3,20),wldis(20),trayl(20),
      s traypl(20),rqatm(3,20),ruatm(3,20)
+c$omp threadprivate(/sixs_disc/)
  
  
 c****************************************************************************c
@@ -320,8 +350,8 @@ c   can be changed as soon as they are well distributed over the whole space c
 c   before the gauss integration, these values are interpolated to the gauss c
 c   angles                                                                   c
 c****************************************************************************c
-      data angmu /85.0,80.0,70.0,60.0,50.0,40.0,30.0,20.0,10.0,0.00/
-      data angphi/0.00,30.0,60.0,90.0,120.0,150.0,180.0,
+      data angmud/85.0,80.0,70.0,60.0,50.0,40.0,30.0,20.0,10.0,0.00/
+      data angphd/0.00,30.0,60.0,90.0,120.0,150.0,180.0,
      s          210.0,240.0,270.0,300.0,330.0,360.0/
  
 c***********************************************************************
@@ -427,11 +457,19 @@ c***********************************************************************
       mu2=mu2_p
       np=np_p
       nfi=nfi_p
-      iwr=6
+      iwr=iwrin
       ier=.FALSE.
+      fail=.FALSE.
+      istat=0
       iinf=1
       isup=1501
       igmax=20
+c fast mode: fewer layers and scattering orders in the successive
+c orders computations when SIXS_FAST is set (see sixsfm in SIXSRUN.f)
+      if (sixsfm()) then
+        nt=nt_fast_p
+        igmax=igmax_fast_p
+      endif
 c***********************************************************************
 c  preliminary computations for gauss integration
 c***********************************************************************
@@ -440,10 +478,10 @@ c***********************************************************************
       accu2=1.E-03
       accu3=1.E-07
       do k=1,13
-       angphi(k)=angphi(k)*pi/180.
+       angphi(k)=angphd(k)*pi/180.
       enddo
       do k=1,10
-       angmu(k)=cos(angmu(k)*pi/180.)
+       angmu(k)=cos(angmud(k)*pi/180.)
       enddo
       call gauss(-1.,1.,anglem,weightm,mu2)
       call gauss(0.,pi2,rp,gp,np)
@@ -562,7 +600,8 @@ c                 solar and viewing positions are computed             c
 c                                                                      c
 c**********************************************************************c
 
-      read(iread,*) igeom
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) igeom
  
       if (igeom.lt.0) then
           if (igeom.lt.-10) then
@@ -576,42 +615,50 @@ c**********************************************************************c
       goto(1001,1002,1003,1004,1005,1006,1007),igeom
 c   igeom=0.....
 
-      read(iread,*) asol,phi0,avis,phiv,month,jday
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) asol,phi0,avis,phiv,month,jday
 
       goto 22
 c
- 1001 read(iread,*) month,jday,tu,nc,nl
+ 1001 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,nc,nl
       call posmto(month,jday,tu,nc,nl,
      1            asol,phi0,avis,phiv,xlon,xlat)
       goto 22
- 1002 read(iread,*) month,jday,tu,nc,nl
+ 1002 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,nc,nl
       call posge(month,jday,tu,nc,nl,
      1           asol,phi0,avis,phiv,xlon,xlat)
       goto 22
- 1003 read(iread,*) month,jday,tu,nc,nl
+ 1003 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,nc,nl
       call posgw(month,jday,tu,nc,nl,
      1           asol,phi0,avis,phiv,xlon,xlat)
       goto 22
- 1004 read(iread,*) month,jday,tu,nc,xlonan,hna
+ 1004 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,nc,xlonan,hna
       campm=1.0
       call posnoa(month,jday,tu,nc,xlonan,hna,campm,
      1            asol,phi0,avis,phiv,xlon,xlat)
       goto 22
- 1005 read(iread,*) month,jday,tu,nc,xlonan,hna
+ 1005 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,nc,xlonan,hna
       campm=-1.0
       call posnoa(month,jday,tu,nc,xlonan,hna,campm,
      1            asol,phi0,avis,phiv,xlon,xlat)
       goto 22
- 1006 read(iread,*) month,jday,tu,xlon,xlat
+ 1006 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,xlon,xlat
       call posspo(month,jday,tu,xlon,xlat,
      a            asol,phi0,avis,phiv)
       goto 22
- 1007 read(iread,*) month,jday,tu,xlon,xlat
+ 1007 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) month,jday,tu,xlon,xlat
       call poslan(month,jday,tu,xlon,xlat,
      s            asol,phi0,avis,phiv)
    22 continue
 
-      if(ier) stop
+      if(ier) goto 9999
       dsol=1.
       call varsol(jday,month,dsol)
 
@@ -674,14 +721,19 @@ c**********************************************************************c
       uw=0.
       uo3=0.
 
-      read(iread,*) idatm
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) idatm
 
 
       if(idatm.eq.0) go to 5
-      if(idatm.eq.8) read(iread,*) uw,uo3
+      if(idatm.eq.8) then
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) uw,uo3
+      endif
       if(idatm.ne.7) go to 6
       do 7 k=1,34
-       read(iread,*) z(k),p(k),t(k),wh(k),wo(k)
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) z(k),p(k),t(k),wh(k),wo(k)
     7 continue
       go to 5
     6 if(idatm.eq.1)  call tropic
@@ -823,7 +875,8 @@ c**********************************************************************c
       taer55=0.
       iaer_prof=0
  
-      read(iread,*) iaer
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) iaer
       
 c  the user-defined aerosol profile
       if (iaer.lt.0) then
@@ -838,10 +891,13 @@ c  the user-defined aerosol profile
       height_z(i)=0.0
       enddo
 
-      read(5,*) num_z
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) num_z
 
       do i=0,num_z-1
-       read(5,*) height_z(num_z-i),taer55_z(num_z-i),iaer
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) height_z(num_z-i),
+     s   taer55_z(num_z-i),iaer
        alt_z(num_z-1-i)=total_height+height_z(num_z-i)
        total_height=total_height+height_z(num_z-i)
        taer55=taer55+taer55_z(num_z-i)
@@ -853,7 +909,10 @@ c  the user-defined aerosol profile
       if (iaer.ge.0.and.iaer.le.7) nquad=nqdef_p
       if (iaer.ge.8.and.iaer.le.11) nquad=nquad_p
 
-      if(iaer.eq.4) read(iread,*) (c(n),n=1,4)
+      if(iaer.eq.4) then
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (c(n),n=1,4)
+      endif
       
       goto(49,40,41,42,49,49,49,49,43,44,45,46,47),iaer+1
  
@@ -872,51 +931,73 @@ c  the user-defined aerosol profile
       c(3)=0.00
       c(4)=0.22
       go to 49
-   43 read(iread,*) rmin,rmax,icp
+   43 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) rmin,rmax,icp
       do i=1,icp
-       read(5,*)x1(i),x2(i),cij(i)
-       read(5,*)(rn(l,i),l=1,20)
-       read(5,*)(ri(l,i),l=1,20)
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) x1(i),x2(i),cij(i)
+       call sixsrv(iread,rn(1,i),20)
+       if (fail) goto 9999
+       call sixsrv(iread,ri(1,i),20)
+       if (fail) goto 9999
       enddo
         do i=1,icp
          cij_out(i)=cij(i)
         enddo
       go to 49
-   44 read(iread,*) rmin,rmax
-      read(iread,*) x1(1),x2(1),x3(1)
-      read(5,*)(rn(l,1),l=1,20)
-      read(5,*)(ri(l,1),l=1,20)
+   44 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) rmin,rmax
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) x1(1),x2(1),x3(1)
+      call sixsrv(iread,rn(1,1),20)
+      if (fail) goto 9999
+      call sixsrv(iread,ri(1,1),20)
+      if (fail) goto 9999
       go to 49
-   45 read(iread,*) rmin,rmax
-      read(iread,*) x1(1)
-      read(5,*)(rn(l,1),l=1,20)
-      read(5,*)(ri(l,1),l=1,20)
+   45 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) rmin,rmax
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) x1(1)
+      call sixsrv(iread,rn(1,1),20)
+      if (fail) goto 9999
+      call sixsrv(iread,ri(1,1),20)
+      if (fail) goto 9999
       go to 49
-   46 read(5,*)irsunph
+   46 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) irsunph
       do i=1,irsunph
-       read(5,*)rsunph(i),nrsunph(i)
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) rsunph(i),nrsunph(i)
 C       nrsunph(i)=nrsunph(i)/(rsunph(i)**4.)/(4*3.1415/3)
       enddo
       rmin=rsunph(1)
       rmax=rsunph(irsunph)+1e-07
-      read(5,*)(rn(l,1),l=1,20)
-      read(5,*)(ri(l,1),l=1,20)
+      call sixsrv(iread,rn(1,1),20)
+      if (fail) goto 9999
+      call sixsrv(iread,ri(1,1),20)
+      if (fail) goto 9999
       go to 49
-   47 read(5,'(A80)')FILE2
+   47 call sixsrd(iread,cardln,ios)
+      FILE2=cardln(1:80)
       i2=index(FILE2,' ')-1
       go to 49
 
    49 continue
 
       if (iaer.ge.8.and.iaer.le.11)then
-       read(5,*)iaerp
-       if (iaerp.eq.1)read(5,'(A80)')FILE
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) iaerp
+       if (iaerp.eq.1) then
+         call sixsrd(iread,cardln,ios)
+         FILE=cardln(1:80)
+       endif
        i1=index(FILE,' ')-1
        FILE2=FILE(1:I1)//'.mie'
        i2=index(FILE2,' ')-1
       endif
 
       call aeroso(iaer,c,xmud,wldis,FILE2,ipol)
+      if (fail) goto 9999
 
 
 c**********************************************************************c
@@ -939,9 +1020,11 @@ c**********************************************************************c
 
       if (iaer_prof.eq.0) then
 
-      read(iread,*) v
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) v
       if(v) 71,10,11
-   10 read(iread,*) taer55
+   10 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) taer55
       v=exp(-log(taer55/2.7628)/0.79902)
       goto 71
    11 call oda550(iaer,v,taer55)
@@ -961,7 +1044,8 @@ c                                                                      c
 c                                                                      c
 c**********************************************************************c
  
- 771   read(iread,*) xps
+ 771   call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) xps
 
        if (xps.ge.0.) then
         xps=0.
@@ -1000,7 +1084,8 @@ C    profile according to the values at ground level. Taerp will be    c
 c    computed according to a 2km exponential profile for aerosol.      c
 c**********************************************************************c
 
-        read(iread,*) xpp
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) xpp
 
         xpp=-xpp
         if (xpp.le.0.0) then
@@ -1021,7 +1106,8 @@ c	       satellite case of equivalent
 	      idatmp=4
 	      else
 c	      "real" plane case	      
-              read(iread,*) puw,puo3
+              call sixsrd(iread,cardln,ios)
+              read(cardln,*,err=9998,end=9998) puw,puo3
 	      if (puw.lt.0.) then
                  call presplane(puw,puo3,xpp,ftray)
 	         idatmp=2
@@ -1036,10 +1122,11 @@ c	      "real" plane case
 	         call presplane(puwus,puo3us,xpp,ftray)
 	         idatmp=8
               endif
-              if(ier) stop
+              if(ier) goto 9999
               palt=zpl(34)-z(1)
 	      pps=ppl(34)
-              read(iread,*) taer55p
+              call sixsrd(iread,cardln,ios)
+              read(cardln,*,err=9998,end=9998) taer55p
 	    if ((taer55p.lt.0.).or.((taer55-taer55p).lt.accu2)) then
 c a scale heigh of 2km is assumed in case no value is given for taer55p
                taer55p=taer55*(1.-exp(-palt/2.))
@@ -1201,21 +1288,25 @@ c**********************************************************************c
        s(l)=1.
    38 continue
 
-      read(iread,*) iwave
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) iwave
 
       if (iwave.eq.-2) goto 1600
       if (iwave) 16,17,18
 
 
-   16 read(iread,*) wl
+   16 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) wl
 
 
       wlinf=wl
       wlsup=wl
       go to 19
-   17 read(iread,*) wlinf,wlsup
+   17 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) wlinf,wlsup
       go to 19
- 1600 read(iread,*) wlinf,wlsup
+ 1600 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) wlinf,wlsup
       go to 19
 c       110
 c       111     band of meteosat        (2)
@@ -1251,13 +1342,15 @@ c       152     GLI     band            (89,118)
      s      152,152,152,152,152,152,152,152,152,152,
      s      152,152,152,152,152,152,152,152,152,152
      s     ),iwave
-  110 read(iread,*) wlinf,wlsup
+  110 call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) wlinf,wlsup
       iinf=(wlinf-.25)/0.0025+1.5
       isup=(wlsup-.25)/0.0025+1.5
       do 1113 ik=iinf,isup
        s(ik)=0.
  1113 continue
-      read(iread,*) (s(i),i=iinf,isup)
+      call sixsrv(iread,s(iinf),isup-iinf+1)
+      if (fail) goto 9999
       goto 20
   111 call meteo
       go to 19
@@ -1372,7 +1465,7 @@ CCCC Check initialization  (debug)
        cscaa=-xmus*lutmuv-cos(filut(i,j)*pi/180.)*sqrt(1.-xmus*xmus)
      S  *sqrt(1.-lutmuv*lutmuv)
        scaa=acos(cscaa)*180./pi
-      write(6,*) its,luttv,filut(i,j),scaa
+      write(iwr,*) its,luttv,filut(i,j),scaa
       enddo
       enddo
 CCCC Check initialization  (debug)     
@@ -1661,11 +1754,13 @@ c**********************************************************************c
 c     uniform or non-uniform surface conditions                        c
 c**********************************************************************c
 
-      read(iread,*) inhomo
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) inhomo
 
       if(inhomo) 30,30,31
 
-  30  read(iread,*) idirec
+  30  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) idirec
 
       if(idirec)21,21,25
  
@@ -1690,20 +1785,25 @@ c call os to compute downward radiation field for robarp
      s                     xlmuv,xlphim,nfi,rolut)
       endif
 c
-      read(iread,*) ibrdf
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) ibrdf
 c*********************************************************************c
       if(ibrdf)23,23,24
 c**********************************************************************c
 c     brdf from in-situ measurements                                   c
 c**********************************************************************c
   23  do 900 k=1,13
-        read(iread,*) (brdfdats(10-j+1,k),j=1,10)
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (brdfdats(10-j+1,k),j=1,10)
   900 continue
       do 901 k=1,13
-        read(iread,*) (brdfdatv(10-j+1,k),j=1,10)
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (brdfdatv(10-j+1,k),j=1,10)
   901 continue
-      read(iread,*) albbrdf
-      read(iread,*) rodir
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) albbrdf
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) rodir
       rm(-mu)=phirad
       rm(mu)=xmuv
       rm(0)=xmus
@@ -1723,7 +1823,8 @@ c**********************************************************************c
 c     brdf from hapke's model                                          c
 c**********************************************************************c
   24  if(ibrdf.eq.1) then
-        read(iread,*) par1,par2,par3,par4
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) par1,par2,par3,par4
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1752,11 +1853,14 @@ c**********************************************************************c
 c     brdf from verstraete et al's model                               c
 c**********************************************************************c
       if(ibrdf.eq.2) then
-        read(iread,*) (options(i),i=3,5)
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (options(i),i=3,5)
         options(1)=1
         options(2)=1
-        read(iread,*) (struct(i),i=1,4)
-        read(iread,*) (optics(i),i=1,3)
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (struct(i),i=1,4)
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) (optics(i),i=1,3)
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1785,7 +1889,8 @@ c**********************************************************************c
 c     brdf from Roujean et al's model                                  c
 c**********************************************************************c
       if(ibrdf.eq.3) then
-        read(iread,*) par1,par2,par3
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) par1,par2,par3
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1814,7 +1919,8 @@ c**********************************************************************c
 c     brdf from walthall et al's model
 c**********************************************************************c
       if(ibrdf.eq.4) then
-        read(iread,*) par1,par2,par3,par4
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) par1,par2,par3,par4
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1843,7 +1949,8 @@ c**********************************************************************c
 c     brdf from minnaert's model                                       c
 c**********************************************************************c
       if(ibrdf.eq.5) then
-        read(iread,*) par1,par2
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) par1,par2
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1873,7 +1980,8 @@ c**********************************************************************c
 c     brdf from ocean condition
 c**********************************************************************c
       if(ibrdf.eq.6) then
-        read(iread,*) pws,phi_wind,xsal,pcl
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) pws,phi_wind,xsal,pcl
         if (xsal.lt.0.001)xsal=34.3
         paw=phi0-phi_wind
 	
@@ -1913,15 +2021,19 @@ c**********************************************************************c
 c     brdf from Iaquinta and Pinty model
 c**********************************************************************c
       if(ibrdf.eq.7) then
-        read(iread,*) pild,pihs
-        read(iread,*) pxLt,pc
-        read(iread,*) pRl,pTl,pRs
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) pild,pihs
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) pxLt,pc
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) pRl,pTl,pRs
 	
         srm(-1)=phirad
         srm(1)=xmuv
         srm(0)=xmus
         call iapibrdf(pild,pxlt,prl,ptl,prs,pihs,pc,1,1,srm,srp,
      s           sbrdftmp)
+        if (fail) goto 9999
         do l=iinf,isup
            sbrdf(l)=sbrdftmp(1,1)
            enddo
@@ -1945,7 +2057,8 @@ c**********************************************************************c
 c     brdf from Rahman model                
 c**********************************************************************c
       if(ibrdf.eq.8) then
-        read(iread,*) par1,par2,par3
+        call sixsrd(iread,cardln,ios)
+        read(cardln,*,err=9998,end=9998) par1,par2,par3
 	
         srm(-1)=phirad
         srm(1)=xmuv
@@ -1975,8 +2088,10 @@ c**********************************************************************c
 c     brdf from kuusk's msrm model                                     c
 c**********************************************************************c
       if(ibrdf.eq.9) then
-         read(iread,*) uli,eei,thmi,sli
-         read(iread,*) cabi,cwi,vaii,rnci,rsl1i
+         call sixsrd(iread,cardln,ios)
+         read(cardln,*,err=9998,end=9998) uli,eei,thmi,sli
+         call sixsrd(iread,cardln,ios)
+         read(cardln,*,err=9998,end=9998) cabi,cwi,vaii,rnci,rsl1i
 	 
         do l=iinf,isup
            srm(-1)=phirad
@@ -1985,6 +2100,7 @@ c**********************************************************************c
            wl=.25+(l-1)*step 
            call akbrdf(eei,thmi,uli,sli,rsl1i,wl,rnci,cabi,cwi,vaii
      s      ,1,1,srm,srp,sbrdftmp)
+           if (fail) goto 9999
            sbrdf(l)=sbrdftmp(1,1)
            enddo
 	 
@@ -2002,6 +2118,7 @@ c
          call akalbe
 *    & (eei,thmi,uli,sli,rsl1i,wlmoy,rnci,cabi,cwi,vaii,albbrdf)
      & (albbrdf)
+         if (fail) goto 9999
          go to 69
       endif
 c
@@ -2009,7 +2126,8 @@ c**********************************************************************c
 c     brdf from MODIS BRDF   model                                     c
 c**********************************************************************c
       if(ibrdf.eq.10) then
-         read(iread,*)p1,p2,p3
+         call sixsrd(iread,cardln,ios)
+         read(cardln,*,err=9998,end=9998) p1,p2,p3
 	 
            srm(-1)=phirad
            srm(1)=xmuv
@@ -2107,17 +2225,21 @@ c**********************************************************************c
 c     uniform surface with lambertian conditions                       c
 c**********************************************************************c
 
-  21  read(iread,*) igroun
+  21  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) igroun
 
       if(igroun) 29,32,33
       
-  29  read(iread,*) nwlinf,nwlsup
+  29  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) nwlinf,nwlsup
       niinf=(nwlinf-.25)/0.0025+1.5
       nisup=(nwlsup-.25)/0.0025+1.5
-      read(iread,*) (rocl(i),i=niinf,nisup)
+      call sixsrv(iread,rocl(niinf),nisup-niinf+1)
+      if (fail) goto 9999
       goto 36
 
-  32  read(iread,*) ro
+  32  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) ro
 
       do 35 l=iinf,isup
         rocl(l)=ro
@@ -2135,11 +2257,14 @@ c**********************************************************************c
 c**********************************************************************c
 c     non-uniform conditions with lambertian conditions                c
 c**********************************************************************c
- 31   read(iread,*) igrou1,igrou2,rad
+ 31   call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) igrou1,igrou2,rad
       if(igrou1) 59,60,63
-  59  read(iread,*) (rocl(i),i=iinf,isup)
+  59  call sixsrv(iread,rocl(iinf),isup-iinf+1)
+      if (fail) goto 9999
       goto 61
-  60  read(iread,*) roc
+  60  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) roc
       do 64 l=iinf,isup
         rocl(l)=roc
    64 continue
@@ -2149,9 +2274,11 @@ c**********************************************************************c
       if(igrou1.eq.3) call sand  (rocl)
       if(igrou1.eq.4) call lakew (rocl)
    61 if(igrou2) 66,62,65
-  66  read(iread,*) (roel(i),i=iinf,isup)
+  66  call sixsrv(iread,roel(iinf),isup-iinf+1)
+      if (fail) goto 9999
       goto 34
-  62  read(iread,*) roe
+  62  call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) roe
       do 67 l=iinf,isup
         roel(l)=roe
    67 continue
@@ -2191,11 +2318,13 @@ c               distance, es is in [w/m2/sr/mic].                      c
 c                                                                      c
 c**********************************************************************c
 
-      read(iread,*) irapp
+      call sixsrd(iread,cardln,ios)
+      read(cardln,*,err=9998,end=9998) irapp
 
       if (irapp.ge.0) then
          irapp=1
-         read(iread,*) rapp
+         call sixsrd(iread,cardln,ios)
+         read(cardln,*,err=9998,end=9998) rapp
          endif
 	 
 	 
@@ -2219,19 +2348,24 @@ C       read(iread,*,end=37) ilut
       
        irop=0
 
-       read(iread,*,end=37) irop
+       call sixsrd(iread,cardln,ios)
+       if (ios.ne.0) goto 37
+       read(cardln,*,err=9998,end=9998) irop
 
        if (irop.eq.1) then
-       read(iread,*) ropq,ropu
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) ropq,ropu
        endif
        
        if (irop.eq.2) then
-       read(iread,*) pveg
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) pveg
        call polnad(asol,avis,phi,pveg,ropq,ropu)
        endif
        
        if (irop.eq.3) then
-       read(iread,*) wspd,azw
+       call sixsrd(iread,cardln,ios)
+       read(cardln,*,err=9998,end=9998) wspd,azw
        razw=phi0-azw
        call polglit(asol,avis,phi,wspd,razw,ropq,ropu)
        endif
@@ -2337,10 +2471,10 @@ c --- aerosols model (type) ----
        aer_model(12)="user-defined"           
 
        num_z=num_z-1
-       write(6,5551) num_z
-       write(6,5552)
+       write(iwr,5551) num_z
+       write(iwr,5552)
        do i=1,num_z
-       write(6,5553)i,height_z(num_z+1-i),taer55_z(num_z+1-i),
+       write(iwr,5553)i,height_z(num_z+1-i),taer55_z(num_z+1-i),
      a aer_model(iaer)
        enddo
        
@@ -2364,7 +2498,7 @@ c --- aerosols model (type) ----
       
        if (iaer.eq.4)write(iwr,133)(c(i),i=1,4)
        if (iaer.eq.8) then
-        write(6,134) icp
+        write(iwr,134) icp
         do i=1,icp
          write(iwr,135)x1(i),x2(i),cij_out(i)
         enddo
@@ -2381,7 +2515,7 @@ c --- for the exponential profile ----
       if(abs(v).le.xacc) write(iwr, 140)taer55
       if(abs(v).gt.xacc) write(iwr, 141)v,taer55
       endif
-1112  write(6,5555)
+1112  write(iwr,5555)
 
 
 c --- spectral condition ----
@@ -3067,7 +3201,7 @@ C SIMPLE LUT in azimuth
       if (ilut.eq.2) then
           do ifi=1,nfi
 	  xtphi=(ifi-1)*180.0/(nfi-1)
-	  write(6,*) "lutfi ",xtphi,ratm2_fi(ifi)
+	  write(iwr,*) "lutfi ",xtphi,ratm2_fi(ifi)
 	  enddo
       endif	  
 
@@ -3079,7 +3213,7 @@ C LUT FOR Look up table data
         write(*,*) 'main.f: Could not open rotoa_bs for reading.'
         call getcwd(cwd)
         write(*,*) 'main.f: Current working directory: ', trim(cwd)
-        stop 'main.f: 6S processing error'
+        goto 9999
       endif
 
       write(10,2222) "AERO-LUT Lambda min,max ",wlinf,wlsup
@@ -3156,7 +3290,7 @@ C Case for an aps LUT
         write(*,*) 'main.f: Could not open rotoa_aps_bs for reading.'
         call getcwd(cwd)
         write(*,*) 'main.f: Current working directory: ', trim(cwd)
-        stop 'main.f: 6S processing error'
+        goto 9999
       endif
 
       write(10,2222) "AERO-LUT Lambda min,max ",wlinf,wlsup
@@ -3292,6 +3426,39 @@ CCC	write(iwr, 931)'instrument app ref.:',zero,zero,refeti
       write(iwr, 931)'sing. scat. albedo :',pizerr,pizera,pizert
       write(iwr, 1401)
       write(iwr, 1402)
+
+c**********************************************************************c
+c                                                                      c
+c                    results returned to the caller                    c
+c        gaseous transmittances: water vapor, ozone, co2, oxygen,      c
+c                                no2, ch4, co                          c
+c        scattering transmittances (down, up): rayleigh, aerosol,      c
+c                                total                                 c
+c        spherical albedo: rayleigh, total                             c
+c        aerosol optical depth                                         c
+c        reflectance: rayleigh, aerosol, total, apparent               c
+c                                                                      c
+c**********************************************************************c
+      sixres(1)=stwava
+      sixres(2)=stozon
+      sixres(3)=stdica
+      sixres(4)=stoxyg
+      sixres(5)=stniox
+      sixres(6)=stmeth
+      sixres(7)=stmoca
+      sixres(8)=sdtotr
+      sixres(9)=sutotr
+      sixres(10)=sdtota
+      sixres(11)=sutota
+      sixres(12)=sdtott
+      sixres(13)=sutott
+      sixres(14)=sasr
+      sixres(15)=sast
+      sixres(16)=sodaer
+      sixres(17)=sroray
+      sixres(18)=sroaer
+      sixres(19)=srotot
+      sixres(20)=refet
  
 c**********************************************************************c
 c                                                                      c
@@ -3368,7 +3535,13 @@ c        write(6,'(A5,F9.5,A8,F9.5)') 'y=',y, '  acr=',y/(1.+xc*y)
 c        write(6,*) 'rogbrdf=',rogbrdf,' rodir=',brdfints(mu,1),
 c    s            ' diff=',rogbrdf-brdfints(mu,1)
       endif
-      stop
+      return
+
+c error in the 6S processing: return the error status to the caller
+c instead of stopping, since 6S may be run within another program
+ 9998 call print_error('6S input card error: '//trim(cardln))
+ 9999 istat=1
+      return
  
 c**********************************************************************c
 c                                                                      c
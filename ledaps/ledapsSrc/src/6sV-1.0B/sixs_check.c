@@ -0,0 +1,114 @@
+/* sixs_check: checks the results of 6S in its current run configuration
+   (number of OpenMP threads given by OMP_NUM_THREADS, fast mode given by
+   SIXS_FAST) against the reference configuration (one thread, full
+   successive orders computations), for one deck of 6S input cards.
+
+   sixs_check deck_file [tolerance]
+
+   Both runs are timed and the largest relative difference of the 6S
+   results is reported; the exit status is 1 if it is above the tolerance
+   (default 1e-4, or 1e-3 in fast mode, whose coarser layers and fewer
+   scattering orders change the path reflectances by a few 1e-4). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define DECK_SIZE 16384
+#define NB_OUT 20
+#define DEFAULT_TOLERANCE 1e-4
+#define FAST_TOLERANCE 1e-3
+
+int sixs_run(const char *deck, int ndeck, float *results);
+int sixs_fast_mode(void);
+
+static const char *out_names[NB_OUT] = {"T_g_wv", "T_g_o3", "T_g_co2",
+	"T_g_o2", "T_g_no2", "T_g_ch4", "T_g_co", "T_r_down", "T_r_up",
+	"T_a_down", "T_a_up", "T_ra_down", "T_ra_up", "S_r", "S_ra", "aot",
+	"rho_r", "rho_a", "rho_ra", "rho_toa"};
+
+static double now(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv,NULL);
+	return tv.tv_sec+1e-6*tv.tv_usec;
+}
+
+int main(int argc, char *argv[]) {
+	static char deck[DECK_SIZE];
+	float ref[NB_OUT],res[NB_OUT];
+	double tolerance=-1.,t_ref,t_res,diff,max_diff=0.;
+	char *fast;
+	int ndeck,nthreads=1,fast_mode,i;
+	FILE *fd;
+
+	if (argc<2 || argc>3) {
+		printf("Usage: sixs_check deck_file [tolerance]\n");
+		return EXIT_FAILURE;
+	}
+	if (argc==3)
+		tolerance=atof(argv[2]);
+	if ((fd=fopen(argv[1],"r"))==NULL) {
+		fprintf(stderr,"ERROR: opening 6S deck %s\n",argv[1]);
+		return EXIT_FAILURE;
+	}
+	ndeck=fread(deck,1,DECK_SIZE,fd);
+	if (!feof(fd)) {
+		fprintf(stderr,"ERROR: 6S deck %s too long\n",argv[1]);
+		return EXIT_FAILURE;
+	}
+	fclose(fd);
+
+	/* Reference: one thread, no fast mode */
+	fast=getenv("SIXS_FAST");
+	if (fast!=NULL)
+		fast=strdup(fast);
+	fast_mode=sixs_fast_mode();
+	if (tolerance<0.)
+		tolerance=fast_mode ? FAST_TOLERANCE : DEFAULT_TOLERANCE;
+	unsetenv("SIXS_FAST");
+#ifdef _OPENMP
+	nthreads=omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	t_ref=now();
+	if (sixs_run(deck,ndeck,ref)) {
+		fprintf(stderr,"ERROR: 6S reference run failed\n");
+		return EXIT_FAILURE;
+	}
+	t_ref=now()-t_ref;
+
+	/* Run configuration */
+	if (fast!=NULL)
+		setenv("SIXS_FAST",fast,1);
+#ifdef _OPENMP
+	omp_set_num_threads(nthreads);
+#endif
+	t_res=now();
+	if (sixs_run(deck,ndeck,res)) {
+		fprintf(stderr,"ERROR: 6S run failed\n");
+		return EXIT_FAILURE;
+	}
+	t_res=now()-t_res;
+
+	printf("%-10s %14s %14s %10s\n","result","reference","run","rel diff");
+	for (i=0;i<NB_OUT;i++) {
+		diff=fabs(res[i]-ref[i]);
+		if (fabs(ref[i])>1e-6)
+			diff/=fabs(ref[i]);
+		if (diff>max_diff)
+			max_diff=diff;
+		printf("%-10s %14.6f %14.6f %10.2e\n",out_names[i],ref[i],res[i],diff);
+	}
+	printf("\nreference (1 thread): %.3f s\n",t_ref);
+	printf("run (%d thread(s)%s): %.3f s\n",nthreads,
+		fast_mode ? ", fast mode" : "",t_res);
+	printf("max relative difference %.2e, tolerance %.2e: %s\n",max_diff,
+		tolerance,(max_diff<=tolerance) ? "OK" : "FAILED");
+	return (max_diff<=tolerance) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
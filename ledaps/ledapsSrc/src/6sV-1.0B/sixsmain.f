@@ -0,0 +1,11 @@
+      program ssssss
+c**********************************************************************c
+c     stand-alone 6S: the input cards are read from the standard input c
+c     and the listing is written to the standard output                c
+c**********************************************************************c
+      real sixres(20)
+      integer istat
+
+      call sixs(6,sixres,istat)
+      if (istat.ne.0) stop 1
+      end
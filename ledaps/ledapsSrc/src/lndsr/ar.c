@@ -3,6 +3,7 @@
 08-01-2013: Modified divide by 10000. to multiply by 0.0001 since
             that is faster.  Gail Schmidt, USGS EROS LSRD
 ***************************************************************/
+#include <string.h>
 #include "ar.h"
 #include "const.h"
 #include "error.h"
@@ -20,9 +21,71 @@ void csalbr(float *tau_ray,float *actual_S_r);
 int compute_aot(int band,float rho_toa,float rho_surf_est,float ts,float tv, float phi, float uoz, float uwv, float spres,sixs_tables_t *sixs_tables,float *aot);
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 
+bool ArAllocScratch(Lut_t *lut, Ar_gridcell_t *ar_gridcell,
+        Ar_scratch_t *scratch)
+{
+/***
+Allocate the scratch buffers of Ar; each thread calling Ar needs its own
+***/
+  int ib;
+
+  memset(scratch,0,sizeof(*scratch));
+  for (ib=0;ib<3;ib++)
+    if ((scratch->collect_band[ib]=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL) {
+      ArFreeScratch(scratch);
+      return false;
+    }
+  if ((scratch->collect_band7=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL) {
+    ArFreeScratch(scratch);
+    return false;
+  }
+/**
+	Allocate memory for atmos_coef_ar struct used in filtering aot based on AC red band
+**/
+  if (allocate_mem_atmos_coeff(ar_gridcell->nbrows*ar_gridcell->nbcols,&scratch->atmos_coef_ar)) {
+    ArFreeScratch(scratch);
+    return false;
+  }
+  scratch->allocated=true;
+  return true;
+}
+
+void ArFreeScratch(Ar_scratch_t *scratch)
+{
+  int ib;
+
+  for (ib=0;ib<3;ib++)
+    free(scratch->collect_band[ib]);
+  free(scratch->collect_band7);
+  if (scratch->allocated)
+    free_mem_atmos_coeff(&scratch->atmos_coef_ar);
+  memset(scratch,0,sizeof(*scratch));
+}
+
+void ArAddStats(Ar_stats_t *ar_stats, Ar_stats_t *ar_stats_add)
+{
+/***
+Add the statistics of a row of regions to the scene statistics
+***/
+  ar_stats->nfill += ar_stats_add->nfill;
+  if (ar_stats_add->first)
+    return;
+  if (ar_stats->first) {
+    ar_stats->ar_min = ar_stats_add->ar_min;
+    ar_stats->ar_max = ar_stats_add->ar_max;
+    ar_stats->first = false;
+  } else {
+    if (ar_stats_add->ar_min < ar_stats->ar_min)
+      ar_stats->ar_min = ar_stats_add->ar_min;
+    if (ar_stats_add->ar_max > ar_stats->ar_max)
+      ar_stats->ar_max = ar_stats_add->ar_max;
+  }
+}
+
 bool Ar(int il_ar,Lut_t *lut, Img_coord_int_t *size_in, int16 ***line_in, 
         char **ddv_line, int **line_ar, Ar_stats_t *ar_stats,
-        Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables) 
+        Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,
+        Ar_scratch_t *scratch) 
 {
 /***
 ddv_line contains results of cloud_screening when this routine is called
@@ -35,6 +98,9 @@ bit 7 = snow
 
 The DDV flag in ddv_line (bit 0) is updated in this routine
 
+Ar only updates ddv_line, line_ar, ar_stats and its scratch buffers, so
+different rows of regions can be processed in parallel, each with its own
+scratch buffers (see ArAllocScratch)
 ***/
   int is, il,i,j;
   int is_ar;
@@ -65,20 +131,13 @@ The DDV flag in ddv_line (bit 0) is updated in this routine
 	float a_CH4_b7=0.030172, b_CH4_b7=0.79652;
 
 
-	atmos_t atmos_coef_ar;
+	atmos_t *atmos_coef_ar=&scratch->atmos_coef_ar;
 	float rho;
 	int nb_negative_red,nb_red_obs,ipt;
 
 	for (ib=0;ib<3;ib++)
-		if ((collect_band[ib]=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL)
-			return false;
-	if ((collect_band7=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL)
-		return false;
-/**
-	Allocate memory for atmos_coef_ar struct used in filtering aot based on AC red band
-**/
-	if (allocate_mem_atmos_coeff(ar_gridcell->nbrows*ar_gridcell->nbcols,&atmos_coef_ar))
-		return false;
+		collect_band[ib]=scratch->collect_band[ib];
+	collect_band7=scratch->collect_band7;
 
   /* Do for each region along a line */
 
@@ -99,12 +158,13 @@ The DDV flag in ddv_line (bit 0) is updated in this routine
 
 	 collect_nbsamps=0;
 	 
-    fts=ar_gridcell->line_sun_zen[is_ar];
-    ftv=ar_gridcell->line_view_zen[is_ar];
-    phi=ar_gridcell->line_rel_az[is_ar];
-    uwv=ar_gridcell->line_wv[is_ar];
-    uoz=ar_gridcell->line_ozone[is_ar];
-    spres=ar_gridcell->line_spres[is_ar];
+    ipt=il_ar*ar_gridcell->nbcols+is_ar;
+    fts=ar_gridcell->sun_zen[ipt];
+    ftv=ar_gridcell->view_zen[ipt];
+    phi=ar_gridcell->rel_az[ipt];
+    uwv=ar_gridcell->wv[ipt];
+    uoz=ar_gridcell->ozone[ipt];
+    spres=ar_gridcell->spres[ipt];
 
 /**
 compute wv transmittance for band 7
@@ -276,12 +336,11 @@ exclude clouds, cloud shadow & snow pixels flagged by the internal cloud mask
 	Filter aot : Correct red band using retreived aot. if over 30% of the corrected refelctances are
     negative, reject aot.
 ***/
-		if (update_gridcell_atmos_coefs(il_ar,is_ar,&atmos_coef_ar,ar_gridcell,sixs_tables,line_ar,lut,6, 0))
+		if (update_gridcell_atmos_coefs(il_ar,is_ar,atmos_coef_ar,ar_gridcell,sixs_tables,line_ar,lut,6, 0))
 			return false;
 		ib=2; /*  test with red band */
 		nb_red_obs=0;
 		nb_negative_red=0;
-		ipt=il_ar*lut->ar_size.s+is_ar;
     	for (il = 0; il < lut->ar_region_size.l; il++) {
       		for (is = is_start; is < (is_end + 1); is++) {
 			if (!(ddv_line[il][is]&0x08)) {
@@ -291,18 +350,18 @@ exclude clouds, cloud shadow & snow pixels flagged by the internal cloud mask
      	                        rho6=(float)line_in[il][4][is]*0.0001;
      	                        rho1=(float)line_in[il][0][is]*0.0001;
 	                        rho7 /= T_g_b7;  /* correct for water vapor and other gases*/
-     			        rho=(rho/atmos_coef_ar.tgOG[ib][ipt]-atmos_coef_ar.rho_ra[ib][ipt]);
-				rho /= (atmos_coef_ar.tgH2O[ib][ipt]*atmos_coef_ar.td_ra[ib][ipt]*atmos_coef_ar.tu_ra[ib][ipt]);
-				rho /= (1.+atmos_coef_ar.S_ra[ib][ipt]*rho);
-     			        rho4=(rho/atmos_coef_ar.tgOG[3][ipt]-atmos_coef_ar.rho_ra[3][ipt]);
-				rho4 /= (atmos_coef_ar.tgH2O[3][ipt]*atmos_coef_ar.td_ra[3][ipt]*atmos_coef_ar.tu_ra[3][ipt]);
-				rho4 /= (1.+atmos_coef_ar.S_ra[3][ipt]*rho4);
-     			        rho6=(rho/atmos_coef_ar.tgOG[4][ipt]-atmos_coef_ar.rho_ra[4][ipt]);
-				rho6 /= (atmos_coef_ar.tgH2O[4][ipt]*atmos_coef_ar.td_ra[4][ipt]*atmos_coef_ar.tu_ra[4][ipt]);
-				rho6 /= (1.+atmos_coef_ar.S_ra[4][ipt]*rho6);
-     			        rho1=(rho/atmos_coef_ar.tgOG[0][ipt]-atmos_coef_ar.rho_ra[0][ipt]);
-				rho1 /= (atmos_coef_ar.tgH2O[0][ipt]*atmos_coef_ar.td_ra[0][ipt]*atmos_coef_ar.tu_ra[0][ipt]);
-				rho1 /= (1.+atmos_coef_ar.S_ra[0][ipt]*rho1);
+     			        rho=(rho/atmos_coef_ar->tgOG[ib][ipt]-atmos_coef_ar->rho_ra[ib][ipt]);
+				rho /= (atmos_coef_ar->tgH2O[ib][ipt]*atmos_coef_ar->td_ra[ib][ipt]*atmos_coef_ar->tu_ra[ib][ipt]);
+				rho /= (1.+atmos_coef_ar->S_ra[ib][ipt]*rho);
+     			        rho4=(rho/atmos_coef_ar->tgOG[3][ipt]-atmos_coef_ar->rho_ra[3][ipt]);
+				rho4 /= (atmos_coef_ar->tgH2O[3][ipt]*atmos_coef_ar->td_ra[3][ipt]*atmos_coef_ar->tu_ra[3][ipt]);
+				rho4 /= (1.+atmos_coef_ar->S_ra[3][ipt]*rho4);
+     			        rho6=(rho/atmos_coef_ar->tgOG[4][ipt]-atmos_coef_ar->rho_ra[4][ipt]);
+				rho6 /= (atmos_coef_ar->tgH2O[4][ipt]*atmos_coef_ar->td_ra[4][ipt]*atmos_coef_ar->tu_ra[4][ipt]);
+				rho6 /= (1.+atmos_coef_ar->S_ra[4][ipt]*rho6);
+     			        rho1=(rho/atmos_coef_ar->tgOG[0][ipt]-atmos_coef_ar->rho_ra[0][ipt]);
+				rho1 /= (atmos_coef_ar->tgH2O[0][ipt]*atmos_coef_ar->td_ra[0][ipt]*atmos_coef_ar->tu_ra[0][ipt]);
+				rho1 /= (1.+atmos_coef_ar->S_ra[0][ipt]*rho1);
 				nb_red_obs++;
 			
 				if ((rho < 0.) || (rho > rho7 )) /*eric introduced that to get rid of the salt pan */
@@ -340,13 +399,6 @@ exclude clouds, cloud shadow & snow pixels flagged by the internal cloud mask
 	  }
     }
   }
-	for (ib=0;ib<3;ib++)
-		free(collect_band[ib]);
-	free(collect_band7);
-
-	if(free_mem_atmos_coeff(&atmos_coef_ar))
-		return false;
-
   return true;
 }
 
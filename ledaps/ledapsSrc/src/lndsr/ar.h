@@ -13,9 +13,22 @@ typedef struct {
   long nfill;
 } Ar_stats_t;
 
+/* Scratch buffers of Ar, allocated once for each thread */
+typedef struct {
+  short *collect_band[3];       /* dark target reflectances of a region */
+  short *collect_band7;
+  atmos_t atmos_coef_ar;        /* coefficients used to filter the aot */
+  bool allocated;               /* atmos_coef_ar allocated */
+} Ar_scratch_t;
+
+bool ArAllocScratch(Lut_t *lut, Ar_gridcell_t *ar_gridcell,
+        Ar_scratch_t *scratch);
+void ArFreeScratch(Ar_scratch_t *scratch);
+void ArAddStats(Ar_stats_t *ar_stats, Ar_stats_t *ar_stats_add);
 bool Ar(int il_ar,Lut_t *lut, Img_coord_int_t *size_in, int16 ***line_in,
         char **ddv_line, int **line_ar, Ar_stats_t *ar_stats,
-        Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables);
+        Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,
+        Ar_scratch_t *scratch);
 
 int ArInterp(Lut_t *lut, Img_coord_int_t *loc, int ***line_ar, int *inter_aot);
 int Fill_Ar_Gaps(Lut_t *lut, int ***line_ar, int ib);
@@ -14,6 +14,26 @@ int free_mem_atmos_coeff(atmos_t *atmos_coef);
 void SrInterpAtmCoef (Lut_t *lut, Img_coord_int_t *input_loc, atmos_t *atmos_coef, atmos_t *interpol_atmos_coef);
 
 
+/* Add a value to a compensated sum */
+static void cld_sum_add(cld_sum_t *cld_sum, double value)
+{
+    double t;
+
+    t = cld_sum->sum + value;
+    if (fabs(cld_sum->sum) >= fabs(value))
+        cld_sum->comp += (cld_sum->sum - t) + value;
+    else
+        cld_sum->comp += (value - t) + cld_sum->sum;
+    cld_sum->sum = t;
+}
+
+/* Value of a compensated sum */
+double cld_sum_value(cld_sum_t *cld_sum)
+{
+    return cld_sum->sum + cld_sum->comp;
+}
+
+
 bool cloud_detection_pass1
 (
     Lut_t *lut,              /* I: lookup table informat */
@@ -25,6 +45,8 @@ bool cloud_detection_pass1
     float *atemp_line,       /* I: auxiliary temperature for the line */
     cld_diags_t *cld_diags   /* I/O: cloud diagnostics (stats are updated) */
 )
+/* Only the clear sky sums of the cells of the current line are updated, so
+   lines of different rows of cells can be processed in parallel. */
 {
     int is;                   /* current sample in the line */
     bool is_fill;             /* is the current pixel fill */
@@ -140,12 +162,14 @@ bool cloud_detection_pass1
                 if (!water) { /* if not water */
                     if ((t6 > (atemp_line[is] - 20.)) && (!C5)) { 
                         if (!((C1||C3)&&C2&&C4)) { /* clear */
-                            cld_diags->avg_t6_clear[cld_row][cld_col] += t6;
-                            cld_diags->std_t6_clear[cld_row][cld_col] +=
-                                (t6*t6);
-                            cld_diags->avg_b7_clear[cld_row][cld_col] += rho7;
-                            cld_diags->std_b7_clear[cld_row][cld_col] +=
-                                (rho7*rho7);
+                            cld_sum_add(&cld_diags->sum_t6_clear[cld_row]
+                                [cld_col], t6);
+                            cld_sum_add(&cld_diags->sumsq_t6_clear[cld_row]
+                                [cld_col], (double)t6*t6);
+                            cld_sum_add(&cld_diags->sum_b7_clear[cld_row]
+                                [cld_col], rho7);
+                            cld_sum_add(&cld_diags->sumsq_b7_clear[cld_row]
+                                [cld_col], (double)rho7*rho7);
                             cld_diags->nb_t6_clear[cld_row][cld_col]++;
                         }
                     }
@@ -712,6 +736,39 @@ int allocate_cld_diags
             sizeof(int)))==NULL)
             return -1;
 
+    /* Clear sky sums of the first pass of the cloud screening */
+    if ((cld_diags->sum_t6_clear = malloc (cld_diags->nbrows*
+        sizeof(cld_sum_t *)))==NULL)
+        return -1;
+    for (i = 0; i < cld_diags->nbrows; i++) 
+        if ((cld_diags->sum_t6_clear[i] = calloc(cld_diags->nbcols,
+            sizeof(cld_sum_t)))==NULL)
+            return -1;
+
+    if ((cld_diags->sumsq_t6_clear = malloc (cld_diags->nbrows*
+        sizeof(cld_sum_t *)))==NULL)
+        return -1;
+    for (i = 0; i < cld_diags->nbrows; i++) 
+        if ((cld_diags->sumsq_t6_clear[i] = calloc(cld_diags->nbcols,
+            sizeof(cld_sum_t)))==NULL)
+            return -1;
+
+    if ((cld_diags->sum_b7_clear = malloc (cld_diags->nbrows*
+        sizeof(cld_sum_t *)))==NULL)
+        return -1;
+    for (i = 0; i < cld_diags->nbrows; i++) 
+        if ((cld_diags->sum_b7_clear[i] = calloc(cld_diags->nbcols,
+            sizeof(cld_sum_t)))==NULL)
+            return -1;
+
+    if ((cld_diags->sumsq_b7_clear = malloc (cld_diags->nbrows*
+        sizeof(cld_sum_t *)))==NULL)
+        return -1;
+    for (i = 0; i < cld_diags->nbrows; i++) 
+        if ((cld_diags->sumsq_b7_clear[i] = calloc(cld_diags->nbcols,
+            sizeof(cld_sum_t)))==NULL)
+            return -1;
+
     return 0;
 }
 
@@ -726,6 +783,10 @@ void free_cld_diags(cld_diags_t *cld_diags) {
         free(cld_diags->std_b7_clear[i]);
         free(cld_diags->airtemp_2m[i]);
         free(cld_diags->nb_t6_clear[i]);
+        free(cld_diags->sum_t6_clear[i]);
+        free(cld_diags->sumsq_t6_clear[i]);
+        free(cld_diags->sum_b7_clear[i]);
+        free(cld_diags->sumsq_b7_clear[i]);
     }
 
     free(cld_diags->avg_t6_clear);
@@ -734,6 +795,10 @@ void free_cld_diags(cld_diags_t *cld_diags) {
     free(cld_diags->std_b7_clear);
     free(cld_diags->airtemp_2m);
     free(cld_diags->nb_t6_clear);
+    free(cld_diags->sum_t6_clear);
+    free(cld_diags->sumsq_t6_clear);
+    free(cld_diags->sum_b7_clear);
+    free(cld_diags->sumsq_b7_clear);
 }
 
 void fill_cld_diags(cld_diags_t *cld_diags) {
@@ -13,10 +13,16 @@
 #define CLDDIAGS_CELLHEIGHT_10KM 330
 #define CLDDIAGS_CELLWIDTH_10KM 330
 
+/* Compensated (Neumaier) sum of the clear pixels values of a cell */
+typedef struct {
+	double sum,comp;
+} cld_sum_t;
+
 typedef struct cld_diags_t {
 	int nbrows,nbcols,cellheight,cellwidth;
 	float **avg_t6_clear,**std_t6_clear,**avg_b7_clear,**std_b7_clear,**airtemp_2m;
 	int **nb_t6_clear;
+	cld_sum_t **sum_t6_clear,**sumsq_t6_clear,**sum_b7_clear,**sumsq_b7_clear;
 }cld_diags_t;
 
 
@@ -24,6 +30,7 @@ typedef struct cld_diags_t {
 int allocate_cld_diags(struct cld_diags_t *cld_diags,int cell_height, int cell_width, int scene_height, int scene_width);
 void free_cld_diags(struct cld_diags_t *cld_diags);
 void fill_cld_diags(cld_diags_t *cld_diags);
+double cld_sum_value(cld_sum_t *cld_sum);
 void interpol_clddiags_1pixel(cld_diags_t *cld_diags, int img_line, int img_sample, float *t6_clear, float *airtemp_2m);
 
 bool cloud_detection_pass1(Lut_t *lut, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line,float *atemp_line, cld_diags_t *cld_diags);
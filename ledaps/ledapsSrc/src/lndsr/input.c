@@ -34,12 +34,20 @@
 
    2. 'OpenInput' must be called before any of the other routines.  
    3. 'FreeInput' should be used to free the 'input' data structure.
+   4. lndsr goes through the input several times (cloud screening passes,
+      aerosol retrieval and surface reflectance), so the input files are
+      memory mapped and read ahead once: the later passes are served from
+      memory instead of seeking and reading every line again.  The files
+      are read line by line if they can't be mapped.
 
 !END****************************************************************************
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "input.h"
 #include "error.h"
 #include "mystring.h"
@@ -48,6 +56,22 @@
 
 #define INPUT_FILL (-9999)
 
+/* Map an input file in memory and start reading it ahead; returns NULL if
+   it can't be mapped */
+static void *MapInput(FILE *fp, size_t nbytes)
+{
+  struct stat st;
+  void *map;
+
+  if (nbytes == 0 || fstat(fileno(fp), &st) || (size_t)st.st_size < nbytes)
+    return NULL;
+  map = mmap(NULL, nbytes, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+  if (map == MAP_FAILED)
+    return NULL;
+  madvise(map, nbytes, MADV_WILLNEED);
+  return map;
+}
+
 /* Functions */
 Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
 /* 
@@ -85,6 +109,9 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
   }
 
   /* Open TOA reflectance files for access */
+  for (ib = 0; ib < NBAND_REFL_MAX; ib++)
+    this->map[ib] = NULL;
+  this->map_qa = NULL;
   for (ib = 0; ib < this->nband; ib++) {
     this->fp_bin[ib] = fopen(this->file_name[ib], "r");
     if (this->fp_bin[ib] == NULL) {
@@ -92,6 +119,8 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
       break;
     }
     this->open[ib] = true;
+    this->map[ib] = (int16 *)MapInput(this->fp_bin[ib],
+      (size_t)this->size.l * this->size.s * sizeof(int16));
   }
 
   /* Open QA file for access, if not processing thermal band */
@@ -99,8 +128,11 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
     this->fp_bin_qa = fopen(this->file_name_qa, "r");
     if (this->fp_bin_qa == NULL) 
       error_string = "opening QA binary file";
-    else
+    else {
       this->open_qa = true;
+      this->map_qa = (uint8 *)MapInput(this->fp_bin_qa,
+        (size_t)this->size.l * this->size.s * sizeof(uint8));
+    }
   }
 
   if (error_string != NULL) {
@@ -109,6 +141,9 @@ Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
       this->file_name[ib] = NULL;
 
       if (this->open[ib]) {
+        if (this->map[ib] != NULL)
+          munmap(this->map[ib],
+            (size_t)this->size.l * this->size.s * sizeof(int16));
         fclose(this->fp_bin[ib]);
         this->open[ib] = false;
       }
@@ -160,6 +195,11 @@ bool CloseInput(Input_t *this)
   for (ib = 0; ib < this->nband; ib++) {
     if (this->open[ib]) {
       none_open = false;
+      if (this->map[ib] != NULL) {
+        munmap(this->map[ib],
+          (size_t)this->size.l * this->size.s * sizeof(int16));
+        this->map[ib] = NULL;
+      }
       fclose(this->fp_bin[ib]);
       this->open[ib] = false;
     }
@@ -167,6 +207,11 @@ bool CloseInput(Input_t *this)
 
   /*** now close the QA file, if it's open ***/
   if (this->open_qa) {
+    if (this->map_qa != NULL) {
+      munmap(this->map_qa,
+        (size_t)this->size.l * this->size.s * sizeof(uint8));
+      this->map_qa = NULL;
+    }
     fclose(this->fp_bin_qa);
     this->open_qa = false;
   }
@@ -229,6 +274,13 @@ bool GetInputLine(Input_t *this, int iband, int iline, int16 *line)
   if (!this->open[iband])
     RETURN_ERROR("band not open", "GetInputLine", false);
 
+  /* Copy the line from the mapped file */
+  if (this->map[iband] != NULL) {
+    memcpy(line, &this->map[iband][(size_t)iline * this->size.s],
+      this->size.s * sizeof(int16));
+    return true;
+  }
+
   /* Read the data */
   buf_void = (void *)line;
   loc = (long) (iline * this->size.s * sizeof(int16));
@@ -254,6 +306,12 @@ bool GetInputQALine(Input_t *this, int iline, uint8 *line)
   if (!this->open_qa)
     RETURN_ERROR("QA band not open", "GetInputQALine", false);
 
+  if (this->map_qa != NULL) {
+    memcpy(line, &this->map_qa[(size_t)iline * this->size.s],
+      this->size.s * sizeof(uint8));
+    return true;
+  }
+
   buf_void = (void *)line;
   loc = (long) (iline * this->size.s * sizeof(uint8));
   if (fseek(this->fp_bin_qa, loc, SEEK_SET))
@@ -79,6 +79,9 @@ typedef struct {
   bool open_qa;            /* Flag to indicate whether the specific input
                               file is open for access; 'true' = open, 
                               'false' = not open */
+  int16 *map[NBAND_REFL_MAX]; /* Memory mapping of the input binary files
+                                (NULL if not mapped; read line by line) */
+  uint8 *map_qa;           /* Memory mapping of the QA binary file */
 } Input_t;
 
 /* Prototypes */
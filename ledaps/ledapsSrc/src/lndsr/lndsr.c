@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
@@ -45,8 +46,35 @@
 #define DEM_LONMAX 180.0
 #define P_DFTVALUE 1013.0
 
+/* Memory budget (MB) of the dark target plane, above which it is kept in a
+   temporary file */
+#define DDV_MEM_MAX_ENV "LEDAPS_DDV_MEM_MAX"
+#define DDV_MEM_MAX_DEFAULT 2048
+
+/* Spacing (pixels) of the coarse grid of the air temperature */
+#define ATEMP_GRID_STEP 32
+
+/* Errors of compute_aerosol */
+#define AR_ERROR_ALLOC 1
+#define AR_ERROR_READ 2
+#define AR_ERROR_AR 3
+
+/* Errors of the cloud screening */
+#define CLD_ERROR_ALLOC 1
+#define CLD_ERROR_READ 2
+#define CLD_ERROR_PASS 3
+
 /* Type definitions */
 
+/* Air temperature at scene time on a coarse grid of the scene; nodes are
+   every step pixels, plus the last line/sample */
+typedef struct {
+    int step;
+    int nl, ns;                 /* number of nodes in each direction */
+    int size_l, size_s;         /* scene size */
+    float *value;               /* nl*ns node values */
+} atemp_grid_t;
+
 atmos_t atmos_coef;
 #ifdef DEBUG_AR
 FILE *fd_ar_diags = NULL;
@@ -72,6 +100,17 @@ int update_atmos_coefs(atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tabl
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 float calcuoz(short jday,float flat);
 float get_dem_spres(short *dem,float lat,float lon);
+void first_touch_blocks(char *plane, size_t block_size, int nblocks);
+char *allocate_ddv_plane(size_t block_size, int nblocks);
+int compute_aerosol(Lut_t *lut, Input_t *input, char *ddv_plane,
+    size_t ddv_block_size, int ***line_ar, Ar_stats_t *ar_row_stats,
+    Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables);
+int cloud_screening_pass1(Lut_t *lut, Input_t *input, Input_t *input_b6,
+    atemp_grid_t *atemp_grid, cld_diags_t *cld_diags);
+int compute_atemp_grid(atemp_grid_t *grid, Geoloc_t *space,
+    t_ncep_ancillary *anc, float scene_gmt, int size_l, int size_s);
+void atemp_grid_line(atemp_grid_t *grid, int il, float *atemp_line);
+float atemp_grid_value(atemp_grid_t *grid, int il, int is);
 
 #ifdef SAVE_6S_RESULTS
 #define SIXS_RESULTS_FILENAME "SIXS_RUN_RESULTS.TXT"
@@ -100,7 +139,7 @@ int main (int argc, char *argv[]) {
     int *line_ar_buf = NULL;
     int16** b6_line = NULL;
     int16* b6_line_buf = NULL;
-    float *atemp_line = NULL;
+    atemp_grid_t atemp_grid;    /* air temperature at scene time */
     uint8** qa_line = NULL;
     uint8* qa_line_buf = NULL;
     char **ddv_line = NULL;
@@ -113,7 +152,10 @@ int main (int argc, char *argv[]) {
     bool refl_is_fill;
 
     Sr_stats_t sr_stats;
+    Sr_coef_t sr_coef;
     Ar_stats_t ar_stats;
+    Ar_stats_t *ar_row_stats = NULL;
+    int ar_status, cld_status;
     Ar_gridcell_t ar_gridcell;
     float *prwv_in[NBAND_PRWV_MAX];
     float *prwv_in_buf = NULL;
@@ -144,20 +186,21 @@ int main (int argc, char *argv[]) {
 
     sixs_tables_t sixs_tables;
     float center_lat,center_lon;
-    char tmpfilename[128];
-    FILE *fdtmp/*, *fdtmp2 */;
-    int tmpid;                  /* file ID for temporary file (ID not used) */
+#if defined(DEBUG_AR) || defined(DEBUG_CLD)
+    char diags_filename[128];   /* DEBUG_AR/DEBUG_CLD diagnostics file */
+#endif
+    char *ddv_plane = NULL;     /* dark target flags of the whole scene */
+    size_t ddv_block_size, ddv_plane_size;
   
     short *dem_array;
     int dem_available;
   
     cld_diags_t cld_diags;
 
-    float flat,flon/*,fts,ffs*/;
     double delta_y,delta_x;
     float adjust_north;
   
-    float sum_value,sumsq_value;
+    double sum_value,sumsq_value;
     int no_ozone_file;
     short jday;
 
@@ -300,16 +343,16 @@ int main (int argc, char *argv[]) {
 
     /* Open diagnostics files if needed */
 #ifdef DEBUG_AR
-    strcpy(tmpfilename,param->output_file_name);
-    strcat(tmpfilename,".DEBUG_AR");
-    fd_ar_diags=fopen(tmpfilename,"w");
+    strcpy(diags_filename,param->output_file_name);
+    strcat(diags_filename,".DEBUG_AR");
+    fd_ar_diags=fopen(diags_filename,"w");
     if (fd_ar_diags != NULL) {
         fprintf(fd_ar_diags,"cell_row cell_col total_nb_samples avg_b1 std_b1 avg_b2 std_b2 avg_b3 std_b3 avg_b7 std_b7 szen vzen relaz wv ozone spres fraction_water fraction_clouds fraction_cldshadow fraction_snow spres_ratio tau_ray corrected_T_ray corrected_Sr measured_rho_b1 simulated_b1_01 simulated_b1_02 simulated_b1_03 simulated_b1_04 simulated_b1_05 simulated_b1_06 simulated_b1_07 simulated_b1_08 simulated_b1_09 simulated_b1_10 simulated_b1_11 simulated_b1_12 simulated_b1_13 simulated_b1_14 simulated_b1_15 aot_index coef aot_value new_aot ratio_neg_red\n"); 
     }
 #endif
 #ifdef DEBUG_CLD
-    strcpy(tmpfilename,"tempfile.DEBUG_CLD");
-    fd_cld_diags=fopen(tmpfilename,"w");
+    strcpy(diags_filename,"tempfile.DEBUG_CLD");
+    fd_cld_diags=fopen(diags_filename,"w");
     if (fd_cld_diags != NULL) {
         fprintf(fd_cld_diags,"cell_row cell_col nb_samples airtemp_2m "
             "avg_t6_clear std_t6_clear avg_b7_clear std_b7_clear\n"); 
@@ -365,10 +408,6 @@ int main (int argc, char *argv[]) {
         }
     }
 
-    /* Allocate memory for one air temperature line */
-    atemp_line = calloc(input->size.s,sizeof(float));
-    if (atemp_line == NULL) EXIT_ERROR("allocating atemp line", "main");
-
     /* Allocate memory for ddv line */
     ddv_line = calloc(lut->ar_region_size.l,sizeof(char *));
     if (ddv_line == NULL) EXIT_ERROR("allocating ddv line", "main");
@@ -444,10 +483,12 @@ int main (int argc, char *argv[]) {
     if (line_ar_band_buf == NULL) 
         EXIT_ERROR("allocating aerosol line buffer (b)", "main");
 
-    line_ar_buf = calloc(lut->ar_size.l * lut->ar_size.s * AERO_NB_BANDS, 
-        sizeof(int));
+    line_ar_buf = malloc((size_t)lut->ar_size.l * lut->ar_size.s *
+        AERO_NB_BANDS * sizeof(int));
     if (line_ar_buf == NULL) 
         EXIT_ERROR("allocating aerosol line buffer (c)", "main");
+    first_touch_blocks((char *)line_ar_buf,
+        (size_t)lut->ar_size.s * AERO_NB_BANDS * sizeof(int), lut->ar_size.l);
 
     for (il = 0; il < lut->ar_size.l; il++) {
         line_ar[il] = line_ar_band_buf;
@@ -709,7 +750,8 @@ int main (int argc, char *argv[]) {
         default:
             EXIT_ERROR("Unknown Instrument", "main");
     }
-    create_6S_tables(&sixs_tables, &input->meta);
+    if (create_6S_tables(&sixs_tables, &input->meta) != 0)
+        EXIT_ERROR("running 6S", "main");
 #ifdef SAVE_6S_RESULTS
     write_6S_results_to_file(SIXS_RESULTS_FILENAME,&sixs_tables);
     }
@@ -829,59 +871,25 @@ int main (int argc, char *argv[]) {
         EXIT_ERROR("couldn't allocate memory from cld_diags","main");
     }
 
-    /* Screen the clouds */
-    for (il = 0; il < input->size.l; il++) {
-        if (!(il%100)) 
-        {
-            printf("First pass cloud screening for line %d\r",il);
-            fflush(stdout);
-        }
-
-        /* Read each input band */
-        for (ib = 0; ib < input->nband; ib++) {
-            if (!GetInputLine(input, ib, il, line_in[0][ib]))
-                EXIT_ERROR("reading input data for a line (b)", "main");
-        }
-        if (!GetInputQALine(input, il, qa_line[0]))
-            EXIT_ERROR("reading input data for qa_line (1)", "main");
-        if (param->thermal_band) {
-            if (!GetInputLine(input_b6, 0, il, b6_line[0]))
-                EXIT_ERROR("reading input data for b6_line (1)", "main");
-        }
-
-        tmpint = (int)(scene_gmt / anc_ATEMP.timeres);
-        if (tmpint >= anc_ATEMP.nblayers - 1)
-            tmpint = anc_ATEMP.nblayers - 2;
-        coef = (double)(scene_gmt - anc_ATEMP.time[tmpint]) / anc_ATEMP.timeres;
-
-        img.is_fill = false;
-        img.l = il;
-#ifdef _OPENMP
-        #pragma omp parallel for private (is, geo, flat, flon, tmpflt_arr) firstprivate (img, atemp_line)
-#endif
-        for (is = 0; is < input->size.s; is++) {
-            /* Get the geolocation info for this pixel */
-            img.s = is;
-            if (!from_space (space, &img, &geo))
-                EXIT_ERROR("mapping from space (2)", "main");
-            flat = geo.lat * DEG;
-            flon = geo.lon * DEG;
-
-            /* Interpolate the anciliary data for this lat/long, then pull the
-               information for the scene center time and adjust */
-            interpol_spatial_anc (&anc_ATEMP, flat, flon, tmpflt_arr);
-            atemp_line[is] = (1. - coef) * tmpflt_arr[tmpint] +
-                coef * tmpflt_arr[tmpint+1];
-        }
+    /* Air temperature at scene time for the cloud screening, on a coarse grid
+       interpolated to the pixels */
+    if (param->thermal_band) {
+        if (compute_atemp_grid(&atemp_grid, space, &anc_ATEMP, scene_gmt,
+            input->size.l, input->size.s))
+            EXIT_ERROR("computing air temperature grid", "main");
+    }
 
-        /* Run Cld Screening Pass1 and compute stats. This cloud detection
-           function contains statistics gathering that needs to be in a
-           critical section for multi-threading. */
-        if (param->thermal_band)
-            if (!cloud_detection_pass1 (lut, input->size.s, il, line_in[0],
-                qa_line[0], b6_line[0], atemp_line, &cld_diags))
-                EXIT_ERROR("running cloud detection pass 1", "main");
-    } /* end for il */
+    /* Screen the clouds */
+    if (param->thermal_band) {
+        cld_status = cloud_screening_pass1(lut, input, input_b6, &atemp_grid,
+            &cld_diags);
+        if (cld_status == CLD_ERROR_ALLOC)
+            EXIT_ERROR("allocating cloud screening buffers", "main");
+        else if (cld_status == CLD_ERROR_READ)
+            EXIT_ERROR("reading input data for a line (b)", "main");
+        else if (cld_status == CLD_ERROR_PASS)
+            EXIT_ERROR("running cloud detection pass 1", "main");
+    }
     printf ("\n");
 
     if (param->thermal_band) {
@@ -892,14 +900,7 @@ int main (int argc, char *argv[]) {
                 fflush(stdout);
             }
 
-            tmpint=(int)(scene_gmt / anc_ATEMP.timeres);
-            if (tmpint >= anc_ATEMP.nblayers - 1)
-                tmpint = anc_ATEMP.nblayers - 2;
-            coef =(double)(scene_gmt - anc_ATEMP.time[tmpint]) /
-                anc_ATEMP.timeres;
-
             /* Note the right shift by 1 is a faster way of divide by 2 */
-            img.is_fill = false;
             img.l = il * cld_diags.cellheight + (cld_diags.cellheight >> 1);
             if (img.l >= input->size.l)
                 img.l = input->size.l-1;
@@ -907,18 +908,12 @@ int main (int argc, char *argv[]) {
                 img.s = is * cld_diags.cellwidth + (cld_diags.cellwidth >> 1);
                 if (img.s >= input->size.s)
                     img.s = input->size.s-1;
-                if (!from_space (space, &img, &geo))
-                    EXIT_ERROR("mapping from space (3)", "main");
-                flat=geo.lat * DEG;
-                flon=geo.lon * DEG;
-
-                interpol_spatial_anc(&anc_ATEMP,flat,flon,tmpflt_arr);
-                cld_diags.airtemp_2m[il][is] = (1.-coef)*tmpflt_arr[tmpint] +
-                    coef * tmpflt_arr[tmpint+1];
+                cld_diags.airtemp_2m[il][is] = atemp_grid_value(&atemp_grid,
+                    (int)img.l, (int)img.s);
 
                 if (cld_diags.nb_t6_clear[il][is] > 0) {
-                    sum_value=cld_diags.avg_t6_clear[il][is];
-                    sumsq_value=cld_diags.std_t6_clear[il][is];
+                    sum_value=cld_sum_value(&cld_diags.sum_t6_clear[il][is]);
+                    sumsq_value=cld_sum_value(&cld_diags.sumsq_t6_clear[il][is]);
                     cld_diags.avg_t6_clear[il][is] = sum_value/cld_diags.nb_t6_clear[il][is];
                     if (cld_diags.nb_t6_clear[il][is] > 1) {
                         cld_diags.std_t6_clear[il][is] = (sumsq_value-(sum_value*sum_value)/cld_diags.nb_t6_clear[il][is])/(cld_diags.nb_t6_clear[il][is]-1);
@@ -928,8 +923,8 @@ int main (int argc, char *argv[]) {
                     else 
                         cld_diags.std_t6_clear[il][is] = 0.;
 
-                    sum_value=cld_diags.avg_b7_clear[il][is];
-                    sumsq_value=cld_diags.std_b7_clear[il][is];
+                    sum_value=cld_sum_value(&cld_diags.sum_b7_clear[il][is]);
+                    sumsq_value=cld_sum_value(&cld_diags.sumsq_b7_clear[il][is]);
                     cld_diags.avg_b7_clear[il][is] = sum_value/cld_diags.nb_t6_clear[il][is];
                     if (cld_diags.nb_t6_clear[il][is] > 1) {
                         cld_diags.std_b7_clear[il][is] = (sumsq_value-(sum_value*sum_value)/cld_diags.nb_t6_clear[il][is])/(cld_diags.nb_t6_clear[il][is]-1);
@@ -948,6 +943,7 @@ int main (int argc, char *argv[]) {
         }  /* end for il */
 
         fill_cld_diags(&cld_diags);
+        free(atemp_grid.value);
 #ifdef DEBUG_CLD
         for (il=0;il<cld_diags.nbrows;il++) 
             for (is=0;is<cld_diags.nbcols;is++) 
@@ -959,14 +955,13 @@ int main (int argc, char *argv[]) {
     printf ("\n");
 
 /***
-    Create dark target temporary file
+    Allocate the dark target plane, one block of lines per aerosol region
 ***/
-    strcpy(tmpfilename, "temporary_dark_target_XXXXXX");
-    if ((tmpid = mkstemp (tmpfilename)) < 1)
-      EXIT_ERROR("creating filename for dark target temporary file", "main");
-    close(tmpid);
-    if ((fdtmp=fopen(tmpfilename,"w"))==NULL)
-      EXIT_ERROR("creating dark target temporary file", "main");
+    ddv_block_size = (size_t)lut->ar_region_size.l * input->size.s;
+    ddv_plane_size = (size_t)lut->ar_size.l * ddv_block_size;
+    if ((ddv_plane = allocate_ddv_plane(ddv_block_size, lut->ar_size.l))
+        == NULL)
+      EXIT_ERROR("allocating dark target plane", "main");
 
     /* Read input second time and create cloud and cloud shadow masks */
     ptr_rot_cld[0]=rot_cld[0];
@@ -989,33 +984,58 @@ int main (int argc, char *argv[]) {
         if (il_end >= input->size.l)
             il_end = input->size.l - 1;
 
-        /* Read each input band for each line in region */
+        /* update status from the region loop, since the lines of a region
+           are screened by several threads */
+        printf("Cloud screening pass 2 for line %d\r",il_start);
+        fflush(stdout);
+
+        /* Read each input band for each line in region and run the cloud
+           screening pass 2; the lines only share the cloud diagnostics,
+           which are read only, so they are screened in parallel */
+        cld_status = 0;
+#ifdef _OPENMP
+        #pragma omp parallel for private (il_region, ib) schedule (dynamic)
+#endif
         for (il = il_start; il < (il_end + 1); il++) {
+            bool read_ok = true;
+
             il_region = il - il_start;
-            for (ib = 0; ib < input->nband; ib++) {
-                if (!GetInputLine(input, ib, il, line_in[il_region][ib]))
-                    EXIT_ERROR("reading input data for a line (a)", "main");
+#ifdef _OPENMP
+            #pragma omp critical (lndsr_input)
+#endif
+            {
+                for (ib = 0; ib < input->nband && read_ok; ib++)
+                    read_ok = GetInputLine(input, ib, il,
+                        line_in[il_region][ib]);
+                if (read_ok)
+                    read_ok = GetInputQALine(input, il, qa_line[il_region]);
+                if (read_ok && param->thermal_band)
+                    read_ok = GetInputLine(input_b6, 0, il,
+                        b6_line[il_region]);
             }
-
-            if (!GetInputQALine(input, il, qa_line[il_region]))
-                EXIT_ERROR("reading input data for qa_line (2)", "main");
-            if (param->thermal_band) {
-                if (!GetInputLine(input_b6, 0, il, b6_line[il_region]))
-                    EXIT_ERROR("reading input data for b6_line (2)", "main");
-
-                /* Run Cld Screening Pass2 */
-                if (!cloud_detection_pass2(lut, input->size.s, il,
-                    line_in[il_region], qa_line[il_region], b6_line[il_region],
-                    &cld_diags, ptr_rot_cld[1][il_region]))
-                    EXIT_ERROR("running cloud detection pass 2", "main");
+            if (!read_ok) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                cld_status = CLD_ERROR_READ;
+                continue;
             }
-            else {
-                if (!cloud_detection_pass2(lut, input->size.s, il,
-                    line_in[il_region], qa_line[il_region], NULL, &cld_diags,
-                    ptr_rot_cld[1][il_region]))
-                    EXIT_ERROR("running cloud detection pass 2", "main");
+
+            /* Run Cld Screening Pass2 */
+            if (!cloud_detection_pass2(lut, input->size.s, il,
+                line_in[il_region], qa_line[il_region],
+                param->thermal_band ? b6_line[il_region] : NULL, &cld_diags,
+                ptr_rot_cld[1][il_region])) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                cld_status = CLD_ERROR_PASS;
             }
         }  /* end for il */
+        if (cld_status == CLD_ERROR_READ)
+            EXIT_ERROR("reading input data for a line (a)", "main");
+        else if (cld_status == CLD_ERROR_PASS)
+            EXIT_ERROR("running cloud detection pass 2", "main");
 
         if (param->thermal_band) {
             /* Cloud Mask Dilation : 5 pixels */
@@ -1032,12 +1052,11 @@ int main (int argc, char *argv[]) {
         }
 
         /***
-        Save cloud and cloud shadow in temporary file
+        Save cloud and cloud shadow of the previous region
         ***/
         if (il_ar > 0)
-            if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,
-                fdtmp) != 1)
-                EXIT_ERROR("writing dark target to temporary file", "main");
+            memcpy(&ddv_plane[(il_ar-1)*ddv_block_size], ptr_rot_cld[0][0],
+                ddv_block_size);
 
         ptr_tmp_cld=ptr_rot_cld[0];
         ptr_rot_cld[0]=ptr_rot_cld[1];
@@ -1050,72 +1069,32 @@ int main (int argc, char *argv[]) {
 
     /** Last Block **/
     dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5);
-    if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,fdtmp)
-        != 1)
-        EXIT_ERROR("writing dark target to temporary file", "main");
-
-    fclose(fdtmp);
+    memcpy(&ddv_plane[(il_ar-1)*ddv_block_size], ptr_rot_cld[0][0],
+        ddv_block_size);
+    printf("\n");
 
     /* Done with the cloud diagnostics */
     free_cld_diags (&cld_diags);
 
-    /***
-    Open temporary file for read and write
-    ***/
-    if ((fdtmp=fopen(tmpfilename,"r+"))==NULL)
-        EXIT_ERROR("opening dark target temporary file (r+)", "main");
-
     /* Read input second time and compute the aerosol for each region */
-    for (il_start = 0, il_ar = 0; il_start < input->size.l; 
-         il_start += lut->ar_region_size.l, il_ar++) {
-        ar_gridcell.line_lat=&(ar_gridcell.lat[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_lon=&(ar_gridcell.lon[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_sun_zen=&(ar_gridcell.sun_zen[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_view_zen=&(ar_gridcell.view_zen[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_rel_az=&(ar_gridcell.rel_az[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_wv=&(ar_gridcell.wv[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_spres=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_ozone=&(ar_gridcell.ozone[il_ar*lut->ar_size.s]);
-        ar_gridcell.line_spres_dem=&(ar_gridcell.spres[il_ar*lut->ar_size.s]);
-    
-        il_end = il_start + lut->ar_region_size.l - 1;
-        if (il_end >= input->size.l)
-            il_end = input->size.l - 1;
-     
-        if (fseek(fdtmp,(long)(il_ar*lut->ar_region_size.l*input->size.s),
-            SEEK_SET))
-            EXIT_ERROR("seeking in temporary file (r)", "main");
-        if (fread(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1)
-            EXIT_ERROR("reading dark target to temporary file", "main");
-
-        /* Read each input band for each line in region */
-        for (il = il_start, il_region = 0; il < (il_end + 1);
-             il++, il_region++) {
-            for (ib = 0; ib < input->nband; ib++) {
-                if (!GetInputLine(input, ib, il, line_in[il_region][ib]))
-                    EXIT_ERROR("reading input data for a line (a)", "main");
-            }
-        }  /* end for il */
-
-        /* Compute the aerosol for the regions */
-#ifdef DEBUG_AR
-        diags_il_ar=il_ar;
-#endif
-        if (!Ar(il_ar,lut, &input->size, line_in, ddv_line, line_ar[il_ar],
-            &ar_stats, &ar_gridcell, &sixs_tables))
-            EXIT_ERROR("computing aerosol", "main");
-
-        /***
-        Save dark target map in temporary file
-        ***/
-        if (fseek(fdtmp,il_ar*lut->ar_region_size.l*input->size.s,SEEK_SET))
-            EXIT_ERROR("seeking in temporary file (w)", "main");
-        if (fwrite(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1)
-            EXIT_ERROR("writing dark target to temporary file", "main");
-    }  /* end for il_start */
+    ar_row_stats = calloc(lut->ar_size.l, sizeof(Ar_stats_t));
+    if (ar_row_stats == NULL)
+        EXIT_ERROR("allocating aerosol statistics", "main");
+    ar_status = compute_aerosol(lut, input, ddv_plane, ddv_block_size, line_ar,
+        ar_row_stats, &ar_gridcell, &sixs_tables);
+    if (ar_status == AR_ERROR_ALLOC)
+        EXIT_ERROR("allocating aerosol buffers", "main");
+    else if (ar_status == AR_ERROR_READ)
+        EXIT_ERROR("reading input data for a line (a)", "main");
+    else if (ar_status == AR_ERROR_AR)
+        EXIT_ERROR("computing aerosol", "main");
+
+    /* Statistics added in row order, whatever the number of threads */
+    for (il_ar = 0; il_ar < lut->ar_size.l; il_ar++)
+        ArAddStats(&ar_stats, &ar_row_stats[il_ar]);
+    free(ar_row_stats);
 
     printf("\n");
-    fclose(fdtmp);
 #ifdef DEBUG_AR
     fclose(fd_ar_diags);
 #endif
@@ -1137,14 +1116,10 @@ int main (int argc, char *argv[]) {
     update_atmos_coefs(&atmos_coef,&ar_gridcell, &sixs_tables,line_ar, lut,
         input->nband, 0); /*Eric COMMENTED TO PERFORM NO CORRECTION*/
 #endif
+    if (!SrInit(lut, input->size.s, &atmos_coef, &sr_coef))
+        EXIT_ERROR("setting up the surface reflectance coefficients", "main");
 
     /* Re-read input and compute surface reflectance */
-    /***
-    Open temporary file for read
-    ***/
-    if ((fdtmp=fopen(tmpfilename,"r"))==NULL)
-        EXIT_ERROR("opening dark target temporary file", "main");
-
     for (il = 0; il < input->size.l; il++) {
         if (!(il%100)) 
         {
@@ -1162,14 +1137,15 @@ int main (int argc, char *argv[]) {
             EXIT_ERROR("reading input data for b6_line (1)", "main");
 
         /* Compute the surface reflectance */
-        if (!Sr(lut, input->size.s, il, line_in[0], line_out, &sr_stats))
+        if (!Sr(lut, &sr_coef, input->size.s, il, line_in[0], line_out,
+            &sr_stats))
             EXIT_ERROR("computing surface reflectance for a line", "main");
 
         /***
-        Read line from dark target temporary file
+        Get line from dark target plane
         ***/
-        if (fread(ddv_line[0],input->size.s,1,fdtmp)!=1)
-            EXIT_ERROR("reading line from dark target temporary file", "main");
+        memcpy(ddv_line[0], &ddv_plane[(size_t)il*input->size.s],
+            input->size.s);
 
         loc.l=il;
         i_aot=il/lut->ar_region_size.l;
@@ -1235,8 +1211,8 @@ int main (int argc, char *argv[]) {
         }
     }  /* for il */
     printf("\n");
-    fclose(fdtmp);
-    unlink(tmpfilename); 
+    munmap(ddv_plane, ddv_plane_size);
+    SrFree(&sr_coef);
     
     /* Print the statistics, skip bands that don't exist */
     printf(" total pixels %ld\n", ((long)input->size.l * (long)input->size.s));
@@ -1395,6 +1371,406 @@ int free_mem_atmos_coeff(atmos_t *atmos_coef)
     return 0;
 }
 
+/* Zero a full-scene plane of nblocks blocks, one per row of aerosol regions,
+   from the threads and on the same schedule as compute_aerosol, which works
+   on the rows in parallel.  The pages of each block are then first touched
+   by one of the processing threads rather than all by the main thread, so
+   with bound threads the plane is spread over the memory of their nodes. */
+void first_touch_blocks(char *plane, size_t block_size, int nblocks)
+{
+    int iblock;
+
+#ifdef _OPENMP
+    #pragma omp parallel for schedule (dynamic)
+#endif
+    for (iblock = 0; iblock < nblocks; iblock++)
+        memset(&plane[(size_t)iblock * block_size], 0, block_size);
+}
+
+/* Allocate the dark target plane (cloud, cloud shadow, water, snow and DDV
+   flags, bit-packed in one byte per pixel, see clouds.c), of nblocks blocks
+   of block_size bytes, zeroed.  It is kept in anonymous memory, first
+   touched block by block, unless it is larger than the LEDAPS_DDV_MEM_MAX
+   budget (in MB), in which case it is mapped from a temporary file in the
+   working directory.  Returns NULL on error; free with munmap. */
+char *allocate_ddv_plane(size_t block_size, int nblocks)
+{
+    char *env, tmpfilename[] = "temporary_dark_target_XXXXXX";
+    long mem_max;
+    int fd;
+    size_t size = block_size * nblocks;
+    void *plane;
+
+    env = getenv(DDV_MEM_MAX_ENV);
+    mem_max = (env != NULL) ? atol(env) : DDV_MEM_MAX_DEFAULT;
+    if (size <= (size_t)mem_max * 1024 * 1024) {
+        plane = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (plane != MAP_FAILED) {
+            first_touch_blocks((char *)plane, block_size, nblocks);
+            return (char *)plane;
+        }
+        printf("WARNING: can't allocate the dark target plane in memory, "
+            "using a temporary file\n");
+    }
+
+    if ((fd = mkstemp(tmpfilename)) < 0)
+        return NULL;
+    unlink(tmpfilename);  /* the file goes away once unmapped */
+    if (ftruncate(fd, (off_t)size)) {
+        close(fd);
+        return NULL;
+    }
+    plane = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return (plane != MAP_FAILED) ? (char *)plane : NULL;
+}
+
+/* Compute the aerosol for each row of regions.  The rows are independent:
+   each one reads its own input lines, updates its own block of the dark
+   target plane in place and its own statistics (ar_row_stats), so they are
+   processed in parallel, each thread with its own buffers.  Returns 0, or
+   an AR_ERROR_* code on error. */
+int compute_aerosol(Lut_t *lut, Input_t *input, char *ddv_plane,
+    size_t ddv_block_size, int ***line_ar, Ar_stats_t *ar_row_stats,
+    Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables)
+{
+    int status = 0;
+    int il_ar, il_start, il_end, il, il_region, ib;
+
+#ifdef _OPENMP
+    #pragma omp parallel private (il_ar, il_start, il_end, il, il_region, ib)
+#endif
+    {
+        int16 ***line_in = NULL;
+        int16 **line_in_band_buf = NULL;
+        int16 *line_in_buf = NULL;
+        char **ddv_line = NULL;
+        Ar_scratch_t scratch;
+        bool alloc_ok, read_ok;
+
+        /* Input lines and scratch buffers of the thread */
+        line_in = calloc(lut->ar_region_size.l, sizeof(int16 **));
+        line_in_band_buf = calloc(lut->ar_region_size.l * input->nband,
+            sizeof(int16 *));
+        line_in_buf = calloc((size_t)input->size.s * lut->ar_region_size.l *
+            input->nband, sizeof(int16));
+        ddv_line = calloc(lut->ar_region_size.l, sizeof(char *));
+        alloc_ok = ArAllocScratch(lut, ar_gridcell, &scratch);
+        if (line_in == NULL || line_in_band_buf == NULL ||
+            line_in_buf == NULL || ddv_line == NULL || !alloc_ok) {
+            alloc_ok = false;
+#ifdef _OPENMP
+            #pragma omp atomic write
+#endif
+            status = AR_ERROR_ALLOC;
+        }
+        else {
+            for (il = 0; il < lut->ar_region_size.l; il++) {
+                line_in[il] = &line_in_band_buf[il * input->nband];
+                for (ib = 0; ib < input->nband; ib++)
+                    line_in[il][ib] = &line_in_buf[((size_t)il * input->nband +
+                        ib) * input->size.s];
+            }
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule (dynamic)
+#endif
+        for (il_ar = 0; il_ar < lut->ar_size.l; il_ar++) {
+            if (!alloc_ok)
+                continue;
+            il_start = il_ar * lut->ar_region_size.l;
+            il_end = il_start + lut->ar_region_size.l - 1;
+            if (il_end >= input->size.l)
+                il_end = input->size.l - 1;
+
+            /* Read each input band for each line in region.  The lines of
+               the last region past the end of the image are the ones of the
+               previous region, as when the regions were processed in turn
+               with a single input buffer. */
+            read_ok = true;
+#ifdef _OPENMP
+            #pragma omp critical (lndsr_input)
+#endif
+            for (il_region = 0; il_region < lut->ar_region_size.l && read_ok;
+                 il_region++) {
+                il = il_start + il_region;
+                if (il > il_end)
+                    il -= lut->ar_region_size.l;
+                for (ib = 0; ib < input->nband && read_ok; ib++) {
+                    if (il < 0)
+                        memset(line_in[il_region][ib], 0,
+                            input->size.s * sizeof(int16));
+                    else if (!GetInputLine(input, ib, il,
+                        line_in[il_region][ib]))
+                        read_ok = false;
+                }
+            }
+            if (!read_ok) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                status = AR_ERROR_READ;
+                continue;
+            }
+
+            /* The dark target map of the region is updated in place */
+            for (il_region = 0; il_region < lut->ar_region_size.l; il_region++)
+                ddv_line[il_region] = &ddv_plane[il_ar * ddv_block_size +
+                    (size_t)il_region * input->size.s];
+
+            /* Compute the aerosol for the regions */
+#ifdef DEBUG_AR
+            diags_il_ar=il_ar;
+#endif
+            ar_row_stats[il_ar].first = true;
+            if (!Ar(il_ar, lut, &input->size, line_in, ddv_line,
+                line_ar[il_ar], &ar_row_stats[il_ar], ar_gridcell,
+                sixs_tables, &scratch)) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                status = AR_ERROR_AR;
+            }
+        }  /* end for il_ar */
+
+        ArFreeScratch(&scratch);
+        free(ddv_line);
+        free(line_in_buf);
+        free(line_in_band_buf);
+        free(line_in);
+    }  /* end omp parallel */
+
+    return status;
+}
+
+/* First pass of the cloud screening: clear sky statistics of the cloud
+   diagnostics cells.  The sums of a cell are only updated by the lines of
+   its row of cells, so the rows of cells are processed in parallel, each
+   by one thread, line after line: the sums are added in the same order
+   whatever the number of threads.  Returns 0, or a CLD_ERROR_* code on
+   error. */
+int cloud_screening_pass1(Lut_t *lut, Input_t *input, Input_t *input_b6,
+    atemp_grid_t *atemp_grid, cld_diags_t *cld_diags)
+{
+    int status = 0;
+    int cld_row, il, il_end, ib;
+
+#ifdef _OPENMP
+    #pragma omp parallel private (cld_row, il, il_end, ib)
+#endif
+    {
+        int16 *line_in[NBAND_REFL_MAX];
+        int16 *line_in_buf = NULL;
+        uint8 *qa_line = NULL;
+        int16 *b6_line = NULL;
+        float *atemp_line = NULL;
+        bool alloc_ok, ok;
+
+        /* Input line buffers of the thread */
+        line_in_buf = calloc((size_t)input->size.s * input->nband,
+            sizeof(int16));
+        qa_line = calloc(input->size.s, sizeof(uint8));
+        b6_line = calloc(input_b6->size.s, sizeof(int16));
+        atemp_line = calloc(input->size.s, sizeof(float));
+        alloc_ok = (line_in_buf != NULL && qa_line != NULL &&
+            b6_line != NULL && atemp_line != NULL);
+        if (!alloc_ok) {
+#ifdef _OPENMP
+            #pragma omp atomic write
+#endif
+            status = CLD_ERROR_ALLOC;
+        }
+        else {
+            for (ib = 0; ib < input->nband; ib++)
+                line_in[ib] = &line_in_buf[(size_t)ib * input->size.s];
+        }
+
+#ifdef _OPENMP
+        #pragma omp for schedule (dynamic)
+#endif
+        for (cld_row = 0; cld_row < cld_diags->nbrows; cld_row++) {
+            if (!alloc_ok)
+                continue;
+            il_end = (cld_row + 1) * cld_diags->cellheight;
+            if (il_end > input->size.l)
+                il_end = input->size.l;
+            for (il = cld_row * cld_diags->cellheight; il < il_end; il++) {
+#ifndef _OPENMP
+                /* update status, but not if multi-threaded */
+                if (!(il%100)) 
+                {
+                    printf("First pass cloud screening for line %d\r",il);
+                    fflush(stdout);
+                }
+#endif
+
+                /* Read each input band */
+                ok = true;
+#ifdef _OPENMP
+                #pragma omp critical (lndsr_input)
+#endif
+                {
+                    for (ib = 0; ib < input->nband && ok; ib++)
+                        ok = GetInputLine(input, ib, il, line_in[ib]);
+                    if (ok)
+                        ok = GetInputQALine(input, il, qa_line);
+                    if (ok)
+                        ok = GetInputLine(input_b6, 0, il, b6_line);
+                }
+                if (!ok) {
+#ifdef _OPENMP
+                    #pragma omp atomic write
+#endif
+                    status = CLD_ERROR_READ;
+                    break;
+                }
+
+                /* Run Cld Screening Pass1 and compute stats */
+                atemp_grid_line(atemp_grid, il, atemp_line);
+                if (!cloud_detection_pass1 (lut, input->size.s, il, line_in,
+                    qa_line, b6_line, atemp_line, cld_diags)) {
+#ifdef _OPENMP
+                    #pragma omp atomic write
+#endif
+                    status = CLD_ERROR_PASS;
+                    break;
+                }
+            }  /* end for il */
+        }  /* end for cld_row */
+
+        free(atemp_line);
+        free(b6_line);
+        free(qa_line);
+        free(line_in_buf);
+    }  /* end omp parallel */
+
+    return status;
+}
+
+/* Position of a node of the air temperature grid along one direction */
+static int atemp_grid_pos(int k, int step, int size)
+{
+    return (k * step < size - 1) ? k * step : size - 1;
+}
+
+/* Locate a line or sample between two nodes of the air temperature grid */
+static void atemp_grid_locate(int i, int step, int n, int size, int *k,
+    float *w)
+{
+    int p0, p1;
+
+    *k = i / step;
+    if (*k > n - 2)
+        *k = (n > 1) ? n - 2 : 0;
+    *w = 0.;
+    if (n > 1) {
+        p0 = atemp_grid_pos(*k, step, size);
+        p1 = atemp_grid_pos(*k + 1, step, size);
+        *w = (float)(i - p0) / (p1 - p0);
+    }
+}
+
+/* Compute the air temperature grid from the NCEP data, interpolated at the
+   scene time.  The grid lines are first touched by the threads which compute
+   them.  Returns -1 if the grid can't be allocated or a node can't be
+   geolocated. */
+int compute_atemp_grid(atemp_grid_t *grid, Geoloc_t *space,
+    t_ncep_ancillary *anc, float scene_gmt, int size_l, int size_s)
+{
+    int tmpint, il, is;
+    double coef;
+    int status = 0;
+
+    grid->step = ATEMP_GRID_STEP;
+    grid->size_l = size_l;
+    grid->size_s = size_s;
+    grid->nl = (size_l - 1 + grid->step - 1) / grid->step + 1;
+    grid->ns = (size_s - 1 + grid->step - 1) / grid->step + 1;
+    grid->value = malloc((size_t)grid->nl * grid->ns * sizeof(float));
+    if (grid->value == NULL)
+        return -1;
+
+    tmpint = (int)(scene_gmt / anc->timeres);
+    if (tmpint >= anc->nblayers - 1)
+        tmpint = anc->nblayers - 2;
+    coef = (double)(scene_gmt - anc->time[tmpint]) / anc->timeres;
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (is)
+#endif
+    for (il = 0; il < grid->nl; il++) {
+        Img_coord_float_t img;
+        Geo_coord_t geo;
+        float tmpflt_arr[4];
+
+        img.is_fill = false;
+        img.l = atemp_grid_pos(il, grid->step, size_l);
+        for (is = 0; is < grid->ns; is++) {
+            img.s = atemp_grid_pos(is, grid->step, size_s);
+            if (!from_space (space, &img, &geo)) {
+#ifdef _OPENMP
+                #pragma omp atomic write
+#endif
+                status = -1;
+                continue;
+            }
+            interpol_spatial_anc (anc, geo.lat * DEG, geo.lon * DEG,
+                tmpflt_arr);
+            grid->value[il * grid->ns + is] = (1. - coef) * tmpflt_arr[tmpint]
+                + coef * tmpflt_arr[tmpint+1];
+        }
+    }
+    if (status) {
+        free(grid->value);
+        grid->value = NULL;
+    }
+    return status;
+}
+
+/* Interpolate the air temperature grid (bilinear) along a line */
+void atemp_grid_line(atemp_grid_t *grid, int il, float *atemp_line)
+{
+    int kl, ks, is, s0, s1;
+    float wl, *v0, *v1, a0, a1;
+
+    atemp_grid_locate(il, grid->step, grid->nl, grid->size_l, &kl, &wl);
+    v0 = &grid->value[kl * grid->ns];
+    v1 = (grid->nl > 1) ? &grid->value[(kl + 1) * grid->ns] : v0;
+    for (ks = 0; ks < grid->ns; ks++) {
+        s0 = atemp_grid_pos(ks, grid->step, grid->size_s);
+        s1 = (ks + 1 < grid->ns) ? atemp_grid_pos(ks + 1, grid->step,
+            grid->size_s) : grid->size_s;
+        a0 = (1. - wl) * v0[ks] + wl * v1[ks];
+        if (ks + 1 < grid->ns) {
+            a1 = (1. - wl) * v0[ks+1] + wl * v1[ks+1];
+            for (is = s0; is < s1; is++)
+                atemp_line[is] = a0 + (a1 - a0) * (is - s0) / (s1 - s0);
+        }
+        else {
+            for (is = s0; is < s1; is++)
+                atemp_line[is] = a0;
+        }
+    }
+}
+
+/* Interpolate the air temperature grid (bilinear) at one pixel */
+float atemp_grid_value(atemp_grid_t *grid, int il, int is)
+{
+    int kl, ks, kl1, ks1;
+    float wl, ws;
+
+    atemp_grid_locate(il, grid->step, grid->nl, grid->size_l, &kl, &wl);
+    atemp_grid_locate(is, grid->step, grid->ns, grid->size_s, &ks, &ws);
+    kl1 = (grid->nl > 1) ? kl + 1 : kl;
+    ks1 = (grid->ns > 1) ? ks + 1 : ks;
+    return (1. - wl) * ((1. - ws) * grid->value[kl * grid->ns + ks] +
+        ws * grid->value[kl * grid->ns + ks1]) +
+        wl * ((1. - ws) * grid->value[kl1 * grid->ns + ks] +
+        ws * grid->value[kl1 * grid->ns + ks1]);
+}
+
 /******************************************************************************
 !C
 !Routine: calcuoz
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include "sixs_cache.h"
+
+/* The cache is content-addressed: the 6S inputs are written out at the
+   precision used in the 6S input cards (see sixs_runs.c), so two scenes
+   with the same key get exactly the same 6S results.  The key is hashed to
+   name the cache file, and is stored at the top of the file to guard
+   against hash collisions.  Files are written under a temporary name and
+   renamed, so concurrent lndsr processes only ever see complete tables. */
+
+#define SIXS_CACHE_PREFIX "sixs_"
+#define SIXS_CACHE_SUFFIX ".tab"
+#define SIXS_CACHE_KEY_SIZE 1024
+
+typedef struct {
+	char name[256];
+	time_t mtime;
+} sixs_cache_entry_t;
+
+/* Build the cache key of the 6S tables inputs */
+static void sixs_cache_key(sixs_tables_t *sixs_tables, const char *kind,
+		char *key) {
+	int j,n;
+
+	n=sprintf(key,"v%d %s %d %d %d %.2f %.2f %.2f %.2f %.2f %.3f %f",
+		SIXS_CACHE_VERSION,kind,(int)sixs_tables->Inst,sixs_tables->month,
+		sixs_tables->day,sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,
+		sixs_tables->uwv,sixs_tables->uoz,sixs_tables->srefl,
+		sixs_tables->target_alt);
+	for (j=0;j<SIXS_NB_AOT;j++)
+		n+=sprintf(&key[n]," %.3f",sixs_tables->aot[j]);
+	n+=sprintf(&key[n]," %d",(int)sizeof(sixs_tables_t));
+	/* results of the 6S fast mode are kept apart */
+	if (sixs_fast_mode())
+		sprintf(&key[n]," fast");
+}
+
+/* Get the cache file name of a key (64-bit FNV-1a hash of the key); returns
+   false if the cache is not enabled */
+static bool sixs_cache_file(const char *key, char *filename) {
+	char *dir;
+	unsigned long long hash=0xcbf29ce484222325ULL;
+	const char *c;
+
+	dir=getenv(SIXS_CACHE_DIR_ENV);
+	if (dir==NULL || dir[0]=='\0')
+		return false;
+	for (c=key;*c;c++) {
+		hash^=(unsigned char)*c;
+		hash*=0x100000001b3ULL;
+	}
+	sprintf(filename,"%s/%s%016llx%s",dir,SIXS_CACHE_PREFIX,hash,
+		SIXS_CACHE_SUFFIX);
+	return true;
+}
+
+static int sixs_cache_cmp(const void *a, const void *b) {
+	time_t ta=((const sixs_cache_entry_t *)a)->mtime;
+	time_t tb=((const sixs_cache_entry_t *)b)->mtime;
+	return (ta<tb) ? -1 : (ta>tb);
+}
+
+/* Remove the least recently used tables above the cache size limit */
+static void sixs_cache_evict(void) {
+	char *dir,*env,path[1024];
+	DIR *dp;
+	struct dirent *de;
+	struct stat st;
+	sixs_cache_entry_t *entry=NULL,*tmp;
+	int nentry=0,maxentry=0,max_tables,i,lp,ls;
+
+	dir=getenv(SIXS_CACHE_DIR_ENV);
+	env=getenv(SIXS_CACHE_MAX_ENV);
+	max_tables=(env!=NULL) ? atoi(env) : SIXS_CACHE_MAX_DEFAULT;
+	if (max_tables<=0 || (dp=opendir(dir))==NULL)
+		return;
+
+	lp=strlen(SIXS_CACHE_PREFIX);
+	ls=strlen(SIXS_CACHE_SUFFIX);
+	while ((de=readdir(dp))!=NULL) {
+		i=strlen(de->d_name);
+		if (i<lp+ls || i>=(int)sizeof(entry->name) ||
+			strncmp(de->d_name,SIXS_CACHE_PREFIX,lp) ||
+			strcmp(&de->d_name[i-ls],SIXS_CACHE_SUFFIX))
+			continue;
+		sprintf(path,"%s/%s",dir,de->d_name);
+		if (stat(path,&st))
+			continue;
+		if (nentry==maxentry) {
+			maxentry=maxentry ? 2*maxentry : 256;
+			if ((tmp=realloc(entry,maxentry*sizeof(*entry)))==NULL)
+				break;
+			entry=tmp;
+		}
+		strcpy(entry[nentry].name,de->d_name);
+		entry[nentry].mtime=st.st_mtime;
+		nentry++;
+	}
+	closedir(dp);
+
+	if (nentry>max_tables) {
+		qsort(entry,nentry,sizeof(*entry),sixs_cache_cmp);
+		for (i=0;i<nentry-max_tables;i++) {
+			sprintf(path,"%s/%s",dir,entry[i].name);
+			unlink(path);	/* may already be gone (other process) */
+		}
+	}
+	free(entry);
+}
+
+/* Fill the 6S tables from the cache; returns true on a cache hit */
+bool sixs_cache_read(sixs_tables_t *sixs_tables, const char *kind) {
+	char key[SIXS_CACHE_KEY_SIZE],line[SIXS_CACHE_KEY_SIZE],filename[1024];
+	sixs_tables_t cached;
+	FILE *fd;
+	bool hit;
+
+	sixs_cache_key(sixs_tables,kind,key);
+	if (!sixs_cache_file(key,filename))
+		return false;
+	if ((fd=fopen(filename,"rb"))==NULL)
+		return false;
+	hit=(fgets(line,SIXS_CACHE_KEY_SIZE,fd)!=NULL &&
+		!strncmp(line,key,strlen(key)) && line[strlen(key)]=='\n' &&
+		fread(&cached,sizeof(cached),1,fd)==1 && fgetc(fd)==EOF);
+	fclose(fd);
+	if (!hit)
+		return false;
+
+	/* Keep the inputs as given, only take the 6S results */
+	cached.Inst=sixs_tables->Inst;
+	cached.month=sixs_tables->month;
+	cached.day=sixs_tables->day;
+	cached.sza=sixs_tables->sza;
+	cached.vza=sixs_tables->vza;
+	cached.phi=sixs_tables->phi;
+	cached.uwv=sixs_tables->uwv;
+	cached.uoz=sixs_tables->uoz;
+	cached.srefl=sixs_tables->srefl;
+	cached.target_alt=sixs_tables->target_alt;
+	memcpy(cached.aot,sixs_tables->aot,sizeof(cached.aot));
+	*sixs_tables=cached;
+
+	utime(filename,NULL);	/* mark as recently used */
+	printf("6S tables read from cache %s\n",filename);
+	return true;
+}
+
+/* Store the 6S tables in the cache; failures only disable the caching */
+void sixs_cache_write(sixs_tables_t *sixs_tables, const char *kind) {
+	char key[SIXS_CACHE_KEY_SIZE],filename[1024],tmp_filename[1100];
+	FILE *fd;
+	bool ok;
+
+	sixs_cache_key(sixs_tables,kind,key);
+	if (!sixs_cache_file(key,filename))
+		return;
+	sprintf(tmp_filename,"%s.%ld.tmp",filename,(long)getpid());
+	if ((fd=fopen(tmp_filename,"wb"))==NULL) {
+		printf("WARNING: can't create 6S cache file %s\n",tmp_filename);
+		return;
+	}
+	ok=(fprintf(fd,"%s\n",key)>0 &&
+		fwrite(sixs_tables,sizeof(*sixs_tables),1,fd)==1 &&
+		fflush(fd)==0 && fsync(fileno(fd))==0);
+	if (fclose(fd) || !ok || rename(tmp_filename,filename)) {
+		printf("WARNING: can't write 6S cache file %s\n",filename);
+		unlink(tmp_filename);
+		return;
+	}
+	sixs_cache_evict();
+}
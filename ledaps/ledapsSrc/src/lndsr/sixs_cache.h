@@ -0,0 +1,21 @@
+#ifndef SIXS_CACHE_H
+#define SIXS_CACHE_H
+#include "bool.h"
+#include "sixs_runs.h"
+
+/* The 6S tables are cached in the directory given by LEDAPS_6S_CACHE_DIR
+   (no caching if it isn't defined).  At most LEDAPS_6S_CACHE_MAX tables
+   are kept, the least recently used ones being removed first. */
+#define SIXS_CACHE_DIR_ENV "LEDAPS_6S_CACHE_DIR"
+#define SIXS_CACHE_MAX_ENV "LEDAPS_6S_CACHE_MAX"
+#define SIXS_CACHE_MAX_DEFAULT 1000
+#define SIXS_CACHE_VERSION 1
+
+/* Kind of surface the tables were computed for */
+#define SIXS_CACHE_LAND "land"
+#define SIXS_CACHE_WATER "water"
+
+bool sixs_cache_read(sixs_tables_t *sixs_tables, const char *kind);
+void sixs_cache_write(sixs_tables_t *sixs_tables, const char *kind);
+
+#endif
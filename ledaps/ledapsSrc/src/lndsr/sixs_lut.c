@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sixs_lut.h"
+
+/* LUT file layout (native byte order):
+     SIXS_LUT_MAGIC (8 chars), version, instrument, month, day (int)
+     vza, srefl, target_alt, aot[SIXS_NB_AOT] (float)
+     nnodes[SIXS_LUT_NDIM] (int), then the nodes of each dimension (float)
+     one record of SIXS_LUT_NB_VALUES floats per grid point, sza varying
+     slowest and uoz fastest (see sixs_lut_pack for the record layout)
+   At run time only the 2^SIXS_LUT_NDIM records around the scene are read. */
+
+#define SIXS_LUT_TOL 1e-4
+
+const char *sixs_lut_inst_name(Sixs_Inst_t inst) {
+	switch (inst) {
+		case SIXS_INST_TM: return "tm";
+		case SIXS_INST_ETM: return "etm";
+		default: return "unknown";
+	}
+}
+
+/* Copy the 6S results of the tables in a LUT record */
+void sixs_lut_pack(sixs_tables_t *sixs_tables, float *values) {
+	int i,j,k=0;
+
+	for (i=0;i<SIXS_NB_BANDS;i++) {
+		values[k++]=sixs_tables->S_r[i];
+		values[k++]=sixs_tables->T_r_up[i];
+		values[k++]=sixs_tables->T_r_down[i];
+		values[k++]=sixs_tables->T_r[i];
+		values[k++]=sixs_tables->T_g_wv[i];
+		values[k++]=sixs_tables->T_g_og[i];
+		values[k++]=sixs_tables->rho_r[i];
+		for (j=0;j<SIXS_NB_AOT;j++) {
+			values[k++]=sixs_tables->aot_wavelength[i][j];
+			values[k++]=sixs_tables->T_a_up[i][j];
+			values[k++]=sixs_tables->T_a_down[i][j];
+			values[k++]=sixs_tables->T_a[i][j];
+			values[k++]=sixs_tables->rho_ra[i][j];
+			values[k++]=sixs_tables->rho_a[i][j];
+			values[k++]=sixs_tables->S_ra[i][j];
+			values[k++]=sixs_tables->T_ra_up[i][j];
+			values[k++]=sixs_tables->T_ra_down[i][j];
+			values[k++]=sixs_tables->T_ra[i][j];
+			values[k++]=sixs_tables->rho_toa[i][j];
+		}
+	}
+}
+
+/* Copy a LUT record in the 6S results of the tables */
+void sixs_lut_unpack(float *values, sixs_tables_t *sixs_tables) {
+	int i,j,k=0;
+
+	for (i=0;i<SIXS_NB_BANDS;i++) {
+		sixs_tables->S_r[i]=values[k++];
+		sixs_tables->T_r_up[i]=values[k++];
+		sixs_tables->T_r_down[i]=values[k++];
+		sixs_tables->T_r[i]=values[k++];
+		sixs_tables->T_g_wv[i]=values[k++];
+		sixs_tables->T_g_og[i]=values[k++];
+		sixs_tables->rho_r[i]=values[k++];
+		for (j=0;j<SIXS_NB_AOT;j++) {
+			sixs_tables->aot_wavelength[i][j]=values[k++];
+			sixs_tables->T_a_up[i][j]=values[k++];
+			sixs_tables->T_a_down[i][j]=values[k++];
+			sixs_tables->T_a[i][j]=values[k++];
+			sixs_tables->rho_ra[i][j]=values[k++];
+			sixs_tables->rho_a[i][j]=values[k++];
+			sixs_tables->S_ra[i][j]=values[k++];
+			sixs_tables->T_ra_up[i][j]=values[k++];
+			sixs_tables->T_ra_down[i][j]=values[k++];
+			sixs_tables->T_ra[i][j]=values[k++];
+			sixs_tables->rho_toa[i][j]=values[k++];
+		}
+	}
+}
+
+int sixs_lut_write_header(FILE *fd, sixs_lut_header_t *header) {
+	int ival[4],d;
+	float fval[3];
+
+	ival[0]=SIXS_LUT_VERSION;
+	ival[1]=(int)header->Inst;
+	ival[2]=header->month;
+	ival[3]=header->day;
+	fval[0]=header->vza;
+	fval[1]=header->srefl;
+	fval[2]=header->target_alt;
+	if (fwrite(SIXS_LUT_MAGIC,1,8,fd)!=8 || fwrite(ival,sizeof(int),4,fd)!=4 ||
+		fwrite(fval,sizeof(float),3,fd)!=3 ||
+		fwrite(header->aot,sizeof(float),SIXS_NB_AOT,fd)!=SIXS_NB_AOT ||
+		fwrite(header->nnodes,sizeof(int),SIXS_LUT_NDIM,fd)!=SIXS_LUT_NDIM)
+		return -1;
+	for (d=0;d<SIXS_LUT_NDIM;d++)
+		if (fwrite(header->nodes[d],sizeof(float),header->nnodes[d],fd)!=
+			(size_t)header->nnodes[d])
+			return -1;
+	return 0;
+}
+
+int sixs_lut_read_header(FILE *fd, sixs_lut_header_t *header) {
+	char magic[8];
+	int ival[4],d;
+	float fval[3];
+
+	if (fread(magic,1,8,fd)!=8 || memcmp(magic,SIXS_LUT_MAGIC,8) ||
+		fread(ival,sizeof(int),4,fd)!=4 || ival[0]!=SIXS_LUT_VERSION ||
+		fread(fval,sizeof(float),3,fd)!=3 ||
+		fread(header->aot,sizeof(float),SIXS_NB_AOT,fd)!=SIXS_NB_AOT ||
+		fread(header->nnodes,sizeof(int),SIXS_LUT_NDIM,fd)!=SIXS_LUT_NDIM)
+		return -1;
+	header->Inst=(Sixs_Inst_t)ival[1];
+	header->month=ival[2];
+	header->day=ival[3];
+	header->vza=fval[0];
+	header->srefl=fval[1];
+	header->target_alt=fval[2];
+	for (d=0;d<SIXS_LUT_NDIM;d++) {
+		if (header->nnodes[d]<1 || header->nnodes[d]>SIXS_LUT_MAX_NODES ||
+			fread(header->nodes[d],sizeof(float),header->nnodes[d],fd)!=
+			(size_t)header->nnodes[d])
+			return -1;
+	}
+	return 0;
+}
+
+/* Find the grid cell of x along one LUT dimension; returns false if x is
+   outside of the grid */
+static bool sixs_lut_locate(float *nodes, int nnodes, float x, int *k,
+		float *w) {
+	int i;
+
+	*k=0;
+	*w=0.;
+	if (nnodes==1)
+		return (fabs(x-nodes[0])<=SIXS_LUT_TOL);
+	if (x<nodes[0]-SIXS_LUT_TOL || x>nodes[nnodes-1]+SIXS_LUT_TOL)
+		return false;
+	for (i=0;i<nnodes-2 && x>nodes[i+1];i++)
+		;
+	*k=i;
+	*w=(x-nodes[i])/(nodes[i+1]-nodes[i]);
+	if (*w<0.)
+		*w=0.;
+	if (*w>1.)
+		*w=1.;
+	return true;
+}
+
+/* Fill the 6S tables by multilinear interpolation in a LUT file; returns
+   false if the LUT doesn't cover the 6S inputs of the tables */
+bool sixs_lut_interp_file(const char *filename, sixs_tables_t *sixs_tables) {
+	FILE *fd;
+	sixs_lut_header_t header;
+	float x[SIXS_LUT_NDIM],w[SIXS_LUT_NDIM],weight;
+	int k[SIXS_LUT_NDIM],d,j,c,v;
+	bool ok;
+	long hdr_size,irec;
+	float rec[SIXS_LUT_NB_VALUES],values[SIXS_LUT_NB_VALUES];
+	double sum[SIXS_LUT_NB_VALUES];
+
+	if ((fd=fopen(filename,"rb"))==NULL)
+		return false;
+	if (sixs_lut_read_header(fd,&header)) {
+		printf("WARNING: invalid 6S LUT %s, running 6S\n",filename);
+		fclose(fd);
+		return false;
+	}
+	hdr_size=ftell(fd);
+
+	/* The fixed inputs must be the ones of the LUT */
+	x[SIXS_LUT_SZA]=sixs_tables->sza;
+	x[SIXS_LUT_PHI]=fmod(sixs_tables->phi,360.);
+	if (x[SIXS_LUT_PHI]<0.)
+		x[SIXS_LUT_PHI]+=360.;
+	x[SIXS_LUT_UWV]=sixs_tables->uwv;
+	x[SIXS_LUT_UOZ]=sixs_tables->uoz;
+	ok=(header.Inst==sixs_tables->Inst && header.month==sixs_tables->month &&
+		header.day==sixs_tables->day &&
+		fabs(header.vza-sixs_tables->vza)<=SIXS_LUT_TOL &&
+		fabs(header.srefl-sixs_tables->srefl)<=SIXS_LUT_TOL &&
+		fabs(header.target_alt-sixs_tables->target_alt)<=SIXS_LUT_TOL);
+	for (j=0;j<SIXS_NB_AOT && ok;j++)
+		ok=(fabs(header.aot[j]-sixs_tables->aot[j])<=SIXS_LUT_TOL);
+	for (d=0;d<SIXS_LUT_NDIM && ok;d++)
+		ok=sixs_lut_locate(header.nodes[d],header.nnodes[d],x[d],&k[d],&w[d]);
+	if (!ok) {
+		printf("6S LUT %s doesn't cover the scene, running 6S\n",filename);
+		fclose(fd);
+		return false;
+	}
+
+	memset(sum,0,sizeof(sum));
+	for (c=0;c<(1<<SIXS_LUT_NDIM);c++) {
+		weight=1.;
+		irec=0;
+		for (d=0;d<SIXS_LUT_NDIM;d++) {
+			if ((c>>d)&1) {
+				weight*=w[d];
+				irec=irec*header.nnodes[d]+k[d]+1;
+			} else {
+				weight*=1.-w[d];
+				irec=irec*header.nnodes[d]+k[d];
+			}
+		}
+		if (weight==0.)
+			continue;
+		if (fseek(fd,hdr_size+irec*(long)sizeof(rec),SEEK_SET) ||
+			fread(rec,sizeof(float),SIXS_LUT_NB_VALUES,fd)!=
+			SIXS_LUT_NB_VALUES) {
+			printf("WARNING: reading 6S LUT %s, running 6S\n",filename);
+			fclose(fd);
+			return false;
+		}
+		for (v=0;v<SIXS_LUT_NB_VALUES;v++)
+			sum[v]+=weight*rec[v];
+	}
+	fclose(fd);
+
+	for (v=0;v<SIXS_LUT_NB_VALUES;v++)
+		values[v]=sum[v];
+	sixs_lut_unpack(values,sixs_tables);
+	return true;
+}
+
+/* Fill the 6S tables from the LUT of the instrument in LEDAPS_6S_LUT_DIR,
+   if any; returns true if the tables were interpolated */
+bool sixs_lut_interp(sixs_tables_t *sixs_tables) {
+	char *dir,filename[1024],lut_name[64];
+
+	dir=getenv(SIXS_LUT_DIR_ENV);
+	if (dir==NULL || dir[0]=='\0')
+		return false;
+	sprintf(lut_name,SIXS_LUT_NAME,sixs_lut_inst_name(sixs_tables->Inst));
+	snprintf(filename,sizeof(filename),"%s/%s",dir,lut_name);
+	if (!sixs_lut_interp_file(filename,sixs_tables))
+		return false;
+	printf("6S tables interpolated from %s\n",filename);
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SIXS_LUT_H
+#define SIXS_LUT_H
+#include "bool.h"
+#include "sixs_runs.h"
+
+/* Precomputed 6S LUT: the 6S tables are run offline by sixs_lut_gen over a
+   grid of solar zenith, relative azimuth, water vapor and ozone, for one
+   instrument, and interpolated at run time.  lndsr looks for the LUT of its
+   instrument in the directory given by LEDAPS_6S_LUT_DIR (6S is run as
+   before if it isn't defined). */
+#define SIXS_LUT_DIR_ENV "LEDAPS_6S_LUT_DIR"
+#define SIXS_LUT_NAME "ledaps_6s_lut_%s.bin"
+#define SIXS_LUT_MAGIC "LDP6SLUT"
+#define SIXS_LUT_VERSION 1
+
+/* Grid dimensions, in the order of the LUT records (uoz varies fastest) */
+typedef enum {
+  SIXS_LUT_SZA = 0,
+  SIXS_LUT_PHI,
+  SIXS_LUT_UWV,
+  SIXS_LUT_UOZ,
+  SIXS_LUT_NDIM
+} Sixs_Lut_Dim_t;
+
+#define SIXS_LUT_MAX_NODES 64
+
+/* Number of values of one LUT record (all the 6S tables results) */
+#define SIXS_LUT_NB_BAND_VALUES 7
+#define SIXS_LUT_NB_AOT_VALUES 11
+#define SIXS_LUT_NB_VALUES (SIXS_NB_BANDS*(SIXS_LUT_NB_BAND_VALUES+ \
+	SIXS_NB_AOT*SIXS_LUT_NB_AOT_VALUES))
+
+typedef struct {
+	Sixs_Inst_t Inst;
+	int month,day;          /* fixed 6S inputs of the LUT */
+	float vza,srefl,target_alt;
+	float aot[SIXS_NB_AOT];
+	int nnodes[SIXS_LUT_NDIM];
+	float nodes[SIXS_LUT_NDIM][SIXS_LUT_MAX_NODES];
+} sixs_lut_header_t;
+
+const char *sixs_lut_inst_name(Sixs_Inst_t inst);
+void sixs_lut_pack(sixs_tables_t *sixs_tables, float *values);
+void sixs_lut_unpack(float *values, sixs_tables_t *sixs_tables);
+int sixs_lut_write_header(FILE *fd, sixs_lut_header_t *header);
+int sixs_lut_read_header(FILE *fd, sixs_lut_header_t *header);
+bool sixs_lut_interp_file(const char *filename, sixs_tables_t *sixs_tables);
+bool sixs_lut_interp(sixs_tables_t *sixs_tables);
+
+#endif
@@ -0,0 +1,287 @@
+/* sixs_lut_gen: offline generator of the precomputed 6S LUT used by lndsr
+   (see sixs_lut.h), and validation of a LUT against exact 6S runs.
+
+   sixs_lut_gen --inst=tm|etm [--sza=list] [--phi=list] [--uwv=list]
+                [--uoz=list] lut_file
+       runs 6S over the grid (comma separated lists of nodes) and writes the
+       LUT to lut_file
+   sixs_lut_gen --validate=n lut_file
+       compares the interpolated tables to 6S at n random points inside the
+       grid of lut_file and reports the differences */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "sixs_lut.h"
+
+/* Fixed 6S inputs, as set by lndsr for the 6S tables */
+#define LUT_VZA 0.
+#define LUT_MONTH 9
+#define LUT_DAY 15
+#define LUT_SREFL 0.14
+#define LUT_TARGET_ALT 0.
+
+static const char *dim_names[SIXS_LUT_NDIM] = {"sza", "phi", "uwv", "uoz"};
+static const char *default_nodes[SIXS_LUT_NDIM] = {
+	"0,10,20,30,40,50,60,70,80",
+	"0,90,180,270,360",
+	"0,0.5,1,2,3,4,5,7",
+	"0.2,0.3,0.4,0.5"
+};
+
+static void usage(void) {
+	printf("Usage: sixs_lut_gen --inst=tm|etm [--sza=list] [--phi=list] "
+		"[--uwv=list] [--uoz=list] lut_file\n"
+		"       sixs_lut_gen --validate=n lut_file\n\n"
+		"Nodes are given as comma separated increasing values (defaults: "
+		"sza=%s phi=%s uwv=%s uoz=%s)\n",default_nodes[0],default_nodes[1],
+		default_nodes[2],default_nodes[3]);
+}
+
+/* Parse a comma separated list of increasing nodes */
+static int parse_nodes(const char *list, float *nodes, int *nnodes) {
+	char buf[1024],*tok;
+
+	strncpy(buf,list,sizeof(buf)-1);
+	buf[sizeof(buf)-1]='\0';
+	*nnodes=0;
+	for (tok=strtok(buf,",");tok!=NULL;tok=strtok(NULL,",")) {
+		if (*nnodes==SIXS_LUT_MAX_NODES)
+			return -1;
+		nodes[*nnodes]=atof(tok);
+		if (*nnodes>0 && nodes[*nnodes]<=nodes[*nnodes-1])
+			return -1;
+		(*nnodes)++;
+	}
+	return (*nnodes>0) ? 0 : -1;
+}
+
+/* Set the 6S inputs of the tables at a grid point */
+static void set_inputs(sixs_tables_t *sixs_tables, sixs_lut_header_t *header,
+		float *x) {
+	memset(sixs_tables,0,sizeof(*sixs_tables));
+	sixs_tables->Inst=header->Inst;
+	sixs_tables->month=header->month;
+	sixs_tables->day=header->day;
+	sixs_tables->vza=header->vza;
+	sixs_tables->srefl=header->srefl;
+	sixs_tables->target_alt=header->target_alt;
+	sixs_tables->sza=x[SIXS_LUT_SZA];
+	sixs_tables->phi=x[SIXS_LUT_PHI];
+	sixs_tables->uwv=x[SIXS_LUT_UWV];
+	sixs_tables->uoz=x[SIXS_LUT_UOZ];
+	set_6S_aot_grid(sixs_tables);
+}
+
+static int generate(sixs_lut_header_t *header, const char *filename) {
+	static sixs_tables_t sixs_tables;
+	float x[SIXS_LUT_NDIM],values[SIXS_LUT_NB_VALUES];
+	int k[SIXS_LUT_NDIM],d,n,ntotal;
+	char tmp_filename[1100];
+	FILE *fd;
+
+	ntotal=1;
+	for (d=0;d<SIXS_LUT_NDIM;d++)
+		ntotal*=header->nnodes[d];
+
+	sprintf(tmp_filename,"%s.%ld.tmp",filename,(long)getpid());
+	if ((fd=fopen(tmp_filename,"wb"))==NULL) {
+		fprintf(stderr,"ERROR: creating LUT file %s\n",tmp_filename);
+		return -1;
+	}
+	if (sixs_lut_write_header(fd,header)) {
+		fprintf(stderr,"ERROR: writing LUT file %s\n",tmp_filename);
+		fclose(fd);
+		unlink(tmp_filename);
+		return -1;
+	}
+
+	/* Grid points in record order, uoz varying fastest */
+	for (n=0;n<ntotal;n++) {
+		int rest=n;
+		for (d=SIXS_LUT_NDIM-1;d>=0;d--) {
+			k[d]=rest%header->nnodes[d];
+			rest/=header->nnodes[d];
+			x[d]=header->nodes[d][k[d]];
+		}
+		printf("6S LUT point %d/%d: sza %.2f phi %.2f uwv %.2f uoz %.2f\n",
+			n+1,ntotal,x[0],x[1],x[2],x[3]);
+		set_inputs(&sixs_tables,header,x);
+		if (run_6S_tables(&sixs_tables)) {
+			fprintf(stderr,"ERROR: running 6S for LUT point %d\n",n+1);
+			fclose(fd);
+			unlink(tmp_filename);
+			return -1;
+		}
+		sixs_lut_pack(&sixs_tables,values);
+		if (fwrite(values,sizeof(float),SIXS_LUT_NB_VALUES,fd)!=
+			SIXS_LUT_NB_VALUES) {
+			fprintf(stderr,"ERROR: writing LUT file %s\n",tmp_filename);
+			fclose(fd);
+			unlink(tmp_filename);
+			return -1;
+		}
+	}
+
+	if (fclose(fd) || rename(tmp_filename,filename)) {
+		fprintf(stderr,"ERROR: writing LUT file %s\n",filename);
+		unlink(tmp_filename);
+		return -1;
+	}
+	printf("6S LUT written to %s (%d points)\n",filename,ntotal);
+	return 0;
+}
+
+/* Quantities reported by the validation, as offsets in a LUT record (see
+   sixs_lut_pack); per band quantities have no AOT offset */
+#define NB_CHECKED 8
+static const char *checked_names[NB_CHECKED] = {"rho_r", "T_g_wv", "T_g_og",
+	"rho_ra", "rho_a", "T_a", "S_ra", "T_ra"};
+static const int checked_band_offset[NB_CHECKED] = {6, 4, 5, -1, -1, -1, -1,
+	-1};
+static const int checked_aot_offset[NB_CHECKED] = {-1, -1, -1, 4, 5, 3, 6, 9};
+
+static int validate(const char *filename, int npoints) {
+	static sixs_tables_t exact,interp;
+	sixs_lut_header_t header;
+	float x[SIXS_LUT_NDIM],ve[SIXS_LUT_NB_VALUES],vi[SIXS_LUT_NB_VALUES];
+	double max_abs[NB_CHECKED],max_rel[NB_CHECKED],sum2[NB_CHECKED];
+	long nval[NB_CHECKED];
+	int n,d,q,i,j,off;
+	double diff;
+	FILE *fd;
+
+	if ((fd=fopen(filename,"rb"))==NULL || sixs_lut_read_header(fd,&header)) {
+		fprintf(stderr,"ERROR: reading LUT file %s\n",filename);
+		if (fd!=NULL)
+			fclose(fd);
+		return -1;
+	}
+	fclose(fd);
+
+	memset(max_abs,0,sizeof(max_abs));
+	memset(max_rel,0,sizeof(max_rel));
+	memset(sum2,0,sizeof(sum2));
+	memset(nval,0,sizeof(nval));
+	srand(1);	/* same validation set for every run */
+	for (n=0;n<npoints;n++) {
+		for (d=0;d<SIXS_LUT_NDIM;d++) {
+			x[d]=header.nodes[d][0]+(header.nodes[d][header.nnodes[d]-1]-
+				header.nodes[d][0])*(rand()/(RAND_MAX+1.));
+			/* stay at the 6S input precision (2 decimals) */
+			x[d]=floor(x[d]*100.+0.5)/100.;
+		}
+		printf("Validation point %d/%d: sza %.2f phi %.2f uwv %.2f uoz %.2f\n",
+			n+1,npoints,x[0],x[1],x[2],x[3]);
+		set_inputs(&exact,&header,x);
+		if (run_6S_tables(&exact)) {
+			fprintf(stderr,"ERROR: running 6S for validation point %d\n",
+				n+1);
+			return -1;
+		}
+		set_inputs(&interp,&header,x);
+		if (!sixs_lut_interp_file(filename,&interp)) {
+			fprintf(stderr,"ERROR: interpolating in LUT file %s\n",filename);
+			return -1;
+		}
+		sixs_lut_pack(&exact,ve);
+		sixs_lut_pack(&interp,vi);
+
+		for (q=0;q<NB_CHECKED;q++) {
+			for (i=0;i<SIXS_NB_BANDS;i++) {
+				for (j=0;j<(checked_band_offset[q]>=0 ? 1 : SIXS_NB_AOT);j++) {
+					off=i*(SIXS_LUT_NB_BAND_VALUES+
+						SIXS_NB_AOT*SIXS_LUT_NB_AOT_VALUES);
+					if (checked_band_offset[q]>=0)
+						off+=checked_band_offset[q];
+					else
+						off+=SIXS_LUT_NB_BAND_VALUES+
+							j*SIXS_LUT_NB_AOT_VALUES+checked_aot_offset[q];
+					diff=fabs(vi[off]-ve[off]);
+					if (diff>max_abs[q])
+						max_abs[q]=diff;
+					if (fabs(ve[off])>1e-6 && diff/fabs(ve[off])>max_rel[q])
+						max_rel[q]=diff/fabs(ve[off]);
+					sum2[q]+=diff*diff;
+					nval[q]++;
+				}
+			}
+		}
+	}
+
+	printf("\nLUT interpolation vs 6S, %d points, %s:\n",npoints,
+		sixs_lut_inst_name(header.Inst));
+	printf("%-8s %12s %12s %12s\n","quantity","max abs","rms","max rel");
+	for (q=0;q<NB_CHECKED;q++)
+		printf("%-8s %12.6f %12.6f %11.4f%%\n",checked_names[q],max_abs[q],
+			nval[q] ? sqrt(sum2[q]/nval[q]) : 0.,100.*max_rel[q]);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static sixs_tables_t grid;
+	sixs_lut_header_t header;
+	const char *nodes[SIXS_LUT_NDIM];
+	char *filename=NULL;
+	int i,d,npoints=0;
+	size_t l;
+
+	memset(&header,0,sizeof(header));
+	header.Inst=SIXS_INST_NULL;
+	for (d=0;d<SIXS_LUT_NDIM;d++)
+		nodes[d]=default_nodes[d];
+
+	for (i=1;i<argc;i++) {
+		if (!strcmp(argv[i],"--inst=tm"))
+			header.Inst=SIXS_INST_TM;
+		else if (!strcmp(argv[i],"--inst=etm"))
+			header.Inst=SIXS_INST_ETM;
+		else if (!strncmp(argv[i],"--validate=",11))
+			npoints=atoi(&argv[i][11]);
+		else if (argv[i][0]!='-' && filename==NULL)
+			filename=argv[i];
+		else {
+			for (d=0;d<SIXS_LUT_NDIM;d++) {
+				l=strlen(dim_names[d]);
+				if (!strncmp(argv[i],"--",2) &&
+					!strncmp(&argv[i][2],dim_names[d],l) && argv[i][l+2]=='=') {
+					nodes[d]=&argv[i][l+3];
+					break;
+				}
+			}
+			if (d==SIXS_LUT_NDIM) {
+				usage();
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	if (filename==NULL) {
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (npoints>0)
+		return validate(filename,npoints) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if (header.Inst==SIXS_INST_NULL) {
+		usage();
+		return EXIT_FAILURE;
+	}
+	header.month=LUT_MONTH;
+	header.day=LUT_DAY;
+	header.vza=LUT_VZA;
+	header.srefl=LUT_SREFL;
+	header.target_alt=LUT_TARGET_ALT;
+	set_6S_aot_grid(&grid);
+	memcpy(header.aot,grid.aot,sizeof(header.aot));
+	for (d=0;d<SIXS_LUT_NDIM;d++) {
+		if (parse_nodes(nodes[d],header.nodes[d],&header.nnodes[d])) {
+			fprintf(stderr,"ERROR: invalid %s nodes %s\n",dim_names[d],
+				nodes[d]);
+			return EXIT_FAILURE;
+		}
+	}
+	return generate(&header,filename) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
+#include <stdarg.h>
 #include "sixs_runs.h"
+#include "sixs_cache.h"
+#include "sixs_lut.h"
 
 struct etm_spectral_function_t {
 	int nbvals[SIXS_NB_BANDS];
@@ -11,20 +13,25 @@ struct etm_spectral_function_t {
 	float response[SIXS_NB_BANDS][155];
 } etm_spectral_function_t;
 
-int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
-	char cmd[128],sixs_cmd_filename[1024],sixs_out_filename[1024],line_in[256];
-    /* char tmp_file[1024], cmd_string[1024]; */
-	int i,j,k;
-	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
+/* Append formatted text (one or more input cards) to a 6S input deck */
+static void sixs_card(char *deck, int *ndeck, const char *format, ...) {
+	va_list ap;
+	int n;
+
+	va_start(ap,format);
+	n=vsnprintf(&deck[*ndeck],SIXS_DECK_SIZE-*ndeck,format,ap);
+	va_end(ap);
+	if (n<0 || *ndeck+n>=SIXS_DECK_SIZE) {
+		fprintf(stderr,"ERROR: 6S input deck too long\n");
+		exit(-1);
+	}
+	*ndeck+=n;
+}
+
+/* Append the spectral conditions of band i to a 6S input deck */
+static void sixs_band_cards(char *deck, int *ndeck, Sixs_Inst_t inst, int i) {
+	int k;
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char short_name[1024];
-    char local_granule_id[1024];
-    char acq_date_string[MAX_DATE_LEN + 1];
-    const char *sat_names[SAT_MAX] = {"1", "2", "3", "4", "5", "7"};
-    const char *inst_names[INST_MAX] = {"M", "T", "E"};
-    const char *wrs_names[WRS_MAX] = {"1", "2"};
-	
 	struct etm_spectral_function_t etm_spectral_function = {
 		{54,61,65,81,131,155},
 		{0.420,0.500,0.580,0.730,1.501,2.0},
@@ -38,6 +45,75 @@ int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
 			{0.004,0.001,0.003,0.000,0.002,0.001,0.002,0.002,0.012,0.008,0.009,0.018,0.017,0.031,0.037,0.046,0.058,0.076,0.088,0.110,0.149,0.196,0.242,0.303,0.367,0.437,0.519,0.610,0.677,0.718,0.756,0.774,0.784,0.775,0.789,0.782,0.778,0.766,0.762,0.768,0.775,0.769,0.788,0.808,0.794,0.823,0.811,0.819,0.836,0.837,0.836,0.851,0.859,0.855,0.871,0.873,0.875,0.859,0.872,0.859,0.872,0.863,0.865,0.868,0.877,0.873,0.869,0.876,0.868,0.879,0.873,0.876,0.880,0.874,0.870,0.858,0.863,0.859,0.844,0.859,0.854,0.863,0.868,0.856,0.847,0.861,0.851,0.852,0.838,0.847,0.840,0.831,0.836,0.838,0.822,0.838,0.839,0.842,0.854,0.862,0.873,0.868,0.879,0.891,0.898,0.919,0.920,0.926,0.928,0.934,0.936,0.953,0.954,0.952,0.960,0.973,0.985,0.972,0.970,0.994,0.989,0.975,1.000,0.991,0.968,0.966,0.956,0.929,0.929,0.926,0.903,0.924,0.929,0.928,0.920,0.853,0.775,0.659,0.531,0.403,0.275,0.218,0.131,0.104,0.075,0.052,0.029,0.028,0.014,0.019,0.013,0.007,0.015,0.000,0.004}
 		}
 	};
+
+	switch (inst) {
+		case SIXS_INST_TM:
+			sixs_card(deck,ndeck,"%d (predefined band)\n",tm_band[i]);
+		break;
+		case SIXS_INST_ETM:
+			sixs_card(deck,ndeck,"1 (user defined filter function)\n");
+			sixs_card(deck,ndeck,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
+			for (k=0;k<etm_spectral_function.nbvals[i];k++) {
+				sixs_card(deck,ndeck,"%05.3f ",etm_spectral_function.response[i][k]);
+				if (!((k+1)%10))
+					sixs_card(deck,ndeck,"\n");
+			}
+			if (k%10)
+				sixs_card(deck,ndeck,"\n");
+		break;
+		default:
+			fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
+			exit(-1);
+	}
+}
+
+/* Store the results of the 6S run for band i and AOT j in the tables */
+static void sixs_store(sixs_tables_t *sixs_tables, int i, int j, float *res) {
+	if (j==0) {
+		sixs_tables->T_r_down[i]=res[SIXS_OUT_T_R_DOWN];
+		sixs_tables->T_r_up[i]=res[SIXS_OUT_T_R_UP];
+		sixs_tables->T_r[i]=res[SIXS_OUT_T_R_DOWN]*res[SIXS_OUT_T_R_UP];
+		sixs_tables->T_g_wv[i]=res[SIXS_OUT_T_G_WV];
+		sixs_tables->T_g_og[i]=res[SIXS_OUT_T_G_OZ]*res[SIXS_OUT_T_G_CO2]*
+			res[SIXS_OUT_T_G_O2]*res[SIXS_OUT_T_G_NO2]*res[SIXS_OUT_T_G_NO2]*
+			res[SIXS_OUT_T_G_CH4]*res[SIXS_OUT_T_G_CO];
+		sixs_tables->S_r[i]=res[SIXS_OUT_S_R];
+		sixs_tables->rho_r[i]=res[SIXS_OUT_RHO_R];
+	}
+	sixs_tables->S_ra[i][j]=res[SIXS_OUT_S_RA];
+	sixs_tables->aot_wavelength[i][j]=res[SIXS_OUT_AOT];
+	sixs_tables->T_a_down[i][j]=res[SIXS_OUT_T_A_DOWN];
+	sixs_tables->T_a_up[i][j]=res[SIXS_OUT_T_A_UP];
+	sixs_tables->T_a[i][j]=res[SIXS_OUT_T_A_DOWN]*res[SIXS_OUT_T_A_UP];
+	sixs_tables->T_ra_down[i][j]=res[SIXS_OUT_T_RA_DOWN];
+	sixs_tables->T_ra_up[i][j]=res[SIXS_OUT_T_RA_UP];
+	sixs_tables->T_ra[i][j]=res[SIXS_OUT_T_RA_DOWN]*res[SIXS_OUT_T_RA_UP];
+	sixs_tables->rho_a[i][j]=res[SIXS_OUT_RHO_A];
+	sixs_tables->rho_ra[i][j]=res[SIXS_OUT_RHO_RA];
+	sixs_tables->rho_toa[i][j]=res[SIXS_OUT_RHO_TOA];
+}
+
+/* The 6S input cards are built in memory and 6S is run in-process through
+   sixs_run (6sV-1.0B/SIXSRUN.f), so no temporary files or shell are needed.
+   The 6S common blocks are thread private, so the runs are spread over the
+   OpenMP threads.  The tables are interpolated from the precomputed 6S LUT
+   (see sixs_lut.c) or read from the 6S cache (see sixs_cache.c) when
+   available, in which case 6S is not run at all. */
+int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
+	set_6S_aot_grid(sixs_tables);
+
+	if (sixs_lut_interp(sixs_tables))
+		return 0;
+	if (sixs_cache_read(sixs_tables,SIXS_CACHE_LAND))
+		return 0;
+	if (run_6S_tables(sixs_tables))
+		return 1;
+	sixs_cache_write(sixs_tables,SIXS_CACHE_LAND);
+	return 0;
+}
+
+/* Set the AOT grid of the 6S tables */
+void set_6S_aot_grid(sixs_tables_t *sixs_tables) {
 	sixs_tables->aot[0]=0.01;
 	sixs_tables->aot[1]=0.05;
 	sixs_tables->aot[2]=0.10;
@@ -53,818 +129,145 @@ int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
 	sixs_tables->aot[12]=1.60;
 	sixs_tables->aot[13]=1.80;
 	sixs_tables->aot[14]=2.00;
-	
-    /* Determine the 6s command and output filenames */
-    if (sprintf(short_name, "L%s%s%s", sat_names[meta->sat], 
-        inst_names[meta->inst], "SR") < 0) {
-        fprintf(stderr, "ERROR:creating short name\n");
-        exit(-1);
-    }
+}
 
-    if (!FormatDate(&meta->acq_date, DATE_FORMAT_DATEB, acq_date_string)) {
-        fprintf(stderr, "ERROR:formatting acquisition date\n");
-        exit(-1);
-    }
-    acq_date_string[4] = '\0';
+/* Run 6S over the bands and AOT grid of the 6S tables (continental aerosol
+   model, homogeneous lambertian surface).  Returns non-zero if any of the 6S
+   runs failed. */
+int run_6S_tables(sixs_tables_t *sixs_tables) {
+	char deck[SIXS_DECK_SIZE];
+	int ndeck;
+	float res[SIXS_NB_OUT];
+	int i,j;
+	int nfailed=0;
 
-    sprintf(local_granule_id, "%s.a%4s%3s.w%1sp%03dr%03d",
-        short_name, acq_date_string, &acq_date_string[5],
-        wrs_names[meta->wrs_sys], meta->ipath, meta->irow);
-	
 	/* Run 6s */
 #ifdef _OPENMP
-        #pragma omp parallel for private (i, j, k, sixs_cmd_filename, sixs_out_filename, fd, cmd, line_in, tgoz, tgco2, tgo2, tgno2, tgch4, tgco)
+        #pragma omp parallel for private (i, j, deck, ndeck, res) reduction (+:nfailed)
 #endif
 	for (i=0;i<SIXS_NB_BANDS;i++) {
 		for (j=0;j<SIXS_NB_AOT;j++) {
-
-                   sprintf (sixs_cmd_filename, "sixs_cmd_%s_%d_%d", local_granule_id, i+1, j+1);
-                   sprintf (sixs_out_filename, "sixs_output_%s_%d_%d", local_granule_id, i+1, j+1);
 			printf("Processing 6S for band %d  AOT %2d\r",i+1,j+1);
                         fflush(stdout);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-				exit(-1);
-			}
 
-			fprintf(fd,"%s <<+ >%s\n",SIXS_APP,sixs_out_filename);
-			fprintf(fd,"0 (user defined)\n");
-			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
-			fprintf(fd,"8 (option for water vapor and ozone)\n");
-			fprintf(fd,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
-			fprintf(fd,"1 (continental model)\n");
-			fprintf(fd,"0 (option for optical thickness at 550 nm)\n");
-			fprintf(fd,"%.3f (value of aot550\n",sixs_tables->aot[j]);
-			fprintf(fd,"%f (target level)\n",sixs_tables->target_alt);
-			fprintf(fd,"-1000 (sensor level : -1000=satellite level)\n");
-			switch (sixs_tables->Inst) {
-				case SIXS_INST_TM:
-					fprintf(fd,"%d (predefined band)\n",tm_band[i]);
-				break;
-				case SIXS_INST_ETM:
-					fprintf(fd,"1 (user defined filter function)\n");
-					fprintf(fd,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
-					for (k=0;k<etm_spectral_function.nbvals[i];k++) {
-						fprintf(fd,"%05.3f ",etm_spectral_function.response[i][k]);
-						if (!((k+1)%10))
-							fprintf(fd,"\n");
-					}
-					if (k%10)
-						fprintf(fd,"\n");
-				break;
-				default:
-					fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
-					exit(-1);
-			}
-			fprintf(fd,"0 (homogeneous surface)\n");
-			fprintf(fd,"0 (no directional effects)\n");
-			fprintf(fd,"0 (constant value for rho)\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
-			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"0\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-                        /* Modified 9/26/2014 to run bash shell vs. sh */
-		        sprintf(cmd,"bash %s",sixs_cmd_filename);
-		        if (system(cmd)) {
-		           fprintf(stderr,"ERROR: Can't run 6S \n");
-		           exit(-1);
-		        }
+			ndeck=0;
+			sixs_card(deck,&ndeck,"0 (user defined)\n");
+			sixs_card(deck,&ndeck,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
+			sixs_card(deck,&ndeck,"8 (option for water vapor and ozone)\n");
+			sixs_card(deck,&ndeck,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
+			sixs_card(deck,&ndeck,"1 (continental model)\n");
+			sixs_card(deck,&ndeck,"0 (option for optical thickness at 550 nm)\n");
+			sixs_card(deck,&ndeck,"%.3f (value of aot550\n",sixs_tables->aot[j]);
+			sixs_card(deck,&ndeck,"%f (target level)\n",sixs_tables->target_alt);
+			sixs_card(deck,&ndeck,"-1000 (sensor level : -1000=satellite level)\n");
+			sixs_band_cards(deck,&ndeck,sixs_tables->Inst,i);
+			sixs_card(deck,&ndeck,"0 (homogeneous surface)\n");
+			sixs_card(deck,&ndeck,"0 (no directional effects)\n");
+			sixs_card(deck,&ndeck,"0 (constant value for rho)\n");
+			sixs_card(deck,&ndeck,"%.3f (value of rho)\n",sixs_tables->srefl);
+			sixs_card(deck,&ndeck,"-1 (no atmospheric correction)\n");
+			sixs_card(deck,&ndeck,"0\n");
 
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
-			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
+			if (sixs_run(deck,ndeck,res)) {
+				printf("\nERROR: 6S failed for band %d  AOT %2d\n",i+1,j+1);
+				nfailed++;
+				continue;
 			}
-			fclose(fd);
-/* For OZONE debugging:
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_cmd_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_cmd_filename, tmp_file);
-            system (cmd_string);
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_out_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_out_filename, tmp_file);
-            system (cmd_string);
-*/
-	        unlink(sixs_cmd_filename);
-	        unlink(sixs_out_filename);
+			sixs_store(sixs_tables,i,j,res);
 		}  /* for j */
 	}  /* for i */
 	printf ("\n");
-	return 0;
+	return (nfailed > 0) ? 1 : 0;
 }
 
 /* This function is not actually used in lndsr processing */
 int create_6S_tables_water(sixs_tables_t *sixs_tables) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int i,j,k;
-	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
-	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
-	
-	struct etm_spectral_function_t etm_spectral_function = {
-		{54,61,65,81,131,155},
-		{0.420,0.500,0.580,0.730,1.501,2.0},
-		{0.550,0.650,0.740,0.930,1.825,2.386},
-		{
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.016,0.071,0.287,0.666,0.792,0.857,0.839,0.806,0.779,0.846,0.901,0.900,0.890,0.851,0.875,0.893,0.884,0.930,0.958,0.954,0.980,0.975,0.965,0.962,0.995,0.990,0.990,0.979,0.983,0.969,0.960,0.768,0.293,0.054,0.009,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.001,0.002,0.003,0.012,0.026,0.074,0.174,0.348,0.552,0.696,0.759,0.785,0.822,0.870,0.905,0.929,0.947,0.952,0.952,0.951,0.953,0.950,0.954,0.967,0.959,0.941,0.933,0.938,0.951,0.956,0.955,0.956,0.973,0.992,1.000,0.976,0.942,0.930,0.912,0.799,0.574,0.340,0.185,0.105,0.062,0.038,0.021,0.011,0.005,0.002,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.001,0.002,0.010,0.047,0.174,0.419,0.731,0.921,0.942,0.937,0.937,0.949,0.965,0.973,0.970,0.958,0.955,0.962,0.980,0.993,0.998,1.000,0.995,0.992,0.988,0.977,0.954,0.932,0.880,0.729,0.444,0.183,0.066,0.025,0.012,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.000,0.000,0.000,0.000,0.002,0.004,0.002,0.001,0.020,0.032,0.052,0.069,0.110,0.175,0.271,0.402,0.556,0.705,0.812,0.871,0.896,0.908,0.918,0.926,0.928,0.930,0.926,0.925,0.928,0.923,0.916,0.908,0.903,0.909,0.924,0.946,0.954,0.971,0.969,0.967,0.965,0.967,0.961,0.949,0.931,0.925,0.929,0.943,0.961,0.985,0.992,0.998,0.992,0.994,0.997,0.998,1.000,0.991,0.988,0.969,0.926,0.868,0.817,0.819,0.880,0.854,0.572,0.256,0.104,0.044,0.022,0.011,0.007,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.000,0.003,0.000,0.001,0.007,0.008,0.008,0.012,0.012,0.028,0.041,0.062,0.087,0.114,0.176,0.230,0.306,0.410,0.481,0.543,0.598,0.642,0.686,0.719,0.750,0.785,0.817,0.845,0.867,0.881,0.902,0.900,0.896,0.892,0.899,0.882,0.872,0.872,0.872,0.878,0.868,0.860,0.877,0.884,0.897,0.895,0.898,0.912,0.921,0.927,0.937,0.947,0.948,0.954,0.961,0.962,0.962,0.964,0.969,0.956,0.952,0.951,0.952,0.953,0.939,0.934,0.928,0.943,0.945,0.935,0.944,0.947,0.944,0.949,0.960,0.966,0.971,0.978,0.993,0.998,0.996,0.996,0.997,0.986,0.990,0.988,0.992,0.985,0.982,0.978,0.970,0.966,0.952,0.927,0.883,0.832,0.751,0.656,0.577,0.483,0.393,0.310,0.239,0.184,0.142,0.104,0.080,0.063,0.049,0.041,0.036,0.023,0.021,0.019,0.012,0.006,0.008,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000,0.000},
-			{0.004,0.001,0.003,0.000,0.002,0.001,0.002,0.002,0.012,0.008,0.009,0.018,0.017,0.031,0.037,0.046,0.058,0.076,0.088,0.110,0.149,0.196,0.242,0.303,0.367,0.437,0.519,0.610,0.677,0.718,0.756,0.774,0.784,0.775,0.789,0.782,0.778,0.766,0.762,0.768,0.775,0.769,0.788,0.808,0.794,0.823,0.811,0.819,0.836,0.837,0.836,0.851,0.859,0.855,0.871,0.873,0.875,0.859,0.872,0.859,0.872,0.863,0.865,0.868,0.877,0.873,0.869,0.876,0.868,0.879,0.873,0.876,0.880,0.874,0.870,0.858,0.863,0.859,0.844,0.859,0.854,0.863,0.868,0.856,0.847,0.861,0.851,0.852,0.838,0.847,0.840,0.831,0.836,0.838,0.822,0.838,0.839,0.842,0.854,0.862,0.873,0.868,0.879,0.891,0.898,0.919,0.920,0.926,0.928,0.934,0.936,0.953,0.954,0.952,0.960,0.973,0.985,0.972,0.970,0.994,0.989,0.975,1.000,0.991,0.968,0.966,0.956,0.929,0.929,0.926,0.903,0.924,0.929,0.928,0.920,0.853,0.775,0.659,0.531,0.403,0.275,0.218,0.131,0.104,0.075,0.052,0.029,0.028,0.014,0.019,0.013,0.007,0.015,0.000,0.004}
-		}
-	};
-	sixs_tables->aot[0]=0.01;
-	sixs_tables->aot[1]=0.05;
-	sixs_tables->aot[2]=0.10;
-	sixs_tables->aot[3]=0.15;
-	sixs_tables->aot[4]=0.20;
-	sixs_tables->aot[5]=0.30;
-	sixs_tables->aot[6]=0.40;
-	sixs_tables->aot[7]=0.60;
-	sixs_tables->aot[8]=0.80;
-	sixs_tables->aot[9]=1.00;
-	sixs_tables->aot[10]=1.20;
-	sixs_tables->aot[11]=1.40;
-	sixs_tables->aot[12]=1.60;
-	sixs_tables->aot[13]=1.80;
-	sixs_tables->aot[14]=2.00;
+	char deck[SIXS_DECK_SIZE];
+	int ndeck;
+	float res[SIXS_NB_OUT];
+	int i,j;
+
+	set_6S_aot_grid(sixs_tables);
 	printf ("DEBUG: in compute_6S_tables_water -- shouldn't be here!\n");
-	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
+	if (sixs_cache_read(sixs_tables,SIXS_CACHE_WATER))
+		return 0;
 	
 	for (i=0;i<SIXS_NB_BANDS;i++) {
 		for (j=0;j<SIXS_NB_AOT;j++) {
 			printf("Processing Band %d  AOT %d\n",i+1,j+1);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-				exit(-1);
-			}
 
-			fprintf(fd,"%s <<+ >%s\n",SIXS_APP,sixs_out_filename);
-			fprintf(fd,"0 (user defined)\n");
-			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
-			fprintf(fd,"8 (option for water vapor and ozone)\n");
-			fprintf(fd,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
-			fprintf(fd,"2 (maritime model)\n");
-			fprintf(fd,"0 (option for optical thickness at 550 nm)\n");
-			fprintf(fd,"%.3f (value of aot550\n",sixs_tables->aot[j]);
-			fprintf(fd,"%f (target level)\n",sixs_tables->target_alt);
-			fprintf(fd,"-1000 (sensor level : -1000=satellite level)\n");
-			switch (sixs_tables->Inst) {
-				case SIXS_INST_TM:
-					fprintf(fd,"%d (predefined band)\n",tm_band[i]);
-				break;
-				case SIXS_INST_ETM:
-					fprintf(fd,"1 (user defined filter function)\n");
-					fprintf(fd,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
-					for (k=0;k<etm_spectral_function.nbvals[i];k++) {
-						fprintf(fd,"%05.3f ",etm_spectral_function.response[i][k]);
-						if (!((k+1)%10))
-							fprintf(fd,"\n");
-					}
-					if (k%10)
-						fprintf(fd,"\n");
-				break;
-				default:
-					fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
-					exit(-1);
-			}
-			fprintf(fd,"0 (homogeneous surface)\n");
-			fprintf(fd,"1 (directional effects)\n");
-			fprintf(fd,"6 (Ocean)\n");
-			fprintf(fd,"2.0 0.0 0.0 .10 (wind speed(m/s) wind azimuth(deg) salinity(deg) pigment concentration(mg/m3))\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
-			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-            /* Modified 9/26/2014 to run bash shell vs. sh */
-			sprintf(cmd,"bash %s",sixs_cmd_filename);
-			if (system(cmd)) {
-				fprintf(stderr,"ERROR: Can't run 6S \n");
-				exit(-1);
-			}
-	
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
-			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*       apparent reflectance",28)) { 
-					k=28;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_toa[i][j]);
-				}
-			}
-			fclose(fd);
+			ndeck=0;
+			sixs_card(deck,&ndeck,"0 (user defined)\n");
+			sixs_card(deck,&ndeck,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
+			sixs_card(deck,&ndeck,"8 (option for water vapor and ozone)\n");
+			sixs_card(deck,&ndeck,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
+			sixs_card(deck,&ndeck,"2 (maritime model)\n");
+			sixs_card(deck,&ndeck,"0 (option for optical thickness at 550 nm)\n");
+			sixs_card(deck,&ndeck,"%.3f (value of aot550\n",sixs_tables->aot[j]);
+			sixs_card(deck,&ndeck,"%f (target level)\n",sixs_tables->target_alt);
+			sixs_card(deck,&ndeck,"-1000 (sensor level : -1000=satellite level)\n");
+			sixs_band_cards(deck,&ndeck,sixs_tables->Inst,i);
+			sixs_card(deck,&ndeck,"0 (homogeneous surface)\n");
+			sixs_card(deck,&ndeck,"1 (directional effects)\n");
+			sixs_card(deck,&ndeck,"6 (Ocean)\n");
+			sixs_card(deck,&ndeck,"2.0 0.0 0.0 .10 (wind speed(m/s) wind azimuth(deg) salinity(deg) pigment concentration(mg/m3))\n");
+			sixs_card(deck,&ndeck,"%.3f (value of rho)\n",sixs_tables->srefl);
+			sixs_card(deck,&ndeck,"-1 (no atmospheric correction)\n");
+
+			if (sixs_run(deck,ndeck,res))
+				return 1;
+			sixs_store(sixs_tables,i,j,res);
 		}
 	}
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+	sixs_cache_write(sixs_tables,SIXS_CACHE_WATER);
 	return 0;
 }
 
 /* This function is not actually used in lndsr processing */
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int k;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
+	char deck[SIXS_DECK_SIZE];
+	int ndeck;
+	float res[SIXS_NB_OUT];
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
-	FILE *fd;
 	printf ("DEBUG: in compute_atmos_params_6S -- shouldn't be here!\n");
 	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
-
-	if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-		fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-		exit(-1);
-	}
-	fprintf(fd,"%s <<+ >%s\n",SIXS_APP,sixs_out_filename);
-	fprintf(fd,"0\n");
-	fprintf(fd,"%.2f %.2f %.2f %.2f %d %d\n",sixs_atmos_params->sza,sixs_atmos_params->phi,sixs_atmos_params->vza,0.,sixs_atmos_params->month,sixs_atmos_params->day);
-	fprintf(fd,"8\n");
-	fprintf(fd,"%.2f %.2f\n",sixs_atmos_params->uwv,sixs_atmos_params->uoz);
+	ndeck=0;
+	sixs_card(deck,&ndeck,"0\n");
+	sixs_card(deck,&ndeck,"%.2f %.2f %.2f %.2f %d %d\n",sixs_atmos_params->sza,sixs_atmos_params->phi,sixs_atmos_params->vza,0.,sixs_atmos_params->month,sixs_atmos_params->day);
+	sixs_card(deck,&ndeck,"8\n");
+	sixs_card(deck,&ndeck,"%.2f %.2f\n",sixs_atmos_params->uwv,sixs_atmos_params->uoz);
 	if (sixs_atmos_params->aot > 0) {
-		fprintf(fd,"1\n");
-		fprintf(fd,"0\n");
-		fprintf(fd,"%.3f\n",sixs_atmos_params->aot);
+		sixs_card(deck,&ndeck,"1\n");
+		sixs_card(deck,&ndeck,"0\n");
+		sixs_card(deck,&ndeck,"%.3f\n",sixs_atmos_params->aot);
 	} else {
-		fprintf(fd,"0\n");
-		fprintf(fd,"-1\n");
-	}
-	fprintf(fd,"0\n");
-	fprintf(fd,"-1000\n");
-	fprintf(fd,"%d\n",tm_band[sixs_atmos_params->band]);
-	fprintf(fd,"0\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"%.3f\n",sixs_atmos_params->srefl);
-	fprintf(fd,"-1\n");
-	fprintf(fd,"0\n");
-	fprintf(fd,"+\n");
-	fclose(fd);
-	
-	sprintf(cmd,"bash %s",sixs_cmd_filename);
-	if (system(cmd)) {
-		fprintf(stderr,"ERROR: Can't run 6S \n");
-		exit(-1);
-	}
-	
-	if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-		fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-		exit(-1);
-	}
-	while (fgets(line_in,256,fd)) {
-		line_in[strlen(line_in)-1]='\0';
-		if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->S_r);
-		}
-		if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_up);
-		}
-		if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_up);
-		}
-		if (!strncmp(line_in,"*      reflectance I      :",27)) {
-			k=27;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_r);
-			while (line_in[k]!=' ')		/* rayleigh */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_a);
-		}
-		if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_g_wv);
-		}
-		if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgoz);
-		}
-		if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco2);
-		}
-		if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgo2);
-		}
-		if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgno2);
-		}
-		if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgch4);
-		}
-		if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco);
-		}
+		sixs_card(deck,&ndeck,"0\n");
+		sixs_card(deck,&ndeck,"-1\n");
 	}
-	fclose(fd);
-	sixs_atmos_params->T_g_og=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-	
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+	sixs_card(deck,&ndeck,"0\n");
+	sixs_card(deck,&ndeck,"-1000\n");
+	sixs_card(deck,&ndeck,"%d\n",tm_band[sixs_atmos_params->band]);
+	sixs_card(deck,&ndeck,"0\n");
+	sixs_card(deck,&ndeck,"0\n");
+	sixs_card(deck,&ndeck,"0\n");
+	sixs_card(deck,&ndeck,"%.3f\n",sixs_atmos_params->srefl);
+	sixs_card(deck,&ndeck,"-1\n");
+	sixs_card(deck,&ndeck,"0\n");
+
+	if (sixs_run(deck,ndeck,res))
+		return 1;
+
+	sixs_atmos_params->S_r=res[SIXS_OUT_S_R];
+	sixs_atmos_params->T_r_down=res[SIXS_OUT_T_R_DOWN];
+	sixs_atmos_params->T_r_up=res[SIXS_OUT_T_R_UP];
+	sixs_atmos_params->T_a_down=res[SIXS_OUT_T_A_DOWN];
+	sixs_atmos_params->T_a_up=res[SIXS_OUT_T_A_UP];
+	sixs_atmos_params->rho_r=res[SIXS_OUT_RHO_R];
+	sixs_atmos_params->rho_a=res[SIXS_OUT_RHO_A];
+	sixs_atmos_params->T_g_wv=res[SIXS_OUT_T_G_WV];
+	sixs_atmos_params->T_g_og=res[SIXS_OUT_T_G_OZ]*res[SIXS_OUT_T_G_CO2]*
+		res[SIXS_OUT_T_G_O2]*res[SIXS_OUT_T_G_NO2]*res[SIXS_OUT_T_G_NO2]*
+		res[SIXS_OUT_T_G_CH4]*res[SIXS_OUT_T_G_CO];
 	return 0;
 }
 
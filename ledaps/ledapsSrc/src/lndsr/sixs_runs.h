@@ -4,7 +4,32 @@
 
 #define SIXS_NB_AOT 15
 #define SIXS_NB_BANDS 6
-#define SIXS_APP "sixsV1.0B"
+
+/* Size of the 6S input deck built in memory for one 6S run */
+#define SIXS_DECK_SIZE 16384
+
+/* Results returned by sixs_run (see subroutine sixs in 6sV-1.0B/main.f) */
+#define SIXS_OUT_T_G_WV 0       /* water vapor transmittance */
+#define SIXS_OUT_T_G_OZ 1       /* ozone transmittance */
+#define SIXS_OUT_T_G_CO2 2      /* co2 transmittance */
+#define SIXS_OUT_T_G_O2 3       /* oxygen transmittance */
+#define SIXS_OUT_T_G_NO2 4      /* no2 transmittance */
+#define SIXS_OUT_T_G_CH4 5      /* ch4 transmittance */
+#define SIXS_OUT_T_G_CO 6       /* co transmittance */
+#define SIXS_OUT_T_R_DOWN 7     /* Rayleigh transmittance Down */
+#define SIXS_OUT_T_R_UP 8       /* Rayleigh transmittance Up */
+#define SIXS_OUT_T_A_DOWN 9     /* aerosol transmittance Down */
+#define SIXS_OUT_T_A_UP 10      /* aerosol transmittance Up */
+#define SIXS_OUT_T_RA_DOWN 11   /* Rayleigh+aerosol transmittance Down */
+#define SIXS_OUT_T_RA_UP 12     /* Rayleigh+aerosol transmittance Up */
+#define SIXS_OUT_S_R 13         /* Rayleigh spherical albedo */
+#define SIXS_OUT_S_RA 14        /* Rayleigh+aerosol spherical albedo */
+#define SIXS_OUT_AOT 15         /* aerosol optical depth at the band */
+#define SIXS_OUT_RHO_R 16       /* rayleigh reflectance */
+#define SIXS_OUT_RHO_A 17       /* aerosol reflectance */
+#define SIXS_OUT_RHO_RA 18      /* rayleigh + aerosol reflectance */
+#define SIXS_OUT_RHO_TOA 19     /* apparent reflectance */
+#define SIXS_NB_OUT 20
 
 typedef enum {
   SIXS_INST_NULL = -1,
@@ -55,6 +80,17 @@ typedef struct {
 } sixs_atmos_params_t;
 
 int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta);
+void set_6S_aot_grid(sixs_tables_t *sixs_tables);
+int run_6S_tables(sixs_tables_t *sixs_tables);
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params);
 
+/* 6S entry point, in 6sV-1.0B/SIXSRUN.f: runs 6S on the ndeck characters
+   of input cards in deck and returns the SIXS_NB_OUT results.  Returns 0 on
+   success and non-zero if 6S failed, in which case results is not set. */
+int sixs_run(const char *deck, int ndeck, float *results);
+
+/* 6S fast mode, in 6sV-1.0B/SIXSRUN.f: returns non-zero if SIXS_FAST is set
+   and is neither empty nor "0" */
+int sixs_fast_mode(void);
+
 #endif
@@ -1,3 +1,5 @@
+#include <string.h>
+#include <math.h>
 #include "sr.h"
 #include "ar.h"
 #include "const.h"
@@ -12,97 +14,323 @@
  * - input saturated pixels are flagged as such and output as saturated
  */
 
-extern atmos_t atmos_coef;
 void SrInterpAtmCoef (Lut_t *lut, Img_coord_int_t *input_loc, atmos_t *atmos_coef, atmos_t *interpol_atmos_coef);
 
+/* Coefficients of Sr_coef_t, in the order of the column sums and of the
+   last valid coefficients */
+#define SR_TGOG 0
+#define SR_RHO_RA 1
+#define SR_T_RA 2
+#define SR_S_RA 3
+#define SR_NCOEF 4
+
+/* Find the two aerosol grid points around an image location along one
+   direction, with their interpolation weights (as in SrInterpAtmCoef) */
+static void SrGridPoints(int loc, int region_size, int grid_size, int *p0,
+    int *p1, double *w0, double *w1)
+{
+    int half = (region_size + 1) >> 1;   /* divide by 2 */
+
+    *p0 = (loc - half) / region_size;
+    *p1 = *p0 + 1;
+    if (*p1 >= grid_size) {
+        *p1 = grid_size - 1;
+        if (*p0 > 0)
+            (*p0)--;
+    }
+    *w0 = 1.0 - fabs((double)((loc - half) - *p0 * region_size)) /
+        region_size;
+    *w1 = 1.0 - fabs((double)((loc - half) - *p1 * region_size)) /
+        region_size;
+}
+
+bool SrInit
+(
+    Lut_t *lut,           /* I: lookup table information */
+    int nsamp,            /* I: number of samples of a line */
+    atmos_t *atmos_coef,  /* I: atmospheric coefficients of the aerosol grid */
+    Sr_coef_t *sr_coef    /* O: coefficients and buffers for Sr */
+)
+/* Reduce the atmospheric coefficients of each aerosol grid cell to the ones
+   used by the surface reflectance, and set up the interpolation along the
+   samples, which is the same for every line. */
+{
+    int ib, ipt, npt, is, ks0, ks1, nrun;
+    double w0, w1;
+
+    memset(sr_coef, 0, sizeof(*sr_coef));
+    sr_coef->nband = (lut->nband < NBAND_REFL_MAX) ? lut->nband :
+        NBAND_REFL_MAX;
+    sr_coef->ar_size = lut->ar_size;
+    sr_coef->nsamp = nsamp;
+    npt = lut->ar_size.l * lut->ar_size.s;
+
+    sr_coef->computed = calloc(npt, sizeof(bool));
+    sr_coef->run_start = calloc(nsamp + 1, sizeof(int));
+    sr_coef->run_ks0 = calloc(nsamp, sizeof(int));
+    sr_coef->run_ks1 = calloc(nsamp, sizeof(int));
+    sr_coef->ws0 = calloc(nsamp, sizeof(float));
+    sr_coef->ws1 = calloc(nsamp, sizeof(float));
+    sr_coef->col_sum = calloc(SR_NCOEF * sr_coef->nband * lut->ar_size.s,
+        sizeof(double));
+    sr_coef->col_w = calloc(lut->ar_size.s, sizeof(double));
+    sr_coef->col_n = calloc(lut->ar_size.s, sizeof(int));
+    sr_coef->inv_w = calloc(nsamp, sizeof(float));
+    sr_coef->rho = calloc(nsamp, sizeof(float));
+    if (sr_coef->computed == NULL || sr_coef->run_start == NULL ||
+        sr_coef->run_ks0 == NULL || sr_coef->run_ks1 == NULL ||
+        sr_coef->ws0 == NULL || sr_coef->ws1 == NULL ||
+        sr_coef->col_sum == NULL || sr_coef->col_w == NULL ||
+        sr_coef->col_n == NULL || sr_coef->inv_w == NULL ||
+        sr_coef->rho == NULL) {
+        SrFree(sr_coef);
+        RETURN_ERROR("allocating surface reflectance coefficients", "SrInit",
+            false);
+    }
+    for (ib = 0; ib < sr_coef->nband; ib++) {
+        sr_coef->tgOG[ib] = malloc(npt * sizeof(float));
+        sr_coef->rho_ra[ib] = malloc(npt * sizeof(float));
+        sr_coef->t_ra[ib] = malloc(npt * sizeof(float));
+        sr_coef->S_ra[ib] = malloc(npt * sizeof(float));
+        if (sr_coef->tgOG[ib] == NULL || sr_coef->rho_ra[ib] == NULL ||
+            sr_coef->t_ra[ib] == NULL || sr_coef->S_ra[ib] == NULL) {
+            SrFree(sr_coef);
+            RETURN_ERROR("allocating surface reflectance coefficients",
+                "SrInit", false);
+        }
+    }
+
+    /* Only the other gases transmittance, the atmospheric reflectance, the
+       total transmittance and the spherical albedo are used */
+    for (ipt = 0; ipt < npt; ipt++) {
+        sr_coef->computed[ipt] = (atmos_coef->computed[ipt] != 0);
+        for (ib = 0; ib < sr_coef->nband; ib++) {
+            sr_coef->tgOG[ib][ipt] = atmos_coef->tgOG[ib][ipt];
+            sr_coef->rho_ra[ib][ipt] = atmos_coef->rho_ra[ib][ipt];
+            sr_coef->t_ra[ib][ipt] = atmos_coef->tgH2O[ib][ipt] *
+                atmos_coef->td_ra[ib][ipt] * atmos_coef->tu_ra[ib][ipt];
+            sr_coef->S_ra[ib][ipt] = atmos_coef->S_ra[ib][ipt];
+        }
+    }
+
+    /* Runs of samples between the same two grid columns */
+    nrun = 0;
+    for (is = 0; is < nsamp; is++) {
+        SrGridPoints(is, lut->ar_region_size.s, lut->ar_size.s, &ks0, &ks1,
+            &w0, &w1);
+        if (is == 0 || ks0 != sr_coef->run_ks0[nrun-1] ||
+            ks1 != sr_coef->run_ks1[nrun-1]) {
+            sr_coef->run_start[nrun] = is;
+            sr_coef->run_ks0[nrun] = ks0;
+            sr_coef->run_ks1[nrun] = ks1;
+            nrun++;
+        }
+        sr_coef->ws0[is] = w0;
+        sr_coef->ws1[is] = w1;
+    }
+    sr_coef->run_start[nrun] = nsamp;
+    sr_coef->nrun = nrun;
+
+    /* Until a valid sample is found: no correction */
+    for (ib = 0; ib < sr_coef->nband; ib++) {
+        sr_coef->last[SR_TGOG][ib] = 1.;
+        sr_coef->last[SR_RHO_RA][ib] = 0.;
+        sr_coef->last[SR_T_RA][ib] = 1.;
+        sr_coef->last[SR_S_RA][ib] = 0.;
+    }
+    return true;
+}
+
+void SrFree(Sr_coef_t *sr_coef)
+{
+    int ib;
+
+    for (ib = 0; ib < NBAND_REFL_MAX; ib++) {
+        free(sr_coef->tgOG[ib]);
+        free(sr_coef->rho_ra[ib]);
+        free(sr_coef->t_ra[ib]);
+        free(sr_coef->S_ra[ib]);
+    }
+    free(sr_coef->computed);
+    free(sr_coef->run_start);
+    free(sr_coef->run_ks0);
+    free(sr_coef->run_ks1);
+    free(sr_coef->ws0);
+    free(sr_coef->ws1);
+    free(sr_coef->col_sum);
+    free(sr_coef->col_w);
+    free(sr_coef->col_n);
+    free(sr_coef->inv_w);
+    free(sr_coef->rho);
+    memset(sr_coef, 0, sizeof(*sr_coef));
+}
+
 bool Sr
 (
     Lut_t *lut,           /* I: lookup table information */
+    Sr_coef_t *sr_coef,   /* I: atmospheric coefficients (see SrInit) */
     int nsamp,            /* I: number of samples to be processed */
     int il,               /* I: current line being processed */
     int16 **line_in,      /* I: array of input lines, one for each band */
     int16 **line_out,     /* O: array of output lines, one for each band */
     Sr_stats_t *sr_stats  /* O: statistics for this line */
 )
+/* The atmospheric coefficients are interpolated bilinearly in the aerosol
+   grid, as in SrInterpAtmCoef, only from the computed grid points.  The
+   weights are separable, so the two grid lines around the current line are
+   first combined for every grid column, then each run of samples between
+   two grid columns is corrected in a loop without branches, over the
+   samples. */
 {
     int is;                   /* current sample in the line */
     int ib;                   /* current band for this pixel */
-    Img_coord_int_t loc;      /* line/sample location for current pix */
-    float rho;                /* surface reflectance value */
-    float tmpflt;             /* temporary float value for corrections */
-    atmos_t interpol_atmos_coef; /* interpolated atmospheric coefficients,
-                                    based on the current line/sample location
-                                    in the aerosol data grid */
-
-    /* Allocate memory for the interpolated atmospheric coefficients and
-       start the location for the current line */
-    allocate_mem_atmos_coeff (1, &interpol_atmos_coef);
-    loc.l = il;
-
-    /* loop through the samples in this line */
-    for (is = 0; is < nsamp; is++) {
-        loc.s = is;
+    int ir, ic, ks, ipt, kl[2], ks0, ks1, is0, is1;
+    int ncol = sr_coef->ar_size.s;
+    double wl[2];
+    double *col_sum;
+    float a0[SR_NCOEF], a1[SR_NCOEF], w0, w1;
+    float *ws0 = sr_coef->ws0, *ws1 = sr_coef->ws1;
+    float *inv_w = sr_coef->inv_w, *rho = sr_coef->rho;
+    float tg, rr, tt, sa, r;
+    int16 *in, *out;
+
+    if (nsamp != sr_coef->nsamp)
+        RETURN_ERROR("invalid number of samples", "Sr", false);
+
+    /* Combine the two grid lines around the current line, for each column.
+       NAZMI 6/2/04 : correct even cloudy pixels */
+    SrGridPoints(il, lut->ar_region_size.l, sr_coef->ar_size.l, &kl[0], &kl[1],
+        &wl[0], &wl[1]);
+    memset(sr_coef->col_sum, 0, SR_NCOEF * sr_coef->nband * ncol *
+        sizeof(double));
+    for (ks = 0; ks < ncol; ks++) {
+        sr_coef->col_w[ks] = 0.;
+        sr_coef->col_n[ks] = 0;
+        for (ir = 0; ir < 2; ir++) {
+            ipt = kl[ir] * ncol + ks;
+            if (!sr_coef->computed[ipt])
+                continue;
+            sr_coef->col_w[ks] += wl[ir];
+            sr_coef->col_n[ks]++;
+            for (ib = 0; ib < sr_coef->nband; ib++) {
+                col_sum = &sr_coef->col_sum[(ib * SR_NCOEF) * ncol];
+                col_sum[SR_TGOG * ncol + ks] += wl[ir] * sr_coef->tgOG[ib][ipt];
+                col_sum[SR_RHO_RA * ncol + ks] +=
+                    wl[ir] * sr_coef->rho_ra[ib][ipt];
+                col_sum[SR_T_RA * ncol + ks] += wl[ir] * sr_coef->t_ra[ib][ipt];
+                col_sum[SR_S_RA * ncol + ks] += wl[ir] * sr_coef->S_ra[ib][ipt];
+            }
+        }
+    }
 
-        /* Interpolate the atmospheric coefficients for the current line/sample
-           location */
-        /* NAZMI 6/2/04 : correct even cloudy pixels */
-        SrInterpAtmCoef (lut, &loc, &atmos_coef, &interpol_atmos_coef);
+    /* Inverse of the sum of the weights of each sample */
+    for (ir = 0; ir < sr_coef->nrun; ir++) {
+        ks0 = sr_coef->run_ks0[ir];
+        ks1 = sr_coef->run_ks1[ir];
+        w0 = sr_coef->col_w[ks0];
+        w1 = sr_coef->col_w[ks1];
+        for (is = sr_coef->run_start[ir]; is < sr_coef->run_start[ir+1]; is++)
+            inv_w[is] = 1. / (ws0[is] * w0 + ws1[is] * w1);
+    }
+
+    /* Loop through each band, correcting the line */
+    for (ib = 0; ib < sr_coef->nband; ib++) {
+        in = line_in[ib];
+        out = line_out[ib];
+        col_sum = &sr_coef->col_sum[(ib * SR_NCOEF) * ncol];
+
+        for (ir = 0; ir < sr_coef->nrun; ir++) {
+            ks0 = sr_coef->run_ks0[ir];
+            ks1 = sr_coef->run_ks1[ir];
+            is0 = sr_coef->run_start[ir];
+            is1 = sr_coef->run_start[ir+1];
+
+            if (sr_coef->col_n[ks0] + sr_coef->col_n[ks1] == 0) {
+                /* No computed grid point: keep the last valid coefficients */
+                tg = sr_coef->last[SR_TGOG][ib];
+                rr = sr_coef->last[SR_RHO_RA][ib];
+                tt = sr_coef->last[SR_T_RA][ib];
+                sa = sr_coef->last[SR_S_RA][ib];
+                for (is = is0; is < is1; is++) {
+                    r = ((float)in[is] * 0.0001f / tg - rr) / tt;
+                    rho[is] = r / (1.f + sa * r);
+                }
+                continue;
+            }
 
-        /* Loop through each band, correcting the pixel.  Fill and saturated
-           pixels are skipped and flagged. */
-        for (ib = 0; ib < lut->nband; ib++) {
-            if (line_in[ib][is] == lut->in_fill) {
+            for (ic = 0; ic < SR_NCOEF; ic++) {
+                a0[ic] = col_sum[ic * ncol + ks0];
+                a1[ic] = col_sum[ic * ncol + ks1];
+            }
+#ifdef _OPENMP
+            #pragma omp simd private (tg, rr, tt, sa, r)
+#endif
+            for (is = is0; is < is1; is++) {
+                tg = (ws0[is] * a0[SR_TGOG] + ws1[is] * a1[SR_TGOG]) *
+                    inv_w[is];
+                rr = (ws0[is] * a0[SR_RHO_RA] + ws1[is] * a1[SR_RHO_RA]) *
+                    inv_w[is];
+                tt = (ws0[is] * a0[SR_T_RA] + ws1[is] * a1[SR_T_RA]) *
+                    inv_w[is];
+                sa = (ws0[is] * a0[SR_S_RA] + ws1[is] * a1[SR_S_RA]) *
+                    inv_w[is];
+                r = ((float)in[is] * 0.0001f / tg - rr) / tt;
+                rho[is] = r / (1.f + sa * r);
+            }
+
+            /* Coefficients of the last sample, for runs without any computed
+               grid point */
+            is = is1 - 1;
+            for (ic = 0; ic < SR_NCOEF; ic++)
+                sr_coef->last[ic][ib] = (ws0[is] * a0[ic] + ws1[is] * a1[ic]) *
+                    inv_w[is];
+        }
+
+        /* Fill and saturated pixels are skipped and flagged, the others are
+           scaled and checked */
+        for (is = 0; is < nsamp; is++) {
+            if (in[is] == lut->in_fill) {
                 /* fill pixel */
-                line_out[ib][is] = lut->output_fill;
+                out[is] = lut->output_fill;
                 sr_stats->nfill[ib]++;
                 continue;
             }
-            else if (line_in[ib][is] == lut->in_satu) {
+            else if (in[is] == lut->in_satu) {
                 /* saturated pixel */
-                line_out[ib][is] = lut->output_satu;
+                out[is] = lut->output_satu;
                 sr_stats->nsatu[ib]++;
                 continue;
             }
             else {
-                rho = (float)line_in[ib][is] * 0.0001;
-                rho = (rho/interpol_atmos_coef.tgOG[ib][0] -
-                    interpol_atmos_coef.rho_ra[ib][0]);
-                tmpflt = interpol_atmos_coef.tgH2O[ib][0] *
-                    interpol_atmos_coef.td_ra[ib][0] *
-                    interpol_atmos_coef.tu_ra[ib][0];
-                rho /= tmpflt;
-                rho /= (1. + interpol_atmos_coef.S_ra[ib][0] * rho);
-    
                 /* Scale the reflectance value and store it as an int16 */
-                line_out[ib][is] = (short)(rho*10000.);  /* scale for output */
+                out[is] = (short)(rho[is]*10000.);  /* scale for output */
     
                 /* Verify the reflectance value is within the valid range */
-                if (line_out[ib][is] < lut->min_valid_sr) {
+                if (out[is] < lut->min_valid_sr) {
                     sr_stats->nout_range[ib]++;
-                    line_out[ib][is] = lut->min_valid_sr;
+                    out[is] = lut->min_valid_sr;
                 }
-                else if (line_out[ib][is] > lut->max_valid_sr) {
+                else if (out[is] > lut->max_valid_sr) {
                     sr_stats->nout_range[ib]++;
-                    line_out[ib][is] = lut->max_valid_sr;
+                    out[is] = lut->max_valid_sr;
                 }
             }
     
             /* Keep track of the min/max value for the stats */
             if (sr_stats->first[ib]) {
-                sr_stats->sr_min[ib] = sr_stats->sr_max[ib] = line_out[ib][is];
+                sr_stats->sr_min[ib] = sr_stats->sr_max[ib] = out[is];
                 sr_stats->first[ib] = false;
             }
             else {
-                if (line_out[ib][is] < sr_stats->sr_min[ib])
-                    sr_stats->sr_min[ib] = line_out[ib][is];
+                if (out[is] < sr_stats->sr_min[ib])
+                    sr_stats->sr_min[ib] = out[is];
     
-                else if (line_out[ib][is] > sr_stats->sr_max[ib])
-                    sr_stats->sr_max[ib] = line_out[ib][is];
+                else if (out[is] > sr_stats->sr_max[ib])
+                    sr_stats->sr_max[ib] = out[is];
             } 
-        }  /* end for ib */
-    }  /* end for is */
+        }  /* end for is */
+    }  /* end for ib */
 
-    free_mem_atmos_coeff(&interpol_atmos_coef);
     return true;
 }
 
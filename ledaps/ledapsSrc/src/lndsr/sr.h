@@ -15,7 +15,33 @@ typedef struct {
   long nout_range[NBAND_SR_MAX];
 } Sr_stats_t;
 
+/* Atmospheric correction coefficients of each aerosol grid cell, reduced to
+   the ones used by the surface reflectance, and the buffers of the
+   interpolation along a line (see SrInit) */
+typedef struct {
+  int nband;                    /* number of bands corrected */
+  Img_coord_int_t ar_size;      /* size of the aerosol grid */
+  int nsamp;                    /* number of samples of a line */
+  bool *computed;               /* coefficients computed for the cell */
+  float *tgOG[NBAND_REFL_MAX];  /* other gases transmittance */
+  float *rho_ra[NBAND_REFL_MAX]; /* atmospheric reflectance */
+  float *t_ra[NBAND_REFL_MAX];  /* tgH2O * td_ra * tu_ra */
+  float *S_ra[NBAND_REFL_MAX];  /* spherical albedo */
+  int nrun;                     /* number of runs of samples between the
+                                   same two grid columns */
+  int *run_start;               /* first sample of each run (nrun+1) */
+  int *run_ks0, *run_ks1;       /* grid columns around each run */
+  float *ws0, *ws1;             /* weights of the columns for each sample */
+  double *col_sum;              /* line interpolated sums of each column */
+  double *col_w;                /* line interpolated weights of each column */
+  int *col_n;                   /* number of computed cells of each column */
+  float *inv_w;                 /* inverse of the weight of each sample */
+  float *rho;                   /* surface reflectance of a line */
+  float last[4][NBAND_REFL_MAX]; /* coefficients of the last valid sample */
+} Sr_coef_t;
 
-bool Sr(Lut_t *lut, int nsamp, int il, int16 **line_in, int16 **line_out,
-        Sr_stats_t *sr_stats);
+bool SrInit(Lut_t *lut, int nsamp, atmos_t *atmos_coef, Sr_coef_t *sr_coef);
+void SrFree(Sr_coef_t *sr_coef);
+bool Sr(Lut_t *lut, Sr_coef_t *sr_coef, int nsamp, int il, int16 **line_in,
+        int16 **line_out, Sr_stats_t *sr_stats);
 #endif
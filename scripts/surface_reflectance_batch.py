@@ -0,0 +1,397 @@
+#! /usr/bin/env python
+
+'''
+    PURPOSE: Run the surface reflectance applications for a list of scenes on
+             one node, packing the scenes onto the node under a thread budget
+             and a memory budget.
+
+    PROJECT: Land Satellites Data Systems Science Research and Development
+             (LSRD) at the USGS EROS
+
+    LICENSE: NASA Open Source Agreement 1.3
+
+    NOTES:
+        Each scene is run with surface_reflectance.py's science application
+            (do_lasrc_landsat.py, do_lasrc_sentinel.py, or do_ledaps.py) in
+            the directory of its XML file, with OMP_NUM_THREADS set to the
+            threads given to the job.  Arguments which aren't batch options
+            are passed through to every application.
+        Each running job is given its own CPUs through OMP_PLACES, taken from
+            the CPUs freed by the jobs before it, so the jobs running at once
+            don't bind their threads to the same cores.  If the node threads
+            are more than the CPUs this process may run on, the threads are
+            left unbound (OMP_PROC_BIND=false).
+        The scenes are ordered by application family and auxiliary day, so
+            the scenes sharing an auxiliary file run together while it is in
+            the page cache.
+        The memory of a job is the peak RSS from its lasrc --estimate log,
+            <xml basename>.estimate in the estimate directory, if there is
+            one, or the default job memory otherwise.  A job is started when
+            its memory fits in the memory left on the node; the first job is
+            always started.
+        The threads of a job are the node threads divided by the number of
+            jobs which fit on the node at once, limited to the threads which
+            are free, so a lone scene gets the whole node and the tail of the
+            batch picks up the threads freed by the jobs before it.
+        The output of each job is written to <xml basename>.batch.log next to
+            its XML file.  The summary CSV has one line per scene with the
+            threads, wall time, and peak RSS of the job (which can be fed to
+            calibrate_lasrc_cost.py along with the estimate logs), followed
+            by the aggregate throughput as comments.
+'''
+
+import os
+import sys
+import time
+import logging
+import argparse
+import subprocess
+
+from surface_reflectance import get_science_application_name
+
+
+# Application families sharing the same auxiliary files
+LASRC_FAMILY = 'lasrc'
+LEDAPS_FAMILY = 'ledaps'
+
+# Fewest MB of memory a job is taken to need
+MIN_JOB_MEMORY_MB = 100.0
+
+
+class Job(object):
+    '''A scene to be run and, once started, the process running it'''
+
+    def __init__(self, xml_filename):
+        self.xml_filename = os.path.abspath(xml_filename)
+        self.basename = os.path.basename(xml_filename)
+        self.application = get_science_application_name(self.basename[0:4])
+        self.family = (LEDAPS_FAMILY
+                       if self.application == 'do_ledaps.py'
+                       else LASRC_FAMILY)
+        self.aux_day = get_aux_day(self.basename)
+        self.estimate_log = None
+        self.memory_mb = 0.0
+        self.threads = 0
+        self.cpus = []
+        self.process = None
+        self.log = None
+        self.start_time = 0.0
+        self.wall_sec = 0.0
+        self.max_rss_mb = 0.0
+        self.status = None
+
+
+def get_aux_day(basename):
+    '''Returns the acquisition date (YYYYMMDD) of a scene, which determines
+    the auxiliary files it reads
+
+    Note: Sentinel-2 names carry the date in the 5th field, and Landsat
+          collection names in the 4th, matching the do_lasrc_*.py scripts.
+    '''
+
+    fields = basename.split('_')
+    if basename[0:4] in ['S2A_', 'S2B_']:
+        return fields[4][0:8]
+    return fields[3][0:8]
+
+
+def read_estimate(estimate_log):
+    '''Returns the COST_ESTIMATE fields of a lasrc --estimate log, or None if
+    the log doesn't have them'''
+
+    with open(estimate_log, 'r') as fd:
+        for line in fd:
+            if line.startswith('COST_ESTIMATE '):
+                return dict((name, float(value)) for (name, value) in
+                            [field.split('=') for field in line.split()[1:]])
+    return None
+
+
+def get_node_memory_mb():
+    '''Returns the total memory of the node in MB'''
+
+    with open('/proc/meminfo', 'r') as fd:
+        for line in fd:
+            if line.startswith('MemTotal:'):
+                return float(line.split()[1]) / 1024.0
+    raise Exception('MemTotal not found in /proc/meminfo')
+
+
+def parse_cmd_line():
+    '''Parses the batch options; the remaining arguments are passed through to
+    the science applications'''
+
+    parser = argparse.ArgumentParser(
+        description='Run surface reflectance for a list of scenes on this '
+                    'node.  Unrecognized arguments are passed through to the '
+                    'science applications.')
+    parser.add_argument('--scene_list', action='store', dest='scene_list',
+                        required=True, metavar='FILE',
+                        help='file listing the XML files of the scenes, one '
+                             'per line')
+    parser.add_argument('--threads', action='store', dest='threads',
+                        type=int, default=0,
+                        help='threads available on the node (default: all '
+                             'the cores)')
+    parser.add_argument('--memory', action='store', dest='memory_mb',
+                        type=float, default=0.0,
+                        help='memory available on the node in MB (default: '
+                             '90%% of the node memory)')
+    parser.add_argument('--job_memory', action='store', dest='job_memory_mb',
+                        type=float, default=6000.0,
+                        help='memory of a job in MB when there is no '
+                             'estimate for it (default: 6000)')
+    parser.add_argument('--min_job_threads', action='store',
+                        dest='min_job_threads', type=int, default=2,
+                        help='fewest threads given to a job unless fewer are '
+                             'free (default: 2)')
+    parser.add_argument('--max_job_threads', action='store',
+                        dest='max_job_threads', type=int, default=16,
+                        help='most threads given to a job (default: 16)')
+    parser.add_argument('--estimate_dir', action='store',
+                        dest='estimate_dir', metavar='DIR',
+                        help='directory of the lasrc --estimate logs of the '
+                             'scenes, named <xml basename>.estimate')
+    parser.add_argument('--summary', action='store', dest='summary',
+                        default='surface_reflectance_batch.csv',
+                        metavar='FILE',
+                        help='summary CSV to be written (default: '
+                             'surface_reflectance_batch.csv)')
+
+    (args, passthrough_args) = parser.parse_known_args()
+
+    if args.job_memory_mb <= 0.0:
+        parser.error('--job_memory must be greater than 0')
+    if args.min_job_threads <= 0:
+        parser.error('--min_job_threads must be greater than 0')
+
+    return (args, passthrough_args)
+
+
+def read_jobs(args):
+    '''Reads the scene list and sets up the jobs in the order they are to
+    be started'''
+
+    logger = logging.getLogger(__name__)
+
+    jobs = []
+    with open(args.scene_list, 'r') as fd:
+        for line in fd:
+            xml_filename = line.strip()
+            if len(xml_filename) == 0 or xml_filename.startswith('#'):
+                continue
+            job = Job(xml_filename)
+
+            # Use the estimated memory of the job if there is one
+            job.memory_mb = args.job_memory_mb
+            if args.estimate_dir is not None:
+                estimate_log = os.path.join(args.estimate_dir,
+                                            job.basename + '.estimate')
+                if os.path.isfile(estimate_log):
+                    estimate = read_estimate(estimate_log)
+                    if estimate is not None:
+                        job.estimate_log = os.path.abspath(estimate_log)
+                        job.memory_mb = estimate.get('rss_mb',
+                                                     args.job_memory_mb)
+
+            # An estimate of no memory would pack the node without limit
+            job.memory_mb = max(job.memory_mb, MIN_JOB_MEMORY_MB)
+            jobs.append(job)
+
+    # Keep the scenes sharing auxiliary files together
+    jobs.sort(key=lambda job: (job.family, job.aux_day, job.basename))
+
+    logger.info('{0} scenes on {1} auxiliary days'
+                .format(len(jobs), len(set((job.family, job.aux_day)
+                                           for job in jobs))))
+    return jobs
+
+
+def get_node_cpus(node_threads):
+    '''Returns the CPUs the jobs are bound to, one per node thread, or None
+    if there aren't enough CPUs to bind them to'''
+
+    if hasattr(os, 'sched_getaffinity'):
+        cpus = sorted(os.sched_getaffinity(0))
+    else:
+        cpus = list(range(os.sysconf('SC_NPROCESSORS_ONLN')))
+    if node_threads > len(cpus):
+        return None
+    return cpus[0:node_threads]
+
+
+def start_job(job, threads, cpus, passthrough_args):
+    '''Starts the science application for a job with the given threads,
+    bound to the given CPUs unless they are None'''
+
+    logger = logging.getLogger(__name__)
+
+    job.threads = threads
+    job.cpus = cpus or []
+    job.log = open(job.xml_filename[:-len('.xml')] + '.batch.log', 'w')
+
+    # The applications default to binding their threads from the first core,
+    # so give each job its own places or the jobs would share the same cores
+    env = dict(os.environ)
+    env['OMP_NUM_THREADS'] = str(threads)
+    if cpus is None:
+        env['OMP_PROC_BIND'] = 'false'
+        env.pop('OMP_PLACES', None)
+    else:
+        env['OMP_PROC_BIND'] = 'close'
+        env['OMP_PLACES'] = ','.join('{{{0}}}'.format(cpu) for cpu in cpus)
+    cmd = ([job.application, '--xml', job.xml_filename] +
+           passthrough_args)
+
+    logger.info('Starting {0} with {1} threads and {2:.0f} MB: {3}'
+                .format(job.basename, threads, job.memory_mb,
+                        ' '.join(cmd)))
+    job.start_time = time.time()
+    job.process = subprocess.Popen(cmd, stdout=job.log,
+                                   stderr=subprocess.STDOUT, env=env,
+                                   cwd=os.path.dirname(job.xml_filename))
+
+
+def reap_jobs(running):
+    '''Collects the jobs which have finished, with their wall time and peak
+    RSS, and returns the ones still running'''
+
+    logger = logging.getLogger(__name__)
+
+    still_running = []
+    for job in running:
+        (pid, status, rusage) = os.wait4(job.process.pid, os.WNOHANG)
+        if pid == 0:
+            still_running.append(job)
+            continue
+
+        # ru_maxrss covers the application and the children it waited for,
+        # in KB on Linux
+        job.wall_sec = time.time() - job.start_time
+        job.max_rss_mb = rusage.ru_maxrss / 1024.0
+        job.status = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        job.process.returncode = job.status
+        job.log.close()
+        logger.info('Finished {0} with status {1} in {2:.0f} s, peak RSS '
+                    '{3:.0f} MB'.format(job.basename, job.status,
+                                        job.wall_sec, job.max_rss_mb))
+    return still_running
+
+
+def run_jobs(jobs, node_threads, node_memory_mb, args, passthrough_args):
+    '''Runs the jobs, starting each one as soon as its memory and threads
+    are free'''
+
+    pending = list(jobs)
+    running = []
+    node_cpus = get_node_cpus(node_threads)
+    while len(pending) > 0 or len(running) > 0:
+        running = reap_jobs(running)
+        if node_cpus is not None:
+            busy_cpus = set(cpu for j in running for cpu in j.cpus)
+            free_cpus = [cpu for cpu in node_cpus if cpu not in busy_cpus]
+
+        while len(pending) > 0:
+            job = pending[0]
+            free_threads = node_threads - sum(j.threads for j in running)
+            free_memory_mb = node_memory_mb - sum(j.memory_mb
+                                                  for j in running)
+
+            # Wait for memory and threads unless the node is idle
+            if len(running) > 0 and (job.memory_mb > free_memory_mb or
+                                     free_threads < args.min_job_threads):
+                break
+
+            # Split the node between the jobs which fit on it at once
+            remaining = len(pending) + len(running)
+            fit_jobs = min(remaining,
+                           max(1, int(node_memory_mb // job.memory_mb)),
+                           max(1, node_threads // args.min_job_threads))
+            threads = node_threads // fit_jobs
+            threads = max(args.min_job_threads,
+                          min(threads, args.max_job_threads))
+            threads = max(1, min(threads, free_threads))
+
+            cpus = None
+            if node_cpus is not None:
+                cpus = free_cpus[0:threads]
+                free_cpus = free_cpus[threads:]
+            start_job(job, threads, cpus, passthrough_args)
+            running.append(job)
+            pending.pop(0)
+
+        time.sleep(1)
+
+
+def write_summary(jobs, node_threads, elapsed_sec, summary):
+    '''Writes the per-scene results and the aggregate throughput'''
+
+    logger = logging.getLogger(__name__)
+
+    nfailed = len([job for job in jobs if job.status != 0])
+    thread_sec = sum(job.threads * job.wall_sec for job in jobs)
+    with open(summary, 'w') as fd:
+        fd.write('xml,application,aux_day,estimate_log,threads,memory_mb,'
+                 'wall_sec,max_rss_mb,status\n')
+        for job in jobs:
+            fd.write('{0},{1},{2},{3},{4},{5:.0f},{6:.1f},{7:.1f},{8}\n'
+                     .format(job.xml_filename, job.application, job.aux_day,
+                             job.estimate_log or '', job.threads,
+                             job.memory_mb, job.wall_sec, job.max_rss_mb,
+                             job.status))
+        fd.write('# scenes: {0}, failed: {1}\n'.format(len(jobs), nfailed))
+        fd.write('# elapsed: {0:.1f} s, throughput: {1:.2f} scenes/hour\n'
+                 .format(elapsed_sec, 3600.0 * len(jobs) / elapsed_sec))
+        fd.write('# mean scene wall time: {0:.1f} s, thread utilization: '
+                 '{1:.1f}%\n'
+                 .format(sum(job.wall_sec for job in jobs) / len(jobs),
+                         100.0 * thread_sec / (node_threads * elapsed_sec)))
+
+    logger.info('{0} scenes ({1} failed) in {2:.0f} s, {3:.2f} scenes/hour.  '
+                'Summary: {4}'.format(len(jobs), nfailed, elapsed_sec,
+                                      3600.0 * len(jobs) / elapsed_sec,
+                                      summary))
+    return nfailed
+
+
+def main():
+    '''Reads the scene list, runs the scenes, and writes the summary'''
+
+    # Setup the default logger format and level.  Log to STDOUT.
+    logging.basicConfig(format=('%(asctime)s.%(msecs)03d %(process)d'
+                                ' %(levelname)-8s'
+                                ' %(filename)s:%(lineno)d:'
+                                '%(funcName)s -- %(message)s'),
+                        datefmt='%Y-%m-%d %H:%M:%S',
+                        level=logging.INFO,
+                        stream=sys.stdout)
+
+    # Get the logger
+    logger = logging.getLogger(__name__)
+
+    (args, passthrough_args) = parse_cmd_line()
+
+    node_threads = args.threads
+    if node_threads <= 0:
+        node_threads = os.sysconf('SC_NPROCESSORS_ONLN')
+    node_memory_mb = args.memory_mb
+    if node_memory_mb <= 0.0:
+        node_memory_mb = 0.9 * get_node_memory_mb()
+    logger.info('Node budget: {0} threads, {1:.0f} MB'
+                .format(node_threads, node_memory_mb))
+
+    jobs = read_jobs(args)
+    if len(jobs) == 0:
+        logger.error('No scenes in {0}'.format(args.scene_list))
+        sys.exit(1)
+
+    start_time = time.time()
+    run_jobs(jobs, node_threads, node_memory_mb, args, passthrough_args)
+    nfailed = write_summary(jobs, node_threads,
+                            max(time.time() - start_time, 1.0), args.summary)
+
+    if nfailed > 0:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()